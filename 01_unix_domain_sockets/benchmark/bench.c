@@ -0,0 +1,502 @@
+/**------------------------------------------------------------------------------------------------
+ * ?                                           ABOUT
+ * @author         :  Nguyen Dinh Hoan
+ * @email          :  hoann.wk@gmail.com
+ * @repo           :  https://github.com/hoan9x/IPC-in-Linux
+ * @createdOn      :  16-Oct-2026
+ * @description    :  Latency and throughput benchmark: spawns a server variant, drives it with M clients
+ *                    sending PING frames back-to-back, and reports one machine-readable row per run
+ *------------------------------------------------------------------------------------------------**/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <errno.h>
+#include <libgen.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../common/frame.h"
+#include "../common/histogram.h"
+#include "../common/socket_mode.h"
+
+/* LOG macro function, on stderr because stdout carries the results */
+#define LOG_INFO(format, ...) do { fprintf(stderr, "[BENCH_INFO] " format "\n", ##__VA_ARGS__); } while (0)
+#define LOG_ERROR(format, ...) do { fprintf(stderr, "[BENCH_ERROR] " format "\n", ##__VA_ARGS__); } while (0)
+
+#define DEFAULT_SERVERS "multiplexing_server.app,multiplexing_server2.app,multiplexing_server3.app," \
+                        "multiplexing_server4.app,multiplexing_server5.app,multiplexing_server6.app"
+#define DEFAULT_CLIENTS "1,8,64"
+#define DEFAULT_SIZES "16,256,4096"
+#define DEFAULT_DURATION_MS 2000
+#define DEFAULT_WARMUP_MS 200
+#define MAX_LIST_ITEMS 32
+#define MAX_SERVER_ARGS 16
+/* How long the server gets to create its socket, and a client to wait for one reply */
+#define SERVER_START_TIMEOUT_MS 3000
+#define REPLY_TIMEOUT_MS 5000
+#define SERVER_STOP_TIMEOUT_MS 1000
+
+enum OutputFormat
+{
+    OUTPUT_CSV,
+    OUTPUT_JSON,
+};
+
+/* Shared by the client threads of one run */
+struct RunControl
+{
+    const char *socketPath;
+    uint32_t messageSize;
+    atomic_bool isMeasuring;
+    atomic_bool isStopping;
+    pthread_barrier_t startBarrier;
+};
+
+struct ClientResult
+{
+    struct Histogram latency;   /* round-trip time in nanoseconds, measured phase only */
+    uint64_t messages;
+    uint64_t errors;
+};
+
+struct ClientThread
+{
+    pthread_t thread;
+    struct RunControl *control;
+    struct ClientResult result;
+};
+
+/* Socket type of every client, the servers get the same "-t mode" option */
+static enum SocketMode socketMode = SOCKET_MODE_STREAM;
+
+static uint64_t nowNs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+static void sleepMs(int ms)
+{
+    struct timespec duration = {.tv_sec = ms / 1000, .tv_nsec = (ms % 1000) * 1000000L};
+    while (nanosleep(&duration, &duration) < 0 && EINTR == errno)
+        ;
+}
+
+/* Split a comma separated list in place, return the number of items */
+static int splitList(char *list, char *items[], int maxItems)
+{
+    int count = 0;
+    for (char *item = strtok(list, ","); item && count < maxItems; item = strtok(NULL, ","))
+        items[count++] = item;
+    return count;
+}
+
+static int connectTo(const char *socketPath)
+{
+    struct sockaddr_un structSocketInfo;
+    memset(&structSocketInfo, 0, sizeof(struct sockaddr_un));
+    structSocketInfo.sun_family = AF_UNIX;
+    strncpy(structSocketInfo.sun_path, socketPath, sizeof(structSocketInfo.sun_path)-1);
+
+    int dataSocket = socket(AF_UNIX, socketModeType(socketMode) | SOCK_CLOEXEC, 0);
+    if (dataSocket < 0)
+        return -1;
+    /* A datagram client needs an address of its own for the pongs */
+    if (SOCKET_MODE_DGRAM == socketMode && socketAutobind(dataSocket) < 0)
+    {
+        close(dataSocket);
+        return -1;
+    }
+    /**
+     * A server that stops answering fails the run instead of hanging it. The send timeout also bounds
+     * connect(), which blocks on a UNIX socket while the backlog of the server is full.
+     **/
+    struct timeval timeout = {.tv_sec = REPLY_TIMEOUT_MS / 1000, .tv_usec = (REPLY_TIMEOUT_MS % 1000) * 1000};
+    setsockopt(dataSocket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(dataSocket, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    if (connect(dataSocket, (const struct sockaddr *)&structSocketInfo, sizeof(struct sockaddr_un)) < 0)
+    {
+        close(dataSocket);
+        return -1;
+    }
+    return dataSocket;
+}
+
+/**
+ * Receive the reply to one PING. A stream is parsed, on a seqpacket or datagram socket the reply is one message
+ * received in buffer, which has room for one byte more than the expected frame so a longer one is detected.
+ * Return 1 and fill frame, or -1 on error.
+ **/
+static int receiveReply(int dataSocket, struct FrameParser *parser, char *buffer, size_t size, struct Frame *frame)
+{
+    int ret;
+    if (SOCKET_MODE_STREAM != socketMode)
+    {
+        ssize_t length = recv(dataSocket, buffer, size, 0);
+        if (length < (ssize_t)FRAME_HEADER_SIZE)
+            return -1;
+        memcpy(&frame->header, buffer, FRAME_HEADER_SIZE);
+        frame->payload = buffer + FRAME_HEADER_SIZE;
+        return (FRAME_HEADER_SIZE + frame->header.length == (size_t)length) ? 1 : -1;
+    }
+    while (0 == (ret = frameParserNext(parser, frame)))
+    {
+        if (frameParserRead(parser, dataSocket) <= 0)
+            return -1;
+    }
+    return ret;
+}
+
+/**
+ * One closed-loop client: send a PING, wait for its PONG, repeat. Only the round trips completed while
+ * the run is in its measured phase are counted, the warm-up fills the caches and the server tables.
+ **/
+static void *clientMain(void *arg)
+{
+    struct ClientThread *self = arg;
+    struct RunControl *control = self->control;
+    struct FrameParser parser;
+    struct Frame frame;
+    char *payload = malloc(control->messageSize ? control->messageSize : 1);
+    size_t replySize = FRAME_HEADER_SIZE + control->messageSize + 1;
+    char *reply = (SOCKET_MODE_STREAM != socketMode) ? malloc(replySize) : NULL;
+    int dataSocket = connectTo(control->socketPath);
+
+    frameParserInit(&parser);
+    histogramInit(&self->result.latency);
+    pthread_barrier_wait(&control->startBarrier);
+    if (dataSocket < 0 || !payload || (SOCKET_MODE_STREAM != socketMode && !reply))
+    {
+        self->result.errors++;
+        goto done;
+    }
+    memset(payload, 'x', control->messageSize);
+
+    for (uint32_t seq = 0; !atomic_load_explicit(&control->isStopping, memory_order_relaxed); ++seq)
+    {
+        uint64_t startNs = nowNs();
+        if (frameWrite(dataSocket, FRAME_TYPE_PING, seq, payload, control->messageSize) < 0)
+        {
+            self->result.errors++;
+            break;
+        }
+        int ret = receiveReply(dataSocket, &parser, reply, replySize, &frame);
+        if (ret < 0 || FRAME_TYPE_PONG != frame.header.type || seq != frame.header.seq ||
+            control->messageSize != frame.header.length)
+        {
+            self->result.errors++;
+            break;
+        }
+        if (atomic_load_explicit(&control->isMeasuring, memory_order_relaxed))
+        {
+            histogramRecord(&self->result.latency, nowNs() - startNs);
+            self->result.messages++;
+        }
+    }
+
+done:
+    if (dataSocket >= 0)
+        close(dataSocket);
+    frameParserRelease(&parser);
+    free(reply);
+    free(payload);
+    return NULL;
+}
+
+/**
+ * Start "app [args...] socketPath" with stdout/stderr discarded. stdin is a pipe that is kept open and
+ * never written, so the servers monitoring stdin neither read the terminal nor spin on an EOF.
+ **/
+static pid_t startServer(const char *appDir, const char *serverSpec, const char *socketPath, int *stdinPipe)
+{
+    char spec[PATH_MAX], app[PATH_MAX];
+    char *args[MAX_SERVER_ARGS + 2];
+    int numArgs = 0, length;
+
+    length = snprintf(spec, sizeof(spec), "%s", serverSpec);
+    if (length < 0 || (size_t)length >= sizeof(spec))
+    {
+        LOG_ERROR("Server command [%.64s...] is too long", serverSpec);
+        return -1;
+    }
+    for (char *arg = strtok(spec, " "); arg && numArgs < MAX_SERVER_ARGS; arg = strtok(NULL, " "))
+        args[numArgs++] = arg;
+    if (0 == numArgs)
+        return -1;
+    /* A bare executable name is looked up next to the benchmark */
+    if (strchr(args[0], '/'))
+        length = snprintf(app, sizeof(app), "%s", args[0]);
+    else
+        length = snprintf(app, sizeof(app), "%s/%s", appDir, args[0]);
+    /* A cut path would start some other executable, or none */
+    if (length < 0 || (size_t)length >= sizeof(app))
+    {
+        LOG_ERROR("Path of server [%.64s...] is too long", args[0]);
+        return -1;
+    }
+    args[numArgs++] = (char *)socketPath;
+    args[numArgs] = NULL;
+
+    if (pipe2(stdinPipe, O_CLOEXEC) < 0)
+        return -1;
+    pid_t pid = fork();
+    if (0 == pid)
+    {
+        int devNull = open("/dev/null", O_WRONLY);
+        dup2(stdinPipe[0], STDIN_FILENO);
+        dup2(devNull, STDOUT_FILENO);
+        dup2(devNull, STDERR_FILENO);
+        execv(app, args);
+        _exit(127);
+    }
+    close(stdinPipe[0]);
+    if (pid < 0)
+    {
+        close(stdinPipe[1]);
+        return -1;
+    }
+
+    /* The server is ready once a connection is accepted by the kernel */
+    for (int waitedMs = 0; waitedMs < SERVER_START_TIMEOUT_MS; waitedMs += 10)
+    {
+        int probe = connectTo(socketPath);
+        if (probe >= 0)
+        {
+            close(probe);
+            return pid;
+        }
+        if (pid == waitpid(pid, NULL, WNOHANG))
+            break;
+        sleepMs(10);
+    }
+    LOG_ERROR("Server [%s] did not start", serverSpec);
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+    close(stdinPipe[1]);
+    return -1;
+}
+
+/* Ask the server to stop with SIGINT like Ctrl+C, and kill it if it does not */
+static void stopServer(pid_t pid, int *stdinPipe, const char *socketPath)
+{
+    kill(pid, SIGINT);
+    for (int waitedMs = 0; waitedMs < SERVER_STOP_TIMEOUT_MS; waitedMs += 10)
+    {
+        if (pid == waitpid(pid, NULL, WNOHANG))
+            goto stopped;
+        sleepMs(10);
+    }
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+stopped:
+    close(stdinPipe[1]);
+    unlink(socketPath);
+}
+
+static void printHeader(enum OutputFormat format)
+{
+    if (OUTPUT_CSV == format)
+    {
+        printf("server,clients,size,duration_s,messages,msgs_per_sec,mb_per_sec,mean_us,p50_us,p99_us,p999_us,max_us,errors\n");
+        fflush(stdout);
+    }
+}
+
+static void printResult(enum OutputFormat format, const char *server, int clients, uint32_t size, double seconds,
+                        const struct Histogram *latency, uint64_t messages, uint64_t errors)
+{
+    double msgsPerSec = seconds > 0 ? messages / seconds : 0.0;
+    /* Payload bytes of the requests, the replies carry as many back */
+    double mbPerSec = msgsPerSec * size / (1024.0 * 1024.0);
+    double p50 = histogramPercentile(latency, 50.0) / 1000.0;
+    double p99 = histogramPercentile(latency, 99.0) / 1000.0;
+    double p999 = histogramPercentile(latency, 99.9) / 1000.0;
+    double maxUs = latency->count ? latency->max / 1000.0 : 0.0;
+
+    if (OUTPUT_CSV == format)
+    {
+        printf("\"%s\",%d,%u,%.3f,%llu,%.0f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%llu\n", server, clients, size, seconds,
+               (unsigned long long)messages, msgsPerSec, mbPerSec, histogramMean(latency) / 1000.0, p50, p99, p999,
+               maxUs, (unsigned long long)errors);
+    }
+    else
+    {
+        printf("{\"server\":\"%s\",\"clients\":%d,\"size\":%u,\"duration_s\":%.3f,\"messages\":%llu,"
+               "\"msgs_per_sec\":%.0f,\"mb_per_sec\":%.2f,\"mean_us\":%.2f,\"p50_us\":%.2f,\"p99_us\":%.2f,"
+               "\"p999_us\":%.2f,\"max_us\":%.2f,\"errors\":%llu}\n", server, clients, size, seconds,
+               (unsigned long long)messages, msgsPerSec, mbPerSec, histogramMean(latency) / 1000.0, p50, p99, p999,
+               maxUs, (unsigned long long)errors);
+    }
+    fflush(stdout);
+}
+
+/* One server, one client count, one message size. Return false when the server could not be started */
+static bool runOnce(const char *appDir, const char *server, int numClients, uint32_t size, int warmupMs, int durationMs,
+                    enum OutputFormat format)
+{
+    char socketPath[sizeof(((struct sockaddr_un *)0)->sun_path)];
+    char serverSpec[PATH_MAX];
+    int stdinPipe[2];
+    snprintf(socketPath, sizeof(socketPath), "/tmp/ipc-bench-%d.sock", (int)getpid());
+    unlink(socketPath);
+
+    /* The mode is part of the server name in the results, so runs of different modes are not compared */
+    int length;
+    if (SOCKET_MODE_STREAM == socketMode)
+        length = snprintf(serverSpec, sizeof(serverSpec), "%s", server);
+    else
+        length = snprintf(serverSpec, sizeof(serverSpec), "%s -t %s", server, socketModeName(socketMode));
+    if (length < 0 || (size_t)length >= sizeof(serverSpec))
+    {
+        LOG_ERROR("Server command [%.64s...] is too long", server);
+        return false;
+    }
+    pid_t pid = startServer(appDir, serverSpec, socketPath, stdinPipe);
+    if (pid < 0)
+        return false;
+
+    struct RunControl control = {.socketPath = socketPath, .messageSize = size};
+    atomic_init(&control.isMeasuring, false);
+    atomic_init(&control.isStopping, false);
+    pthread_barrier_init(&control.startBarrier, NULL, numClients + 1);
+    struct ClientThread *clients = calloc(numClients, sizeof(struct ClientThread));
+    int started = 0;
+    for (; clients && started < numClients; ++started)
+    {
+        clients[started].control = &control;
+        if (0 != pthread_create(&clients[started].thread, NULL, clientMain, &clients[started]))
+            break;
+    }
+    if (started != numClients)
+    {
+        /* The barrier counts every client, a run with missing threads can not start */
+        LOG_ERROR("Creating %d client threads failed", numClients);
+        exit(EXIT_FAILURE);
+    }
+
+    pthread_barrier_wait(&control.startBarrier);
+    sleepMs(warmupMs);
+    uint64_t startNs = nowNs();
+    atomic_store(&control.isMeasuring, true);
+    sleepMs(durationMs);
+    atomic_store(&control.isMeasuring, false);
+    uint64_t endNs = nowNs();
+    atomic_store(&control.isStopping, true);
+
+    struct Histogram *latency = malloc(sizeof(struct Histogram));
+    uint64_t messages = 0, errors = 0;
+    histogramInit(latency);
+    for (int i = 0; i < numClients; ++i)
+    {
+        pthread_join(clients[i].thread, NULL);
+        histogramMerge(latency, &clients[i].result.latency);
+        messages += clients[i].result.messages;
+        errors += clients[i].result.errors;
+    }
+    stopServer(pid, stdinPipe, socketPath);
+
+    printResult(format, serverSpec, numClients, size, (endNs - startNs) / 1e9, latency, messages, errors);
+    free(latency);
+    free(clients);
+    pthread_barrier_destroy(&control.startBarrier);
+    return true;
+}
+
+static void printUsage(const char *appName)
+{
+    printf("Usage: %s [-s servers] [-c clients] [-m sizes] [-d duration_ms] [-w warmup_ms] [-t " SOCKET_MODE_NAMES "] [-f csv|json]\n", appName);
+    printf("  -s  Comma separated server commands, arguments separated by spaces, the socket path is appended\n");
+    printf("      (default %s)\n", DEFAULT_SERVERS);
+    printf("  -c  Comma separated client counts (default %s)\n", DEFAULT_CLIENTS);
+    printf("  -m  Comma separated payload sizes in bytes (default %s)\n", DEFAULT_SIZES);
+    printf("  -d  Measured duration of each run in milliseconds (default %d)\n", DEFAULT_DURATION_MS);
+    printf("  -w  Warm-up of each run in milliseconds, not measured (default %d)\n", DEFAULT_WARMUP_MS);
+    printf("  -t  Socket type of the clients, also passed to the servers with -t when it is not stream (default stream)\n");
+    printf("  -f  Output format, one row per run on stdout (default csv)\n");
+}
+
+int main(int argc, char *argv[])
+{
+    char serverList[4096] = DEFAULT_SERVERS, clientList[256] = DEFAULT_CLIENTS, sizeList[256] = DEFAULT_SIZES;
+    int durationMs = DEFAULT_DURATION_MS, warmupMs = DEFAULT_WARMUP_MS, opt;
+    enum OutputFormat format = OUTPUT_CSV;
+    while (-1 != (opt = getopt(argc, argv, "s:c:m:d:w:t:f:h")))
+    {
+        switch (opt)
+        {
+            case 's': snprintf(serverList, sizeof(serverList), "%s", optarg); break;
+            case 'c': snprintf(clientList, sizeof(clientList), "%s", optarg); break;
+            case 'm': snprintf(sizeList, sizeof(sizeList), "%s", optarg); break;
+            case 'd': durationMs = atoi(optarg); break;
+            case 'w': warmupMs = atoi(optarg); break;
+            case 't':
+                if (socketModeParse(optarg, &socketMode) < 0)
+                {
+                    printUsage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'f': format = (0 == strcmp(optarg, "json")) ? OUTPUT_JSON : OUTPUT_CSV; break;
+            default: printUsage(argv[0]); return (opt == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    char *servers[MAX_LIST_ITEMS], *clients[MAX_LIST_ITEMS], *sizes[MAX_LIST_ITEMS];
+    int numServers = splitList(serverList, servers, MAX_LIST_ITEMS);
+    int numClientCounts = splitList(clientList, clients, MAX_LIST_ITEMS);
+    int numSizes = splitList(sizeList, sizes, MAX_LIST_ITEMS);
+
+    /* The server executables are next to the benchmark executable */
+    char appDir[PATH_MAX];
+    ssize_t len = readlink("/proc/self/exe", appDir, sizeof(appDir) - 1);
+    appDir[len > 0 ? len : 0] = '\0';
+    dirname(appDir);
+
+    /* Every client is a connection, and the servers inherit this limit too */
+    struct rlimit limit;
+    if (0 == getrlimit(RLIMIT_NOFILE, &limit) && limit.rlim_cur < limit.rlim_max)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+    /* A server dying in the middle of a run must fail the write, not kill the benchmark */
+    signal(SIGPIPE, SIG_IGN);
+
+    int failures = 0;
+    printHeader(format);
+    for (int s = 0; s < numServers; ++s)
+    {
+        for (int c = 0; c < numClientCounts; ++c)
+        {
+            for (int m = 0; m < numSizes; ++m)
+            {
+                int numClients = atoi(clients[c]);
+                uint32_t size = (uint32_t)strtoul(sizes[m], NULL, 0);
+                /* A seqpacket or datagram message holds the whole frame */
+                uint32_t maxSize = (SOCKET_MODE_STREAM == socketMode) ? FRAME_MAX_PAYLOAD : SOCKET_MESSAGE_MAX_SIZE - FRAME_HEADER_SIZE;
+                if (numClients <= 0 || size > maxSize)
+                {
+                    LOG_ERROR("Skipping invalid run: %s clients, %s bytes", clients[c], sizes[m]);
+                    continue;
+                }
+                LOG_INFO("Running [%s] with %d clients, %u bytes", servers[s], numClients, size);
+                if (!runOnce(appDir, servers[s], numClients, size, warmupMs, durationMs, format))
+                    failures++;
+            }
+        }
+    }
+
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
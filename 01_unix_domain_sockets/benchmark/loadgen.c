@@ -0,0 +1,595 @@
+/**------------------------------------------------------------------------------------------------
+ * ?                                           ABOUT
+ * @author         :  Nguyen Dinh Hoan
+ * @email          :  hoann.wk@gmail.com
+ * @repo           :  https://github.com/hoan9x/IPC-in-Linux
+ * @createdOn      :  16-Oct-2026
+ * @description    :  Open-loop load generator: thousands of connections driven by one epoll() loop at
+ *                    a target request rate, latency corrected for coordinated omission
+ *------------------------------------------------------------------------------------------------**/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "../common/frame.h"
+#include "../common/histogram.h"
+
+/* LOG macro function, on stderr because stdout carries the results */
+#define LOG_INFO(format, ...) do { fprintf(stderr, "[LOADGEN_INFO] " format "\n", ##__VA_ARGS__); } while (0)
+#define LOG_ERROR(format, ...) do { fprintf(stderr, "[LOADGEN_ERROR] " format "\n", ##__VA_ARGS__); } while (0)
+
+#define DEFAULT_SOCKET_PATH "/tmp/ipc-demo.sock"
+#define DEFAULT_CONNECTIONS 1000
+#define DEFAULT_RATES "10000"
+#define DEFAULT_SIZES "16,256,4096"
+#define DEFAULT_DURATION_MS 5000
+#define DEFAULT_WARMUP_MS 1000
+#define MAX_LIST_ITEMS 32
+#define MAX_EVENTS_PER_WAIT 256
+/* Time given to the requests still unanswered once the schedule is over, they are errors after it */
+#define DRAIN_TIMEOUT_MS 5000
+/* Bounds connect(), which blocks while the backlog of the server is full */
+#define CONNECT_TIMEOUT_MS 5000
+
+enum OutputFormat
+{
+    OUTPUT_CSV,
+    OUTPUT_JSON,
+};
+
+enum Arrival
+{
+    ARRIVAL_FIXED,      /* one request every 1/rate seconds */
+    ARRIVAL_POISSON,    /* exponential gaps of mean 1/rate, as independent users would send */
+};
+
+/* One request sent and not answered yet, replies come back in order on a stream */
+struct Request
+{
+    uint64_t intendedNs;    /* when the schedule wanted it sent, the corrected latency starts here */
+    uint64_t sentNs;        /* when its last byte was taken by the socket, 0 until then */
+    uint64_t endOffset;     /* position of its last byte in the output stream of the connection */
+    uint32_t seq;
+    uint32_t size;
+};
+
+struct LoadConn
+{
+    int fd;
+    bool isDead;
+    uint32_t events;            /* events registered to epoll */
+    uint32_t nextSeq;
+    struct FrameParser parser;
+    /* Requests in flight, a ring that doubles when full */
+    struct Request *requests;
+    size_t head;
+    size_t count;
+    size_t capacity;
+    size_t firstUnsent;         /* index after head of the first request not fully written */
+    /* Bytes the socket did not take yet */
+    char *output;
+    size_t outputStart;
+    size_t outputEnd;
+    size_t outputCapacity;
+    uint64_t bytesQueued;       /* ever appended to output */
+    uint64_t bytesSent;         /* ever written */
+};
+
+/* State of one run at one target rate */
+struct Run
+{
+    struct LoadConn *conns;
+    int numConns;
+    int nextConn;
+    int epollFd;
+    uint64_t measureStartNs;    /* requests intended before this are the warm-up, not recorded */
+    uint64_t lastReplyNs;
+    uint64_t outstanding;
+    uint64_t sent;              /* measured requests */
+    uint64_t completed;
+    uint64_t errors;
+    struct Histogram corrected; /* reply time - intended send time */
+    struct Histogram raw;       /* reply time - actual send time, what a closed-loop client would report */
+};
+
+static uint32_t sizes[MAX_LIST_ITEMS];
+static int numSizes;
+static char *payload;
+static uint64_t rngState = 0x9e3779b97f4a7c15ull;
+
+static uint64_t nowNs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+/* xorshift64*, enough for arrival gaps and size picks */
+static uint64_t nextRandom()
+{
+    rngState ^= rngState >> 12;
+    rngState ^= rngState << 25;
+    rngState ^= rngState >> 27;
+    return rngState * 2685821657736338717ull;
+}
+
+/* Uniform in (0, 1] */
+static double nextUniform()
+{
+    return ((nextRandom() >> 11) + 1) * (1.0 / 9007199254740992.0);
+}
+
+static uint64_t nextGapNs(enum Arrival arrival, double rate)
+{
+    if (ARRIVAL_FIXED == arrival)
+        return (uint64_t)(1e9 / rate);
+    return (uint64_t)(-log(nextUniform()) * 1e9 / rate);
+}
+
+/* Split a comma separated list in place, return the number of items */
+static int splitList(char *list, char *items[], int maxItems)
+{
+    int count = 0;
+    for (char *item = strtok(list, ","); item && count < maxItems; item = strtok(NULL, ","))
+        items[count++] = item;
+    return count;
+}
+
+static int connectTo(const char *socketPath)
+{
+    struct sockaddr_un structSocketInfo;
+    memset(&structSocketInfo, 0, sizeof(struct sockaddr_un));
+    structSocketInfo.sun_family = AF_UNIX;
+    strncpy(structSocketInfo.sun_path, socketPath, sizeof(structSocketInfo.sun_path)-1);
+
+    int dataSocket = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (dataSocket < 0)
+        return -1;
+    struct timeval timeout = {.tv_sec = CONNECT_TIMEOUT_MS / 1000, .tv_usec = (CONNECT_TIMEOUT_MS % 1000) * 1000};
+    setsockopt(dataSocket, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    if (connect(dataSocket, (const struct sockaddr *)&structSocketInfo, sizeof(struct sockaddr_un)) < 0 ||
+        fcntl(dataSocket, F_SETFL, O_NONBLOCK) < 0)
+    {
+        close(dataSocket);
+        return -1;
+    }
+    return dataSocket;
+}
+
+/* Monitor the connection for writing while it has queued bytes */
+static void updateEvents(struct Run *run, struct LoadConn *conn)
+{
+    struct epoll_event event = {.events = EPOLLIN | ((conn->outputEnd > conn->outputStart) ? EPOLLOUT : 0), .data.ptr = conn};
+    if (event.events != conn->events)
+    {
+        conn->events = event.events;
+        epoll_ctl(run->epollFd, EPOLL_CTL_MOD, conn->fd, &event);
+    }
+}
+
+/* Every request still in flight on a dead connection is an error */
+static void failConn(struct Run *run, struct LoadConn *conn)
+{
+    if (conn->isDead)
+        return;
+    conn->isDead = true;
+    for (size_t i = 0; i < conn->count; ++i)
+    {
+        if (conn->requests[(conn->head + i) % conn->capacity].intendedNs >= run->measureStartNs)
+            run->errors++;
+    }
+    run->outstanding -= conn->count;
+    conn->count = 0;
+    epoll_ctl(run->epollFd, EPOLL_CTL_DEL, conn->fd, NULL);
+}
+
+/* Write the queued bytes, the requests whose last byte went out get their send time */
+static void flushConn(struct Run *run, struct LoadConn *conn)
+{
+    while (conn->outputEnd > conn->outputStart)
+    {
+        ssize_t ret = write(conn->fd, conn->output + conn->outputStart, conn->outputEnd - conn->outputStart);
+        if (ret < 0)
+        {
+            if (EINTR == errno)
+                continue;
+            if (EAGAIN != errno && EWOULDBLOCK != errno)
+                failConn(run, conn);
+            break;
+        }
+        conn->outputStart += (size_t)ret;
+        conn->bytesSent += (uint64_t)ret;
+    }
+    if (conn->isDead)
+        return;
+    uint64_t now = nowNs();
+    for (; conn->firstUnsent < conn->count; conn->firstUnsent++)
+    {
+        struct Request *request = &conn->requests[(conn->head + conn->firstUnsent) % conn->capacity];
+        if (request->endOffset > conn->bytesSent)
+            break;
+        request->sentNs = now;
+    }
+    if (conn->outputStart == conn->outputEnd)
+        conn->outputStart = conn->outputEnd = 0;
+    updateEvents(run, conn);
+}
+
+static int appendOutput(struct LoadConn *conn, const void *data, size_t length)
+{
+    if (conn->outputEnd + length > conn->outputCapacity)
+    {
+        /* Compact first, grow only if the unsent bytes really need more room */
+        memmove(conn->output, conn->output + conn->outputStart, conn->outputEnd - conn->outputStart);
+        conn->outputEnd -= conn->outputStart;
+        conn->outputStart = 0;
+        if (conn->outputEnd + length > conn->outputCapacity)
+        {
+            size_t capacity = (conn->outputCapacity ? conn->outputCapacity * 2 : 64 * 1024) + length;
+            char *output = realloc(conn->output, capacity);
+            if (!output)
+                return -1;
+            conn->output = output;
+            conn->outputCapacity = capacity;
+        }
+    }
+    memcpy(conn->output + conn->outputEnd, data, length);
+    conn->outputEnd += length;
+    conn->bytesQueued += length;
+    return 0;
+}
+
+/**
+ * Issue the request the schedule planned at intendedNs on the next live connection. It is sent even when
+ * the schedule is late, so a stalled server accumulates latency for every request it delayed instead of
+ * silently lowering the offered rate.
+ **/
+static void issueRequest(struct Run *run, uint64_t intendedNs)
+{
+    struct LoadConn *conn = NULL;
+    for (int tries = 0; tries < run->numConns && !conn; ++tries)
+    {
+        struct LoadConn *candidate = &run->conns[run->nextConn];
+        run->nextConn = (run->nextConn + 1) % run->numConns;
+        if (!candidate->isDead)
+            conn = candidate;
+    }
+    bool isMeasured = (intendedNs >= run->measureStartNs);
+    run->sent += isMeasured;
+    if (!conn)
+    {
+        run->errors += isMeasured;
+        return;
+    }
+    if (conn->count == conn->capacity)
+    {
+        size_t capacity = conn->capacity ? conn->capacity * 2 : 16;
+        struct Request *requests = malloc(capacity * sizeof(struct Request));
+        if (!requests)
+        {
+            run->errors += isMeasured;
+            return;
+        }
+        for (size_t i = 0; i < conn->count; ++i)
+            requests[i] = conn->requests[(conn->head + i) % conn->capacity];
+        free(conn->requests);
+        conn->requests = requests;
+        conn->capacity = capacity;
+        conn->head = 0;
+    }
+
+    uint32_t size = sizes[nextRandom() % (uint64_t)numSizes];
+    struct FrameHeader header = {.length = size, .type = FRAME_TYPE_PING, .flags = 0, .seq = conn->nextSeq++};
+    if (appendOutput(conn, &header, FRAME_HEADER_SIZE) < 0 || appendOutput(conn, payload, size) < 0)
+    {
+        failConn(run, conn);
+        run->errors += isMeasured;
+        return;
+    }
+    conn->requests[(conn->head + conn->count) % conn->capacity] = (struct Request){
+        .intendedNs = intendedNs, .sentNs = 0, .endOffset = conn->bytesQueued, .seq = header.seq, .size = size};
+    conn->count++;
+    run->outstanding++;
+    /* Bytes already waiting mean the socket is full, EPOLLOUT sends the new request behind them */
+    if (conn->outputEnd - conn->outputStart == FRAME_HEADER_SIZE + size)
+        flushConn(run, conn);
+}
+
+/* Match the replies received on a connection with its requests, in order */
+static void readReplies(struct Run *run, struct LoadConn *conn)
+{
+    struct Frame frame;
+    int ret;
+    ssize_t numRead = frameParserRead(&conn->parser, conn->fd);
+    if (numRead < 0 && (EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno))
+        return;
+    if (numRead <= 0)
+    {
+        LOG_ERROR("Connection fd[%d] closed by the server with %zu requests in flight", conn->fd, conn->count);
+        failConn(run, conn);
+        return;
+    }
+    uint64_t now = nowNs();
+    while ((ret = frameParserNext(&conn->parser, &frame)) > 0)
+    {
+        struct Request *request = &conn->requests[conn->head];
+        if (0 == conn->count || FRAME_TYPE_PONG != frame.header.type || request->seq != frame.header.seq ||
+            request->size != frame.header.length)
+        {
+            ret = -1;
+            break;
+        }
+        if (request->intendedNs >= run->measureStartNs)
+        {
+            histogramRecord(&run->corrected, now - request->intendedNs);
+            /* A reply can not come before the request was fully written, the send time is then now */
+            histogramRecord(&run->raw, now - (request->sentNs ? request->sentNs : now));
+            run->completed++;
+            run->lastReplyNs = now;
+        }
+        conn->head = (conn->head + 1) % conn->capacity;
+        conn->count--;
+        conn->firstUnsent -= (conn->firstUnsent > 0);
+        run->outstanding--;
+    }
+    if (ret < 0)
+    {
+        LOG_ERROR("Unexpected reply on fd[%d], dropping the connection", conn->fd);
+        run->errors++;
+        failConn(run, conn);
+        return;
+    }
+    frameParserTrim(&conn->parser);
+}
+
+static void printHeader(enum OutputFormat format)
+{
+    if (OUTPUT_CSV == format)
+    {
+        printf("connections,arrival,target_rps,duration_s,sent,completed,achieved_rps,p50_us,p90_us,p99_us,p999_us,max_us,"
+               "raw_p50_us,raw_p99_us,raw_max_us,errors\n");
+        fflush(stdout);
+    }
+}
+
+static void printResult(enum OutputFormat format, const struct Run *run, enum Arrival arrival, double rate, double seconds)
+{
+    const char *arrivalName = (ARRIVAL_FIXED == arrival) ? "fixed" : "poisson";
+    /* A saturated server answers during the drain too: the rate is over the time it really took */
+    double elapsed = (run->lastReplyNs > run->measureStartNs) ? (run->lastReplyNs - run->measureStartNs) / 1e9 : 0.0;
+    double achieved = run->completed / ((elapsed > seconds) ? elapsed : seconds);
+    double p50 = histogramPercentile(&run->corrected, 50.0) / 1000.0;
+    double p90 = histogramPercentile(&run->corrected, 90.0) / 1000.0;
+    double p99 = histogramPercentile(&run->corrected, 99.0) / 1000.0;
+    double p999 = histogramPercentile(&run->corrected, 99.9) / 1000.0;
+    double maxUs = run->corrected.count ? run->corrected.max / 1000.0 : 0.0;
+    double rawP50 = histogramPercentile(&run->raw, 50.0) / 1000.0;
+    double rawP99 = histogramPercentile(&run->raw, 99.0) / 1000.0;
+    double rawMaxUs = run->raw.count ? run->raw.max / 1000.0 : 0.0;
+
+    if (OUTPUT_CSV == format)
+    {
+        printf("%d,%s,%.0f,%.3f,%llu,%llu,%.0f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%llu\n", run->numConns, arrivalName,
+               rate, seconds, (unsigned long long)run->sent, (unsigned long long)run->completed, achieved, p50, p90, p99,
+               p999, maxUs, rawP50, rawP99, rawMaxUs, (unsigned long long)run->errors);
+    }
+    else
+    {
+        printf("{\"connections\":%d,\"arrival\":\"%s\",\"target_rps\":%.0f,\"duration_s\":%.3f,\"sent\":%llu,"
+               "\"completed\":%llu,\"achieved_rps\":%.0f,\"p50_us\":%.2f,\"p90_us\":%.2f,\"p99_us\":%.2f,"
+               "\"p999_us\":%.2f,\"max_us\":%.2f,\"raw_p50_us\":%.2f,\"raw_p99_us\":%.2f,\"raw_max_us\":%.2f,"
+               "\"errors\":%llu}\n", run->numConns, arrivalName, rate, seconds, (unsigned long long)run->sent,
+               (unsigned long long)run->completed, achieved, p50, p90, p99, p999, maxUs, rawP50, rawP99, rawMaxUs,
+               (unsigned long long)run->errors);
+    }
+    fflush(stdout);
+}
+
+/* Arm the timer at an absolute CLOCK_MONOTONIC time */
+static void armTimer(int timerFd, uint64_t deadlineNs)
+{
+    struct itimerspec timer = {.it_value = {.tv_sec = deadlineNs / 1000000000u, .tv_nsec = deadlineNs % 1000000000u}};
+    timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &timer, NULL);
+}
+
+/* Open the connections, offer the load at one rate for warmup + duration, wait for the last replies */
+static bool runOnce(const char *socketPath, int numConns, double rate, enum Arrival arrival, int warmupMs, int durationMs,
+                    enum OutputFormat format)
+{
+    struct Run *run = calloc(1, sizeof(struct Run));
+    struct epoll_event readyEvents[MAX_EVENTS_PER_WAIT];
+    int timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    bool isOk = false;
+    if (!run || timerFd < 0)
+        goto done;
+    histogramInit(&run->corrected);
+    histogramInit(&run->raw);
+    run->epollFd = epoll_create1(EPOLL_CLOEXEC);
+    run->conns = calloc(numConns, sizeof(struct LoadConn));
+    if (run->epollFd < 0 || !run->conns)
+        goto done;
+    struct epoll_event event = {.events = EPOLLIN, .data.ptr = NULL};
+    epoll_ctl(run->epollFd, EPOLL_CTL_ADD, timerFd, &event);
+
+    for (; run->numConns < numConns; run->numConns++)
+    {
+        struct LoadConn *conn = &run->conns[run->numConns];
+        conn->fd = connectTo(socketPath);
+        if (conn->fd < 0)
+        {
+            LOG_ERROR("Connection %d to [%s] failed (errno %d)", run->numConns, socketPath, errno);
+            goto done;
+        }
+        frameParserInit(&conn->parser);
+        conn->events = EPOLLIN;
+        event = (struct epoll_event){.events = EPOLLIN, .data.ptr = conn};
+        if (epoll_ctl(run->epollFd, EPOLL_CTL_ADD, conn->fd, &event) < 0)
+        {
+            close(conn->fd);
+            goto done;
+        }
+    }
+
+    uint64_t startNs = nowNs();
+    uint64_t nextNs = startNs + nextGapNs(arrival, rate);
+    uint64_t endNs = startNs + (uint64_t)(warmupMs + durationMs) * 1000000u;
+    uint64_t drainEndNs = endNs + (uint64_t)DRAIN_TIMEOUT_MS * 1000000u;
+    run->measureStartNs = startNs + (uint64_t)warmupMs * 1000000u;
+    for (;;)
+    {
+        /* Catch up with the schedule: every request due is issued now, with the time it was due */
+        uint64_t now = nowNs();
+        for (; nextNs <= now && nextNs < endNs; nextNs += nextGapNs(arrival, rate))
+            issueRequest(run, nextNs);
+        if (nextNs >= endNs && (0 == run->outstanding || now >= drainEndNs))
+            break;
+        armTimer(timerFd, (nextNs < endNs) ? nextNs : drainEndNs);
+
+        int numReady = epoll_wait(run->epollFd, readyEvents, MAX_EVENTS_PER_WAIT, -1);
+        if (numReady < 0 && EINTR != errno)
+        {
+            LOG_ERROR("epoll_wait() return error");
+            goto done;
+        }
+        for (int i = 0; i < numReady; ++i)
+        {
+            struct LoadConn *conn = readyEvents[i].data.ptr;
+            if (!conn)
+            {
+                uint64_t expirations;
+                if (read(timerFd, &expirations, sizeof(expirations)) < 0)
+                    continue;
+                continue;
+            }
+            if (conn->isDead)
+                continue;
+            if (readyEvents[i].events & EPOLLOUT)
+                flushConn(run, conn);
+            if (!conn->isDead && (readyEvents[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)))
+                readReplies(run, conn);
+        }
+    }
+    /* Requests never answered are errors, the server did not keep up within the drain timeout */
+    for (int i = 0; i < run->numConns; ++i)
+        failConn(run, &run->conns[i]);
+
+    printResult(format, run, arrival, rate, durationMs / 1000.0);
+    isOk = true;
+
+done:
+    if (timerFd >= 0)
+        close(timerFd);
+    if (run)
+    {
+        for (int i = 0; run->conns && i < run->numConns; ++i)
+        {
+            close(run->conns[i].fd);
+            frameParserRelease(&run->conns[i].parser);
+            free(run->conns[i].requests);
+            free(run->conns[i].output);
+        }
+        if (run->epollFd >= 0)
+            close(run->epollFd);
+        free(run->conns);
+        free(run);
+    }
+    return isOk;
+}
+
+static void printUsage(const char *appName)
+{
+    printf("Usage: %s [-n connections] [-r rates] [-a poisson|fixed] [-m sizes] [-d duration_ms] [-w warmup_ms] [-S seed] [-f csv|json] [socket_path]\n", appName);
+    printf("  -n  Connections opened to the server (default %d)\n", DEFAULT_CONNECTIONS);
+    printf("  -r  Comma separated target rates in requests per second, one run each (default %s)\n", DEFAULT_RATES);
+    printf("  -a  Arrivals: poisson (default, exponential gaps) or fixed (evenly spaced)\n");
+    printf("  -m  Comma separated payload sizes in bytes, each request picks one at random (default %s)\n", DEFAULT_SIZES);
+    printf("  -d  Measured duration of each run in milliseconds (default %d)\n", DEFAULT_DURATION_MS);
+    printf("  -w  Warm-up of each run in milliseconds, not measured (default %d)\n", DEFAULT_WARMUP_MS);
+    printf("  -S  Seed of the arrivals and sizes, runs with the same seed offer the same load\n");
+    printf("  -f  Output format, one row per rate on stdout (default csv)\n");
+}
+
+int main(int argc, char *argv[])
+{
+    char rateList[256] = DEFAULT_RATES, sizeList[256] = DEFAULT_SIZES;
+    int numConns = DEFAULT_CONNECTIONS, durationMs = DEFAULT_DURATION_MS, warmupMs = DEFAULT_WARMUP_MS, opt;
+    enum Arrival arrival = ARRIVAL_POISSON;
+    enum OutputFormat format = OUTPUT_CSV;
+    while (-1 != (opt = getopt(argc, argv, "n:r:a:m:d:w:S:f:h")))
+    {
+        switch (opt)
+        {
+            case 'n': numConns = atoi(optarg); break;
+            case 'r': snprintf(rateList, sizeof(rateList), "%s", optarg); break;
+            case 'a': arrival = (0 == strcmp(optarg, "fixed")) ? ARRIVAL_FIXED : ARRIVAL_POISSON; break;
+            case 'm': snprintf(sizeList, sizeof(sizeList), "%s", optarg); break;
+            case 'd': durationMs = atoi(optarg); break;
+            case 'w': warmupMs = atoi(optarg); break;
+            case 'S': rngState = strtoull(optarg, NULL, 0) | 1; break;
+            case 'f': format = (0 == strcmp(optarg, "json")) ? OUTPUT_JSON : OUTPUT_CSV; break;
+            default: printUsage(argv[0]); return (opt == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    const char *socketPath = (argc>optind)?argv[optind]:DEFAULT_SOCKET_PATH;
+
+    char *rates[MAX_LIST_ITEMS], *sizeItems[MAX_LIST_ITEMS];
+    int numRates = splitList(rateList, rates, MAX_LIST_ITEMS);
+    uint32_t maxSize = 0;
+    numSizes = splitList(sizeList, sizeItems, MAX_LIST_ITEMS);
+    for (int i = 0; i < numSizes; ++i)
+    {
+        sizes[i] = (uint32_t)strtoul(sizeItems[i], NULL, 0);
+        maxSize = (sizes[i] > maxSize) ? sizes[i] : maxSize;
+    }
+    if (numConns <= 0 || 0 == numSizes || maxSize > FRAME_MAX_PAYLOAD || durationMs <= 0 || warmupMs < 0)
+    {
+        printUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    payload = malloc(maxSize ? maxSize : 1);
+    if (!payload)
+        return EXIT_FAILURE;
+    memset(payload, 'x', maxSize);
+
+    /* Every connection is a descriptor */
+    struct rlimit limit;
+    if (0 == getrlimit(RLIMIT_NOFILE, &limit) && limit.rlim_cur < limit.rlim_max)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+    /* A server closing a connection must fail its writes, not kill the generator */
+    signal(SIGPIPE, SIG_IGN);
+
+    int failures = 0;
+    printHeader(format);
+    for (int r = 0; r < numRates; ++r)
+    {
+        double rate = strtod(rates[r], NULL);
+        if (rate <= 0)
+        {
+            LOG_ERROR("Skipping invalid rate [%s]", rates[r]);
+            continue;
+        }
+        LOG_INFO("Offering %.0f requests/s over %d connections to [%s]", rate, numConns, socketPath);
+        if (!runOnce(socketPath, numConns, rate, arrival, warmupMs, durationMs, format))
+            failures++;
+    }
+    free(payload);
+
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
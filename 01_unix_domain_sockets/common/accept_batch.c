@@ -0,0 +1,169 @@
+/**------------------------------------------------------------------------------------------------
+ * ?                                           ABOUT
+ * @author         :  Nguyen Dinh Hoan
+ * @email          :  hoann.wk@gmail.com
+ * @repo           :  https://github.com/hoan9x/IPC-in-Linux
+ * @createdOn      :  16-Oct-2026
+ * @description    :  Accept storms: listen() backlog sized from net.core.somaxconn, pending connections
+ *                    drained with accept4() in batches, and an optional token bucket on the accept rate
+ *------------------------------------------------------------------------------------------------**/
+#define _GNU_SOURCE
+#include "accept_batch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/socket.h>
+
+#define SOMAXCONN_PATH "/proc/sys/net/core/somaxconn"
+
+static uint64_t nowNs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+/* Add the tokens earned since the last refill, up to the burst */
+static void refillTokens(struct AcceptBatch *batch, uint64_t now)
+{
+    if (batch->rate <= 0)
+        return;
+    batch->tokens += (double)(now - batch->refillNs) * batch->rate / 1e9;
+    if (batch->tokens > batch->burst)
+        batch->tokens = batch->burst;
+    batch->refillNs = now;
+}
+
+void acceptBatchInit(struct AcceptBatch *batch, int flags, double rate, double burst)
+{
+    memset(batch, 0, sizeof(*batch));
+    batch->flags = flags;
+    batch->rate = rate;
+    batch->burst = (burst >= 1) ? burst : 1;
+    batch->tokens = batch->burst;
+    batch->refillNs = nowNs();
+}
+
+int acceptParseRate(const char *text, double *rate, double *burst)
+{
+    char *end;
+    errno = 0;
+    double parsedRate = strtod(text, &end), parsedBurst = parsedRate;
+    if (':' == *end)
+        parsedBurst = strtod(end + 1, &end);
+    if (errno || '\0' != *end || parsedRate <= 0 || parsedBurst < 1)
+        return -1;
+    *rate = parsedRate;
+    *burst = parsedBurst;
+    return 0;
+}
+
+int acceptParseBacklog(const char *text, int *backlog)
+{
+    char *end;
+    errno = 0;
+    long parsed = strtol(text, &end, 0);
+    if (errno || '\0' != *end || parsed < 0 || parsed > 0x7fffffff)
+        return -1;
+    *backlog = (int)parsed;
+    return 0;
+}
+
+/* net.core.somaxconn, SOMAXCONN if it can not be read */
+static int readSomaxconn(void)
+{
+    int value = SOMAXCONN;
+    FILE *file = fopen(SOMAXCONN_PATH, "r");
+    if (file)
+    {
+        if (1 != fscanf(file, "%d", &value) || value <= 0)
+            value = SOMAXCONN;
+        fclose(file);
+    }
+    return value;
+}
+
+int acceptListen(int connSocket, int backlog)
+{
+    int maxBacklog = readSomaxconn();
+    if (0 == backlog || backlog > maxBacklog)
+        backlog = maxBacklog;
+    if (listen(connSocket, backlog) < 0)
+        return -1;
+    return backlog;
+}
+
+int acceptBatchRun(struct AcceptBatch *batch, int connSocket)
+{
+    int count = 0;
+    uint64_t now = nowNs();
+    batch->isDrained = false;
+    if (now < batch->resumeNs)
+        return 0;
+    refillTokens(batch, now);
+    while (count < ACCEPT_BATCH_MAX)
+    {
+        if (batch->rate > 0 && batch->tokens < 1)
+        {
+            batch->stats.ratePauses++;
+            break;
+        }
+        int dataSocket = accept4(connSocket, NULL, NULL, batch->flags);
+        batch->stats.acceptCalls++;
+        if (dataSocket < 0)
+        {
+            /* The client gave up while waiting in the backlog, the next one may still be there */
+            if (EINTR == errno || ECONNABORTED == errno)
+                continue;
+            if (EAGAIN == errno || EWOULDBLOCK == errno)
+            {
+                batch->isDrained = true;
+                break;
+            }
+            if (EMFILE == errno || ENFILE == errno)
+            {
+                /* Retrying at once would spin, the pending connections wait until descriptors are closed */
+                batch->stats.fdPauses++;
+                batch->resumeNs = now + (uint64_t)ACCEPT_FD_RETRY_MS * 1000000u;
+                break;
+            }
+            /* The connections already taken are handed over, the error shows again on the next call */
+            if (0 == count)
+                return -1;
+            break;
+        }
+        if (batch->rate > 0)
+            batch->tokens -= 1;
+        batch->fds[count++] = dataSocket;
+    }
+    if (count > 0)
+    {
+        batch->stats.accepted += (unsigned long long)count;
+        batch->stats.batches++;
+        if ((unsigned long long)count > batch->stats.largestBatch)
+            batch->stats.largestBatch = (unsigned long long)count;
+    }
+    return count;
+}
+
+int acceptBatchDelayMs(struct AcceptBatch *batch)
+{
+    uint64_t now = nowNs();
+    if (now < batch->resumeNs)
+        return (int)((batch->resumeNs - now + 999999) / 1000000);
+    refillTokens(batch, now);
+    if (batch->rate > 0 && batch->tokens < 1)
+        return (int)((1 - batch->tokens) * 1000 / batch->rate) + 1;
+    return -1;
+}
+
+int acceptStatsFormat(const struct AcceptBatch *batch, char *buffer, size_t size)
+{
+    const struct AcceptStats *stats = &batch->stats;
+    return snprintf(buffer, size, "%llu accepted in %llu batches (largest %llu) with %llu accept4(), paused %llu times "
+                    "by the rate limit and %llu times out of descriptors", stats->accepted, stats->batches,
+                    stats->largestBatch, stats->acceptCalls, stats->ratePauses, stats->fdPauses);
+}
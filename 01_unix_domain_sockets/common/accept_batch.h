@@ -0,0 +1,83 @@
+/**------------------------------------------------------------------------------------------------
+ * ?                                           ABOUT
+ * @author         :  Nguyen Dinh Hoan
+ * @email          :  hoann.wk@gmail.com
+ * @repo           :  https://github.com/hoan9x/IPC-in-Linux
+ * @createdOn      :  16-Oct-2026
+ * @description    :  Accept storms: listen() backlog sized from net.core.somaxconn, pending connections
+ *                    drained with accept4() in batches, and an optional token bucket on the accept rate
+ *------------------------------------------------------------------------------------------------**/
+#ifndef ACCEPT_BATCH_H
+#define ACCEPT_BATCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Connections taken by one acceptBatchRun() call, a server handles them before draining the next ones */
+#define ACCEPT_BATCH_MAX 64
+/* Backlog 0 means as deep as the kernel allows (net.core.somaxconn) */
+#define ACCEPT_DEFAULT_BACKLOG 0
+/* Accepting stops for this long when the process or the system is out of descriptors */
+#define ACCEPT_FD_RETRY_MS 100
+
+struct AcceptStats
+{
+    unsigned long long accepted;
+    unsigned long long acceptCalls;     /* accept4() calls, including the one that returned EAGAIN */
+    unsigned long long batches;         /* acceptBatchRun() calls that took at least one connection */
+    unsigned long long largestBatch;
+    unsigned long long ratePauses;      /* times the rate limit stopped a batch */
+    unsigned long long fdPauses;        /* times EMFILE/ENFILE stopped a batch */
+};
+
+/**
+ * Pending connections of a listening socket taken in batches. Connections beyond the rate limit, or that
+ * can not get a descriptor, stay in the backlog: the server stops monitoring the listening socket until
+ * acceptBatchDelayMs() says accepting can resume, instead of waking up for connections it can not take.
+ **/
+struct AcceptBatch
+{
+    int fds[ACCEPT_BATCH_MAX];
+    int flags;                  /* accept4() flags of the new connections */
+    bool isDrained;             /* the last run reached EAGAIN, no connection is pending */
+    /* Token bucket: rate connections per second on average, bursts of up to burst, no limit when rate is 0 */
+    double rate;
+    double burst;
+    double tokens;
+    uint64_t refillNs;
+    uint64_t resumeNs;          /* no accept4() before this time, after EMFILE/ENFILE */
+    struct AcceptStats stats;
+};
+
+void acceptBatchInit(struct AcceptBatch *batch, int flags, double rate, double burst);
+/* Parse "rate[:burst]" in connections per second, the burst defaults to one second worth of connections */
+int acceptParseRate(const char *text, double *rate, double *burst);
+/* Parse a backlog, 0 for the kernel maximum, return 0 or -1 */
+int acceptParseBacklog(const char *text, int *backlog);
+/**
+ * listen() with backlog pending connections, or net.core.somaxconn when backlog is 0. The kernel silently caps
+ * the backlog at somaxconn, the backlog really in effect is returned (-1 with errno set if listen() failed).
+ **/
+int acceptListen(int connSocket, int backlog);
+/**
+ * Accept up to ACCEPT_BATCH_MAX pending connections into batch->fds, stopping early at EAGAIN (isDrained is
+ * then set), when the rate limit is reached or when out of descriptors. Return the number accepted, or -1 with
+ * errno set on an unexpected accept4() error. Until isDrained, run again while acceptBatchDelayMs() allows it
+ * and pause otherwise: an edge-triggered socket reports no new event for the connections left pending.
+ **/
+int acceptBatchRun(struct AcceptBatch *batch, int connSocket);
+/* -1 while connections can be accepted, otherwise the milliseconds until accepting can resume */
+int acceptBatchDelayMs(struct AcceptBatch *batch);
+/* Format the counters into buffer, return snprintf() result */
+int acceptStatsFormat(const struct AcceptBatch *batch, char *buffer, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ACCEPT_BATCH_H */
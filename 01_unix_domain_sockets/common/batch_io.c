@@ -0,0 +1,554 @@
+/**------------------------------------------------------------------------------------------------
+ * ?                                           ABOUT
+ * @author         :  Nguyen Dinh Hoan
+ * @email          :  hoann.wk@gmail.com
+ * @repo           :  https://github.com/hoan9x/IPC-in-Linux
+ * @createdOn      :  16-Oct-2026
+ * @description    :  Batched I/O: frames coalesced into one writev(), reads drained into a large buffer
+ *                    parsed in place, sendmmsg()/recvmmsg() for datagram and seqpacket sockets
+ *------------------------------------------------------------------------------------------------**/
+#define _GNU_SOURCE
+#include "batch_io.h"
+#include "buffer_pool.h"
+#include "fd_passing.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+
+/* Size of the chunks an output queue borrows from its pool, header included */
+#define OUT_QUEUE_CHUNK_SIZE (16 * 1024)
+/* Chunks written by one writev() of an output queue */
+#define OUT_QUEUE_MAX_IOV 64
+
+int ioStatsFormat(const struct IoStats *stats, char *buffer, size_t size)
+{
+    return snprintf(buffer, size, "%llu reads (%.2f frames/read, %llu bytes), %llu writes (%.2f frames/write, %llu bytes)",
+                    stats->readCalls, stats->readCalls ? (double)stats->framesRead / stats->readCalls : 0.0, stats->bytesRead,
+                    stats->writeCalls, stats->writeCalls ? (double)stats->framesWritten / stats->writeCalls : 0.0,
+                    stats->bytesWritten);
+}
+
+/**------------------------------------------------------------------------
+ *                           Stream sockets: writev()
+ *------------------------------------------------------------------------**/
+void outBatchInit(struct OutBatch *batch, struct IoStats *stats)
+{
+    batch->count = 0;
+    batch->bytes = 0;
+    batch->stats = stats;
+    batch->queue = NULL;
+}
+
+int outBatchQueue(struct OutBatch *batch, int fd, uint16_t type, uint32_t seq, const void *payload, uint32_t length)
+{
+    if (OUT_BATCH_MAX_FRAMES == batch->count && outBatchFlush(batch, fd) < 0)
+        return -1;
+    struct FrameHeader *header = &batch->headers[batch->count];
+    header->length = length;
+    header->type = type;
+    header->flags = 0;
+    header->seq = seq;
+    batch->iov[2 * batch->count] = (struct iovec){.iov_base = header, .iov_len = FRAME_HEADER_SIZE};
+    batch->iov[2 * batch->count + 1] = (struct iovec){.iov_base = (void *)payload, .iov_len = length};
+    batch->count++;
+    batch->bytes += FRAME_HEADER_SIZE + length;
+    return 0;
+}
+
+int outBatchFlush(struct OutBatch *batch, int fd)
+{
+    struct iovec *iov = batch->iov;
+    int iovCount = 2 * batch->count;
+    if (batch->stats)
+    {
+        batch->stats->framesWritten += batch->count;
+        batch->stats->bytesWritten += batch->bytes;
+    }
+    batch->count = 0;
+    batch->bytes = 0;
+
+    /* Bytes already waiting go first, the new frames are queued behind them */
+    if (batch->queue && batch->queue->bytes > 0)
+        return outQueueAppend(batch->queue, iov, iovCount);
+    while (iovCount > 0)
+    {
+        ssize_t ret = writev(fd, iov, iovCount);
+        if (ret < 0)
+        {
+            if (EINTR == errno)
+                continue;
+            /* The socket is full, the rest is written from the queue when it becomes writable */
+            if ((EAGAIN == errno || EWOULDBLOCK == errno) && batch->queue)
+                return outQueueAppend(batch->queue, iov, iovCount);
+            return -1;
+        }
+        if (batch->stats)
+            batch->stats->writeCalls++;
+        /* Short write, skip what was written and send the rest */
+        iovSkip(&iov, &iovCount, (size_t)ret);
+    }
+    return 0;
+}
+
+/**------------------------------------------------------------------------
+ *                   Stream sockets: non-blocking output queue
+ *------------------------------------------------------------------------**/
+struct OutChunk
+{
+    struct OutChunk *next;
+    size_t capacity;    /* data bytes of the chunk */
+    size_t start;       /* first byte not written yet */
+    size_t end;         /* end of the bytes queued */
+    char data[];
+};
+
+static void updateQueued(struct OutQueue *queue, size_t added, size_t removed)
+{
+    queue->bytes = queue->bytes + added - removed;
+    if (!queue->stats)
+        return;
+    queue->stats->queuedBytes = queue->stats->queuedBytes + added - removed;
+    queue->stats->totalQueuedBytes += added;
+    if (queue->stats->queuedBytes > queue->stats->peakQueuedBytes)
+        queue->stats->peakQueuedBytes = queue->stats->queuedBytes;
+}
+
+void outQueueInit(struct OutQueue *queue, struct BufferPool *pool, struct OutQueueStats *stats)
+{
+    memset(queue, 0, sizeof(*queue));
+    queue->pool = pool;
+    queue->stats = stats;
+}
+
+/* Unlink the head chunk and give it back to the pool */
+static void dropHead(struct OutQueue *queue)
+{
+    struct OutChunk *chunk = queue->head;
+    queue->head = chunk->next;
+    if (!queue->head)
+        queue->tail = NULL;
+    bufferPoolPut(queue->pool, chunk, chunk->capacity + sizeof(struct OutChunk));
+}
+
+void outQueueRelease(struct OutQueue *queue)
+{
+    updateQueued(queue, 0, queue->bytes);
+    while (queue->head)
+        dropHead(queue);
+    queue->isReadPaused = false;
+}
+
+int outQueueAppend(struct OutQueue *queue, const struct iovec *iov, int iovCount)
+{
+    for (int i = 0; i < iovCount; ++i)
+    {
+        const char *data = iov[i].iov_base;
+        size_t length = iov[i].iov_len;
+        while (length > 0)
+        {
+            struct OutChunk *chunk = queue->tail;
+            if (!chunk || chunk->end == chunk->capacity)
+            {
+                size_t capacity;
+                chunk = bufferPoolGet(queue->pool, OUT_QUEUE_CHUNK_SIZE, &capacity);
+                if (!chunk)
+                {
+                    errno = ENOMEM;
+                    return -1;
+                }
+                chunk->next = NULL;
+                chunk->capacity = capacity - sizeof(struct OutChunk);
+                chunk->start = chunk->end = 0;
+                if (queue->tail)
+                    queue->tail->next = chunk;
+                else
+                    queue->head = chunk;
+                queue->tail = chunk;
+            }
+            size_t n = chunk->capacity - chunk->end;
+            if (n > length)
+                n = length;
+            memcpy(chunk->data + chunk->end, data, n);
+            chunk->end += n;
+            data += n;
+            length -= n;
+            updateQueued(queue, n, 0);
+        }
+    }
+    return 0;
+}
+
+int outQueueFlush(struct OutQueue *queue, int fd)
+{
+    struct iovec iov[OUT_QUEUE_MAX_IOV];
+    while (queue->head)
+    {
+        int iovCount = 0;
+        for (struct OutChunk *chunk = queue->head; chunk && iovCount < OUT_QUEUE_MAX_IOV; chunk = chunk->next)
+            iov[iovCount++] = (struct iovec){.iov_base = chunk->data + chunk->start, .iov_len = chunk->end - chunk->start};
+        ssize_t ret = writev(fd, iov, iovCount);
+        if (ret < 0)
+        {
+            if (EINTR == errno)
+                continue;
+            if (EAGAIN == errno || EWOULDBLOCK == errno)
+                return 0;
+            return -1;
+        }
+        updateQueued(queue, 0, (size_t)ret);
+        /* Give back the chunks written entirely, the first partly written one keeps its offset */
+        while (ret > 0)
+        {
+            struct OutChunk *chunk = queue->head;
+            size_t n = chunk->end - chunk->start;
+            if ((size_t)ret < n)
+            {
+                chunk->start += (size_t)ret;
+                break;
+            }
+            ret -= (ssize_t)n;
+            dropHead(queue);
+        }
+    }
+    return 0;
+}
+
+size_t outQueueCopy(const struct OutQueue *queue, void *buffer, size_t size)
+{
+    size_t copied = 0;
+    for (const struct OutChunk *chunk = queue->head; chunk && copied < size; chunk = chunk->next)
+    {
+        size_t n = chunk->end - chunk->start;
+        if (n > size - copied)
+            n = size - copied;
+        memcpy((char *)buffer + copied, chunk->data + chunk->start, n);
+        copied += n;
+    }
+    return copied;
+}
+
+short outQueueEvents(struct OutQueue *queue, size_t highWater, size_t lowWater)
+{
+    if (!queue->isReadPaused && queue->bytes >= highWater)
+    {
+        queue->isReadPaused = true;
+        if (queue->stats)
+            queue->stats->pauses++;
+    }
+    else if (queue->isReadPaused && queue->bytes <= lowWater)
+    {
+        queue->isReadPaused = false;
+    }
+    return (queue->isReadPaused ? 0 : POLLIN) | (queue->bytes > 0 ? POLLOUT : 0);
+}
+
+int outQueueParseWatermarks(const char *text, size_t *highWater, size_t *lowWater)
+{
+    char *end;
+    errno = 0;
+    unsigned long long high = strtoull(text, &end, 0), low = high / 4;
+    if (':' == *end)
+        low = strtoull(end + 1, &end, 0);
+    if (errno || '\0' != *end || 0 == high || low > high)
+        return -1;
+    *highWater = (size_t)high;
+    *lowWater = (size_t)low;
+    return 0;
+}
+
+int outQueueStatsFormat(const struct OutQueueStats *stats, char *buffer, size_t size)
+{
+    return snprintf(buffer, size, "%llu bytes queued (peak %llu, %llu in total), reading paused %llu times",
+                    stats->queuedBytes, stats->peakQueuedBytes, stats->totalQueuedBytes, stats->pauses);
+}
+
+/**------------------------------------------------------------------------
+ *                     Stream sockets: shared read buffer
+ *------------------------------------------------------------------------**/
+int batchReaderInit(struct BatchReader *reader, struct IoStats *stats)
+{
+    memset(reader, 0, sizeof(*reader));
+    reader->buffer = malloc(BATCH_READ_BUFFER_SIZE);
+    reader->stats = stats;
+    return reader->buffer ? 0 : -1;
+}
+
+void batchReaderRelease(struct BatchReader *reader)
+{
+    free(reader->buffer);
+    reader->buffer = NULL;
+}
+
+/* read(), or recvmsg() collecting the attached descriptors when fds is not NULL */
+static ssize_t readData(int fd, void *buffer, size_t length, int *fds, int maxFds, int *numFds)
+{
+    if (fds)
+        return recvWithFds(fd, buffer, length, fds, maxFds, numFds);
+    return read(fd, buffer, length);
+}
+
+ssize_t batchReaderReadWithFds(struct BatchReader *reader, struct FrameParser *parser, int fd, int *fds, int maxFds, int *numFds)
+{
+    ssize_t ret;
+    size_t space;
+    reader->owner = parser;
+    if (parser->readPos == parser->writePos)
+    {
+        /* Nothing pending for this connection, its frames are parsed in place in the shared buffer */
+        reader->view.buffer = reader->buffer;
+        reader->view.capacity = BATCH_READ_BUFFER_SIZE;
+        reader->view.readPos = reader->view.writePos = 0;
+        reader->active = &reader->view;
+        ret = readData(fd, reader->buffer, BATCH_READ_BUFFER_SIZE, fds, maxFds, numFds);
+        if (ret > 0)
+            frameParserCommit(&reader->view, (size_t)ret);
+    }
+    else
+    {
+        /* The rest of a partial frame goes after its beginning, in the connection parser */
+        reader->active = parser;
+        char *ptr = frameParserWritePtr(parser, FRAME_HEADER_SIZE, &space);
+        if (!ptr)
+        {
+            errno = ENOMEM;
+            return -1;
+        }
+        ret = readData(fd, ptr, space, fds, maxFds, numFds);
+        if (ret > 0)
+            frameParserCommit(parser, (size_t)ret);
+    }
+
+    if (reader->stats)
+    {
+        reader->stats->readCalls++;
+        if (ret > 0)
+            reader->stats->bytesRead += ret;
+    }
+    return ret;
+}
+
+ssize_t batchReaderRead(struct BatchReader *reader, struct FrameParser *parser, int fd)
+{
+    return batchReaderReadWithFds(reader, parser, fd, NULL, 0, NULL);
+}
+
+int batchReaderNext(struct BatchReader *reader, struct Frame *frame)
+{
+    int ret = frameParserNext(reader->active, frame);
+    if (ret > 0 && reader->stats)
+        reader->stats->framesRead++;
+    return ret;
+}
+
+int batchReaderFinish(struct BatchReader *reader)
+{
+    struct FrameParser *view = &reader->view;
+    int ret = 0;
+    if (&reader->view == reader->active && view->readPos < view->writePos)
+    {
+        size_t space, tail = view->writePos - view->readPos;
+        char *ptr = frameParserWritePtr(reader->owner, tail, &space);
+        if (ptr)
+        {
+            memcpy(ptr, view->buffer + view->readPos, tail);
+            frameParserCommit(reader->owner, tail);
+        }
+        else
+        {
+            errno = ENOMEM;
+            ret = -1;
+        }
+    }
+    else if (reader->owner)
+    {
+        /* Every frame buffered by the connection was handled, its buffer goes back to the pool until more data comes */
+        frameParserTrim(reader->owner);
+    }
+    reader->active = NULL;
+    reader->owner = NULL;
+    return ret;
+}
+
+/**------------------------------------------------------------------------
+ *           Datagram and seqpacket sockets: sendmmsg()/recvmmsg()
+ *------------------------------------------------------------------------**/
+int msgBatchInit(struct MsgBatch *batch, size_t messageSize, struct IoStats *stats)
+{
+    memset(batch, 0, sizeof(*batch));
+    batch->messageSize = messageSize;
+    batch->stats = stats;
+    if (0 == messageSize)
+        return 0;
+
+    batch->buffers = malloc(messageSize * MSG_BATCH_MAX_MESSAGES);
+    if (!batch->buffers)
+        return -1;
+    /* The receive layout never changes, only the lengths written by the kernel are reset before each call */
+    for (int i = 0; i < MSG_BATCH_MAX_MESSAGES; ++i)
+    {
+        batch->iov[i].iov_base = batch->buffers + i * messageSize;
+        batch->iov[i].iov_len = messageSize;
+        batch->msgs[i].msg_hdr.msg_iov = &batch->iov[i];
+        batch->msgs[i].msg_hdr.msg_iovlen = 1;
+        batch->msgs[i].msg_hdr.msg_name = &batch->addrs[i];
+    }
+    return 0;
+}
+
+void msgBatchRelease(struct MsgBatch *batch)
+{
+    free(batch->buffers);
+    batch->buffers = NULL;
+}
+
+int msgBatchRecv(struct MsgBatch *batch, int fd, int flags)
+{
+    int ret;
+    for (int i = 0; i < MSG_BATCH_MAX_MESSAGES; ++i)
+    {
+        batch->msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_un);
+        batch->msgs[i].msg_hdr.msg_flags = 0;
+    }
+    do
+    {
+        ret = recvmmsg(fd, batch->msgs, MSG_BATCH_MAX_MESSAGES, flags, NULL);
+    } while (ret < 0 && EINTR == errno);
+    batch->count = (ret > 0) ? ret : 0;
+
+    if (batch->stats && ret >= 0)
+    {
+        batch->stats->readCalls++;
+        /* Zero-length entries are not frames, recvmmsg() repeats the EOF of a seqpacket socket in every free entry */
+        for (int i = 0; i < ret; ++i)
+        {
+            batch->stats->framesRead += (batch->msgs[i].msg_len > 0);
+            batch->stats->bytesRead += batch->msgs[i].msg_len;
+        }
+    }
+    return ret;
+}
+
+int msgBatchFrame(const struct MsgBatch *batch, int i, struct Frame *frame)
+{
+    const struct msghdr *header = &batch->msgs[i].msg_hdr;
+    size_t length = batch->msgs[i].msg_len;
+    const char *data = header->msg_iov->iov_base;
+
+    /* A truncated message lost the end of its frame */
+    if ((header->msg_flags & MSG_TRUNC) || length < FRAME_HEADER_SIZE)
+        return -1;
+    memcpy(&frame->header, data, FRAME_HEADER_SIZE);
+    if (FRAME_HEADER_SIZE + frame->header.length != length)
+        return -1;
+    frame->payload = data + FRAME_HEADER_SIZE;
+    return 1;
+}
+
+const struct sockaddr_un *msgBatchAddress(const struct MsgBatch *batch, int i, socklen_t *length)
+{
+    *length = batch->msgs[i].msg_hdr.msg_namelen;
+    return &batch->addrs[i];
+}
+
+int msgBatchQueue(struct MsgBatch *batch, int fd, uint16_t type, uint32_t seq, const void *payload, uint32_t length,
+                  const struct sockaddr_un *address, socklen_t addressLength)
+{
+    if (MSG_BATCH_MAX_MESSAGES == batch->count && msgBatchSend(batch, fd) < 0)
+        return -1;
+    int i = batch->count;
+    struct msghdr *header = &batch->msgs[i].msg_hdr;
+    batch->headers[i] = (struct FrameHeader){.length = length, .type = type, .flags = 0, .seq = seq};
+    batch->iov[2 * i] = (struct iovec){.iov_base = &batch->headers[i], .iov_len = FRAME_HEADER_SIZE};
+    batch->iov[2 * i + 1] = (struct iovec){.iov_base = (void *)payload, .iov_len = length};
+    memset(header, 0, sizeof(*header));
+    header->msg_iov = &batch->iov[2 * i];
+    header->msg_iovlen = 2;
+    if (address)
+    {
+        memcpy(&batch->addrs[i], address, addressLength);
+        header->msg_name = &batch->addrs[i];
+        header->msg_namelen = addressLength;
+    }
+    batch->count++;
+    return 0;
+}
+
+int msgBatchSend(struct MsgBatch *batch, int fd)
+{
+    int sent = 0, count = batch->count, failedErrno = 0;
+    batch->count = 0;
+    while (sent < count)
+    {
+        int ret = sendmmsg(fd, batch->msgs + sent, count - sent, MSG_NOSIGNAL | batch->sendFlags);
+        if (ret < 0)
+        {
+            if (EINTR == errno)
+                continue;
+            /* sendmmsg() stops at the first message it cannot send, skip it */
+            failedErrno = errno;
+            sent++;
+            continue;
+        }
+        if (batch->stats)
+        {
+            batch->stats->writeCalls++;
+            batch->stats->framesWritten += ret;
+            for (int i = sent; i < sent + ret; ++i)
+                batch->stats->bytesWritten += batch->msgs[i].msg_len;
+        }
+        sent += ret;
+    }
+    if (failedErrno)
+    {
+        errno = failedErrno;
+        return -1;
+    }
+    return 0;
+}
+
+int msgBatchSendSome(struct MsgBatch *batch, int fd)
+{
+    int sent = 0;
+    while (sent < batch->count)
+    {
+        int ret = sendmmsg(fd, batch->msgs + sent, batch->count - sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (ret < 0)
+        {
+            if (EINTR == errno)
+                continue;
+            if (EAGAIN == errno || EWOULDBLOCK == errno)
+                break;
+            return -1;
+        }
+        if (batch->stats)
+        {
+            batch->stats->writeCalls++;
+            batch->stats->framesWritten += ret;
+            for (int i = sent; i < sent + ret; ++i)
+                batch->stats->bytesWritten += batch->msgs[i].msg_len;
+        }
+        sent += ret;
+    }
+    /* Move the unsent messages to the front, their headers point into the batch and are rebuilt */
+    for (int i = sent; i < batch->count; ++i)
+    {
+        int to = i - sent;
+        struct msghdr *header = &batch->msgs[to].msg_hdr;
+        batch->headers[to] = batch->headers[i];
+        batch->iov[2 * to] = (struct iovec){.iov_base = &batch->headers[to], .iov_len = FRAME_HEADER_SIZE};
+        batch->iov[2 * to + 1] = batch->iov[2 * i + 1];
+        *header = batch->msgs[i].msg_hdr;
+        header->msg_iov = &batch->iov[2 * to];
+        if (header->msg_name)
+        {
+            batch->addrs[to] = batch->addrs[i];
+            header->msg_name = &batch->addrs[to];
+        }
+    }
+    batch->count -= sent;
+    return batch->count;
+}
@@ -0,0 +1,193 @@
+/**------------------------------------------------------------------------------------------------
+ * ?                                           ABOUT
+ * @author         :  Nguyen Dinh Hoan
+ * @email          :  hoann.wk@gmail.com
+ * @repo           :  https://github.com/hoan9x/IPC-in-Linux
+ * @createdOn      :  16-Oct-2026
+ * @description    :  Batched I/O: frames coalesced into one writev(), reads drained into a large buffer
+ *                    parsed in place, sendmmsg()/recvmmsg() for datagram and seqpacket sockets
+ *------------------------------------------------------------------------------------------------**/
+#ifndef BATCH_IO_H
+#define BATCH_IO_H
+
+/* struct mmsghdr needs _GNU_SOURCE, defined by the including file before its first header */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+
+#include "frame.h"
+
+#define OUT_BATCH_MAX_FRAMES 64
+#define MSG_BATCH_MAX_MESSAGES 64
+/* Size of the shared read buffer, one read() can drain this much from a socket */
+#define BATCH_READ_BUFFER_SIZE (64 * 1024)
+/* Default watermarks of the output queues, a connection with more unsent bytes than the high one is not read */
+#define OUT_QUEUE_DEFAULT_HIGH_WATER (1024 * 1024)
+#define OUT_QUEUE_DEFAULT_LOW_WATER (256 * 1024)
+
+/* Syscall and message counters, frames per call shows how well the batching works */
+struct IoStats
+{
+    unsigned long long readCalls;
+    unsigned long long framesRead;
+    unsigned long long bytesRead;
+    unsigned long long writeCalls;
+    unsigned long long framesWritten;
+    unsigned long long bytesWritten;
+};
+
+/* Format the counters and the frames per read/write call into buffer, return snprintf() result */
+int ioStatsFormat(const struct IoStats *stats, char *buffer, size_t size);
+
+/* Bytes waiting in the output queues of every connection, and how often reading had to be paused */
+struct OutQueueStats
+{
+    unsigned long long queuedBytes;     /* currently queued */
+    unsigned long long peakQueuedBytes;
+    unsigned long long totalQueuedBytes;    /* ever queued, i.e. bytes that could not be written at once */
+    unsigned long long pauses;
+};
+
+/**
+ * Bytes of a non-blocking connection that the socket did not take, kept in order in chunks borrowed from a
+ * buffer pool and written when the socket is writable again (POLLOUT/EPOLLOUT). A client that does not read
+ * its replies only grows its own queue, and it is no longer read once the queue passes the high watermark.
+ **/
+struct OutQueue
+{
+    struct OutChunk *head;
+    struct OutChunk *tail;
+    size_t bytes;
+    bool isReadPaused;
+    struct BufferPool *pool;
+    struct OutQueueStats *stats;    /* may be NULL */
+};
+
+void outQueueInit(struct OutQueue *queue, struct BufferPool *pool, struct OutQueueStats *stats);
+/* Drop the unsent bytes and give the chunks back to the pool */
+void outQueueRelease(struct OutQueue *queue);
+/* Copy the iovecs at the end of the queue, return 0 or -1 if out of memory */
+int outQueueAppend(struct OutQueue *queue, const struct iovec *iov, int iovCount);
+/* Write as much of the queue as the socket takes, return 0 (the queue may still hold bytes) or -1 with errno set */
+int outQueueFlush(struct OutQueue *queue, int fd);
+/* Copy up to size queued bytes to buffer without removing them, return the number copied */
+size_t outQueueCopy(const struct OutQueue *queue, void *buffer, size_t size);
+/**
+ * Apply the watermarks and return the poll() events to monitor: POLLOUT while bytes are queued, POLLIN
+ * unless reading is paused. Reading pauses at highWater queued bytes and resumes at lowWater.
+ **/
+short outQueueEvents(struct OutQueue *queue, size_t highWater, size_t lowWater);
+/* Parse "high[:low]" in bytes, low defaults to a quarter of high. Return 0 or -1 if invalid */
+int outQueueParseWatermarks(const char *text, size_t *highWater, size_t *lowWater);
+int outQueueStatsFormat(const struct OutQueueStats *stats, char *buffer, size_t size);
+
+/**
+ * Outbound frames queued for one fd and written together with a single writev(). Payloads are not copied,
+ * they must stay valid until outBatchFlush(). The batch flushes by itself when it is full.
+ * With an output queue set (non-blocking fd), what the socket does not take is copied to the queue instead
+ * of waiting, and nothing is written before the queue is empty so the order of the bytes is kept.
+ **/
+struct OutBatch
+{
+    struct FrameHeader headers[OUT_BATCH_MAX_FRAMES];
+    struct iovec iov[2 * OUT_BATCH_MAX_FRAMES];
+    int count;
+    size_t bytes;
+    struct IoStats *stats;  /* may be NULL */
+    struct OutQueue *queue; /* output queue of the fd being answered, NULL for a blocking fd */
+};
+
+void outBatchInit(struct OutBatch *batch, struct IoStats *stats);
+/* Queue a frame, return 0 or -1 with errno set if the automatic flush of a full batch failed */
+int outBatchQueue(struct OutBatch *batch, int fd, uint16_t type, uint32_t seq, const void *payload, uint32_t length);
+/**
+ * Write every queued frame, retrying on short writes or moving the rest to the output queue,
+ * return 0 or -1 with errno set. The batch is empty afterwards
+ **/
+int outBatchFlush(struct OutBatch *batch, int fd);
+
+/**
+ * Reads from many connections go through one large buffer: a connection with no partial frame reads
+ * straight into it and its frames are parsed in place, so idle connections need no buffer of their own.
+ * Only the unparsed tail of a read (a partial frame) is copied to the connection parser by
+ * batchReaderFinish(), and the next read of that connection continues in its parser.
+ * Frames returned by batchReaderNext() are valid until batchReaderFinish().
+ **/
+struct BatchReader
+{
+    char *buffer;
+    struct FrameParser view;    /* parser over buffer, used while the connection parser is empty */
+    struct FrameParser *active;
+    struct FrameParser *owner;
+    struct IoStats *stats;      /* may be NULL */
+};
+
+int batchReaderInit(struct BatchReader *reader, struct IoStats *stats);
+void batchReaderRelease(struct BatchReader *reader);
+/* read() once from fd on behalf of the connection parser, return the read() result */
+ssize_t batchReaderRead(struct BatchReader *reader, struct FrameParser *parser, int fd);
+/**
+ * Same with recvmsg(), the descriptors passed with SCM_RIGHTS along the data are stored in fds and *numFds is
+ * set to their number (see recvWithFds() in fd_passing.h). A descriptor comes with the first bytes of the frame
+ * it was sent with, so it is always received before that frame is parsed.
+ **/
+ssize_t batchReaderReadWithFds(struct BatchReader *reader, struct FrameParser *parser, int fd, int *fds, int maxFds, int *numFds);
+/* Same as frameParserNext() on the data of the last read */
+int batchReaderNext(struct BatchReader *reader, struct Frame *frame);
+/* True when the last read filled all the room it was given, more data may be waiting. Call it before batchReaderFinish() */
+static inline bool batchReaderIsFull(const struct BatchReader *reader)
+{
+    return reader->active && reader->active->writePos == reader->active->capacity;
+}
+/* Keep the unparsed bytes in the connection parser, return 0 or -1 if out of memory */
+int batchReaderFinish(struct BatchReader *reader);
+
+/**
+ * Batch of messages for a datagram or seqpacket socket, where every message holds exactly one frame.
+ * A batch is used either to receive with one recvmmsg(), or to queue frames sent with as few sendmmsg() as possible.
+ **/
+struct MsgBatch
+{
+    struct mmsghdr msgs[MSG_BATCH_MAX_MESSAGES];
+    struct iovec iov[2 * MSG_BATCH_MAX_MESSAGES];
+    struct FrameHeader headers[MSG_BATCH_MAX_MESSAGES];
+    struct sockaddr_un addrs[MSG_BATCH_MAX_MESSAGES];
+    char *buffers;          /* receive buffers, one of messageSize bytes per message */
+    size_t messageSize;
+    int count;
+    int sendFlags;          /* sendmmsg() flags, e.g. MSG_DONTWAIT so a full peer never blocks the sender */
+    struct IoStats *stats;  /* may be NULL */
+};
+
+/* messageSize is the largest message received, 0 for a batch only used to send */
+int msgBatchInit(struct MsgBatch *batch, size_t messageSize, struct IoStats *stats);
+void msgBatchRelease(struct MsgBatch *batch);
+/**
+ * Receive up to MSG_BATCH_MAX_MESSAGES messages with one recvmmsg(), return how many or -1 with errno set.
+ * flags are the recvmmsg() flags: MSG_WAITFORONE blocks for the first message only, MSG_DONTWAIT never blocks.
+ **/
+int msgBatchRecv(struct MsgBatch *batch, int fd, int flags);
+/* Parse received message i, return 1 and fill frame, or -1 when it is not exactly one frame */
+int msgBatchFrame(const struct MsgBatch *batch, int i, struct Frame *frame);
+/* Sender address of received message i, for a reply on an unconnected datagram socket */
+const struct sockaddr_un *msgBatchAddress(const struct MsgBatch *batch, int i, socklen_t *length);
+/* Queue one frame to send, to address or on the connected peer when address is NULL. The payload is not copied */
+int msgBatchQueue(struct MsgBatch *batch, int fd, uint16_t type, uint32_t seq, const void *payload, uint32_t length,
+                  const struct sockaddr_un *address, socklen_t addressLength);
+/**
+ * Send every queued message, return 0 or -1 with errno set if any could not be sent. A failed message is
+ * skipped and the next ones are still sent, one unreachable datagram peer must not cost the replies of the others.
+ * The batch is empty afterwards.
+ **/
+int msgBatchSend(struct MsgBatch *batch, int fd);
+/**
+ * Send the queued messages the socket takes without blocking, the others stay queued in order at the front of
+ * the batch for the next call (when the socket is writable). Return how many are still queued, or -1 with errno set
+ **/
+int msgBatchSendSome(struct MsgBatch *batch, int fd);
+
+#endif /* BATCH_IO_H */
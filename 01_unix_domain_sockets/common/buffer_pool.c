@@ -0,0 +1,143 @@
+/**------------------------------------------------------------------------------------------------
+ * ?                                           ABOUT
+ * @author         :  Nguyen Dinh Hoan
+ * @email          :  hoann.wk@gmail.com
+ * @repo           :  https://github.com/hoan9x/IPC-in-Linux
+ * @createdOn      :  16-Oct-2026
+ * @description    :  Slab pool of cache-line-aligned buffers lent to the connections
+ *------------------------------------------------------------------------------------------------**/
+#include "buffer_pool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Slabs are chained through a header placed in the first cache line, so the chunks stay aligned */
+struct BufferSlab
+{
+    struct BufferSlab *next;
+};
+
+/* Round size up to a multiple of the cache line, aligned_alloc() requires it */
+static size_t alignSize(size_t size)
+{
+    return (size + BUFFER_POOL_CACHE_LINE - 1) & ~(size_t)(BUFFER_POOL_CACHE_LINE - 1);
+}
+
+/* Index of the smallest class holding size bytes, BUFFER_POOL_NUM_CLASSES if none does */
+static int classIndex(size_t size)
+{
+    int index = 0;
+    size_t chunkSize = BUFFER_POOL_MIN_CHUNK;
+    while (index < BUFFER_POOL_NUM_CLASSES && chunkSize < size)
+    {
+        chunkSize <<= 1;
+        index++;
+    }
+    return index;
+}
+
+void bufferPoolInit(struct BufferPool *pool)
+{
+    memset(pool, 0, sizeof(*pool));
+    for (int i = 0; i < BUFFER_POOL_NUM_CLASSES; ++i)
+        pool->classes[i].chunkSize = (size_t)BUFFER_POOL_MIN_CHUNK << i;
+}
+
+void bufferPoolRelease(struct BufferPool *pool)
+{
+    while (pool->slabs)
+    {
+        struct BufferSlab *next = pool->slabs->next;
+        free(pool->slabs);
+        pool->slabs = next;
+    }
+    bufferPoolInit(pool);
+}
+
+/* Carve a new slab into free chunks of the class */
+static int growClass(struct BufferPool *pool, struct BufferPoolClass *poolClass)
+{
+    size_t slabSize = (poolClass->chunkSize > BUFFER_POOL_SLAB_SIZE) ? poolClass->chunkSize : BUFFER_POOL_SLAB_SIZE;
+    slabSize += BUFFER_POOL_CACHE_LINE;
+    struct BufferSlab *slab = aligned_alloc(BUFFER_POOL_CACHE_LINE, slabSize);
+    if (!slab)
+        return -1;
+    slab->next = pool->slabs;
+    pool->slabs = slab;
+    pool->slabBytes += slabSize;
+
+    char *chunk = (char *)slab + BUFFER_POOL_CACHE_LINE;
+    char *end = (char *)slab + slabSize;
+    for (; chunk + poolClass->chunkSize <= end; chunk += poolClass->chunkSize)
+    {
+        *(void **)chunk = poolClass->freeList;
+        poolClass->freeList = chunk;
+        poolClass->numChunks++;
+    }
+    return 0;
+}
+
+void *bufferPoolGet(struct BufferPool *pool, size_t size, size_t *capacity)
+{
+    int index = classIndex(size);
+    if (BUFFER_POOL_NUM_CLASSES == index)
+    {
+        void *buffer = aligned_alloc(BUFFER_POOL_CACHE_LINE, alignSize(size));
+        if (!buffer)
+            return NULL;
+        *capacity = alignSize(size);
+        pool->largeInUse++;
+        pool->largeBytes += *capacity;
+        if (pool->largeInUse > pool->largeHighWater)
+            pool->largeHighWater = pool->largeInUse;
+        return buffer;
+    }
+
+    struct BufferPoolClass *poolClass = &pool->classes[index];
+    if (!poolClass->freeList && growClass(pool, poolClass) < 0)
+        return NULL;
+    void *chunk = poolClass->freeList;
+    poolClass->freeList = *(void **)chunk;
+    if (++poolClass->inUse > poolClass->highWater)
+        poolClass->highWater = poolClass->inUse;
+    *capacity = poolClass->chunkSize;
+    return chunk;
+}
+
+void bufferPoolPut(struct BufferPool *pool, void *buffer, size_t capacity)
+{
+    if (!buffer)
+        return;
+    int index = classIndex(capacity);
+    if (BUFFER_POOL_NUM_CLASSES == index)
+    {
+        free(buffer);
+        pool->largeInUse--;
+        pool->largeBytes -= capacity;
+        return;
+    }
+    struct BufferPoolClass *poolClass = &pool->classes[index];
+    *(void **)buffer = poolClass->freeList;
+    poolClass->freeList = buffer;
+    poolClass->inUse--;
+}
+
+int bufferPoolFormat(const struct BufferPool *pool, char *buffer, size_t size)
+{
+    int ret = snprintf(buffer, size, "%zuKB in slabs", pool->slabBytes / 1024);
+    for (int i = 0; i < BUFFER_POOL_NUM_CLASSES; ++i)
+    {
+        const struct BufferPoolClass *poolClass = &pool->classes[i];
+        if (0 == poolClass->numChunks || ret < 0 || (size_t)ret >= size)
+            continue;
+        ret += snprintf(buffer + ret, size - (size_t)ret, ", %zuKB: %zu/%zu lent (peak %zu)", poolClass->chunkSize / 1024,
+                        poolClass->inUse, poolClass->numChunks, poolClass->highWater);
+    }
+    if (ret >= 0 && (size_t)ret < size)
+    {
+        ret += snprintf(buffer + ret, size - (size_t)ret, ", large: %zu lent, %zuKB (peak %zu)", pool->largeInUse,
+                        pool->largeBytes / 1024, pool->largeHighWater);
+    }
+    return ret;
+}
@@ -0,0 +1,68 @@
+/**------------------------------------------------------------------------------------------------
+ * ?                                           ABOUT
+ * @author         :  Nguyen Dinh Hoan
+ * @email          :  hoann.wk@gmail.com
+ * @repo           :  https://github.com/hoan9x/IPC-in-Linux
+ * @createdOn      :  16-Oct-2026
+ * @description    :  Slab pool of cache-line-aligned buffers lent to the connections
+ *------------------------------------------------------------------------------------------------**/
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BUFFER_POOL_CACHE_LINE 64
+/* Size classes are powers of two from BUFFER_POOL_MIN_CHUNK, bigger buffers are allocated one by one */
+#define BUFFER_POOL_MIN_CHUNK 4096
+#define BUFFER_POOL_NUM_CLASSES 6
+#define BUFFER_POOL_MAX_CHUNK (BUFFER_POOL_MIN_CHUNK << (BUFFER_POOL_NUM_CLASSES - 1))
+/* Chunks are carved from slabs of this size (or one chunk if it is bigger) */
+#define BUFFER_POOL_SLAB_SIZE (256 * 1024)
+
+struct BufferSlab;
+
+/* One size class: a free list of chunks threaded through the chunks themselves */
+struct BufferPoolClass
+{
+    size_t chunkSize;
+    void *freeList;
+    size_t numChunks;   /* chunks carved from the slabs, free or lent */
+    size_t inUse;
+    size_t highWater;   /* most chunks lent at the same time */
+};
+
+/**
+ * Buffers are lent on demand and given back when the connection is idle, so the memory held is set by the
+ * connections that have data in flight, not by the number of connections. Chunks are never zeroed and the
+ * slabs are kept until bufferPoolRelease(): after the peak, lending a buffer is a free list pop.
+ * Not thread-safe, a pool belongs to one event loop.
+ **/
+struct BufferPool
+{
+    struct BufferPoolClass classes[BUFFER_POOL_NUM_CLASSES];
+    struct BufferSlab *slabs;
+    size_t slabBytes;       /* memory held by the slabs */
+    size_t largeInUse;      /* buffers above BUFFER_POOL_MAX_CHUNK, allocated and freed directly */
+    size_t largeBytes;
+    size_t largeHighWater;
+};
+
+void bufferPoolInit(struct BufferPool *pool);
+/* Free every slab, buffers still lent become invalid */
+void bufferPoolRelease(struct BufferPool *pool);
+/* Lend a buffer of at least size bytes aligned on a cache line, its real size is stored in *capacity. NULL if out of memory */
+void *bufferPoolGet(struct BufferPool *pool, size_t size, size_t *capacity);
+/* Give back a buffer, capacity is the value returned by bufferPoolGet() */
+void bufferPoolPut(struct BufferPool *pool, void *buffer, size_t capacity);
+/* Format the buffers lent, their high-water marks and the memory held into buffer, return snprintf() result */
+int bufferPoolFormat(const struct BufferPool *pool, char *buffer, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BUFFER_POOL_H */
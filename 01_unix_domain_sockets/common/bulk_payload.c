@@ -0,0 +1,81 @@
+/**------------------------------------------------------------------------------------------------
+ * ?                                           ABOUT
+ * @author         :  Nguyen Dinh Hoan
+ * @email          :  hoann.wk@gmail.com
+ * @repo           :  https://github.com/hoan9x/IPC-in-Linux
+ * @createdOn      :  16-Oct-2026
+ * @description    :  Large payloads passed as a sealed memfd instead of through the socket
+ *------------------------------------------------------------------------------------------------**/
+#define _GNU_SOURCE
+#include "bulk_payload.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* Seals the receiver requires: the content can neither change nor shrink while it is mapped */
+#define BULK_REQUIRED_SEALS (F_SEAL_WRITE | F_SEAL_SHRINK)
+
+int bulkCreate(size_t length, void **data)
+{
+    if (0 == length)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    int memFd = memfd_create("ipc-demo-bulk", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (memFd < 0)
+        return -1;
+    if (ftruncate(memFd, (off_t)length) < 0)
+    {
+        close(memFd);
+        return -1;
+    }
+    *data = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, memFd, 0);
+    if (MAP_FAILED == *data)
+    {
+        close(memFd);
+        return -1;
+    }
+    return memFd;
+}
+
+int bulkSeal(int memFd, void *data, size_t length)
+{
+    /* F_SEAL_WRITE is refused while a writable shared mapping exists */
+    munmap(data, length);
+    return fcntl(memFd, F_ADD_SEALS, F_SEAL_WRITE | F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL);
+}
+
+const void *bulkMap(int memFd, size_t length)
+{
+    struct stat info;
+    int seals = fcntl(memFd, F_GET_SEALS);
+    if (seals < 0 || BULK_REQUIRED_SEALS != (seals & BULK_REQUIRED_SEALS) || fstat(memFd, &info) < 0 ||
+        0 == length || (uint64_t)info.st_size < (uint64_t)length)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+    void *data = mmap(NULL, length, PROT_READ, MAP_SHARED, memFd, 0);
+    return (MAP_FAILED == data) ? NULL : data;
+}
+
+void bulkUnmap(const void *data, size_t length)
+{
+    munmap((void *)data, length);
+}
+
+uint32_t bulkChecksum(const void *data, size_t length)
+{
+    const unsigned char *bytes = data;
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
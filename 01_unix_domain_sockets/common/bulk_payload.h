@@ -0,0 +1,48 @@
+/**------------------------------------------------------------------------------------------------
+ * ?                                           ABOUT
+ * @author         :  Nguyen Dinh Hoan
+ * @email          :  hoann.wk@gmail.com
+ * @repo           :  https://github.com/hoan9x/IPC-in-Linux
+ * @createdOn      :  16-Oct-2026
+ * @description    :  Large payloads passed as a sealed memfd instead of through the socket
+ *------------------------------------------------------------------------------------------------**/
+#ifndef BULK_PAYLOAD_H
+#define BULK_PAYLOAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Payloads of at least this size go through a memfd by default, smaller ones are sent inline */
+#define BULK_DEFAULT_THRESHOLD (64 * 1024)
+
+/**
+ * Payload of a FRAME_TYPE_BULK frame. The data itself is in the memfd attached to the frame with SCM_RIGHTS,
+ * so only this descriptor and the fd travel through the socket whatever the payload size.
+ **/
+struct BulkDescriptor
+{
+    uint64_t length;    /* payload bytes, from the start of the memfd */
+};
+
+/**
+ * Sender side: create a memfd of length bytes and map it writable, the caller builds the payload in *data
+ * then calls bulkSeal(). Return the memfd or -1 with errno set.
+ **/
+int bulkCreate(size_t length, void **data);
+/**
+ * Unmap the writable mapping and seal the memfd against writes and resizes, so the receiver can use the data
+ * in place without the sender changing it or truncating it under its mapping (SIGBUS). Return 0 or -1.
+ **/
+int bulkSeal(int memFd, void *data, size_t length);
+
+/**
+ * Receiver side: check that the memfd is sealed against writes and shrinking and holds length bytes,
+ * and map it read-only. Return the mapping or NULL with errno set. The memfd can be closed afterwards.
+ **/
+const void *bulkMap(int memFd, size_t length);
+void bulkUnmap(const void *data, size_t length);
+
+/* FNV-1a checksum of the payload, printed on both sides to show the data arrived unchanged */
+uint32_t bulkChecksum(const void *data, size_t length);
+
+#endif /* BULK_PAYLOAD_H */
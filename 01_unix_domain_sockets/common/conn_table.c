@@ -0,0 +1,163 @@
+/**------------------------------------------------------------------------------------------------
+ * ?                                           ABOUT
+ * @author         :  Nguyen Dinh Hoan
+ * @email          :  hoann.wk@gmail.com
+ * @repo           :  https://github.com/hoan9x/IPC-in-Linux
+ * @createdOn      :  16-Oct-2026
+ * @description    :  Growable connection table shared by the select(), pselect() and poll() servers
+ *------------------------------------------------------------------------------------------------**/
+#include "conn_table.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#define CONN_TABLE_INITIAL_CAPACITY 64
+
+int connTableInit(struct ConnTable *table)
+{
+    memset(table, 0, sizeof(*table));
+    table->freeSlotHead = -1;
+    table->maxFd = -1;
+    FD_ZERO(&table->readFds);
+    FD_ZERO(&table->writeFds);
+    return 0;
+}
+
+void connTableRelease(struct ConnTable *table)
+{
+    free(table->slotOfFd);
+    free(table->dataOfFd);
+    free(table->pollFds);
+    free(table->nextFreeSlot);
+    connTableInit(table);
+}
+
+/* Grow the fd index so that fd fits in it */
+static int growFdIndex(struct ConnTable *table, int fd)
+{
+    int newCapacity = table->fdCapacity ? table->fdCapacity : CONN_TABLE_INITIAL_CAPACITY;
+    while (newCapacity <= fd)
+        newCapacity *= 2;
+    int *newSlotOfFd = realloc(table->slotOfFd, newCapacity * sizeof(int));
+    if (!newSlotOfFd)
+        return -1;
+    table->slotOfFd = newSlotOfFd;
+    void **newDataOfFd = realloc(table->dataOfFd, newCapacity * sizeof(void *));
+    if (!newDataOfFd)
+        return -1;
+    table->dataOfFd = newDataOfFd;
+    for (int i = table->fdCapacity; i < newCapacity; ++i)
+    {
+        newSlotOfFd[i] = -1;
+        newDataOfFd[i] = NULL;
+    }
+    table->fdCapacity = newCapacity;
+    return 0;
+}
+
+/* Get a slot from the free list, or append a new one */
+static int takeSlot(struct ConnTable *table)
+{
+    if (-1 != table->freeSlotHead)
+    {
+        int slot = table->freeSlotHead;
+        table->freeSlotHead = table->nextFreeSlot[slot];
+        return slot;
+    }
+    if (table->numSlots == table->slotCapacity)
+    {
+        int newCapacity = table->slotCapacity ? table->slotCapacity * 2 : CONN_TABLE_INITIAL_CAPACITY;
+        struct pollfd *newPollFds = realloc(table->pollFds, newCapacity * sizeof(struct pollfd));
+        if (!newPollFds)
+            return -1;
+        table->pollFds = newPollFds;
+        int *newNextFreeSlot = realloc(table->nextFreeSlot, newCapacity * sizeof(int));
+        if (!newNextFreeSlot)
+            return -1;
+        table->nextFreeSlot = newNextFreeSlot;
+        table->slotCapacity = newCapacity;
+    }
+    return table->numSlots++;
+}
+
+int connTableAdd(struct ConnTable *table, int fd, short events)
+{
+    if (fd < 0)
+    {
+        errno = EBADF;
+        return -1;
+    }
+    if (fd >= table->fdCapacity && growFdIndex(table, fd) < 0)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+    if (table->slotOfFd[fd] >= 0)
+    {
+        errno = EEXIST;
+        return -1;
+    }
+    int slot = takeSlot(table);
+    if (slot < 0)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    table->slotOfFd[fd] = slot;
+    table->dataOfFd[fd] = NULL;
+    table->pollFds[slot].fd = fd;
+    table->pollFds[slot].revents = 0;
+    table->count++;
+    if (fd > table->maxFd)
+        table->maxFd = fd;
+    connTableSetEvents(table, fd, events);
+    return 0;
+}
+
+void connTableSetEvents(struct ConnTable *table, int fd, short events)
+{
+    if (!connTableContains(table, fd))
+        return;
+    table->pollFds[table->slotOfFd[fd]].events = events;
+    if (fd >= FD_SETSIZE)
+        return;
+    if (events & POLLIN)
+        FD_SET(fd, &table->readFds);
+    else
+        FD_CLR(fd, &table->readFds);
+    if (events & POLLOUT)
+        FD_SET(fd, &table->writeFds);
+    else
+        FD_CLR(fd, &table->writeFds);
+}
+
+void connTableRemove(struct ConnTable *table, int fd)
+{
+    if (!connTableContains(table, fd))
+        return;
+
+    int slot = table->slotOfFd[fd];
+    table->slotOfFd[fd] = -1;
+    table->dataOfFd[fd] = NULL;
+    table->pollFds[slot].fd = -1;
+    table->pollFds[slot].revents = 0;
+    table->nextFreeSlot[slot] = table->freeSlotHead;
+    table->freeSlotHead = slot;
+    table->count--;
+    if (fd < FD_SETSIZE)
+    {
+        FD_CLR(fd, &table->readFds);
+        FD_CLR(fd, &table->writeFds);
+    }
+
+    /* Only removing the highest fd moves the maximum, walk down the fd index to the next fd in use */
+    if (fd == table->maxFd)
+    {
+        int newMax = fd - 1;
+        while (newMax >= 0 && table->slotOfFd[newMax] < 0)
+            newMax--;
+        table->maxFd = newMax;
+    }
+}
@@ -0,0 +1,74 @@
+/**------------------------------------------------------------------------------------------------
+ * ?                                           ABOUT
+ * @author         :  Nguyen Dinh Hoan
+ * @email          :  hoann.wk@gmail.com
+ * @repo           :  https://github.com/hoan9x/IPC-in-Linux
+ * @createdOn      :  16-Oct-2026
+ * @description    :  Growable connection table shared by the select(), pselect() and poll() servers
+ *------------------------------------------------------------------------------------------------**/
+#ifndef CONN_TABLE_H
+#define CONN_TABLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <poll.h>
+#include <sys/select.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * The table has no fixed capacity, its arrays grow by doubling:
+ * + slotOfFd is indexed by fd and gives the slot of that fd, so lookup, insert and remove are O(1)
+ * + dataOfFd is indexed by fd and holds the per-connection state of the caller (e.g. its frame parser)
+ * + pollFds is the array of slots, it can be passed to poll() as is. A removed slot keeps fd -1
+ *   (poll() ignores negative fds) and is pushed to a free list, so slots never move while iterating
+ * The highest fd and the fd_sets used by select() are kept up to date on every insert/remove/event change.
+ **/
+struct ConnTable
+{
+    int *slotOfFd;          /* fd -> slot, -1 if the fd is not in the table */
+    void **dataOfFd;        /* fd -> per-connection data, NULL if not set */
+    int fdCapacity;
+    struct pollfd *pollFds; /* slot -> fd and events */
+    int *nextFreeSlot;      /* free list of slots, linked by slot index */
+    int freeSlotHead;
+    int numSlots;           /* number of slots ever used, pass it to poll() */
+    int slotCapacity;
+    int count;              /* number of fds in the table */
+    int maxFd;              /* highest fd in the table, -1 if empty */
+    fd_set readFds;         /* fds below FD_SETSIZE monitored for POLLIN, copy it before calling select() */
+    fd_set writeFds;        /* same for POLLOUT */
+};
+
+int connTableInit(struct ConnTable *table);
+void connTableRelease(struct ConnTable *table);
+/* Add fd with the poll() events to monitor, return -1 with errno set if fd is invalid, already added or out of memory */
+int connTableAdd(struct ConnTable *table, int fd, short events);
+void connTableRemove(struct ConnTable *table, int fd);
+/* Change the poll() events monitored for fd, and its membership of readFds/writeFds */
+void connTableSetEvents(struct ConnTable *table, int fd, short events);
+
+static inline bool connTableContains(const struct ConnTable *table, int fd)
+{
+    return fd >= 0 && fd < table->fdCapacity && table->slotOfFd[fd] >= 0;
+}
+
+/* Per-connection data is owned by the caller, it must be released before the fd is removed */
+static inline void *connTableGetData(const struct ConnTable *table, int fd)
+{
+    return connTableContains(table, fd) ? table->dataOfFd[fd] : NULL;
+}
+
+static inline void connTableSetData(struct ConnTable *table, int fd, void *data)
+{
+    if (connTableContains(table, fd))
+        table->dataOfFd[fd] = data;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CONN_TABLE_H */
@@ -0,0 +1,438 @@
+/**------------------------------------------------------------------------------------------------
+ * ?                                           ABOUT
+ * @author         :  Nguyen Dinh Hoan
+ * @email          :  hoann.wk@gmail.com
+ * @repo           :  https://github.com/hoan9x/IPC-in-Linux
+ * @createdOn      :  16-Oct-2026
+ * @description    :  C++20 coroutines on a poll() loop: awaitable read, write, accept and timers, so a
+ *                    connection handler is straight-line code and thousands of them share one thread
+ *------------------------------------------------------------------------------------------------**/
+#include "coro_loop.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <new>
+#include <time.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "frame.h"
+
+namespace coro
+{
+
+static thread_local Loop *currentLoop = nullptr;
+
+static uint64_t nowNs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+/**------------------------------------------------------------------------
+ *                              Frame pool
+ *------------------------------------------------------------------------**/
+FramePool::~FramePool()
+{
+    for (void *slab : slabs)
+        free(slab);
+}
+
+void *FramePool::allocate(size_t size) noexcept
+{
+    size_t sizeClass = (size + FRAME_GRANULE - 1) / FRAME_GRANULE;
+    void *frame;
+    if (sizeClass >= sizeof(freeLists) / sizeof(freeLists[0]))
+    {
+        frame = malloc(size);
+        poolStats.fallbacks += (nullptr != frame);
+    }
+    else if (freeLists[sizeClass])
+    {
+        /* The free list is threaded through the free frames themselves */
+        frame = freeLists[sizeClass];
+        freeLists[sizeClass] = *(void **)frame;
+    }
+    else
+    {
+        size_t chunkSize = sizeClass * FRAME_GRANULE;
+        if (slabLeft < chunkSize)
+        {
+            /* The rest of the old slab is left unused, it is smaller than one frame of this size */
+            char *slab = (char *)malloc(FRAME_SLAB_SIZE);
+            if (!slab)
+                return nullptr;
+            slabs.push_back(slab);
+            slabCursor = slab;
+            slabLeft = FRAME_SLAB_SIZE;
+            poolStats.slabBytes += FRAME_SLAB_SIZE;
+        }
+        frame = slabCursor;
+        slabCursor += chunkSize;
+        slabLeft -= chunkSize;
+    }
+    if (frame && ++poolStats.live > poolStats.peak)
+        poolStats.peak = poolStats.live;
+    return frame;
+}
+
+void FramePool::deallocate(void *frame, size_t size) noexcept
+{
+    size_t sizeClass = (size + FRAME_GRANULE - 1) / FRAME_GRANULE;
+    poolStats.live--;
+    if (sizeClass >= sizeof(freeLists) / sizeof(freeLists[0]))
+    {
+        free(frame);
+        return;
+    }
+    *(void **)frame = freeLists[sizeClass];
+    freeLists[sizeClass] = frame;
+}
+
+/**------------------------------------------------------------------------
+ *                                 Task
+ *------------------------------------------------------------------------**/
+Task::promise_type::promise_type() noexcept
+{
+    currentLoop->liveTasks++;
+}
+
+Task::promise_type::~promise_type()
+{
+    currentLoop->liveTasks--;
+}
+
+void Task::promise_type::unhandled_exception() noexcept
+{
+    /* Handlers report errors with return values like the C code they call, an exception is a bug */
+    std::terminate();
+}
+
+/* A task is only created on the thread of a loop, the frame comes from the pool of that loop */
+void *Task::promise_type::operator new(size_t size) noexcept
+{
+    return currentLoop ? currentLoop->frames.allocate(size) : nullptr;
+}
+
+void Task::promise_type::operator delete(void *frame, size_t size) noexcept
+{
+    currentLoop->frames.deallocate(frame, size);
+}
+
+/**------------------------------------------------------------------------
+ *                               Awaiters
+ *------------------------------------------------------------------------**/
+bool Waiter::suspendOn(std::coroutine_handle<> coroutine)
+{
+    handle = coroutine;
+    /* Not suspended if it can not wait (EBUSY, out of memory), await_resume() then reports the error */
+    return loop.wait(*this);
+}
+
+int ReadyAwaiter::await_resume() const noexcept
+{
+    if (error)
+    {
+        errno = error;
+        return -1;
+    }
+    return 0;
+}
+
+bool ReadAwaiter::attempt()
+{
+    do
+    {
+        result = ::read(fd, buffer, size);
+    } while (result < 0 && EINTR == errno);
+    if (result < 0 && (EAGAIN == errno || EWOULDBLOCK == errno))
+        return false;
+    error = (result < 0) ? errno : 0;
+    return true;
+}
+
+ssize_t ReadAwaiter::await_resume() const noexcept
+{
+    if (error)
+    {
+        errno = error;
+        return -1;
+    }
+    return result;
+}
+
+bool WriteAwaiter::attempt()
+{
+    while (iovCount > 0)
+    {
+        ssize_t ret = ::writev(fd, iov, iovCount);
+        if (ret < 0)
+        {
+            if (EINTR == errno)
+                continue;
+            if (EAGAIN == errno || EWOULDBLOCK == errno)
+                return false;
+            error = errno;
+            return true;
+        }
+        written += (size_t)ret;
+        iovSkip(&iov, &iovCount, (size_t)ret);
+    }
+    return true;
+}
+
+ssize_t WriteAwaiter::await_resume() const noexcept
+{
+    if (error)
+    {
+        errno = error;
+        return -1;
+    }
+    return (ssize_t)written;
+}
+
+bool AcceptAwaiter::attempt()
+{
+    do
+    {
+        result = ::accept4(fd, NULL, NULL, flags);
+    } while (result < 0 && EINTR == errno);
+    if (result < 0 && (EAGAIN == errno || EWOULDBLOCK == errno))
+        return false;
+    error = (result < 0) ? errno : 0;
+    return true;
+}
+
+int AcceptAwaiter::await_resume() const noexcept
+{
+    if (error)
+    {
+        errno = error;
+        return -1;
+    }
+    return result;
+}
+
+/**------------------------------------------------------------------------
+ *                                 Loop
+ *------------------------------------------------------------------------**/
+Loop::Loop()
+{
+    currentLoop = this;
+}
+
+Loop::~Loop()
+{
+    /* Tasks still suspended are destroyed, their frames go back to the pool before it is freed */
+    std::vector<std::coroutine_handle<>> suspended;
+    for (int slot = 0; isTableReady && slot < table.numSlots; ++slot)
+    {
+        FdWaiters *waiters = (FdWaiters *)connTableGetData(&table, table.pollFds[slot].fd);
+        if (!waiters)
+            continue;
+        if (waiters->reader)
+            suspended.push_back(waiters->reader->handle);
+        if (waiters->writer)
+            suspended.push_back(waiters->writer->handle);
+        delete waiters;
+    }
+    for (auto &entry : timers)
+    {
+        if (entry.second->fd < 0)
+            suspended.push_back(entry.second->handle);
+    }
+    for (Waiter *waiter : readyList)
+        suspended.push_back(waiter->handle);
+    timers.clear();
+    readyList.clear();
+    if (isTableReady)
+        connTableRelease(&table);
+    isTableReady = false;
+    for (auto handle : suspended)
+        handle.destroy();
+    if (this == currentLoop)
+        currentLoop = nullptr;
+}
+
+int Loop::init()
+{
+    if (connTableInit(&table) < 0)
+        return -1;
+    isTableReady = true;
+    return 0;
+}
+
+Loop *Loop::current()
+{
+    return currentLoop;
+}
+
+/* Register the waiter on its fd and its deadline, false if it can not wait */
+bool Loop::wait(Waiter &waiter)
+{
+    if (waiter.fd >= 0)
+    {
+        FdWaiters *waiters = (FdWaiters *)connTableGetData(&table, waiter.fd);
+        if (!waiters)
+        {
+            waiters = new (std::nothrow) FdWaiters{nullptr, nullptr};
+            if (!waiters || connTableAdd(&table, waiter.fd, 0) < 0)
+            {
+                delete waiters;
+                waiter.error = ENOMEM;
+                return false;
+            }
+            connTableSetData(&table, waiter.fd, waiters);
+        }
+        Waiter *&slot = (POLLIN == waiter.events) ? waiters->reader : waiters->writer;
+        if (slot)
+        {
+            waiter.error = EBUSY;
+            return false;
+        }
+        slot = &waiter;
+        connTableSetEvents(&table, waiter.fd, (waiters->reader ? POLLIN : 0) | (waiters->writer ? POLLOUT : 0));
+    }
+    if (waiter.timeoutMs >= 0)
+    {
+        waiter.timer = timers.emplace(nowNs() + (uint64_t)waiter.timeoutMs * 1000000u, &waiter);
+        waiter.hasTimer = true;
+    }
+    return true;
+}
+
+/* Take the waiter out of its fd and its deadline */
+void Loop::detach(Waiter &waiter)
+{
+    if (waiter.hasTimer)
+    {
+        timers.erase(waiter.timer);
+        waiter.hasTimer = false;
+    }
+    FdWaiters *waiters = (waiter.fd >= 0) ? (FdWaiters *)connTableGetData(&table, waiter.fd) : nullptr;
+    if (!waiters)
+        return;
+    if (&waiter == waiters->reader)
+        waiters->reader = nullptr;
+    if (&waiter == waiters->writer)
+        waiters->writer = nullptr;
+    /* The fd stays in the table with no events, the next wait on it only changes the events */
+    connTableSetEvents(&table, waiter.fd, (waiters->reader ? POLLIN : 0) | (waiters->writer ? POLLOUT : 0));
+}
+
+void Loop::resumeWaiter(Waiter &waiter)
+{
+    detach(waiter);
+    /* The waiter lives in the frame of the coroutine, it is not touched after the resume */
+    waiter.handle.resume();
+}
+
+/* The fd is ready: complete the operation of its waiter and resume it, unless the operation would block again */
+void Loop::dispatch(int fd, bool isReader)
+{
+    FdWaiters *waiters = (FdWaiters *)connTableGetData(&table, fd);
+    Waiter *waiter = waiters ? (isReader ? waiters->reader : waiters->writer) : nullptr;
+    if (waiter && waiter->attempt())
+        resumeWaiter(*waiter);
+}
+
+void Loop::expireTimers()
+{
+    uint64_t now = nowNs();
+    while (!timers.empty() && timers.begin()->first <= now)
+    {
+        Waiter *waiter = timers.begin()->second;
+        /* A sleep ends normally, an I/O wait fails */
+        waiter->error = (waiter->fd >= 0) ? ETIMEDOUT : 0;
+        resumeWaiter(*waiter);
+    }
+}
+
+int Loop::nextTimeoutMs() const
+{
+    if (timers.empty())
+        return -1;
+    uint64_t now = nowNs(), deadline = timers.begin()->first;
+    return (deadline <= now) ? 0 : (int)((deadline - now + 999999) / 1000000);
+}
+
+int Loop::run()
+{
+    while (!isStopping && liveTasks > 0)
+    {
+        /* The waiters of a closed fd, resumed here rather than inside the close() of another coroutine */
+        while (!readyList.empty() && !isStopping)
+        {
+            Waiter *waiter = readyList.back();
+            readyList.pop_back();
+            waiter->handle.resume();
+        }
+        if (isStopping || 0 == liveTasks)
+            break;
+
+        int ret = poll(table.pollFds, table.numSlots, nextTimeoutMs());
+        if (ret < 0)
+        {
+            if (EINTR == errno)
+                continue;
+            return -1;
+        }
+        expireTimers();
+        /* Slots never move, a fd added by a resumed coroutine gets revents 0 and is not dispatched this turn */
+        for (int slot = 0; ret > 0 && slot < table.numSlots; ++slot)
+        {
+            short revents = table.pollFds[slot].revents;
+            int fd = table.pollFds[slot].fd;
+            if (0 == revents || fd < 0)
+                continue;
+            table.pollFds[slot].revents = 0;
+            ret--;
+            /* An error or hangup completes both directions, the retried operation returns what happened */
+            if (revents & (POLLIN | POLLERR | POLLHUP | POLLNVAL))
+                dispatch(fd, true);
+            if (revents & (POLLOUT | POLLERR | POLLHUP | POLLNVAL))
+                dispatch(fd, false);
+        }
+    }
+    return 0;
+}
+
+void Loop::forget(int fd)
+{
+    FdWaiters *waiters = (FdWaiters *)connTableGetData(&table, fd);
+    if (!waiters)
+        return;
+    for (Waiter *waiter : {waiters->reader, waiters->writer})
+    {
+        if (!waiter)
+            continue;
+        if (waiter->hasTimer)
+        {
+            timers.erase(waiter->timer);
+            waiter->hasTimer = false;
+        }
+        waiter->error = EBADF;
+        readyList.push_back(waiter);
+    }
+    delete waiters;
+    connTableRemove(&table, fd);
+}
+
+void Loop::close(int fd)
+{
+    forget(fd);
+    ::close(fd);
+}
+
+int Loop::formatStats(char *buffer, size_t size) const
+{
+    const FramePoolStats &stats = frames.stats();
+    return snprintf(buffer, size, "%zu tasks, %d fds watched, %zu timers, frames: %zu live (peak %zu), %zu bytes of slabs, "
+                    "%zu allocated outside the pool", liveTasks, table.count, timers.size(), stats.live, stats.peak,
+                    stats.slabBytes, stats.fallbacks);
+}
+
+} /* namespace coro */
@@ -0,0 +1,271 @@
+/**------------------------------------------------------------------------------------------------
+ * ?                                           ABOUT
+ * @author         :  Nguyen Dinh Hoan
+ * @email          :  hoann.wk@gmail.com
+ * @repo           :  https://github.com/hoan9x/IPC-in-Linux
+ * @createdOn      :  16-Oct-2026
+ * @description    :  C++20 coroutines on a poll() loop: awaitable read, write, accept and timers, so a
+ *                    connection handler is straight-line code and thousands of them share one thread
+ *------------------------------------------------------------------------------------------------**/
+#ifndef CORO_LOOP_HPP
+#define CORO_LOOP_HPP
+
+#include <coroutine>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "conn_table.h"
+
+namespace coro
+{
+
+class Loop;
+
+/* Frames are pooled by size in steps of FRAME_GRANULE, bigger frames than FRAME_MAX come from malloc() */
+constexpr size_t FRAME_GRANULE = 64;
+constexpr size_t FRAME_MAX = 4096;
+constexpr size_t FRAME_SLAB_SIZE = 64 * 1024;
+
+struct FramePoolStats
+{
+    size_t live;        /* frames of tasks not returned yet */
+    size_t peak;
+    size_t slabBytes;   /* memory carved into frames */
+    size_t fallbacks;   /* frames bigger than FRAME_MAX, allocated one by one */
+};
+
+/**
+ * Free lists of coroutine frames by size. Every connection runs the same coroutine functions, so once the
+ * first connections are served a frame is a free list pop, and the frame of a closed connection serves the
+ * next one. Slabs are kept until the pool is destroyed. Not thread-safe, a pool belongs to one loop.
+ **/
+class FramePool
+{
+public:
+    FramePool() = default;
+    ~FramePool();
+    FramePool(const FramePool &) = delete;
+    FramePool &operator=(const FramePool &) = delete;
+
+    /* nullptr if out of memory */
+    void *allocate(size_t size) noexcept;
+    /* size is the one given to allocate() */
+    void deallocate(void *frame, size_t size) noexcept;
+    const FramePoolStats &stats() const { return poolStats; }
+
+private:
+    void *freeLists[FRAME_MAX / FRAME_GRANULE] = {};
+    char *slabCursor = nullptr;
+    size_t slabLeft = 0;
+    std::vector<void *> slabs;
+    FramePoolStats poolStats = {};
+};
+
+/**
+ * A detached coroutine: it starts at once, runs until its first co_await that has to wait and its frame is
+ * given back to the pool of the loop when it returns. A task is created on the thread of a running loop,
+ * the loop counts the tasks alive. isStarted() is false when no frame could be allocated, the body did not run.
+ **/
+class Task
+{
+public:
+    struct promise_type
+    {
+        promise_type() noexcept;
+        ~promise_type();
+        Task get_return_object() noexcept { return Task(true); }
+        static Task get_return_object_on_allocation_failure() noexcept { return Task(false); }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept;
+        static void *operator new(size_t size) noexcept;
+        static void operator delete(void *frame, size_t size) noexcept;
+    };
+
+    bool isStarted() const { return started; }
+
+private:
+    explicit Task(bool isStarted) : started(isStarted) {}
+    bool started;
+};
+
+/**
+ * A suspended coroutine waiting for a fd to be ready, for a deadline, or both. The loop calls attempt()
+ * when the fd is reported ready: the operation is retried there and the coroutine is only resumed once it
+ * completed, a spurious wakeup (EAGAIN again) keeps it waiting.
+ **/
+class Waiter
+{
+public:
+    virtual ~Waiter() = default;
+
+protected:
+    friend class Loop;
+    Waiter(Loop &owner, int waitFd, short waitEvents, int waitTimeoutMs)
+        : loop(owner), fd(waitFd), events(waitEvents), timeoutMs(waitTimeoutMs) {}
+    /* Try the operation, return false if it would still block */
+    virtual bool attempt() { return true; }
+    bool suspendOn(std::coroutine_handle<> coroutine);
+
+    Loop &loop;
+    int fd;
+    short events;               /* POLLIN or POLLOUT, 0 for a timer only */
+    int timeoutMs;              /* -1 for no deadline */
+    int error = 0;              /* errno of the operation, or ETIMEDOUT, EBADF when the fd was closed meanwhile */
+    std::coroutine_handle<> handle;
+    std::multimap<uint64_t, Waiter *>::iterator timer;
+    bool hasTimer = false;
+};
+
+/* co_await loop.readable(fd) / loop.writable(fd): 0 once ready, -1 with errno set (ETIMEDOUT, EBADF) */
+class ReadyAwaiter : public Waiter
+{
+public:
+    ReadyAwaiter(Loop &owner, int waitFd, short waitEvents, int waitTimeoutMs) : Waiter(owner, waitFd, waitEvents, waitTimeoutMs) {}
+    bool await_ready() const noexcept { return false; }
+    bool await_suspend(std::coroutine_handle<> coroutine) { return suspendOn(coroutine); }
+    int await_resume() const noexcept;
+};
+
+/* co_await loop.read(): the read() result once it does not block, -1 with errno set on error or timeout */
+class ReadAwaiter : public Waiter
+{
+public:
+    ReadAwaiter(Loop &owner, int readFd, void *readBuffer, size_t readSize, int waitTimeoutMs)
+        : Waiter(owner, readFd, POLLIN, waitTimeoutMs), buffer(readBuffer), size(readSize) {}
+    bool await_ready() { return attempt(); }
+    bool await_suspend(std::coroutine_handle<> coroutine) { return suspendOn(coroutine); }
+    ssize_t await_resume() const noexcept;
+
+private:
+    bool attempt() override;
+    void *buffer;
+    size_t size;
+    ssize_t result = -1;
+};
+
+/* co_await loop.writev() / loop.write(): every byte written, or -1 with errno set on error or timeout */
+class WriteAwaiter : public Waiter
+{
+public:
+    WriteAwaiter(Loop &owner, int writeFd, struct iovec *writeIov, int writeIovCount, int waitTimeoutMs)
+        : Waiter(owner, writeFd, POLLOUT, waitTimeoutMs), iov(writeIov), iovCount(writeIovCount) {}
+    WriteAwaiter(Loop &owner, int writeFd, const void *buffer, size_t size, int waitTimeoutMs)
+        : Waiter(owner, writeFd, POLLOUT, waitTimeoutMs), single{const_cast<void *>(buffer), size}, iov(&single), iovCount(1) {}
+    WriteAwaiter(const WriteAwaiter &) = delete;
+    bool await_ready() { return attempt(); }
+    bool await_suspend(std::coroutine_handle<> coroutine) { return suspendOn(coroutine); }
+    ssize_t await_resume() const noexcept;
+
+private:
+    bool attempt() override;
+    struct iovec single = {};
+    struct iovec *iov;
+    int iovCount;
+    size_t written = 0;
+};
+
+/* co_await loop.accept(): the new connection, or -1 with errno set */
+class AcceptAwaiter : public Waiter
+{
+public:
+    AcceptAwaiter(Loop &owner, int listenFd, int acceptFlags) : Waiter(owner, listenFd, POLLIN, -1), flags(acceptFlags) {}
+    bool await_ready() { return attempt(); }
+    bool await_suspend(std::coroutine_handle<> coroutine) { return suspendOn(coroutine); }
+    int await_resume() const noexcept;
+
+private:
+    bool attempt() override;
+    int flags;
+    int result = -1;
+};
+
+/* co_await loop.sleep(ms) */
+class SleepAwaiter : public Waiter
+{
+public:
+    SleepAwaiter(Loop &owner, int waitTimeoutMs) : Waiter(owner, -1, 0, waitTimeoutMs) {}
+    bool await_ready() const noexcept { return timeoutMs <= 0; }
+    bool await_suspend(std::coroutine_handle<> coroutine) { return suspendOn(coroutine); }
+    void await_resume() const noexcept {}
+};
+
+/**
+ * The event loop: the fds waited on are kept in a ConnTable passed to poll() as is, the deadlines in an
+ * ordered map whose first entry gives the poll() timeout. One coroutine at most waits for reading and one
+ * for writing on a fd, a second one gets EBUSY. A fd waited on must be closed with close() (or released with
+ * forget()), so the table never holds a fd number the kernel has given to another connection.
+ * One loop per thread, the tasks created on that thread belong to it.
+ **/
+class Loop
+{
+public:
+    Loop();
+    ~Loop();
+    Loop(const Loop &) = delete;
+    Loop &operator=(const Loop &) = delete;
+
+    /* Return 0, or -1 if the table could not be allocated */
+    int init();
+    /* Run until every task returned or stop() was called, return 0 or -1 with errno set if poll() failed */
+    int run();
+    /* Make run() return, safe to call from a signal handler */
+    void stop() { isStopping = 1; }
+
+    ReadyAwaiter readable(int fd, int timeoutMs = -1) { return ReadyAwaiter(*this, fd, POLLIN, timeoutMs); }
+    ReadyAwaiter writable(int fd, int timeoutMs = -1) { return ReadyAwaiter(*this, fd, POLLOUT, timeoutMs); }
+    ReadAwaiter read(int fd, void *buffer, size_t size, int timeoutMs = -1) { return ReadAwaiter(*this, fd, buffer, size, timeoutMs); }
+    /* The iovecs are modified as they are written, like writevAll() */
+    WriteAwaiter writev(int fd, struct iovec *iov, int iovCount, int timeoutMs = -1) { return WriteAwaiter(*this, fd, iov, iovCount, timeoutMs); }
+    WriteAwaiter write(int fd, const void *buffer, size_t size, int timeoutMs = -1) { return WriteAwaiter(*this, fd, buffer, size, timeoutMs); }
+    /* The connection socket must be non-blocking */
+    AcceptAwaiter accept(int fd, int flags) { return AcceptAwaiter(*this, fd, flags); }
+    SleepAwaiter sleep(int ms) { return SleepAwaiter(*this, ms); }
+
+    /* Stop watching fd, the coroutines still waiting on it are resumed with EBADF */
+    void forget(int fd);
+    /* forget() and close() fd */
+    void close(int fd);
+
+    FramePool &framePool() { return frames; }
+    size_t numTasks() const { return liveTasks; }
+    /* Format the tasks, fds, timers and frame pool counters into buffer, return snprintf() result */
+    int formatStats(char *buffer, size_t size) const;
+    /* The loop of the calling thread, nullptr if none */
+    static Loop *current();
+
+private:
+    friend class Waiter;
+    friend struct Task::promise_type;
+    struct FdWaiters
+    {
+        Waiter *reader;
+        Waiter *writer;
+    };
+
+    bool wait(Waiter &waiter);
+    void detach(Waiter &waiter);
+    void resumeWaiter(Waiter &waiter);
+    void dispatch(int fd, bool isReader);
+    void expireTimers();
+    int nextTimeoutMs() const;
+
+    struct ConnTable table = {};
+    bool isTableReady = false;
+    std::multimap<uint64_t, Waiter *> timers;
+    std::vector<Waiter *> readyList;    /* resumed by the next loop turn, e.g. waiters of a closed fd */
+    FramePool frames;
+    size_t liveTasks = 0;
+    volatile sig_atomic_t isStopping = 0;
+};
+
+} /* namespace coro */
+
+#endif /* CORO_LOOP_HPP */
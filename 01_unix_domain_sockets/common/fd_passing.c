@@ -0,0 +1,124 @@
+/**------------------------------------------------------------------------------------------------
+ * ?                                           ABOUT
+ * @author         :  Nguyen Dinh Hoan
+ * @email          :  hoann.wk@gmail.com
+ * @repo           :  https://github.com/hoan9x/IPC-in-Linux
+ * @createdOn      :  16-Oct-2026
+ * @description    :  Passing file descriptors over a UNIX domain socket with SCM_RIGHTS
+ *------------------------------------------------------------------------------------------------**/
+#define _GNU_SOURCE
+#include "fd_passing.h"
+#include "frame.h"
+
+#include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+ssize_t sendWithFds(int socketFd, const struct iovec *iov, int iovCount, const int *fds, int numFds)
+{
+    union
+    {
+        char buffer[CMSG_SPACE(sizeof(int) * FD_PASSING_MAX_FDS)];
+        struct cmsghdr align;
+    } control;
+    struct msghdr msg;
+    ssize_t ret;
+
+    if (numFds < 0 || numFds > FD_PASSING_MAX_FDS)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = (struct iovec *)iov;
+    msg.msg_iovlen = iovCount;
+    if (numFds > 0)
+    {
+        memset(&control, 0, sizeof(control));
+        msg.msg_control = control.buffer;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * numFds);
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * numFds);
+        memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * numFds);
+    }
+
+    do
+    {
+        ret = sendmsg(socketFd, &msg, MSG_NOSIGNAL);
+    } while (ret < 0 && EINTR == errno);
+    return ret;
+}
+
+ssize_t recvWithFds(int socketFd, void *buffer, size_t length, int *fds, int maxFds, int *numFds)
+{
+    union
+    {
+        char buffer[CMSG_SPACE(sizeof(int) * FD_PASSING_MAX_FDS)];
+        struct cmsghdr align;
+    } control;
+    struct iovec iov = {.iov_base = buffer, .iov_len = length};
+    struct msghdr msg;
+    ssize_t ret;
+
+    *numFds = 0;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buffer;
+    msg.msg_controllen = sizeof(control.buffer);
+
+    do
+    {
+        ret = recvmsg(socketFd, &msg, MSG_CMSG_CLOEXEC);
+    } while (ret < 0 && EINTR == errno);
+    if (ret < 0)
+        return ret;
+
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+        if (SOL_SOCKET != cmsg->cmsg_level || SCM_RIGHTS != cmsg->cmsg_type)
+            continue;
+        int count = (int)((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+        int *received = (int *)CMSG_DATA(cmsg);
+        for (int i = 0; i < count; ++i)
+        {
+            /* Never leak a descriptor the caller has no room for */
+            if (*numFds < maxFds)
+                fds[(*numFds)++] = received[i];
+            else
+                close(received[i]);
+        }
+    }
+    if (msg.msg_flags & MSG_CTRUNC)
+    {
+        /* Some descriptors were dropped by the kernel, the message can not be trusted */
+        for (int i = 0; i < *numFds; ++i)
+            close(fds[i]);
+        *numFds = 0;
+        errno = EMSGSIZE;
+        return -1;
+    }
+    return ret;
+}
+
+int frameWriteWithFds(int socketFd, uint16_t type, uint32_t seq, const void *payload, uint32_t length,
+                      const int *fds, int numFds)
+{
+    struct FrameHeader header = {.length = length, .type = type, .flags = 0, .seq = seq};
+    struct iovec iov[2] = {
+        {.iov_base = &header, .iov_len = FRAME_HEADER_SIZE},
+        {.iov_base = (void *)payload, .iov_len = length},
+    };
+    struct iovec *ptrIov = iov;
+    int iovCount = length ? 2 : 1;
+    ssize_t ret = sendWithFds(socketFd, ptrIov, iovCount, fds, numFds);
+    if (ret < 0)
+        return -1;
+
+    /* The descriptors went with the first bytes, the rest of a short write is sent as plain data */
+    iovSkip(&ptrIov, &iovCount, (size_t)ret);
+    return writevAll(socketFd, ptrIov, iovCount);
+}
@@ -0,0 +1,36 @@
+/**------------------------------------------------------------------------------------------------
+ * ?                                           ABOUT
+ * @author         :  Nguyen Dinh Hoan
+ * @email          :  hoann.wk@gmail.com
+ * @repo           :  https://github.com/hoan9x/IPC-in-Linux
+ * @createdOn      :  16-Oct-2026
+ * @description    :  Passing file descriptors over a UNIX domain socket with SCM_RIGHTS
+ *------------------------------------------------------------------------------------------------**/
+#ifndef FD_PASSING_H
+#define FD_PASSING_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+/* Maximum number of fds sent or received by one call */
+#define FD_PASSING_MAX_FDS 64
+
+/**
+ * Send the iovec data with numFds descriptors attached as SCM_RIGHTS ancillary data.
+ * The descriptors travel with the first byte of the data, so at least one byte must be sent.
+ * Return the number of bytes sent or -1 with errno set.
+ **/
+ssize_t sendWithFds(int socketFd, const struct iovec *iov, int iovCount, const int *fds, int numFds);
+
+/**
+ * Receive up to length bytes and the descriptors attached to them, *numFds is set to the number received.
+ * Received descriptors are close-on-exec. Return the recvmsg() result.
+ **/
+ssize_t recvWithFds(int socketFd, void *buffer, size_t length, int *fds, int maxFds, int *numFds);
+
+/* Send one frame (see frame.h) with the descriptors attached, retrying on short writes, return 0 or -1 */
+int frameWriteWithFds(int socketFd, uint16_t type, uint32_t seq, const void *payload, uint32_t length,
+                      const int *fds, int numFds);
+
+#endif /* FD_PASSING_H */
@@ -0,0 +1,215 @@
+/**------------------------------------------------------------------------------------------------
+ * ?                                           ABOUT
+ * @author         :  Nguyen Dinh Hoan
+ * @email          :  hoann.wk@gmail.com
+ * @repo           :  https://github.com/hoan9x/IPC-in-Linux
+ * @createdOn      :  16-Oct-2026
+ * @description    :  Length-prefixed message framing and incremental frame parser
+ *------------------------------------------------------------------------------------------------**/
+#include "frame.h"
+#include "buffer_pool.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#define FRAME_PARSER_MIN_CAPACITY 4096
+
+void frameParserInit(struct FrameParser *parser)
+{
+    memset(parser, 0, sizeof(*parser));
+}
+
+void frameParserInitPooled(struct FrameParser *parser, struct BufferPool *pool)
+{
+    frameParserInit(parser);
+    parser->pool = pool;
+}
+
+/* Free the buffer where it comes from, the parser keeps its pool */
+static void dropBuffer(struct FrameParser *parser)
+{
+    if (parser->pool)
+        bufferPoolPut(parser->pool, parser->buffer, parser->capacity);
+    else
+        free(parser->buffer);
+    parser->buffer = NULL;
+    parser->capacity = parser->readPos = parser->writePos = 0;
+}
+
+void frameParserRelease(struct FrameParser *parser)
+{
+    dropBuffer(parser);
+    frameParserInit(parser);
+}
+
+void frameParserTrim(struct FrameParser *parser)
+{
+    if (parser->buffer && parser->readPos == parser->writePos)
+        dropBuffer(parser);
+}
+
+/* Replace the buffer by one of newCapacity bytes keeping its content, return 0 or -1 if out of memory */
+static int growBuffer(struct FrameParser *parser, size_t newCapacity)
+{
+    if (!parser->pool)
+    {
+        char *newBuffer = realloc(parser->buffer, newCapacity);
+        if (!newBuffer)
+            return -1;
+        parser->buffer = newBuffer;
+        parser->capacity = newCapacity;
+        return 0;
+    }
+    /* Pool chunks can not be resized in place, the partial frame at the front moves to a bigger one */
+    size_t capacity;
+    char *newBuffer = bufferPoolGet(parser->pool, newCapacity, &capacity);
+    if (!newBuffer)
+        return -1;
+    if (parser->writePos > 0)
+        memcpy(newBuffer, parser->buffer, parser->writePos);
+    bufferPoolPut(parser->pool, parser->buffer, parser->capacity);
+    parser->buffer = newBuffer;
+    parser->capacity = capacity;
+    return 0;
+}
+
+/**
+ * Number of bytes still missing to complete the frame at readPos, 0 if its header is not complete yet or if the
+ * frame is already complete (more frames may follow it in the buffer)
+ **/
+static size_t missingFrameBytes(const struct FrameParser *parser)
+{
+    size_t pending = parser->writePos - parser->readPos;
+    struct FrameHeader header;
+    if (pending < FRAME_HEADER_SIZE)
+        return 0;
+    memcpy(&header, parser->buffer + parser->readPos, FRAME_HEADER_SIZE);
+    if (header.length > FRAME_MAX_PAYLOAD || pending >= FRAME_HEADER_SIZE + (size_t)header.length)
+        return 0;
+    return FRAME_HEADER_SIZE + header.length - pending;
+}
+
+char *frameParserWritePtr(struct FrameParser *parser, size_t minSpace, size_t *space)
+{
+    /* Everything was parsed, start again from the beginning of the buffer */
+    if (parser->readPos == parser->writePos)
+        parser->readPos = parser->writePos = 0;
+
+    /* A big partial frame needs room for its whole payload, so it is read without compacting again */
+    size_t needed = missingFrameBytes(parser);
+    if (needed < minSpace)
+        needed = minSpace;
+    if (needed < 1)
+        needed = 1;
+
+    if (parser->capacity - parser->writePos < needed && parser->readPos > 0)
+    {
+        /* Move the partial frame to the front, only the unparsed tail is copied */
+        memmove(parser->buffer, parser->buffer + parser->readPos, parser->writePos - parser->readPos);
+        parser->writePos -= parser->readPos;
+        parser->readPos = 0;
+    }
+    if (parser->capacity - parser->writePos < needed)
+    {
+        size_t newCapacity = parser->capacity ? parser->capacity : FRAME_PARSER_MIN_CAPACITY;
+        while (newCapacity - parser->writePos < needed)
+        {
+            /* A minSpace no buffer can hold must fail, not double the capacity until it wraps to 0 */
+            if (newCapacity > SIZE_MAX / 2)
+            {
+                errno = ENOMEM;
+                return NULL;
+            }
+            newCapacity *= 2;
+        }
+        if (growBuffer(parser, newCapacity) < 0)
+            return NULL;
+    }
+
+    *space = parser->capacity - parser->writePos;
+    return parser->buffer + parser->writePos;
+}
+
+void frameParserCommit(struct FrameParser *parser, size_t n)
+{
+    parser->writePos += n;
+}
+
+ssize_t frameParserRead(struct FrameParser *parser, int fd)
+{
+    size_t space;
+    char *ptr = frameParserWritePtr(parser, FRAME_HEADER_SIZE, &space);
+    if (!ptr)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+    ssize_t ret = read(fd, ptr, space);
+    if (ret > 0)
+        frameParserCommit(parser, (size_t)ret);
+    return ret;
+}
+
+int frameParserNext(struct FrameParser *parser, struct Frame *frame)
+{
+    size_t pending = parser->writePos - parser->readPos;
+    if (pending < FRAME_HEADER_SIZE)
+        return 0;
+
+    /* The buffer may be unaligned for the header fields, copy it out */
+    memcpy(&frame->header, parser->buffer + parser->readPos, FRAME_HEADER_SIZE);
+    if (frame->header.length > FRAME_MAX_PAYLOAD)
+        return -1;
+    if (pending < FRAME_HEADER_SIZE + frame->header.length)
+        return 0;
+
+    frame->payload = parser->buffer + parser->readPos + FRAME_HEADER_SIZE;
+    parser->readPos += FRAME_HEADER_SIZE + frame->header.length;
+    return 1;
+}
+
+int writevAll(int fd, struct iovec *iov, int iovCount)
+{
+    while (iovCount > 0)
+    {
+        ssize_t ret = writev(fd, iov, iovCount);
+        if (ret < 0)
+        {
+            if (EINTR == errno)
+                continue;
+            return -1;
+        }
+        /* Short write, skip what was written and send the rest */
+        iovSkip(&iov, &iovCount, (size_t)ret);
+    }
+    return 0;
+}
+
+void iovSkip(struct iovec **iov, int *iovCount, size_t n)
+{
+    while (*iovCount > 0 && n >= (*iov)->iov_len)
+    {
+        n -= (*iov)->iov_len;
+        (*iov)++;
+        (*iovCount)--;
+    }
+    if (*iovCount > 0)
+    {
+        (*iov)->iov_base = (char *)(*iov)->iov_base + n;
+        (*iov)->iov_len -= n;
+    }
+}
+
+int frameWrite(int fd, uint16_t type, uint32_t seq, const void *payload, uint32_t length)
+{
+    struct FrameHeader header = {.length = length, .type = type, .flags = 0, .seq = seq};
+    struct iovec iov[2] = {
+        {.iov_base = &header, .iov_len = FRAME_HEADER_SIZE},
+        {.iov_base = (void *)payload, .iov_len = length},
+    };
+    return writevAll(fd, iov, length ? 2 : 1);
+}
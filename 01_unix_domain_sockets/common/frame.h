@@ -0,0 +1,107 @@
+/**------------------------------------------------------------------------------------------------
+ * ?                                           ABOUT
+ * @author         :  Nguyen Dinh Hoan
+ * @email          :  hoann.wk@gmail.com
+ * @repo           :  https://github.com/hoan9x/IPC-in-Linux
+ * @createdOn      :  16-Oct-2026
+ * @description    :  Length-prefixed message framing and incremental frame parser
+ *------------------------------------------------------------------------------------------------**/
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct BufferPool;
+
+/**
+ * Every message on the stream is a fixed header followed by `length` bytes of payload.
+ * UNIX domain sockets never leave the host, so the header is in host byte order.
+ **/
+struct FrameHeader
+{
+    uint32_t length;    /* payload length in bytes, the header is not included */
+    uint16_t type;      /* enum FrameType */
+    uint16_t flags;     /* reserved, 0 */
+    uint32_t seq;       /* sequence number chosen by the sender, echoed back in the reply */
+};
+
+#define FRAME_HEADER_SIZE ((size_t)sizeof(struct FrameHeader))
+/* Bigger frames are treated as a protocol error, the connection should be closed */
+#define FRAME_MAX_PAYLOAD (16u * 1024 * 1024)
+
+enum FrameType
+{
+    FRAME_TYPE_DATA = 1,    /* application data */
+    FRAME_TYPE_REPLY = 2,   /* reply to a DATA frame, same seq */
+    FRAME_TYPE_SHM_REQUEST = 3, /* client asks for the shared-memory transport, payload: uint32 ring capacity */
+    FRAME_TYPE_SHM_ACCEPT = 4,  /* server accepts, the memfd of the channel is attached with SCM_RIGHTS */
+    FRAME_TYPE_SHM_REJECT = 5,  /* server refuses, the client keeps using frames on the socket */
+    FRAME_TYPE_PING = 6,    /* benchmark probe, answered without logging */
+    FRAME_TYPE_PONG = 7,    /* reply to a PING frame, same seq and payload */
+    FRAME_TYPE_BULK = 8,    /* large payload, struct BulkDescriptor, the data is in a sealed memfd attached with SCM_RIGHTS */
+    FRAME_TYPE_RELAY = 9,   /* bytes of one client forwarded by a relay, seq is the client id, the payload is a raw chunk of its stream */
+    FRAME_TYPE_SUBSCRIBE = 10,  /* follow a topic, payload: the topic name */
+    FRAME_TYPE_UNSUBSCRIBE = 11,    /* stop following a topic, payload: the topic name */
+    FRAME_TYPE_PUBLISH = 12,    /* payload: topic name, NUL, message, delivered to every subscriber of the topic */
+    FRAME_TYPE_MESSAGE = 13,    /* a PUBLISH frame delivered to a subscriber, same seq and payload */
+    FRAME_TYPE_HANDOFF_REQUEST = 14,    /* hot restart: a new server asks for the sockets, payload: uint32 socket mode */
+    FRAME_TYPE_HANDOFF_LISTENER = 15,   /* the listening socket is attached with SCM_RIGHTS, no payload */
+    FRAME_TYPE_HANDOFF_CONNECTION = 16, /* a client socket is attached, payload: struct HandoffConnection and its buffered bytes */
+    FRAME_TYPE_HANDOFF_DONE = 17,       /* every socket was handed over, payload: uint32 number of connections */
+};
+
+/* A parsed frame, the payload points into the parser buffer and is valid until the parser reads again */
+struct Frame
+{
+    struct FrameHeader header;
+    const char *payload;
+};
+
+/**
+ * Incremental parser of a byte stream: data is read straight into the parser buffer, then frames are
+ * taken out one by one without copying. A partial frame stays in the buffer until the rest arrives,
+ * and several frames received by one read() are returned by successive frameParserNext() calls.
+ **/
+struct FrameParser
+{
+    char *buffer;
+    size_t capacity;
+    size_t readPos;     /* start of the bytes not yet parsed */
+    size_t writePos;    /* end of the bytes received */
+    struct BufferPool *pool;    /* where the buffer comes from, NULL for malloc() */
+};
+
+void frameParserInit(struct FrameParser *parser);
+/* Same, the buffer is borrowed from pool when data arrives and given back by frameParserTrim() */
+void frameParserInitPooled(struct FrameParser *parser, struct BufferPool *pool);
+void frameParserRelease(struct FrameParser *parser);
+/* Give the buffer back when every byte was parsed, frames returned before are no longer valid */
+void frameParserTrim(struct FrameParser *parser);
+/* Return room for at least minSpace bytes at the end of the buffer (compacting or growing it), NULL if out of memory */
+char *frameParserWritePtr(struct FrameParser *parser, size_t minSpace, size_t *space);
+/* Account for n bytes written at frameParserWritePtr() */
+void frameParserCommit(struct FrameParser *parser, size_t n);
+/* read() once from fd into the parser, return the read() result */
+ssize_t frameParserRead(struct FrameParser *parser, int fd);
+/* Return 1 and fill frame when a complete frame is available, 0 if more data is needed, -1 on a malformed header */
+int frameParserNext(struct FrameParser *parser, struct Frame *frame);
+
+/* Write every iovec with writev(), retrying on short writes, the iovecs are modified, return 0 or -1 with errno set */
+int writevAll(int fd, struct iovec *iov, int iovCount);
+/* Advance an iovec array past n bytes already transferred */
+void iovSkip(struct iovec **iov, int *iovCount, size_t n);
+/* Write a full frame (header and payload) with writev(), retrying on short writes, return 0 or -1 with errno set */
+int frameWrite(int fd, uint16_t type, uint32_t seq, const void *payload, uint32_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FRAME_H */
@@ -0,0 +1,90 @@
+/**------------------------------------------------------------------------------------------------
+ * ?                                           ABOUT
+ * @author         :  Nguyen Dinh Hoan
+ * @email          :  hoann.wk@gmail.com
+ * @repo           :  https://github.com/hoan9x/IPC-in-Linux
+ * @createdOn      :  16-Oct-2026
+ * @description    :  Fixed-memory latency histogram with log-linear buckets (HDR histogram style)
+ *------------------------------------------------------------------------------------------------**/
+#include "histogram.h"
+
+#include <string.h>
+
+#define HISTOGRAM_MAX_VALUE ((UINT64_C(1) << HISTOGRAM_MAX_BITS) - 1)
+
+static int bucketOf(uint64_t value)
+{
+    if (value < HISTOGRAM_SUB_BUCKETS)
+        return (int)value;
+    /* value is in [2^msb, 2^(msb+1)), the bits below the top HISTOGRAM_SUB_BITS+1 ones are dropped */
+    int msb = 63 - __builtin_clzll(value);
+    int shift = msb - HISTOGRAM_SUB_BITS;
+    return (shift + 1) * HISTOGRAM_SUB_BUCKETS + (int)(value >> shift) - HISTOGRAM_SUB_BUCKETS;
+}
+
+static uint64_t highestValueOf(int bucket)
+{
+    if (bucket < HISTOGRAM_SUB_BUCKETS)
+        return (uint64_t)bucket;
+    int shift = bucket / HISTOGRAM_SUB_BUCKETS - 1;
+    uint64_t lowest = (uint64_t)(HISTOGRAM_SUB_BUCKETS + bucket % HISTOGRAM_SUB_BUCKETS) << shift;
+    return lowest + (UINT64_C(1) << shift) - 1;
+}
+
+void histogramInit(struct Histogram *histogram)
+{
+    memset(histogram, 0, sizeof(*histogram));
+    histogram->min = UINT64_MAX;
+}
+
+void histogramRecord(struct Histogram *histogram, uint64_t value)
+{
+    if (value > HISTOGRAM_MAX_VALUE)
+        value = HISTOGRAM_MAX_VALUE;
+    histogram->buckets[bucketOf(value)]++;
+    histogram->count++;
+    histogram->sum += (double)value;
+    if (value < histogram->min)
+        histogram->min = value;
+    if (value > histogram->max)
+        histogram->max = value;
+}
+
+void histogramMerge(struct Histogram *destination, const struct Histogram *source)
+{
+    for (int i = 0; i < HISTOGRAM_BUCKETS; ++i)
+        destination->buckets[i] += source->buckets[i];
+    destination->count += source->count;
+    destination->sum += source->sum;
+    if (source->min < destination->min)
+        destination->min = source->min;
+    if (source->max > destination->max)
+        destination->max = source->max;
+}
+
+uint64_t histogramPercentile(const struct Histogram *histogram, double percentile)
+{
+    if (0 == histogram->count)
+        return 0;
+    /* Rank of the wanted value, at least the first one so the 0th percentile is the minimum */
+    uint64_t rank = (uint64_t)(percentile / 100.0 * (double)histogram->count + 0.5);
+    if (rank < 1)
+        rank = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; ++i)
+    {
+        seen += histogram->buckets[i];
+        if (seen >= rank)
+        {
+            /* Never report more than what was really recorded */
+            uint64_t value = highestValueOf(i);
+            return value < histogram->max ? value : histogram->max;
+        }
+    }
+    return histogram->max;
+}
+
+double histogramMean(const struct Histogram *histogram)
+{
+    return histogram->count ? histogram->sum / (double)histogram->count : 0.0;
+}
@@ -0,0 +1,41 @@
+/**------------------------------------------------------------------------------------------------
+ * ?                                           ABOUT
+ * @author         :  Nguyen Dinh Hoan
+ * @email          :  hoann.wk@gmail.com
+ * @repo           :  https://github.com/hoan9x/IPC-in-Linux
+ * @createdOn      :  16-Oct-2026
+ * @description    :  Fixed-memory latency histogram with log-linear buckets (HDR histogram style)
+ *------------------------------------------------------------------------------------------------**/
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+
+/**
+ * Each power of two is split into HISTOGRAM_SUB_BUCKETS linear buckets, so any recorded value is known
+ * within 1/128 of itself (two significant digits) whatever its magnitude. Values below 2^HISTOGRAM_SUB_BITS
+ * are exact, values above 2^HISTOGRAM_MAX_BITS (about 18 minutes in nanoseconds) are clamped.
+ **/
+#define HISTOGRAM_SUB_BITS 7
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_MAX_BITS 40
+#define HISTOGRAM_BUCKETS ((HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_BUCKETS)
+
+struct Histogram
+{
+    uint64_t count;
+    uint64_t min;
+    uint64_t max;
+    double sum;
+    uint64_t buckets[HISTOGRAM_BUCKETS];
+};
+
+void histogramInit(struct Histogram *histogram);
+void histogramRecord(struct Histogram *histogram, uint64_t value);
+/* Add every value recorded in source to destination */
+void histogramMerge(struct Histogram *destination, const struct Histogram *source);
+/* Return the value at the given percentile (0..100), as the highest value equivalent to its bucket */
+uint64_t histogramPercentile(const struct Histogram *histogram, double percentile);
+double histogramMean(const struct Histogram *histogram);
+
+#endif /* HISTOGRAM_H */
@@ -0,0 +1,261 @@
+/**------------------------------------------------------------------------------------------------
+ * ?                                           ABOUT
+ * @author         :  Nguyen Dinh Hoan
+ * @email          :  hoann.wk@gmail.com
+ * @repo           :  https://github.com/hoan9x/IPC-in-Linux
+ * @createdOn      :  16-Oct-2026
+ * @description    :  Hot restart: a running server hands its listening socket and its live connections,
+ *                    with their buffered bytes, to a new server process over a control socket
+ *------------------------------------------------------------------------------------------------**/
+#define _GNU_SOURCE
+#include "hot_restart.h"
+#include "fd_passing.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+int hotRestartControlPath(const char *socketPath, char *buffer, size_t size)
+{
+    int ret = snprintf(buffer, size, "%s" HOT_RESTART_CONTROL_SUFFIX, socketPath);
+    if (ret < 0 || (size_t)ret >= size || (size_t)ret >= sizeof(((struct sockaddr_un *)0)->sun_path))
+    {
+        buffer[0] = '\0';
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    return 0;
+}
+
+static void fillAddress(struct sockaddr_un *address, const char *path)
+{
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    strncpy(address->sun_path, path, sizeof(address->sun_path) - 1);
+}
+
+int hotRestartListen(const char *controlPath)
+{
+    struct sockaddr_un address;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+    fillAddress(&address, controlPath);
+    unlink(controlPath);
+    if (bind(fd, (const struct sockaddr *)&address, sizeof(address)) < 0 || listen(fd, 1) < 0)
+    {
+        int savedErrno = errno;
+        close(fd);
+        errno = savedErrno;
+        return -1;
+    }
+    return fd;
+}
+
+/* Read exactly length bytes, the descriptors attached to them are added to fds. Return 1, 0 on EOF at the start, or -1 */
+static int readExactly(int fd, void *buffer, size_t length, int *fds, int maxFds, int *numFds)
+{
+    size_t done = 0;
+    while (done < length)
+    {
+        int received = 0;
+        ssize_t ret = recvWithFds(fd, (char *)buffer + done, length - done, fds + *numFds, maxFds - *numFds, &received);
+        if (ret < 0)
+            return -1;
+        *numFds += received;
+        if (0 == ret)
+        {
+            if (0 == done)
+                return 0;
+            errno = EPIPE;
+            return -1;
+        }
+        done += (size_t)ret;
+    }
+    return 1;
+}
+
+/**
+ * Read one frame, its payload is malloc()'ed. A descriptor is attached to the first byte of a frame, so the header
+ * is read on its own: one recvmsg() never takes the bytes of the next frame and its descriptor along.
+ **/
+static int readFrame(int fd, struct FrameHeader *header, char **payload, int *fds, int maxFds, int *numFds)
+{
+    int ret;
+    *payload = NULL;
+    *numFds = 0;
+    ret = readExactly(fd, header, FRAME_HEADER_SIZE, fds, maxFds, numFds);
+    if (ret <= 0)
+        return ret;
+    if (header->length > FRAME_MAX_PAYLOAD)
+    {
+        errno = EPROTO;
+        goto fail;
+    }
+    if (header->length > 0)
+    {
+        *payload = malloc(header->length);
+        if (!*payload)
+            goto fail;
+        if (readExactly(fd, *payload, header->length, fds, maxFds, numFds) <= 0)
+        {
+            errno = EPIPE;
+            goto fail;
+        }
+    }
+    return 1;
+
+fail:
+    free(*payload);
+    *payload = NULL;
+    for (int i = 0; i < *numFds; ++i)
+        close(fds[i]);
+    *numFds = 0;
+    return -1;
+}
+
+int hotRestartAccept(int controlSocket, uint32_t *socketMode)
+{
+    struct timeval timeout = {.tv_sec = HOT_RESTART_REQUEST_TIMEOUT_MS / 1000,
+                              .tv_usec = (HOT_RESTART_REQUEST_TIMEOUT_MS % 1000) * 1000};
+    struct timeval sendTimeout = {.tv_sec = HOT_RESTART_SEND_TIMEOUT_MS / 1000,
+                                  .tv_usec = (HOT_RESTART_SEND_TIMEOUT_MS % 1000) * 1000};
+    struct FrameHeader header;
+    char *payload;
+    int fds[FD_PASSING_MAX_FDS], numFds, ret;
+    /* The control connection is blocking, the handoff is the last thing the old server does */
+    int fd = accept4(controlSocket, NULL, NULL, SOCK_CLOEXEC);
+    if (fd < 0)
+        return -1;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    /* A stalled new server must not freeze the old one in the middle of a handoff */
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &sendTimeout, sizeof(sendTimeout));
+    ret = readFrame(fd, &header, &payload, fds, FD_PASSING_MAX_FDS, &numFds);
+    for (int i = 0; i < numFds; ++i)
+        close(fds[i]);
+    if (ret <= 0 || FRAME_TYPE_HANDOFF_REQUEST != header.type || sizeof(uint32_t) != header.length)
+    {
+        free(payload);
+        close(fd);
+        errno = (ret < 0) ? errno : EPROTO;
+        return -1;
+    }
+    memcpy(socketMode, payload, sizeof(uint32_t));
+    free(payload);
+    return fd;
+}
+
+int hotRestartSendListener(int controlFd, int listenFd)
+{
+    return frameWriteWithFds(controlFd, FRAME_TYPE_HANDOFF_LISTENER, 0, NULL, 0, &listenFd, 1);
+}
+
+int hotRestartSendConnection(int controlFd, int fd, const struct FrameParser *parser, const struct OutQueue *output)
+{
+    struct HandoffConnection connection = {
+        .inputBytes = parser ? (uint32_t)(parser->writePos - parser->readPos) : 0,
+        .outputBytes = output ? (uint32_t)output->bytes : 0,
+    };
+    size_t length = sizeof(connection) + connection.inputBytes + connection.outputBytes;
+    if (length > FRAME_MAX_PAYLOAD)
+    {
+        errno = EMSGSIZE;
+        return -1;
+    }
+    char *payload = malloc(length);
+    if (!payload)
+        return -1;
+    memcpy(payload, &connection, sizeof(connection));
+    if (connection.inputBytes)
+        memcpy(payload + sizeof(connection), parser->buffer + parser->readPos, connection.inputBytes);
+    if (connection.outputBytes)
+        outQueueCopy(output, payload + sizeof(connection) + connection.inputBytes, connection.outputBytes);
+    int ret = frameWriteWithFds(controlFd, FRAME_TYPE_HANDOFF_CONNECTION, 0, payload, (uint32_t)length, &fd, 1);
+    free(payload);
+    return ret;
+}
+
+int hotRestartSendDone(int controlFd, uint32_t numConnections)
+{
+    return frameWrite(controlFd, FRAME_TYPE_HANDOFF_DONE, 0, &numConnections, sizeof(numConnections));
+}
+
+int hotRestartConnect(const char *controlPath, uint32_t socketMode)
+{
+    struct sockaddr_un address;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+    fillAddress(&address, controlPath);
+    if (connect(fd, (const struct sockaddr *)&address, sizeof(address)) < 0 ||
+        frameWrite(fd, FRAME_TYPE_HANDOFF_REQUEST, 0, &socketMode, sizeof(socketMode)) < 0)
+    {
+        int savedErrno = errno;
+        close(fd);
+        errno = savedErrno;
+        return -1;
+    }
+    return fd;
+}
+
+int hotRestartReceive(int controlFd, struct HandoffMessage *message)
+{
+    struct FrameHeader header;
+    int fds[FD_PASSING_MAX_FDS], numFds;
+    int ret = readFrame(controlFd, &header, &message->payload, fds, FD_PASSING_MAX_FDS, &numFds);
+    if (ret <= 0)
+        return ret;
+
+    memset(message, 0, offsetof(struct HandoffMessage, payload));
+    message->type = header.type;
+    message->fd = -1;
+    switch (header.type)
+    {
+        case FRAME_TYPE_HANDOFF_LISTENER:
+            if (1 != numFds)
+                goto fail;
+            message->fd = fds[0];
+            return 1;
+        case FRAME_TYPE_HANDOFF_CONNECTION:
+        {
+            struct HandoffConnection connection;
+            if (1 != numFds || header.length < sizeof(connection))
+                goto fail;
+            memcpy(&connection, message->payload, sizeof(connection));
+            if ((uint64_t)sizeof(connection) + connection.inputBytes + connection.outputBytes != header.length)
+                goto fail;
+            message->fd = fds[0];
+            message->input = message->payload + sizeof(connection);
+            message->inputBytes = connection.inputBytes;
+            message->output = message->input + connection.inputBytes;
+            message->outputBytes = connection.outputBytes;
+            return 1;
+        }
+        case FRAME_TYPE_HANDOFF_DONE:
+            if (0 != numFds || sizeof(uint32_t) != header.length)
+                goto fail;
+            memcpy(&message->numConnections, message->payload, sizeof(uint32_t));
+            return 1;
+        default:
+            break;
+    }
+
+fail:
+    for (int i = 0; i < numFds; ++i)
+        close(fds[i]);
+    free(message->payload);
+    message->payload = NULL;
+    errno = EPROTO;
+    return -1;
+}
+
+void hotRestartMessageRelease(struct HandoffMessage *message)
+{
+    free(message->payload);
+    message->payload = NULL;
+}
@@ -0,0 +1,87 @@
+/**------------------------------------------------------------------------------------------------
+ * ?                                           ABOUT
+ * @author         :  Nguyen Dinh Hoan
+ * @email          :  hoann.wk@gmail.com
+ * @repo           :  https://github.com/hoan9x/IPC-in-Linux
+ * @createdOn      :  16-Oct-2026
+ * @description    :  Hot restart: a running server hands its listening socket and its live connections,
+ *                    with their buffered bytes, to a new server process over a control socket
+ *------------------------------------------------------------------------------------------------**/
+#ifndef HOT_RESTART_H
+#define HOT_RESTART_H
+
+/* struct mmsghdr of batch_io.h needs _GNU_SOURCE, defined by the including file before its first header */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "batch_io.h"
+#include "frame.h"
+
+/* Appended to the socket path to name the control socket of a server */
+#define HOT_RESTART_CONTROL_SUFFIX ".ctl"
+/* A control connection that does not send its request within this time is dropped, the server is not stalled */
+#define HOT_RESTART_REQUEST_TIMEOUT_MS 1000
+/* A new server that stops reading the handoff makes a send fail after this time, the old server then keeps its sockets */
+#define HOT_RESTART_SEND_TIMEOUT_MS 5000
+
+/* Payload of FRAME_TYPE_HANDOFF_CONNECTION, followed by inputBytes of partial frame then outputBytes of queued replies */
+struct HandoffConnection
+{
+    uint32_t inputBytes;
+    uint32_t outputBytes;
+};
+
+/**
+ * One message received by the new server. fd is the socket attached (listener or connection), -1 for DONE;
+ * input and output point into the payload, valid until hotRestartMessageRelease().
+ **/
+struct HandoffMessage
+{
+    uint16_t type;          /* FRAME_TYPE_HANDOFF_LISTENER, _CONNECTION or _DONE */
+    int fd;
+    const char *input;
+    uint32_t inputBytes;
+    const char *output;
+    uint32_t outputBytes;
+    uint32_t numConnections;    /* DONE only */
+    char *payload;
+};
+
+/**
+ * The handoff, over one stream connection to the control socket of the running (old) server:
+ *   new -> old  HANDOFF_REQUEST with the socket mode of the new server, refused by closing if it differs
+ *   old -> new  HANDOFF_LISTENER, then one HANDOFF_CONNECTION per client, then HANDOFF_DONE
+ * The old server stops serving while it hands over and exits after DONE. The sockets are shared, not
+ * re-created: connections waiting in the backlog and bytes not read yet stay in the kernel for the new
+ * server, and the clients never see a disconnect. DONE is the commit point: a new server that does not receive
+ * it exits, an old server that could not send it keeps its descriptors and goes on serving.
+ **/
+
+/* Write the control socket path of socketPath to buffer, return -1 and leave it empty if it does not fit */
+int hotRestartControlPath(const char *socketPath, char *buffer, size_t size);
+/* Create the non-blocking control socket listening at controlPath (removed first), return its fd or -1 */
+int hotRestartListen(const char *controlPath);
+/**
+ * Accept a control connection and read its request, return the connection fd and set *socketMode, or -1.
+ * Its sends time out after HOT_RESTART_SEND_TIMEOUT_MS.
+ **/
+int hotRestartAccept(int controlSocket, uint32_t *socketMode);
+
+/* Old server: send the listening socket */
+int hotRestartSendListener(int controlFd, int listenFd);
+/**
+ * Old server: send a client socket with its partial frame (parser may be NULL) and its queued replies (output may
+ * be NULL). Return 0, or -1 with errno set (EMSGSIZE when the buffered bytes do not fit in one frame)
+ **/
+int hotRestartSendConnection(int controlFd, int fd, const struct FrameParser *parser, const struct OutQueue *output);
+/* Old server: end of the handoff */
+int hotRestartSendDone(int controlFd, uint32_t numConnections);
+
+/* New server: connect to the control socket of the running server and send the request, return the fd or -1 */
+int hotRestartConnect(const char *controlPath, uint32_t socketMode);
+/* New server: receive the next message, return 1, 0 if the old server closed the connection, or -1 */
+int hotRestartReceive(int controlFd, struct HandoffMessage *message);
+void hotRestartMessageRelease(struct HandoffMessage *message);
+
+#endif /* HOT_RESTART_H */
@@ -0,0 +1,242 @@
+/**------------------------------------------------------------------------------------------------
+ * ?                                           ABOUT
+ * @author         :  Nguyen Dinh Hoan
+ * @email          :  hoann.wk@gmail.com
+ * @repo           :  https://github.com/hoan9x/IPC-in-Linux
+ * @createdOn      :  16-Oct-2026
+ * @description    :  Asynchronous logging: lines are formatted into a per-thread lock-free ring and
+ *                    written to stdout by a background thread
+ *------------------------------------------------------------------------------------------------**/
+#define _GNU_SOURCE
+#include "log.h"
+
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+
+/* The writer sleeps between passes, longer while there is nothing to write */
+#define LOG_MIN_SLEEP_MS 1
+#define LOG_MAX_SLEEP_MS 100
+#define LOG_OUTPUT_SIZE (64 * 1024)
+
+struct LogSlot
+{
+    uint32_t length;
+    char text[LOG_LINE_MAX];
+};
+
+/**
+ * Single-producer/single-consumer ring of one thread: the thread fills slots and publishes head, the writer
+ * empties them and publishes tail. Rings are never freed, a thread that exits leaves an empty ring behind.
+ **/
+struct LogRing
+{
+    _Atomic uint32_t head;
+    _Atomic uint32_t tail;
+    _Atomic uint64_t dropped;
+    struct LogRing *next;
+    struct LogSlot slots[LOG_RING_SLOTS];
+};
+
+int logLevel = LOG_LEVEL_INFO;
+
+/* Rings of every thread, pushed without lock and only read by the writer */
+static _Atomic(struct LogRing *) rings;
+static __thread struct LogRing *threadRing;
+static pthread_once_t writerOnce = PTHREAD_ONCE_INIT;
+static bool isWriterStarted;
+/* Serializes the consumers (the writer thread and logFlush()), the producers never take it */
+static pthread_mutex_t consumerLock = PTHREAD_MUTEX_INITIALIZER;
+/* The writer waits here, a producer only signals it when its ring is half full and the writer is asleep */
+static pthread_mutex_t wakeLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wakeCond = PTHREAD_COND_INITIALIZER;
+static atomic_bool isWriterSleeping;
+
+static void writeAll(const char *data, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t ret = write(STDOUT_FILENO, data, length);
+        if (ret < 0 && EINTR == errno)
+            continue;
+        if (ret <= 0)
+            return;
+        data += ret;
+        length -= (size_t)ret;
+    }
+}
+
+/* Move every queued line to stdout, return the number of lines written */
+static size_t drainRings(void)
+{
+    static char output[LOG_OUTPUT_SIZE];
+    size_t used = 0, lines = 0;
+    pthread_mutex_lock(&consumerLock);
+    for (struct LogRing *ring = atomic_load_explicit(&rings, memory_order_acquire); ring; ring = ring->next)
+    {
+        uint64_t dropped = atomic_exchange_explicit(&ring->dropped, 0, memory_order_relaxed);
+        if (dropped > 0)
+        {
+            char notice[64];
+            int length = snprintf(notice, sizeof(notice), "[LOG] %llu lines dropped\n", (unsigned long long)dropped);
+            writeAll(output, used);
+            used = 0;
+            writeAll(notice, (size_t)length);
+        }
+        uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        for (; tail != head; ++tail, ++lines)
+        {
+            const struct LogSlot *slot = &ring->slots[tail % LOG_RING_SLOTS];
+            if (used + slot->length > sizeof(output))
+            {
+                writeAll(output, used);
+                used = 0;
+            }
+            memcpy(output + used, slot->text, slot->length);
+            used += slot->length;
+        }
+        /* The slots are free again once copied, the producer may reuse them while output is written */
+        atomic_store_explicit(&ring->tail, tail, memory_order_release);
+    }
+    writeAll(output, used);
+    pthread_mutex_unlock(&consumerLock);
+    return lines;
+}
+
+static void *writerMain(void *arg)
+{
+    (void)arg;
+    long sleepMs = LOG_MIN_SLEEP_MS;
+    for (;;)
+    {
+        sleepMs = (drainRings() > 0) ? LOG_MIN_SLEEP_MS : (sleepMs * 2 > LOG_MAX_SLEEP_MS ? LOG_MAX_SLEEP_MS : sleepMs * 2);
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += sleepMs * 1000000L;
+        deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+        deadline.tv_nsec %= 1000000000L;
+        pthread_mutex_lock(&wakeLock);
+        atomic_store(&isWriterSleeping, true);
+        pthread_cond_timedwait(&wakeCond, &wakeLock, &deadline);
+        atomic_store(&isWriterSleeping, false);
+        pthread_mutex_unlock(&wakeLock);
+    }
+    return NULL;
+}
+
+static void startWriter(void)
+{
+    /* The writer takes no signal, whatever the mask of the thread logging first: they stay with the server threads */
+    pthread_t thread;
+    pthread_attr_t attr;
+    sigset_t allSignals, savedSignals;
+    sigfillset(&allSignals);
+    pthread_sigmask(SIG_SETMASK, &allSignals, &savedSignals);
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    isWriterStarted = (0 == pthread_create(&thread, &attr, writerMain, NULL));
+    pthread_attr_destroy(&attr);
+    pthread_sigmask(SIG_SETMASK, &savedSignals, NULL);
+}
+
+static struct LogRing *getThreadRing(void)
+{
+    if (threadRing)
+        return threadRing;
+    pthread_once(&writerOnce, startWriter);
+    if (!isWriterStarted)
+        return NULL;
+    struct LogRing *ring = calloc(1, sizeof(struct LogRing));
+    if (!ring)
+        return NULL;
+    ring->next = atomic_load_explicit(&rings, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(&rings, &ring->next, ring, memory_order_release, memory_order_relaxed))
+        ;
+    threadRing = ring;
+    return ring;
+}
+
+/* Format into text and append the newline, a line that does not fit is cut and marked */
+static uint32_t formatLine(char *text, const char *format, va_list args)
+{
+    int length = vsnprintf(text, LOG_LINE_MAX - 1, format, args);
+    if (length < 0)
+        length = 0;
+    if (length >= LOG_LINE_MAX - 1)
+    {
+        length = LOG_LINE_MAX - 2;
+        memcpy(text + length - 3, "...", 3);
+    }
+    text[length] = '\n';
+    return (uint32_t)length + 1;
+}
+
+void logWrite(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    struct LogRing *ring = getThreadRing();
+    if (!ring)
+    {
+        /* No writer thread, the line is written synchronously */
+        char text[LOG_LINE_MAX];
+        uint32_t length = formatLine(text, format, args);
+        writeAll(text, length);
+        va_end(args);
+        return;
+    }
+
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t used = head - atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (used >= LOG_RING_SLOTS)
+    {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        va_end(args);
+        return;
+    }
+    struct LogSlot *slot = &ring->slots[head % LOG_RING_SLOTS];
+    slot->length = formatLine(slot->text, format, args);
+    va_end(args);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+    if (used + 1 >= LOG_RING_SLOTS / 2 && atomic_load_explicit(&isWriterSleeping, memory_order_relaxed))
+    {
+        pthread_mutex_lock(&wakeLock);
+        pthread_cond_signal(&wakeCond);
+        pthread_mutex_unlock(&wakeLock);
+    }
+}
+
+void logSetLevel(int level)
+{
+    logLevel = level;
+}
+
+void logFlush(void)
+{
+    drainRings();
+}
+
+__attribute__((constructor)) static void logInit(void)
+{
+    const char *level = getenv("IPC_LOG_LEVEL");
+    if (level)
+    {
+        if (0 == strcmp(level, "none"))
+            logLevel = LOG_LEVEL_NONE;
+        else if (0 == strcmp(level, "error"))
+            logLevel = LOG_LEVEL_ERROR;
+    }
+    /* Lines still in the rings are written by exit(), including the exit of cleanupAndExitError() */
+    atexit(logFlush);
+}
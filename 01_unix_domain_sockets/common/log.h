@@ -0,0 +1,51 @@
+/**------------------------------------------------------------------------------------------------
+ * ?                                           ABOUT
+ * @author         :  Nguyen Dinh Hoan
+ * @email          :  hoann.wk@gmail.com
+ * @repo           :  https://github.com/hoan9x/IPC-in-Linux
+ * @createdOn      :  16-Oct-2026
+ * @description    :  Asynchronous logging: lines are formatted into a per-thread lock-free ring and
+ *                    written to stdout by a background thread
+ *------------------------------------------------------------------------------------------------**/
+#ifndef LOG_H
+#define LOG_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_INFO 2
+
+/* Levels above this one are compiled out, build with -DLOG_COMPILE_LEVEL=LOG_LEVEL_ERROR to drop LOG_INFO */
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_LEVEL_INFO
+#endif
+
+/* Longest line kept, longer ones are cut and end with "..." */
+#define LOG_LINE_MAX 256
+/* Lines a thread can have waiting for the background writer, more are dropped and counted */
+#define LOG_RING_SLOTS 1024
+
+/* Runtime level, from the IPC_LOG_LEVEL environment variable (none, error or info, default info) */
+extern int logLevel;
+
+/**
+ * Log at LEVEL: a disabled level costs one comparison, or nothing at all above LOG_COMPILE_LEVEL, and the
+ * arguments are not evaluated. The caller never blocks on stdout: the line is formatted into the ring of
+ * its thread, a full ring drops it.
+ **/
+#define LOG_AT(LEVEL, format, ...) do { if ((LEVEL) <= LOG_COMPILE_LEVEL && (LEVEL) <= logLevel) logWrite(format, ##__VA_ARGS__); } while (0)
+
+/* Queue one line, a newline is added. Use LOG_AT() instead */
+void logWrite(const char *format, ...) __attribute__((format(printf, 1, 2)));
+void logSetLevel(int level);
+/* Write every queued line now, also done at exit() */
+void logFlush(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LOG_H */
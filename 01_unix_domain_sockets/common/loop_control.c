@@ -0,0 +1,106 @@
+/**------------------------------------------------------------------------------------------------
+ * ?                                           ABOUT
+ * @author         :  Nguyen Dinh Hoan
+ * @email          :  hoann.wk@gmail.com
+ * @repo           :  https://github.com/hoan9x/IPC-in-Linux
+ * @createdOn      :  16-Oct-2026
+ * @description    :  Control path of an event loop: signals (signalfd) and requests from other threads
+ *                    (eventfd) arrive as readable fds in the same event set as the sockets
+ *------------------------------------------------------------------------------------------------**/
+#define _GNU_SOURCE
+#include "loop_control.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <unistd.h>
+
+int loopControlInit(struct LoopControl *control, const struct LoopSignal *map, int numSignals)
+{
+    sigset_t signals;
+    memset(control, 0, sizeof(*control));
+    control->signalFd = -1;
+    control->eventFd = -1;
+    if (numSignals < 0 || numSignals > LOOP_CONTROL_MAX_SIGNALS)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    memcpy(control->map, map, sizeof(struct LoopSignal) * numSignals);
+    control->numSignals = numSignals;
+
+    sigemptyset(&signals);
+    for (int i = 0; i < numSignals; ++i)
+        sigaddset(&signals, map[i].signalNumber);
+    /* A blocked signal stays pending until it is read from the signalfd */
+    if (0 != pthread_sigmask(SIG_BLOCK, &signals, NULL))
+        return -1;
+    control->signalFd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    control->eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (control->signalFd < 0 || control->eventFd < 0)
+    {
+        int savedErrno = errno;
+        loopControlRelease(control);
+        errno = savedErrno;
+        return -1;
+    }
+    return 0;
+}
+
+void loopControlRelease(struct LoopControl *control)
+{
+    if (control->signalFd >= 0)
+        close(control->signalFd);
+    if (control->eventFd >= 0)
+        close(control->eventFd);
+    control->signalFd = -1;
+    control->eventFd = -1;
+}
+
+void loopControlPost(struct LoopControl *control, unsigned requests)
+{
+    uint64_t one = 1;
+    /* Bits first: the loop woken up by the write always finds them. Both calls are async-signal-safe */
+    atomic_fetch_or_explicit(&control->posted, requests, memory_order_release);
+    if (write(control->eventFd, &one, sizeof(one)) < 0)
+    {
+        /* Only EAGAIN at the counter limit, the loop has a wakeup pending anyway */
+    }
+    atomic_fetch_add_explicit(&control->numPosts, 1, memory_order_relaxed);
+}
+
+unsigned loopControlTake(struct LoopControl *control)
+{
+    struct signalfd_siginfo info[8];
+    unsigned requests = 0;
+    uint64_t count;
+    ssize_t ret;
+
+    while ((ret = read(control->signalFd, info, sizeof(info))) > 0)
+    {
+        for (ssize_t i = 0; i < ret / (ssize_t)sizeof(info[0]); ++i)
+        {
+            control->stats.signals++;
+            for (int k = 0; k < control->numSignals; ++k)
+            {
+                if ((int)info[i].ssi_signo == control->map[k].signalNumber)
+                    requests |= control->map[k].request;
+            }
+        }
+    }
+    if (read(control->eventFd, &count, sizeof(count)) == sizeof(count))
+        control->stats.wakeups++;
+    return requests | atomic_exchange_explicit(&control->posted, 0, memory_order_acquire);
+}
+
+int loopControlStatsFormat(const struct LoopControl *control, char *buffer, size_t size)
+{
+    return snprintf(buffer, size, "%llu signals, %llu posted requests, %llu wakeups",
+                    control->stats.signals,
+                    atomic_load_explicit(&control->numPosts, memory_order_relaxed),
+                    control->stats.wakeups);
+}
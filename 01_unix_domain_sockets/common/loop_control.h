@@ -0,0 +1,74 @@
+/**------------------------------------------------------------------------------------------------
+ * ?                                           ABOUT
+ * @author         :  Nguyen Dinh Hoan
+ * @email          :  hoann.wk@gmail.com
+ * @repo           :  https://github.com/hoan9x/IPC-in-Linux
+ * @createdOn      :  16-Oct-2026
+ * @description    :  Control path of an event loop: signals (signalfd) and requests from other threads
+ *                    (eventfd) arrive as readable fds in the same event set as the sockets
+ *------------------------------------------------------------------------------------------------**/
+#ifndef LOOP_CONTROL_H
+#define LOOP_CONTROL_H
+
+#include <signal.h>
+#include <stdatomic.h>
+#include <stddef.h>
+
+#define LOOP_CONTROL_MAX_SIGNALS 8
+/* Default time a draining server gives its clients before closing them */
+#define LOOP_CONTROL_DEFAULT_DRAIN_MS 5000
+
+/* What the loop is asked to do, several requests may arrive together */
+enum LoopRequest
+{
+    LOOP_REQUEST_WAKEUP = 1u << 0,  /* only wake the loop up, it re-checks state shared with other threads */
+    LOOP_REQUEST_STATS = 1u << 1,   /* print the statistics */
+    LOOP_REQUEST_DRAIN = 1u << 2,   /* stop accepting, send the replies in flight, exit once the clients are gone or at the deadline */
+    LOOP_REQUEST_STOP = 1u << 3,    /* exit now */
+};
+
+/* Request raised by a signal */
+struct LoopSignal
+{
+    int signalNumber;
+    unsigned request;
+};
+
+/* Counted by the loop thread */
+struct LoopControlStats
+{
+    unsigned long long signals;     /* signals read from the signalfd */
+    unsigned long long wakeups;     /* eventfd reads that returned posted requests */
+};
+
+/**
+ * The signals of the map are blocked and read from a signalfd instead of interrupting a system call: no
+ * handler, no flag checked between two calls, a signal sent right before the wait still wakes it up. Other
+ * threads (or a signal handler) post requests with loopControlPost(), which sets bits and writes an eventfd.
+ * Both fds are non-blocking, the loop watches them like sockets with select(), poll(), epoll or io_uring.
+ **/
+struct LoopControl
+{
+    int signalFd;
+    int eventFd;
+    atomic_uint posted;     /* requests posted and not taken yet */
+    atomic_ullong numPosts; /* loopControlPost() calls, from any thread */
+    struct LoopSignal map[LOOP_CONTROL_MAX_SIGNALS];
+    int numSignals;
+    struct LoopControlStats stats;
+};
+
+/**
+ * Block the signals of map and create the fds. The signal mask is per thread and inherited: call it in the main
+ * thread before any other thread starts (the log writer included), so no thread takes these signals itself.
+ * Return 0 or -1 with errno set.
+ **/
+int loopControlInit(struct LoopControl *control, const struct LoopSignal *map, int numSignals);
+void loopControlRelease(struct LoopControl *control);
+/* Post requests to the loop, from any thread, async-signal-safe */
+void loopControlPost(struct LoopControl *control, unsigned requests);
+/* Read both fds and return the requests received since the last call, 0 if none */
+unsigned loopControlTake(struct LoopControl *control);
+int loopControlStatsFormat(const struct LoopControl *control, char *buffer, size_t size);
+
+#endif /* LOOP_CONTROL_H */
@@ -0,0 +1,376 @@
+/**------------------------------------------------------------------------------------------------
+ * ?                                           ABOUT
+ * @author         :  Nguyen Dinh Hoan
+ * @email          :  hoann.wk@gmail.com
+ * @repo           :  https://github.com/hoan9x/IPC-in-Linux
+ * @createdOn      :  16-Oct-2026
+ * @description    :  Per-thread runtime counters, aggregated when scraped from an admin UNIX socket
+ *------------------------------------------------------------------------------------------------**/
+#define _GNU_SOURCE
+#include "metrics.h"
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+/* A scraper that does not read its snapshot within this time is dropped, the admin thread serves the next one */
+#define ADMIN_SEND_TIMEOUT_MS 1000
+
+/* Out of fds the pending scraper stays queued and accept() fails again at once, wait this long before the retry */
+#define ADMIN_ACCEPT_BACKOFF_MS 100
+
+__thread struct MetricsThread *metricsSelf;
+
+/* Threads that counted something, pushed without lock and never freed */
+static _Atomic(struct MetricsThread *) threads;
+static atomic_int numThreads;
+static int adminSocket = -1;
+static char adminPath[sizeof(((struct sockaddr_un *)0)->sun_path)];
+
+/* How each counter is exposed, the syscall counters share one family with a call label */
+static const struct
+{
+    const char *name;
+    const char *call;
+    const char *help;
+} counterInfo[METRIC_NUM_COUNTERS] = {
+    [METRIC_ACCEPTED] = {"connections_accepted_total", NULL, "Connections accepted"},
+    [METRIC_CLOSED] = {"connections_closed_total", NULL, "Connections closed"},
+    [METRIC_ACCEPT_PAUSES] = {"accept_pauses_total", NULL, "Times accepting was paused, connections waiting in the backlog meanwhile"},
+    [METRIC_MESSAGES_IN] = {"messages_in_total", NULL, "Messages received"},
+    [METRIC_BYTES_IN] = {"bytes_in_total", NULL, "Bytes received"},
+    [METRIC_MESSAGES_OUT] = {"messages_out_total", NULL, "Messages sent"},
+    [METRIC_BYTES_OUT] = {"bytes_out_total", NULL, "Bytes sent"},
+    [METRIC_WAKEUPS] = {"loop_wakeups_total", NULL, "Returns from the wait of the event loops"},
+    [METRIC_EVENTS] = {"loop_events_total", NULL, "Ready events handled, divide by the wakeups for the events per wakeup"},
+    [METRIC_BUSY_NS] = {"loop_busy_seconds_total", NULL, "Time spent handling the ready events"},
+    [METRIC_SYSCALL_ACCEPT] = {"syscalls_total", "accept", "System calls issued by the event loops"},
+    [METRIC_SYSCALL_READ] = {"syscalls_total", "read", NULL},
+    [METRIC_SYSCALL_WRITE] = {"syscalls_total", "write", NULL},
+    [METRIC_SYSCALL_WAIT] = {"syscalls_total", "wait", NULL},
+    [METRIC_SYSCALL_CTL] = {"syscalls_total", "ctl", NULL},
+};
+
+struct MetricsThread *metricsRegisterThread(const char *name)
+{
+    struct MetricsThread *thread = metricsSelf;
+    if (!thread)
+    {
+        thread = aligned_alloc(64, sizeof(struct MetricsThread));
+        if (!thread)
+            abort();
+        memset(thread, 0, sizeof(*thread));
+        pthread_mutex_init(&thread->connLock, NULL);
+        int id = atomic_fetch_add_explicit(&numThreads, 1, memory_order_relaxed);
+        snprintf(thread->name, sizeof(thread->name), "thread-%d", id);
+        metricsSelf = thread;
+        thread->next = atomic_load_explicit(&threads, memory_order_relaxed);
+        while (!atomic_compare_exchange_weak_explicit(&threads, &thread->next, thread, memory_order_release, memory_order_relaxed))
+            ;
+    }
+    if (name)
+    {
+        pthread_mutex_lock(&thread->connLock);
+        snprintf(thread->name, sizeof(thread->name), "%s", name);
+        pthread_mutex_unlock(&thread->connLock);
+    }
+    return thread;
+}
+
+void metricsConnOpen(struct ConnMetrics *conn, int fd)
+{
+    struct MetricsThread *thread = metricsThread();
+    memset(conn, 0, sizeof(*conn));
+    conn->fd = fd;
+    conn->openedNs = metricsNow();
+    conn->owner = thread;
+    pthread_mutex_lock(&thread->connLock);
+    conn->next = thread->conns;
+    if (thread->conns)
+        thread->conns->prev = conn;
+    thread->conns = conn;
+    pthread_mutex_unlock(&thread->connLock);
+    metricsBump(&thread->counters[METRIC_ACCEPTED], 1);
+}
+
+void metricsConnClose(struct ConnMetrics *conn)
+{
+    struct MetricsThread *thread = conn->owner;
+    pthread_mutex_lock(&thread->connLock);
+    if (conn->prev)
+        conn->prev->next = conn->next;
+    else
+        thread->conns = conn->next;
+    if (conn->next)
+        conn->next->prev = conn->prev;
+    pthread_mutex_unlock(&thread->connLock);
+    metricsBump(&thread->counters[METRIC_CLOSED], 1);
+}
+
+uint64_t metricsNow(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+void metricsLoopDone(uint64_t wakeupNs, int numEvents)
+{
+    struct MetricsThread *thread = metricsThread();
+    uint64_t busyNs = metricsNow() - wakeupNs;
+    metricsBump(&thread->counters[METRIC_WAKEUPS], 1);
+    metricsBump(&thread->counters[METRIC_EVENTS], (uint64_t)numEvents);
+    metricsBump(&thread->counters[METRIC_BUSY_NS], busyNs);
+    if (busyNs > atomic_load_explicit(&thread->maxBusyNs, memory_order_relaxed))
+        atomic_store_explicit(&thread->maxBusyNs, busyNs, memory_order_relaxed);
+    if ((uint64_t)numEvents > atomic_load_explicit(&thread->maxEvents, memory_order_relaxed))
+        atomic_store_explicit(&thread->maxEvents, (uint64_t)numEvents, memory_order_relaxed);
+}
+
+/**------------------------------------------------------------------------
+ *                        Snapshot in the text format
+ *------------------------------------------------------------------------**/
+struct Text
+{
+    char *data;
+    size_t length;
+    size_t capacity;
+    bool isFailed;
+};
+
+static void appendText(struct Text *text, const char *format, ...) __attribute__((format(printf, 2, 3)));
+static void appendText(struct Text *text, const char *format, ...)
+{
+    for (; !text->isFailed;)
+    {
+        va_list args;
+        va_start(args, format);
+        int ret = vsnprintf(text->data + text->length, text->capacity - text->length, format, args);
+        va_end(args);
+        if (ret >= 0 && (size_t)ret < text->capacity - text->length)
+        {
+            text->length += (size_t)ret;
+            return;
+        }
+        size_t capacity = text->capacity * 2 + (ret > 0 ? (size_t)ret : 0);
+        char *data = realloc(text->data, capacity);
+        if (ret < 0 || !data)
+        {
+            text->isFailed = true;
+            return;
+        }
+        text->data = data;
+        text->capacity = capacity;
+    }
+}
+
+/* "# HELP"/"# TYPE" lines of a family, once */
+static void appendFamily(struct Text *text, const char *prefix, enum MetricCounter counter)
+{
+    if (!counterInfo[counter].help)
+        return;
+    appendText(text, "# HELP ipc_%s%s %s\n# TYPE ipc_%s%s counter\n", prefix, counterInfo[counter].name,
+               counterInfo[counter].help, prefix, counterInfo[counter].name);
+}
+
+/* One sample of a counter, labels is empty or a list of labels without braces */
+static void appendCounter(struct Text *text, const char *prefix, enum MetricCounter counter, const char *labels, uint64_t value)
+{
+    char allLabels[METRICS_THREAD_NAME_MAX + 32];
+    const char *call = counterInfo[counter].call;
+    if (call)
+        snprintf(allLabels, sizeof(allLabels), "%s%scall=\"%s\"", labels, ('\0' != labels[0]) ? "," : "", call);
+    else
+        snprintf(allLabels, sizeof(allLabels), "%s", labels);
+    bool hasLabels = ('\0' != allLabels[0]);
+    appendText(text, "ipc_%s%s%s%s%s", prefix, counterInfo[counter].name, hasLabels ? "{" : "", allLabels, hasLabels ? "}" : "");
+    if (METRIC_BUSY_NS == counter)
+        appendText(text, " %.6f\n", value / 1e9);
+    else
+        appendText(text, " %llu\n", (unsigned long long)value);
+}
+
+char *metricsFormat(size_t *length)
+{
+    struct Text text = {.data = malloc(4096), .capacity = 4096};
+    if (!text.data)
+        return NULL;
+    uint64_t totals[METRIC_NUM_COUNTERS] = {0}, maxBusyNs = 0, maxEvents = 0, now = metricsNow();
+    struct MetricsThread *first = atomic_load_explicit(&threads, memory_order_acquire);
+    int numListed = 0;
+
+    /* Aggregated lazily: the threads are only summed here */
+    for (struct MetricsThread *thread = first; thread; thread = thread->next, ++numListed)
+    {
+        for (int i = 0; i < METRIC_NUM_COUNTERS; ++i)
+            totals[i] += atomic_load_explicit(&thread->counters[i], memory_order_relaxed);
+        uint64_t value = atomic_load_explicit(&thread->maxBusyNs, memory_order_relaxed);
+        maxBusyNs = (value > maxBusyNs) ? value : maxBusyNs;
+        value = atomic_load_explicit(&thread->maxEvents, memory_order_relaxed);
+        maxEvents = (value > maxEvents) ? value : maxEvents;
+    }
+    for (int i = 0; i < METRIC_NUM_COUNTERS; ++i)
+    {
+        appendFamily(&text, "", i);
+        appendCounter(&text, "", i, "", totals[i]);
+    }
+    appendText(&text, "# TYPE ipc_connections_active gauge\nipc_connections_active %llu\n",
+               (unsigned long long)(totals[METRIC_ACCEPTED] - totals[METRIC_CLOSED]));
+    appendText(&text, "# TYPE ipc_loop_max_busy_seconds gauge\nipc_loop_max_busy_seconds %.6f\n", maxBusyNs / 1e9);
+    appendText(&text, "# TYPE ipc_loop_max_events_per_wakeup gauge\nipc_loop_max_events_per_wakeup %llu\n", (unsigned long long)maxEvents);
+    appendText(&text, "# TYPE ipc_threads gauge\nipc_threads %d\n", numListed);
+
+    /* The same counters for each thread */
+    for (int i = 0; i < METRIC_NUM_COUNTERS; ++i)
+    {
+        appendFamily(&text, "thread_", i);
+        for (struct MetricsThread *thread = first; thread; thread = thread->next)
+        {
+            char labels[METRICS_THREAD_NAME_MAX + 16];
+            pthread_mutex_lock(&thread->connLock);
+            snprintf(labels, sizeof(labels), "thread=\"%s\"", thread->name);
+            pthread_mutex_unlock(&thread->connLock);
+            appendCounter(&text, "thread_", i, labels, atomic_load_explicit(&thread->counters[i], memory_order_relaxed));
+        }
+    }
+
+    /* Every open connection, its thread keeps it listed until it is closed */
+    appendText(&text, "# TYPE ipc_connection_messages_in_total counter\n# TYPE ipc_connection_bytes_in_total counter\n"
+               "# TYPE ipc_connection_messages_out_total counter\n# TYPE ipc_connection_bytes_out_total counter\n"
+               "# TYPE ipc_connection_age_seconds gauge\n");
+    for (struct MetricsThread *thread = first; thread; thread = thread->next)
+    {
+        pthread_mutex_lock(&thread->connLock);
+        for (struct ConnMetrics *conn = thread->conns; conn; conn = conn->next)
+        {
+            appendText(&text, "ipc_connection_messages_in_total{thread=\"%s\",fd=\"%d\"} %llu\n", thread->name, conn->fd,
+                       (unsigned long long)atomic_load_explicit(&conn->messagesIn, memory_order_relaxed));
+            appendText(&text, "ipc_connection_bytes_in_total{thread=\"%s\",fd=\"%d\"} %llu\n", thread->name, conn->fd,
+                       (unsigned long long)atomic_load_explicit(&conn->bytesIn, memory_order_relaxed));
+            appendText(&text, "ipc_connection_messages_out_total{thread=\"%s\",fd=\"%d\"} %llu\n", thread->name, conn->fd,
+                       (unsigned long long)atomic_load_explicit(&conn->messagesOut, memory_order_relaxed));
+            appendText(&text, "ipc_connection_bytes_out_total{thread=\"%s\",fd=\"%d\"} %llu\n", thread->name, conn->fd,
+                       (unsigned long long)atomic_load_explicit(&conn->bytesOut, memory_order_relaxed));
+            appendText(&text, "ipc_connection_age_seconds{thread=\"%s\",fd=\"%d\"} %.3f\n", thread->name, conn->fd,
+                       (now - conn->openedNs) / 1e9);
+        }
+        pthread_mutex_unlock(&thread->connLock);
+    }
+
+    if (text.isFailed)
+    {
+        free(text.data);
+        return NULL;
+    }
+    *length = text.length;
+    return text.data;
+}
+
+/**------------------------------------------------------------------------
+ *                              Admin socket
+ *------------------------------------------------------------------------**/
+static void sendSnapshot(int fd)
+{
+    size_t length;
+    char *snapshot = metricsFormat(&length);
+    const char *data = snapshot ? snapshot : "# out of memory\n";
+    length = snapshot ? length : strlen(data);
+    while (length > 0)
+    {
+        ssize_t ret = send(fd, data, length, MSG_NOSIGNAL);
+        if (ret < 0 && EINTR == errno)
+            continue;
+        if (ret <= 0)
+            break;
+        data += ret;
+        length -= (size_t)ret;
+    }
+    free(snapshot);
+}
+
+static void *adminMain(void *arg)
+{
+    (void)arg;
+    for (;;)
+    {
+        int fd = accept4(adminSocket, NULL, NULL, SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            if (EINTR == errno || ECONNABORTED == errno)
+                continue;
+            if (EMFILE == errno || ENFILE == errno)
+            {
+                /* The server closing a connection gives an fd back, sleeping leaves the CPU to it meanwhile */
+                struct timespec backoff = {.tv_sec = 0, .tv_nsec = ADMIN_ACCEPT_BACKOFF_MS * 1000000L};
+                nanosleep(&backoff, NULL);
+                continue;
+            }
+            return NULL;
+        }
+        struct timeval timeout = {.tv_sec = ADMIN_SEND_TIMEOUT_MS / 1000, .tv_usec = (ADMIN_SEND_TIMEOUT_MS % 1000) * 1000};
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        sendSnapshot(fd);
+        close(fd);
+    }
+}
+
+int metricsStartAdmin(const char *path)
+{
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    if (strlen(path) >= sizeof(address.sun_path))
+    {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(address.sun_path, path);
+    unlink(path);
+    adminSocket = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (adminSocket < 0)
+        return -1;
+    if (bind(adminSocket, (const struct sockaddr *)&address, sizeof(address)) < 0 || listen(adminSocket, 8) < 0)
+    {
+        int savedErrno = errno;
+        close(adminSocket);
+        adminSocket = -1;
+        errno = savedErrno;
+        return -1;
+    }
+    strcpy(adminPath, path);
+
+    /* The admin thread takes no signal, they stay with the threads of the server */
+    pthread_t thread;
+    pthread_attr_t attr;
+    sigset_t allSignals, savedSignals;
+    sigfillset(&allSignals);
+    pthread_sigmask(SIG_SETMASK, &allSignals, &savedSignals);
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int ret = pthread_create(&thread, &attr, adminMain, NULL);
+    pthread_attr_destroy(&attr);
+    pthread_sigmask(SIG_SETMASK, &savedSignals, NULL);
+    if (0 != ret)
+    {
+        metricsStopAdmin();
+        close(adminSocket);
+        adminSocket = -1;
+        errno = ret;
+        return -1;
+    }
+    return 0;
+}
+
+void metricsStopAdmin(void)
+{
+    if ('\0' != adminPath[0])
+        unlink(adminPath);
+    adminPath[0] = '\0';
+}
@@ -0,0 +1,133 @@
+/**------------------------------------------------------------------------------------------------
+ * ?                                           ABOUT
+ * @author         :  Nguyen Dinh Hoan
+ * @email          :  hoann.wk@gmail.com
+ * @repo           :  https://github.com/hoan9x/IPC-in-Linux
+ * @createdOn      :  16-Oct-2026
+ * @description    :  Per-thread runtime counters, aggregated when scraped from an admin UNIX socket
+ *------------------------------------------------------------------------------------------------**/
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <pthread.h>
+
+/* The admin socket is the server socket path with this suffix */
+#define METRICS_ADMIN_SUFFIX ".admin"
+#define METRICS_THREAD_NAME_MAX 24
+
+enum MetricCounter
+{
+    METRIC_ACCEPTED,
+    METRIC_CLOSED,
+    METRIC_ACCEPT_PAUSES,   /* accepting paused by a rate limit or by running out of descriptors */
+    METRIC_MESSAGES_IN,
+    METRIC_BYTES_IN,
+    METRIC_MESSAGES_OUT,
+    METRIC_BYTES_OUT,
+    METRIC_WAKEUPS,         /* returns from the wait of the event loop */
+    METRIC_EVENTS,          /* ready events handled */
+    METRIC_BUSY_NS,         /* time spent handling them */
+    METRIC_SYSCALL_ACCEPT,
+    METRIC_SYSCALL_READ,
+    METRIC_SYSCALL_WRITE,
+    METRIC_SYSCALL_WAIT,
+    METRIC_SYSCALL_CTL,     /* registration changes: epoll_ctl() */
+    METRIC_NUM_COUNTERS,
+};
+
+/**
+ * Counters of one connection, embedded in the connection state. Only the thread serving the connection
+ * writes them, the admin thread reads them while the connection is listed.
+ **/
+struct ConnMetrics
+{
+    _Atomic uint64_t messagesIn;
+    _Atomic uint64_t bytesIn;
+    _Atomic uint64_t messagesOut;
+    _Atomic uint64_t bytesOut;
+    int fd;
+    uint64_t openedNs;
+    struct MetricsThread *owner;
+    struct ConnMetrics *prev;
+    struct ConnMetrics *next;
+};
+
+/**
+ * Counters of one thread, on cache lines of their own. The owner updates them with a relaxed load and store,
+ * not a read-modify-write, since it is the only writer: counting costs an add and no thread ever waits on
+ * another one. The admin thread sums the threads when it is scraped.
+ **/
+struct MetricsThread
+{
+    _Atomic uint64_t counters[METRIC_NUM_COUNTERS];
+    _Atomic uint64_t maxBusyNs;         /* longest wakeup */
+    _Atomic uint64_t maxEvents;         /* most events of one wakeup */
+    /* Connections of the thread, the lock is only taken to open or close one and by the admin thread */
+    pthread_mutex_t connLock;
+    struct ConnMetrics *conns;
+    char name[METRICS_THREAD_NAME_MAX];
+    struct MetricsThread *next;
+} __attribute__((aligned(64)));
+
+extern __thread struct MetricsThread *metricsSelf;
+
+/* Register the calling thread under name, done with a generated name by the first counter update otherwise */
+struct MetricsThread *metricsRegisterThread(const char *name);
+
+static inline struct MetricsThread *metricsThread(void)
+{
+    return metricsSelf ? metricsSelf : metricsRegisterThread(NULL);
+}
+
+/* Add to a counter written by the calling thread only */
+static inline void metricsBump(_Atomic uint64_t *counter, uint64_t n)
+{
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+static inline void metricsAdd(enum MetricCounter counter, uint64_t n)
+{
+    metricsBump(&metricsThread()->counters[counter], n);
+}
+
+/* Messages and bytes received from a connection, also added to the thread totals */
+static inline void metricsConnIn(struct ConnMetrics *conn, uint64_t messages, uint64_t bytes)
+{
+    metricsBump(&conn->messagesIn, messages);
+    metricsBump(&conn->bytesIn, bytes);
+    metricsBump(&conn->owner->counters[METRIC_MESSAGES_IN], messages);
+    metricsBump(&conn->owner->counters[METRIC_BYTES_IN], bytes);
+}
+
+/* Messages and bytes sent to a connection, also added to the thread totals */
+static inline void metricsConnOut(struct ConnMetrics *conn, uint64_t messages, uint64_t bytes)
+{
+    metricsBump(&conn->messagesOut, messages);
+    metricsBump(&conn->bytesOut, bytes);
+    metricsBump(&conn->owner->counters[METRIC_MESSAGES_OUT], messages);
+    metricsBump(&conn->owner->counters[METRIC_BYTES_OUT], bytes);
+}
+
+/* List a new connection of the calling thread and count it as accepted */
+void metricsConnOpen(struct ConnMetrics *conn, int fd);
+/* Unlist a connection and count it as closed, to be called by the same thread before its memory is freed */
+void metricsConnClose(struct ConnMetrics *conn);
+
+/* CLOCK_MONOTONIC in nanoseconds */
+uint64_t metricsNow(void);
+/* Account one wakeup of the event loop of the calling thread: numEvents handled since wakeupNs */
+void metricsLoopDone(uint64_t wakeupNs, int numEvents);
+
+/**
+ * Serve the counters on a UNIX socket at path from a background thread: every connection gets a snapshot in
+ * the Prometheus text format and is closed. Return 0 or -1 with errno set.
+ **/
+int metricsStartAdmin(const char *path);
+/* Remove the admin socket file */
+void metricsStopAdmin(void);
+/* Format every counter into a malloc()ed text of *length bytes, NULL if out of memory */
+char *metricsFormat(size_t *length);
+
+#endif /* METRICS_H */
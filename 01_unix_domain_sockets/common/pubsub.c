@@ -0,0 +1,364 @@
+/**------------------------------------------------------------------------------------------------
+ * ?                                           ABOUT
+ * @author         :  Nguyen Dinh Hoan
+ * @email          :  hoann.wk@gmail.com
+ * @repo           :  https://github.com/hoan9x/IPC-in-Linux
+ * @createdOn      :  16-Oct-2026
+ * @description    :  Topic-based publish/subscribe: a published message is stored once in a
+ *                    reference-counted buffer and queued by reference to every subscriber
+ *------------------------------------------------------------------------------------------------**/
+#include "pubsub.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/uio.h>
+
+#include "buffer_pool.h"
+
+/* A topic lives while it has subscribers, publishing to a topic nobody follows allocates nothing */
+struct PubSubTopic
+{
+    struct PubSubTopic *next;   /* in the hash bucket */
+    struct Subscriber **subscribers;
+    size_t numSubscribers;
+    size_t capacity;
+    size_t length;
+    char name[PUBSUB_TOPIC_MAX + 1];
+};
+
+/* FNV-1a hash of the topic name */
+static uint32_t hashTopic(const char *name, size_t length)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; ++i)
+    {
+        hash ^= (unsigned char)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/* Find a topic, *link is set to the pointer that holds it (or where it would be linked) */
+static struct PubSubTopic *findTopic(struct PubSub *pubSub, const char *name, size_t length, struct PubSubTopic ***link)
+{
+    struct PubSubTopic **slot = &pubSub->buckets[hashTopic(name, length) % PUBSUB_TOPIC_BUCKETS];
+    for (; *slot; slot = &(*slot)->next)
+    {
+        if ((*slot)->length == length && 0 == memcmp((*slot)->name, name, length))
+            break;
+    }
+    if (link)
+        *link = slot;
+    return *slot;
+}
+
+static void unrefMessage(struct PubSub *pubSub, struct SharedMessage *message)
+{
+    if (0 == --message->refCount)
+    {
+        bufferPoolPut(pubSub->pool, message, message->capacity);
+        pubSub->stats.liveMessages--;
+    }
+}
+
+static void markPending(struct PubSub *pubSub, struct Subscriber *subscriber)
+{
+    if (subscriber->isPending)
+        return;
+    subscriber->isPending = true;
+    subscriber->nextPending = pubSub->pending;
+    pubSub->pending = subscriber;
+}
+
+void pubSubInit(struct PubSub *pubSub, struct BufferPool *pool, enum PubSubPolicy policy, uint32_t maxQueued)
+{
+    memset(pubSub, 0, sizeof(*pubSub));
+    pubSub->pool = pool;
+    pubSub->policy = policy;
+    pubSub->maxQueued = maxQueued;
+}
+
+void pubSubRelease(struct PubSub *pubSub)
+{
+    for (int i = 0; i < PUBSUB_TOPIC_BUCKETS; ++i)
+    {
+        while (pubSub->buckets[i])
+        {
+            struct PubSubTopic *next = pubSub->buckets[i]->next;
+            free(pubSub->buckets[i]->subscribers);
+            free(pubSub->buckets[i]);
+            pubSub->buckets[i] = next;
+        }
+    }
+    pubSub->numTopics = 0;
+}
+
+int pubSubParsePolicy(const char *text, enum PubSubPolicy *policy)
+{
+    if (0 == strcmp(text, "drop"))
+        *policy = PUBSUB_POLICY_DROP;
+    else if (0 == strcmp(text, "disconnect"))
+        *policy = PUBSUB_POLICY_DISCONNECT;
+    else
+        return -1;
+    return 0;
+}
+
+void subscriberInit(struct Subscriber *subscriber, int fd)
+{
+    memset(subscriber, 0, sizeof(*subscriber));
+    subscriber->fd = fd;
+}
+
+int pubSubSubscribe(struct PubSub *pubSub, struct Subscriber *subscriber, const char *topic, size_t length)
+{
+    struct PubSubTopic **link;
+    if (0 == length || length > PUBSUB_TOPIC_MAX || memchr(topic, '\0', length))
+        return -1;
+    struct PubSubTopic *entry = findTopic(pubSub, topic, length, &link);
+    for (int i = 0; entry && i < subscriber->numTopics; ++i)
+    {
+        if (subscriber->topics[i] == entry)
+            return 0;
+    }
+    if (PUBSUB_MAX_TOPICS_PER_SUBSCRIBER == subscriber->numTopics)
+        return -1;
+    if (!subscriber->queue && !(subscriber->queue = calloc(pubSub->maxQueued, sizeof(struct SharedMessage *))))
+        return -1;
+
+    if (!entry)
+    {
+        if (!(entry = calloc(1, sizeof(struct PubSubTopic))))
+            return -1;
+        memcpy(entry->name, topic, length);
+        entry->length = length;
+        *link = entry;
+        pubSub->numTopics++;
+    }
+    if (entry->numSubscribers == entry->capacity)
+    {
+        size_t capacity = entry->capacity ? entry->capacity * 2 : 8;
+        struct Subscriber **subscribers = realloc(entry->subscribers, capacity * sizeof(struct Subscriber *));
+        if (!subscribers)
+        {
+            /* A topic created just above has no subscriber, it must not stay linked and be matched by publishes */
+            if (0 == entry->numSubscribers)
+            {
+                *link = entry->next;
+                free(entry->subscribers);
+                free(entry);
+                pubSub->numTopics--;
+            }
+            return -1;
+        }
+        entry->subscribers = subscribers;
+        entry->capacity = capacity;
+    }
+    entry->subscribers[entry->numSubscribers++] = subscriber;
+    subscriber->topics[subscriber->numTopics++] = entry;
+    return 0;
+}
+
+/* Take the subscriber out of the topic, the topic is freed with its last subscriber */
+static void leaveTopic(struct PubSub *pubSub, struct PubSubTopic *topic, struct Subscriber *subscriber)
+{
+    for (size_t i = 0; i < topic->numSubscribers; ++i)
+    {
+        if (topic->subscribers[i] == subscriber)
+        {
+            topic->subscribers[i] = topic->subscribers[--topic->numSubscribers];
+            break;
+        }
+    }
+    if (topic->numSubscribers > 0)
+        return;
+    struct PubSubTopic **link;
+    findTopic(pubSub, topic->name, topic->length, &link);
+    *link = topic->next;
+    free(topic->subscribers);
+    free(topic);
+    pubSub->numTopics--;
+}
+
+int pubSubUnsubscribe(struct PubSub *pubSub, struct Subscriber *subscriber, const char *topic, size_t length)
+{
+    struct PubSubTopic *entry = findTopic(pubSub, topic, length, NULL);
+    for (int i = 0; entry && i < subscriber->numTopics; ++i)
+    {
+        if (subscriber->topics[i] == entry)
+        {
+            subscriber->topics[i] = subscriber->topics[--subscriber->numTopics];
+            leaveTopic(pubSub, entry, subscriber);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+void pubSubRemove(struct PubSub *pubSub, struct Subscriber *subscriber)
+{
+    while (subscriber->numTopics > 0)
+        leaveTopic(pubSub, subscriber->topics[--subscriber->numTopics], subscriber);
+    for (; subscriber->count > 0; subscriber->count--)
+    {
+        unrefMessage(pubSub, subscriber->queue[subscriber->head]);
+        subscriber->head = (subscriber->head + 1) % pubSub->maxQueued;
+    }
+    free(subscriber->queue);
+    subscriber->queue = NULL;
+    if (subscriber->isPending)
+    {
+        struct Subscriber **link = &pubSub->pending;
+        while (*link != subscriber)
+            link = &(*link)->nextPending;
+        *link = subscriber->nextPending;
+        subscriber->isPending = false;
+    }
+}
+
+int pubSubPublish(struct PubSub *pubSub, uint32_t seq, const char *payload, uint32_t length)
+{
+    const char *end = memchr(payload, '\0', (length < PUBSUB_TOPIC_MAX + 1) ? length : PUBSUB_TOPIC_MAX + 1);
+    if (!end || end == payload)
+        return -1;
+    pubSub->stats.published++;
+    struct PubSubTopic *topic = findTopic(pubSub, payload, (size_t)(end - payload), NULL);
+    if (!topic)
+        return 0;
+
+    /* The only copy: out of the parser buffer of the publisher, which is reused by its next read */
+    size_t capacity;
+    struct SharedMessage *message = bufferPoolGet(pubSub->pool, sizeof(struct SharedMessage) + FRAME_HEADER_SIZE + length, &capacity);
+    if (!message)
+        return -1;
+    struct FrameHeader header = {.length = length, .type = FRAME_TYPE_MESSAGE, .flags = 0, .seq = seq};
+    memcpy(message->data, &header, FRAME_HEADER_SIZE);
+    memcpy(message->data + FRAME_HEADER_SIZE, payload, length);
+    message->size = (uint32_t)(FRAME_HEADER_SIZE + length);
+    message->capacity = capacity;
+    /* The publisher holds one reference while the message is queued, so it is not freed half way */
+    message->refCount = 1;
+    if (++pubSub->stats.liveMessages > pubSub->stats.peakLiveMessages)
+        pubSub->stats.peakLiveMessages = pubSub->stats.liveMessages;
+
+    int numReached = 0;
+    for (size_t i = 0; i < topic->numSubscribers; ++i)
+    {
+        struct Subscriber *subscriber = topic->subscribers[i];
+        if (subscriber->isEvicted)
+            continue;
+        if (subscriber->count == pubSub->maxQueued)
+        {
+            if (PUBSUB_POLICY_DROP == pubSub->policy)
+            {
+                subscriber->dropped++;
+                pubSub->stats.dropped++;
+                continue;
+            }
+            subscriber->isEvicted = true;
+            pubSub->stats.evicted++;
+            markPending(pubSub, subscriber);
+            continue;
+        }
+        subscriber->queue[(subscriber->head + subscriber->count) % pubSub->maxQueued] = message;
+        subscriber->count++;
+        message->refCount++;
+        markPending(pubSub, subscriber);
+        numReached++;
+    }
+    pubSub->stats.deliveries += (unsigned long long)numReached;
+    unrefMessage(pubSub, message);
+    return numReached;
+}
+
+int subscriberQueueFrame(struct PubSub *pubSub, struct Subscriber *subscriber, uint16_t type, uint32_t seq,
+                         const void *payload, uint32_t length)
+{
+    /* A client that only pings gets its queue here, it has no subscription */
+    if (!subscriber->queue && !(subscriber->queue = calloc(pubSub->maxQueued, sizeof(struct SharedMessage *))))
+        return -1;
+    if (subscriber->count == pubSub->maxQueued)
+        return -1;
+    size_t capacity;
+    struct SharedMessage *message = bufferPoolGet(pubSub->pool, sizeof(struct SharedMessage) + FRAME_HEADER_SIZE + length, &capacity);
+    if (!message)
+        return -1;
+    struct FrameHeader header = {.length = length, .type = type, .flags = 0, .seq = seq};
+    memcpy(message->data, &header, FRAME_HEADER_SIZE);
+    memcpy(message->data + FRAME_HEADER_SIZE, payload, length);
+    message->size = (uint32_t)(FRAME_HEADER_SIZE + length);
+    message->capacity = capacity;
+    message->refCount = 1;
+    if (++pubSub->stats.liveMessages > pubSub->stats.peakLiveMessages)
+        pubSub->stats.peakLiveMessages = pubSub->stats.liveMessages;
+    subscriber->queue[(subscriber->head + subscriber->count) % pubSub->maxQueued] = message;
+    subscriber->count++;
+    markPending(pubSub, subscriber);
+    return 0;
+}
+
+struct Subscriber *pubSubNextPending(struct PubSub *pubSub)
+{
+    struct Subscriber *subscriber = pubSub->pending;
+    if (subscriber)
+    {
+        pubSub->pending = subscriber->nextPending;
+        subscriber->isPending = false;
+    }
+    return subscriber;
+}
+
+int subscriberFlush(struct PubSub *pubSub, struct Subscriber *subscriber)
+{
+    struct iovec iov[PUBSUB_WRITEV_MAX];
+    while (subscriber->count > 0)
+    {
+        /* The iovecs point into the shared buffers, no subscriber gets a copy of its own */
+        int iovCount = 0;
+        for (uint32_t i = 0; i < subscriber->count && iovCount < PUBSUB_WRITEV_MAX; ++i)
+        {
+            struct SharedMessage *message = subscriber->queue[(subscriber->head + i) % pubSub->maxQueued];
+            size_t skip = (0 == i) ? subscriber->offset : 0;
+            iov[iovCount++] = (struct iovec){.iov_base = message->data + skip, .iov_len = message->size - skip};
+        }
+        ssize_t ret = writev(subscriber->fd, iov, iovCount);
+        pubSub->stats.writeCalls++;
+        if (ret < 0)
+        {
+            if (EINTR == errno)
+                continue;
+            if (EAGAIN == errno || EWOULDBLOCK == errno)
+                return 0;
+            return -1;
+        }
+        pubSub->stats.bytesDelivered += (unsigned long long)ret;
+        /* Release the messages written entirely, the first partly written one keeps its offset */
+        while (ret > 0)
+        {
+            struct SharedMessage *message = subscriber->queue[subscriber->head];
+            size_t rest = message->size - subscriber->offset;
+            if ((size_t)ret < rest)
+            {
+                subscriber->offset += (size_t)ret;
+                break;
+            }
+            ret -= (ssize_t)rest;
+            subscriber->offset = 0;
+            subscriber->head = (subscriber->head + 1) % pubSub->maxQueued;
+            subscriber->count--;
+            unrefMessage(pubSub, message);
+        }
+    }
+    return 0;
+}
+
+int pubSubFormatStats(const struct PubSub *pubSub, char *buffer, size_t size)
+{
+    const struct PubSubStats *stats = &pubSub->stats;
+    return snprintf(buffer, size, "%zu topics, %llu published, %llu deliveries, %llu bytes in %llu writev(), %llu dropped, "
+                    "%llu evicted, %llu shared buffers live (peak %llu)", pubSub->numTopics, stats->published,
+                    stats->deliveries, stats->bytesDelivered, stats->writeCalls, stats->dropped, stats->evicted,
+                    stats->liveMessages, stats->peakLiveMessages);
+}
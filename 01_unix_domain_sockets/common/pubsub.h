@@ -0,0 +1,130 @@
+/**------------------------------------------------------------------------------------------------
+ * ?                                           ABOUT
+ * @author         :  Nguyen Dinh Hoan
+ * @email          :  hoann.wk@gmail.com
+ * @repo           :  https://github.com/hoan9x/IPC-in-Linux
+ * @createdOn      :  16-Oct-2026
+ * @description    :  Topic-based publish/subscribe: a published message is stored once in a
+ *                    reference-counted buffer and queued by reference to every subscriber
+ *------------------------------------------------------------------------------------------------**/
+#ifndef PUBSUB_H
+#define PUBSUB_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "frame.h"
+
+/* Longest topic name, the NUL that ends it in a PUBLISH payload is not counted */
+#define PUBSUB_TOPIC_MAX 63
+#define PUBSUB_TOPIC_BUCKETS 256
+#define PUBSUB_MAX_TOPICS_PER_SUBSCRIBER 16
+/* Messages a subscriber may have waiting before the slow-subscriber policy applies */
+#define PUBSUB_DEFAULT_MAX_QUEUED 1024
+/* Queued messages written by one writev() */
+#define PUBSUB_WRITEV_MAX 64
+
+struct BufferPool;
+
+/* What happens to a subscriber whose queue is full when a message arrives */
+enum PubSubPolicy
+{
+    PUBSUB_POLICY_DROP,         /* the new message is not queued for it, the others still get it */
+    PUBSUB_POLICY_DISCONNECT,   /* the subscriber is evicted, the server closes its connection */
+};
+
+/**
+ * A MESSAGE frame (header and payload) as sent to the subscribers, held by one reference per subscriber
+ * queue it is in. The bytes are never modified once published, every subscriber writes them from here.
+ **/
+struct SharedMessage
+{
+    uint32_t refCount;
+    uint32_t size;          /* bytes in data */
+    size_t capacity;        /* of the buffer lent by the pool */
+    char data[];
+};
+
+struct PubSubTopic;
+
+/**
+ * Subscription state of one connection: the topics it follows and a ring of references to the messages it
+ * did not take yet. The ring is only allocated on the first subscription.
+ **/
+struct Subscriber
+{
+    int fd;
+    struct SharedMessage **queue;
+    uint32_t head;          /* oldest queued message */
+    uint32_t count;
+    size_t offset;          /* bytes of the oldest message already written */
+    struct PubSubTopic *topics[PUBSUB_MAX_TOPICS_PER_SUBSCRIBER];
+    int numTopics;
+    bool isPending;         /* in the pending list, its queue got new messages */
+    bool isEvicted;         /* too slow under PUBSUB_POLICY_DISCONNECT, to be closed */
+    struct Subscriber *nextPending;
+    unsigned long long dropped;
+};
+
+struct PubSubStats
+{
+    unsigned long long published;
+    unsigned long long deliveries;      /* message references queued to subscribers */
+    unsigned long long bytesDelivered;  /* bytes written to the subscribers */
+    unsigned long long writeCalls;
+    unsigned long long dropped;
+    unsigned long long evicted;
+    unsigned long long liveMessages;    /* shared buffers still referenced */
+    unsigned long long peakLiveMessages;
+};
+
+struct PubSub
+{
+    struct PubSubTopic *buckets[PUBSUB_TOPIC_BUCKETS];
+    struct BufferPool *pool;
+    enum PubSubPolicy policy;
+    uint32_t maxQueued;
+    struct Subscriber *pending;     /* subscribers with new messages or evicted, see pubSubNextPending() */
+    size_t numTopics;
+    struct PubSubStats stats;
+};
+
+/* Message buffers are borrowed from pool, a subscriber holds at most maxQueued messages */
+void pubSubInit(struct PubSub *pubSub, struct BufferPool *pool, enum PubSubPolicy policy, uint32_t maxQueued);
+/* Free the topics, the subscribers must have been removed before */
+void pubSubRelease(struct PubSub *pubSub);
+/* Parse "drop" or "disconnect", return 0 or -1 */
+int pubSubParsePolicy(const char *text, enum PubSubPolicy *policy);
+
+void subscriberInit(struct Subscriber *subscriber, int fd);
+/* Add the subscriber to a topic (created on demand), return 0, or -1 on a bad name, too many topics or out of memory */
+int pubSubSubscribe(struct PubSub *pubSub, struct Subscriber *subscriber, const char *topic, size_t length);
+/* Remove the subscriber from a topic, return 0 or -1 if it was not subscribed */
+int pubSubUnsubscribe(struct PubSub *pubSub, struct Subscriber *subscriber, const char *topic, size_t length);
+/* Remove the subscriber from every topic and drop its queued messages, to be called before its connection is closed */
+void pubSubRemove(struct PubSub *pubSub, struct Subscriber *subscriber);
+
+/**
+ * Publish the payload of a PUBLISH frame ("topic", NUL, message) to the subscribers of the topic.
+ * The MESSAGE frame is built once and a reference is queued to each subscriber, nothing is written here:
+ * the subscribers that got messages are listed by pubSubNextPending() so that several publications handled
+ * in one pass go out in one writev() per subscriber.
+ * Return the number of subscribers reached, or -1 on a malformed payload or out of memory.
+ **/
+int pubSubPublish(struct PubSub *pubSub, uint32_t seq, const char *payload, uint32_t length);
+/**
+ * Queue a frame for this connection only (a PONG), behind the messages already queued so it never lands in the
+ * middle of one. It goes out with them on the next flush of the pending subscribers. A reply is never dropped:
+ * return 0, or -1 when the queue is full (the client does not read) or out of memory, and the client must be closed.
+ **/
+int subscriberQueueFrame(struct PubSub *pubSub, struct Subscriber *subscriber, uint16_t type, uint32_t seq,
+                         const void *payload, uint32_t length);
+/* Pop the next subscriber with new messages (or evicted), NULL when none is left */
+struct Subscriber *pubSubNextPending(struct PubSub *pubSub);
+/* Write as many queued messages as the socket takes, return 0 (messages may remain) or -1 with errno set */
+int subscriberFlush(struct PubSub *pubSub, struct Subscriber *subscriber);
+/* Format the counters into buffer, return snprintf() result */
+int pubSubFormatStats(const struct PubSub *pubSub, char *buffer, size_t size);
+
+#endif /* PUBSUB_H */
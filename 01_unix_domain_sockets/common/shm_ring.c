@@ -0,0 +1,281 @@
+/**------------------------------------------------------------------------------------------------
+ * ?                                           ABOUT
+ * @author         :  Nguyen Dinh Hoan
+ * @email          :  hoann.wk@gmail.com
+ * @repo           :  https://github.com/hoan9x/IPC-in-Linux
+ * @createdOn      :  16-Oct-2026
+ * @description    :  Lock-free single-producer/single-consumer rings in a shared memfd mapping
+ *------------------------------------------------------------------------------------------------**/
+#define _GNU_SOURCE
+#include "shm_ring.h"
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SHM_CHANNEL_MAGIC 0x49504353u /* "IPCS" */
+#define SHM_CHANNEL_VERSION 1
+#define SHM_RECORD_ALIGN 16u
+/* type of the record filling the end of the data area when the next message does not fit before it */
+#define SHM_RECORD_PADDING 0
+
+/* First cache line of the mapping, followed by the ring to the server then the ring to the client */
+struct ShmChannelHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t capacity;
+};
+
+static size_t ringStride(uint32_t capacity)
+{
+    return sizeof(struct ShmRing) + capacity;
+}
+
+static size_t channelSize(uint32_t capacity)
+{
+    return SHM_CACHE_LINE_SIZE + 2 * ringStride(capacity);
+}
+
+/* Inverse of channelSize(), the size of a mapping is known locally and sealed, the peer can not change it */
+static uint32_t channelCapacity(size_t size)
+{
+    return (uint32_t)((size - SHM_CACHE_LINE_SIZE) / 2 - sizeof(struct ShmRing));
+}
+
+static uint32_t recordSize(uint32_t length)
+{
+    return (uint32_t)((FRAME_HEADER_SIZE + length + SHM_RECORD_ALIGN - 1) & ~(size_t)(SHM_RECORD_ALIGN - 1));
+}
+
+/* Futexes are shared between processes here, so the FUTEX_PRIVATE_FLAG variants can not be used */
+static void futexWait(atomic_uint *word, uint32_t expected, int timeoutMs)
+{
+    struct timespec timeout = {.tv_sec = timeoutMs / 1000, .tv_nsec = (timeoutMs % 1000) * 1000000L};
+    syscall(SYS_futex, word, FUTEX_WAIT, expected, timeoutMs < 0 ? NULL : &timeout, NULL, 0);
+}
+
+static void futexWake(atomic_uint *word)
+{
+    syscall(SYS_futex, word, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+int shmChannelCreate(uint32_t capacity, void **base, size_t *size)
+{
+    uint32_t ringCapacity = SHM_RING_MIN_CAPACITY;
+    while (ringCapacity < capacity && ringCapacity < SHM_RING_MAX_CAPACITY)
+        ringCapacity <<= 1;
+
+    int memFd = memfd_create("ipc-demo-shm", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (memFd < 0)
+        return -1;
+    *size = channelSize(ringCapacity);
+    /* The new pages are zero-filled, so head, tail and the waiting flags start at 0 */
+    if (ftruncate(memFd, *size) < 0)
+        goto error;
+    *base = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_SHARED, memFd, 0);
+    if (MAP_FAILED == *base)
+        goto error;
+
+    struct ShmChannelHeader *header = *base;
+    header->magic = SHM_CHANNEL_MAGIC;
+    header->version = SHM_CHANNEL_VERSION;
+    header->capacity = ringCapacity;
+    /* Kept in the layout for a debugger or an older peer, the views never read it back */
+    struct ShmRingView view;
+    for (int direction = SHM_TO_SERVER; direction <= SHM_TO_CLIENT; ++direction)
+    {
+        shmChannelRing(*base, *size, (enum ShmDirection)direction, &view);
+        view.shared->capacity = ringCapacity;
+    }
+
+    /* A peer truncating the file would make the other side fault with SIGBUS, the size is sealed */
+    if (fcntl(memFd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0)
+    {
+        munmap(*base, *size);
+        goto error;
+    }
+    return memFd;
+
+error:
+    {
+        int savedErrno = errno;
+        close(memFd);
+        errno = savedErrno;
+    }
+    return -1;
+}
+
+int shmChannelMap(int memFd, void **base, size_t *size)
+{
+    struct stat info;
+    int seals = fcntl(memFd, F_GET_SEALS);
+    if (seals < 0 || !(seals & F_SEAL_SHRINK) || fstat(memFd, &info) < 0 ||
+        info.st_size < (off_t)channelSize(SHM_RING_MIN_CAPACITY))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    *size = (size_t)info.st_size;
+    *base = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_SHARED, memFd, 0);
+    if (MAP_FAILED == *base)
+        return -1;
+
+    /**
+     * The capacity is read once here and must match the size of the mapping: from now on every view derives it
+     * from that size, what the peer writes in the header later changes nothing.
+     **/
+    const struct ShmChannelHeader *header = *base;
+    uint32_t capacity = header->capacity;
+    if (SHM_CHANNEL_MAGIC != header->magic || SHM_CHANNEL_VERSION != header->version ||
+        capacity < SHM_RING_MIN_CAPACITY || capacity > SHM_RING_MAX_CAPACITY || (capacity & (capacity - 1)) ||
+        channelSize(capacity) != *size)
+    {
+        munmap(*base, *size);
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+void shmChannelUnmap(void *base, size_t size)
+{
+    if (base)
+        munmap(base, size);
+}
+
+void shmChannelRing(void *base, size_t size, enum ShmDirection direction, struct ShmRingView *view)
+{
+    view->capacity = channelCapacity(size);
+    view->shared = (struct ShmRing *)((char *)base + SHM_CACHE_LINE_SIZE + direction * ringStride(view->capacity));
+    view->data = (char *)view->shared + sizeof(struct ShmRing);
+}
+
+/* Bytes of free space needed at tail for a record, including the padding when it wraps around */
+static uint32_t neededSpace(const struct ShmRingView *ring, uint32_t tail, uint32_t size)
+{
+    uint32_t contiguous = ring->capacity - (tail & (ring->capacity - 1));
+    return (size > contiguous) ? size + contiguous : size;
+}
+
+int shmRingSend(struct ShmRingView *ring, uint16_t type, uint32_t seq, const void *payload, uint32_t length)
+{
+    uint32_t size = recordSize(length);
+    /* Up to half the ring, so a record always fits after the padding of a wrap-around */
+    if (length > ring->capacity / 2 || size > ring->capacity / 2)
+    {
+        errno = EMSGSIZE;
+        return -1;
+    }
+
+    uint32_t tail = atomic_load_explicit(&ring->shared->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&ring->shared->head, memory_order_acquire);
+    if (ring->capacity - (tail - head) < neededSpace(ring, tail, size))
+    {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    char *data = ring->data;
+    uint32_t offset = tail & (ring->capacity - 1);
+    if (size > ring->capacity - offset)
+    {
+        struct FrameHeader padding = {.length = ring->capacity - offset - FRAME_HEADER_SIZE, .type = SHM_RECORD_PADDING};
+        memcpy(data + offset, &padding, FRAME_HEADER_SIZE);
+        tail += ring->capacity - offset;
+        offset = 0;
+    }
+    struct FrameHeader header = {.length = length, .type = type, .flags = 0, .seq = seq};
+    memcpy(data + offset, &header, FRAME_HEADER_SIZE);
+    memcpy(data + offset + FRAME_HEADER_SIZE, payload, length);
+
+    /**
+     * Publish the record, then look whether the consumer sleeps. Both are sequentially consistent and pair
+     * with the consumer setting its flag then reading tail, so one of the two sides always sees the other.
+     **/
+    atomic_store(&ring->shared->tail, tail + size);
+    if (atomic_load(&ring->shared->consumerWaiting))
+        futexWake(&ring->shared->tail);
+    return 0;
+}
+
+int shmRingWaitWritable(struct ShmRingView *ring, uint32_t length, int timeoutMs)
+{
+    uint32_t size = recordSize(length);
+    uint32_t tail = atomic_load_explicit(&ring->shared->tail, memory_order_relaxed);
+    uint32_t needed = neededSpace(ring, tail, size);
+    uint32_t head = atomic_load(&ring->shared->head);
+    if (ring->capacity - (tail - head) >= needed)
+        return 1;
+
+    atomic_store(&ring->shared->producerWaiting, 1);
+    head = atomic_load(&ring->shared->head);
+    if (ring->capacity - (tail - head) < needed)
+        futexWait(&ring->shared->head, head, timeoutMs);
+    atomic_store(&ring->shared->producerWaiting, 0);
+    head = atomic_load(&ring->shared->head);
+    return ring->capacity - (tail - head) >= needed;
+}
+
+int shmRingPeek(struct ShmRingView *ring, struct Frame *frame)
+{
+    uint32_t head = atomic_load_explicit(&ring->shared->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->shared->tail, memory_order_acquire);
+    char *data = ring->data;
+
+    while (head != tail)
+    {
+        /* The mapping is shared with the peer, every length is checked before it is trusted */
+        uint32_t used = tail - head;
+        uint32_t offset = head & (ring->capacity - 1);
+        uint32_t contiguous = ring->capacity - offset;
+        if (used > ring->capacity || used < FRAME_HEADER_SIZE)
+            return -1;
+
+        memcpy(&frame->header, data + offset, FRAME_HEADER_SIZE);
+        if (SHM_RECORD_PADDING == frame->header.type)
+        {
+            if (contiguous > used)
+                return -1;
+            head += contiguous;
+            atomic_store_explicit(&ring->shared->head, head, memory_order_release);
+            continue;
+        }
+        if (frame->header.length > ring->capacity / 2 || recordSize(frame->header.length) > contiguous ||
+            recordSize(frame->header.length) > used)
+            return -1;
+        frame->payload = data + offset + FRAME_HEADER_SIZE;
+        return 1;
+    }
+    return 0;
+}
+
+void shmRingConsume(struct ShmRingView *ring, const struct Frame *frame)
+{
+    uint32_t head = atomic_load_explicit(&ring->shared->head, memory_order_relaxed);
+    atomic_store(&ring->shared->head, head + recordSize(frame->header.length));
+    if (atomic_load(&ring->shared->producerWaiting))
+        futexWake(&ring->shared->head);
+}
+
+int shmRingWaitReadable(struct ShmRingView *ring, int timeoutMs)
+{
+    uint32_t head = atomic_load_explicit(&ring->shared->head, memory_order_relaxed);
+    uint32_t tail = atomic_load(&ring->shared->tail);
+    if (head != tail)
+        return 1;
+
+    /* Only an empty ring costs a syscall, the producer skips the wake-up while this flag is clear */
+    atomic_store(&ring->shared->consumerWaiting, 1);
+    tail = atomic_load(&ring->shared->tail);
+    if (head == tail)
+        futexWait(&ring->shared->tail, tail, timeoutMs);
+    atomic_store(&ring->shared->consumerWaiting, 0);
+    return head != atomic_load(&ring->shared->tail);
+}
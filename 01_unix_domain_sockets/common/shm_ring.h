@@ -0,0 +1,83 @@
+/**------------------------------------------------------------------------------------------------
+ * ?                                           ABOUT
+ * @author         :  Nguyen Dinh Hoan
+ * @email          :  hoann.wk@gmail.com
+ * @repo           :  https://github.com/hoan9x/IPC-in-Linux
+ * @createdOn      :  16-Oct-2026
+ * @description    :  Lock-free single-producer/single-consumer rings in a shared memfd mapping
+ *------------------------------------------------------------------------------------------------**/
+#ifndef SHM_RING_H
+#define SHM_RING_H
+
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "frame.h"
+
+#define SHM_CACHE_LINE_SIZE 64
+#define SHM_RING_DEFAULT_CAPACITY (1u << 20)
+#define SHM_RING_MIN_CAPACITY (1u << 12)
+#define SHM_RING_MAX_CAPACITY (1u << 28)
+
+/**
+ * One direction of the channel. Messages are stored as records made of a FrameHeader and the payload,
+ * padded to 16 bytes and never split across the end of the data area. head and tail are free running
+ * byte counters, only the consumer writes head and only the producer writes tail, so no lock is needed.
+ * The counters are also the futex words: a side that finds the ring empty (or full) sleeps on the
+ * counter of the other side, and is woken only when it announced it is waiting.
+ **/
+struct ShmRing
+{
+    alignas(SHM_CACHE_LINE_SIZE) atomic_uint head;  /* written by the consumer */
+    atomic_uint consumerWaiting;
+    alignas(SHM_CACHE_LINE_SIZE) atomic_uint tail;  /* written by the producer */
+    atomic_uint producerWaiting;
+    alignas(SHM_CACHE_LINE_SIZE) uint32_t capacity; /* size of the data area, a power of two */
+    /* the data area follows, aligned to a cache line */
+};
+
+/**
+ * Process-local handle of a ring. The peer can write anything in the mapping at any time, so offsets and
+ * bounds only use the capacity copied here from the validated size of the mapping, never ShmRing.capacity.
+ **/
+struct ShmRingView
+{
+    struct ShmRing *shared;
+    char *data;
+    uint32_t capacity;
+};
+
+enum ShmDirection
+{
+    SHM_TO_SERVER = 0,
+    SHM_TO_CLIENT = 1,
+};
+
+/**
+ * Create the memfd of a channel holding one ring per direction, each with the capacity rounded to a
+ * power of two, map it and seal its size. Return the memfd (to be passed to the peer) or -1 with errno set.
+ **/
+int shmChannelCreate(uint32_t capacity, void **base, size_t *size);
+/* Map a channel memfd received from the peer and check its layout, return 0 or -1 with errno set */
+int shmChannelMap(int memFd, void **base, size_t *size);
+void shmChannelUnmap(void *base, size_t size);
+/* Fill view with one ring of a channel created or mapped above, size being the size they returned */
+void shmChannelRing(void *base, size_t size, enum ShmDirection direction, struct ShmRingView *view);
+
+/* Producer: copy one message into the ring, return 0 or -1 with errno EAGAIN (ring full) or EMSGSIZE */
+int shmRingSend(struct ShmRingView *ring, uint16_t type, uint32_t seq, const void *payload, uint32_t length);
+/* Producer: sleep until a message of length bytes fits, return 1 if it fits, 0 on timeout */
+int shmRingWaitWritable(struct ShmRingView *ring, uint32_t length, int timeoutMs);
+/**
+ * Consumer: return 1 and fill frame with the oldest message, the payload points into the shared mapping
+ * and stays valid until shmRingConsume(). Return 0 when the ring is empty, -1 if the ring is corrupted.
+ **/
+int shmRingPeek(struct ShmRingView *ring, struct Frame *frame);
+/* Consumer: release the message returned by shmRingPeek() */
+void shmRingConsume(struct ShmRingView *ring, const struct Frame *frame);
+/* Consumer: sleep until the ring is not empty, return 1 if a message is available, 0 on timeout */
+int shmRingWaitReadable(struct ShmRingView *ring, int timeoutMs);
+
+#endif /* SHM_RING_H */
@@ -0,0 +1,50 @@
+/**------------------------------------------------------------------------------------------------
+ * ?                                           ABOUT
+ * @author         :  Nguyen Dinh Hoan
+ * @email          :  hoann.wk@gmail.com
+ * @repo           :  https://github.com/hoan9x/IPC-in-Linux
+ * @createdOn      :  16-Oct-2026
+ * @description    :  Selectable socket type of the servers and clients: stream, seqpacket or datagram
+ *------------------------------------------------------------------------------------------------**/
+#include "socket_mode.h"
+
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+static const char *const modeNames[] = {"stream", "seqpacket", "dgram"};
+
+int socketModeParse(const char *name, enum SocketMode *mode)
+{
+    for (int i = 0; i < (int)(sizeof(modeNames) / sizeof(modeNames[0])); ++i)
+    {
+        if (0 == strcmp(name, modeNames[i]))
+        {
+            *mode = (enum SocketMode)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+const char *socketModeName(enum SocketMode mode)
+{
+    return modeNames[mode];
+}
+
+int socketModeType(enum SocketMode mode)
+{
+    switch (mode)
+    {
+        case SOCKET_MODE_SEQPACKET: return SOCK_SEQPACKET;
+        case SOCKET_MODE_DGRAM: return SOCK_DGRAM;
+        default: return SOCK_STREAM;
+    }
+}
+
+int socketAutobind(int fd)
+{
+    /* An address made of the family only asks the kernel for a unique abstract name (see unix(7), autobind) */
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    return bind(fd, (const struct sockaddr *)&address, sizeof(sa_family_t));
+}
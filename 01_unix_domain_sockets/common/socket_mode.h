@@ -0,0 +1,40 @@
+/**------------------------------------------------------------------------------------------------
+ * ?                                           ABOUT
+ * @author         :  Nguyen Dinh Hoan
+ * @email          :  hoann.wk@gmail.com
+ * @repo           :  https://github.com/hoan9x/IPC-in-Linux
+ * @createdOn      :  16-Oct-2026
+ * @description    :  Selectable socket type of the servers and clients: stream, seqpacket or datagram
+ *------------------------------------------------------------------------------------------------**/
+#ifndef SOCKET_MODE_H
+#define SOCKET_MODE_H
+
+/**
+ * + stream: byte stream, frames are rebuilt by the frame parser
+ * + seqpacket: connection-oriented and boundary-preserving, one message is exactly one frame
+ * + dgram: connectionless, every client sends to the one server socket and the server replies
+ *   to the sender address, so the server keeps no per-client fd at all
+ **/
+enum SocketMode
+{
+    SOCKET_MODE_STREAM,
+    SOCKET_MODE_SEQPACKET,
+    SOCKET_MODE_DGRAM,
+};
+
+#define SOCKET_MODE_NAMES "stream|seqpacket|dgram"
+/* Largest message (frame header included) of the seqpacket and dgram modes, longer ones are truncated and dropped */
+#define SOCKET_MESSAGE_MAX_SIZE (64 * 1024)
+
+/* Parse a mode name, return 0 or -1 if the name is unknown */
+int socketModeParse(const char *name, enum SocketMode *mode);
+const char *socketModeName(enum SocketMode mode);
+/* Socket type to pass to socket(): SOCK_STREAM, SOCK_SEQPACKET or SOCK_DGRAM */
+int socketModeType(enum SocketMode mode);
+/**
+ * Bind a datagram client to an address picked by the kernel in the abstract namespace, without it the
+ * server has no address to reply to. Nothing to unlink afterwards. Return the bind() result.
+ **/
+int socketAutobind(int fd);
+
+#endif /* SOCKET_MODE_H */
@@ -0,0 +1,129 @@
+/**------------------------------------------------------------------------------------------------
+ * ?                                           ABOUT
+ * @author         :  Nguyen Dinh Hoan
+ * @email          :  hoann.wk@gmail.com
+ * @repo           :  https://github.com/hoan9x/IPC-in-Linux
+ * @createdOn      :  16-Oct-2026
+ * @description    :  Fan-in relay moving client data to a downstream socket or file with splice()
+ *------------------------------------------------------------------------------------------------**/
+#define _GNU_SOURCE
+#include "splice_relay.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+
+static int openDownstream(const char *path)
+{
+    struct stat info;
+    if (0 == stat(path, &info) && S_ISSOCK(info.st_mode))
+    {
+        struct sockaddr_un address = {.sun_family = AF_UNIX};
+        strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd >= 0 && connect(fd, (const struct sockaddr *)&address, sizeof(address)) < 0)
+        {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+    return open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+}
+
+int spliceRelayOpen(struct SpliceRelay *relay, const char *path)
+{
+    memset(relay, 0, sizeof(*relay));
+    relay->dataPipe[0] = relay->dataPipe[1] = relay->headerPipe[0] = relay->headerPipe[1] = -1;
+    relay->downstreamFd = openDownstream(path);
+    relay->headers = calloc(SPLICE_RELAY_HEADER_SLOTS, sizeof(struct FrameHeader));
+    if (relay->downstreamFd < 0 || !relay->headers || pipe2(relay->dataPipe, O_CLOEXEC) < 0 ||
+        pipe2(relay->headerPipe, O_CLOEXEC) < 0)
+    {
+        int savedErrno = errno;
+        spliceRelayClose(relay);
+        errno = savedErrno;
+        return -1;
+    }
+    /* A bigger pipe moves bigger chunks per splice(), the default 64KB is kept if the limit is lower */
+    fcntl(relay->dataPipe[1], F_SETPIPE_SZ, SPLICE_RELAY_PIPE_SIZE);
+    return 0;
+}
+
+void spliceRelayClose(struct SpliceRelay *relay)
+{
+    int fds[] = {relay->downstreamFd, relay->dataPipe[0], relay->dataPipe[1], relay->headerPipe[0], relay->headerPipe[1]};
+    for (int i = 0; i < (int)(sizeof(fds) / sizeof(fds[0])); ++i)
+    {
+        if (fds[i] >= 0)
+            close(fds[i]);
+    }
+    free(relay->headers);
+    relay->headers = NULL;
+    relay->downstreamFd = -1;
+}
+
+/* Empty length bytes of a pipe into the downstream */
+static int drainPipe(struct SpliceRelay *relay, int pipeFd, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t ret = splice(pipeFd, NULL, relay->downstreamFd, NULL, length, SPLICE_F_MOVE);
+        relay->syscalls++;
+        if (ret <= 0)
+        {
+            if (ret < 0 && EINTR == errno)
+                continue;
+            relay->isDownstreamBroken = true;
+            return -1;
+        }
+        length -= (size_t)ret;
+    }
+    return 0;
+}
+
+ssize_t spliceRelayForward(struct SpliceRelay *relay, int fd, uint32_t sourceId)
+{
+    ssize_t length;
+    do
+    {
+        /* The data pipe is always empty here, so one call takes up to a whole pipe from the socket */
+        length = splice(fd, NULL, relay->dataPipe[1], NULL, SPLICE_RELAY_PIPE_SIZE, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        relay->syscalls++;
+    } while (length < 0 && EINTR == errno);
+    if (length <= 0)
+        return length;
+
+    /* The header is only known once the chunk length is, it goes through its own pipe to be sent first */
+    struct FrameHeader *header = &relay->headers[relay->nextHeader++ % SPLICE_RELAY_HEADER_SLOTS];
+    *header = (struct FrameHeader){.length = (uint32_t)length, .type = FRAME_TYPE_RELAY, .flags = 0, .seq = sourceId};
+    struct iovec iov = {.iov_base = header, .iov_len = FRAME_HEADER_SIZE};
+    ssize_t ret = vmsplice(relay->headerPipe[1], &iov, 1, 0);
+    relay->syscalls++;
+    if ((ssize_t)FRAME_HEADER_SIZE != ret)
+    {
+        /* The header pipe is empty as well, a short vmsplice() can not happen */
+        relay->isDownstreamBroken = true;
+        return -1;
+    }
+    if (drainPipe(relay, relay->headerPipe[0], FRAME_HEADER_SIZE) < 0 || drainPipe(relay, relay->dataPipe[0], (size_t)length) < 0)
+        return -1;
+
+    relay->bytesRelayed += (unsigned long long)length;
+    relay->chunks++;
+    return length;
+}
+
+int spliceRelayFormatStats(const struct SpliceRelay *relay, char *buffer, size_t size)
+{
+    double megabytes = relay->bytesRelayed / (1024.0 * 1024.0);
+    return snprintf(buffer, size, "%llu bytes relayed in %llu chunks, %llu syscalls (%.1f per MB)", relay->bytesRelayed,
+                    relay->chunks, relay->syscalls, megabytes > 0 ? relay->syscalls / megabytes : 0.0);
+}
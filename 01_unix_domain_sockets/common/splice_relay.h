@@ -0,0 +1,59 @@
+/**------------------------------------------------------------------------------------------------
+ * ?                                           ABOUT
+ * @author         :  Nguyen Dinh Hoan
+ * @email          :  hoann.wk@gmail.com
+ * @repo           :  https://github.com/hoan9x/IPC-in-Linux
+ * @createdOn      :  16-Oct-2026
+ * @description    :  Fan-in relay moving client data to a downstream socket or file with splice()
+ *------------------------------------------------------------------------------------------------**/
+#ifndef SPLICE_RELAY_H
+#define SPLICE_RELAY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "frame.h"
+
+/* Size requested for the data pipe, also the largest chunk moved by one splice() */
+#define SPLICE_RELAY_PIPE_SIZE (256 * 1024)
+/**
+ * Headers handed to vmsplice() are referenced, not copied, and a downstream socket may keep referencing
+ * their page until the consumer reads it. Each chunk gets its own slot, reused only after this many chunks,
+ * far more than a socket send buffer can hold.
+ **/
+#define SPLICE_RELAY_HEADER_SLOTS 4096
+
+/**
+ * The byte streams of many clients are interleaved on one downstream, so each chunk is preceded by a
+ * FRAME_TYPE_RELAY header giving its length and its source. The chunk goes from the client socket to a pipe
+ * and from the pipe to the downstream with splice(), the header is put in its own pipe with vmsplice():
+ * the payload never enters user space.
+ **/
+struct SpliceRelay
+{
+    int downstreamFd;
+    int dataPipe[2];
+    int headerPipe[2];
+    struct FrameHeader *headers;
+    unsigned long nextHeader;
+    bool isDownstreamBroken;        /* set when a write to the downstream failed */
+    unsigned long long bytesRelayed;
+    unsigned long long chunks;
+    unsigned long long syscalls;    /* splice() and vmsplice() calls */
+};
+
+/* Connect to path if it is a UNIX socket, else create or truncate it as a file. Return 0 or -1 with errno set */
+int spliceRelayOpen(struct SpliceRelay *relay, const char *path);
+void spliceRelayClose(struct SpliceRelay *relay);
+/**
+ * Move what is readable on fd (a stream socket) to the downstream as one chunk from sourceId.
+ * Return the number of payload bytes relayed, 0 on EOF of fd, or -1 with errno set. When the failure is on
+ * the downstream side, isDownstreamBroken is set and nothing more can be relayed.
+ **/
+ssize_t spliceRelayForward(struct SpliceRelay *relay, int fd, uint32_t sourceId);
+/* Format bytes relayed, chunks and syscalls per MB into buffer, return snprintf() result */
+int spliceRelayFormatStats(const struct SpliceRelay *relay, char *buffer, size_t size);
+
+#endif /* SPLICE_RELAY_H */
@@ -0,0 +1,216 @@
+/**------------------------------------------------------------------------------------------------
+ * ?                                           ABOUT
+ * @author         :  Nguyen Dinh Hoan
+ * @email          :  hoann.wk@gmail.com
+ * @repo           :  https://github.com/hoan9x/IPC-in-Linux
+ * @createdOn      :  16-Oct-2026
+ * @description    :  Hierarchical timer wheel: O(1) arm/cancel of idle timeouts, deadlines and periodic
+ *                    tasks, the event loop sleeps until the next one is due
+ *------------------------------------------------------------------------------------------------**/
+#include "timer_wheel.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define SLOT_MASK ((uint64_t)TIMER_WHEEL_SLOTS - 1)
+/* Farthest expiry the levels can hold, relative to the current tick */
+#define MAX_DELTA ((1ull << (TIMER_WHEEL_SLOT_BITS * TIMER_WHEEL_LEVELS)) - 1)
+
+static uint64_t nowMs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000u + (uint64_t)now.tv_nsec / 1000000u;
+}
+
+static uint64_t nowTick(const struct TimerWheel *wheel)
+{
+    return (nowMs() - wheel->startMs) / wheel->tickMs;
+}
+
+/**
+ * Put a timer in the slot of its expiry tick: level 0 when it expires within 64 ticks, otherwise the level whose
+ * slots are just wide enough. A slot of level n is cascaded at the tick where its expiry ticks begin, which is
+ * always after the current tick. A timer already due (during a cascade) goes to the current slot, run next.
+ **/
+static void placeTimer(struct TimerWheel *wheel, struct Timer *timer)
+{
+    uint64_t expires = timer->expiresTick, delta;
+    int level = 0;
+    if (expires < wheel->currentTick)
+        expires = wheel->currentTick;
+    delta = expires - wheel->currentTick;
+    if (delta > MAX_DELTA)
+    {
+        /* Beyond the last level: parked at the farthest slot, it is placed again when that slot is cascaded */
+        expires = wheel->currentTick + MAX_DELTA;
+        delta = MAX_DELTA;
+    }
+    while (level < TIMER_WHEEL_LEVELS - 1 && delta >> (TIMER_WHEEL_SLOT_BITS * (level + 1)))
+        level++;
+
+    unsigned slot = (unsigned)((expires >> (TIMER_WHEEL_SLOT_BITS * level)) & SLOT_MASK);
+    struct Timer **head = &wheel->slots[level][slot];
+    timer->level = (uint8_t)level;
+    timer->slot = (uint8_t)slot;
+    timer->next = *head;
+    if (timer->next)
+        timer->next->pprev = &timer->next;
+    timer->pprev = head;
+    *head = timer;
+    wheel->occupied[level] |= 1ull << slot;
+}
+
+static void unlinkTimer(struct TimerWheel *wheel, struct Timer *timer)
+{
+    *timer->pprev = timer->next;
+    if (timer->next)
+        timer->next->pprev = timer->pprev;
+    if (!wheel->slots[timer->level][timer->slot])
+        wheel->occupied[timer->level] &= ~(1ull << timer->slot);
+    timer->next = NULL;
+    timer->pprev = NULL;
+}
+
+void timerWheelInit(struct TimerWheel *wheel, unsigned tickMs)
+{
+    memset(wheel, 0, sizeof(*wheel));
+    wheel->tickMs = tickMs ? tickMs : TIMER_WHEEL_DEFAULT_TICK_MS;
+    wheel->startMs = nowMs();
+}
+
+void timerInit(struct Timer *timer, TimerCallback callback, void *data)
+{
+    memset(timer, 0, sizeof(*timer));
+    timer->callback = callback;
+    timer->data = data;
+}
+
+void timerWheelAdd(struct TimerWheel *wheel, struct Timer *timer, unsigned delayMs)
+{
+    uint64_t ticks = (delayMs + wheel->tickMs - 1) / wheel->tickMs, tick = nowTick(wheel);
+    if (timerIsPending(timer))
+    {
+        unlinkTimer(wheel, timer);
+        wheel->stats.cancelled++;
+        wheel->stats.pending--;
+    }
+    /* The slot of the current tick may have run already, a timer is due one tick later at the earliest */
+    if (tick < wheel->currentTick)
+        tick = wheel->currentTick;
+    timer->expiresTick = tick + (ticks ? ticks : 1);
+    placeTimer(wheel, timer);
+    wheel->stats.armed++;
+    if (++wheel->stats.pending > wheel->stats.peakPending)
+        wheel->stats.peakPending = wheel->stats.pending;
+}
+
+void timerWheelCancel(struct TimerWheel *wheel, struct Timer *timer)
+{
+    if (!timerIsPending(timer))
+        return;
+    unlinkTimer(wheel, timer);
+    wheel->stats.cancelled++;
+    wheel->stats.pending--;
+}
+
+/* Spread the slot of level whose time has come over the lower levels, the level above first when it wraps too */
+static void cascade(struct TimerWheel *wheel, int level)
+{
+    unsigned slot = (unsigned)((wheel->currentTick >> (TIMER_WHEEL_SLOT_BITS * level)) & SLOT_MASK);
+    if (0 == slot && level + 1 < TIMER_WHEEL_LEVELS)
+        cascade(wheel, level + 1);
+    struct Timer *timer = wheel->slots[level][slot];
+    wheel->slots[level][slot] = NULL;
+    wheel->occupied[level] &= ~(1ull << slot);
+    while (timer)
+    {
+        struct Timer *next = timer->next;
+        placeTimer(wheel, timer);
+        wheel->stats.cascaded++;
+        timer = next;
+    }
+}
+
+int timerWheelAdvance(struct TimerWheel *wheel)
+{
+    uint64_t target = nowTick(wheel);
+    int numExpired = 0;
+    while (wheel->currentTick < target)
+    {
+        if (0 == wheel->stats.pending)
+        {
+            wheel->currentTick = target;
+            break;
+        }
+        if (0 == wheel->occupied[0])
+        {
+            /* Nothing due before level 0 wraps, jump to the next cascade */
+            uint64_t nextCascade = (wheel->currentTick | SLOT_MASK) + 1;
+            if (nextCascade > target)
+            {
+                wheel->currentTick = target;
+                break;
+            }
+            wheel->currentTick = nextCascade;
+        }
+        else
+        {
+            wheel->currentTick++;
+        }
+        if (0 == (wheel->currentTick & SLOT_MASK))
+            cascade(wheel, 1);
+
+        /* Timers are taken one by one: a callback may cancel or arm any timer, this one included */
+        struct Timer **head = &wheel->slots[0][wheel->currentTick & SLOT_MASK];
+        while (*head)
+        {
+            struct Timer *timer = *head;
+            unlinkTimer(wheel, timer);
+            wheel->stats.pending--;
+            wheel->stats.expired++;
+            numExpired++;
+            timer->callback(timer);
+        }
+    }
+    return numExpired;
+}
+
+/* Offset from slot to the next occupied slot after it (1 to 64, 64 being slot itself one turn later), 0 if none */
+static unsigned nextSlotOffset(uint64_t occupied, unsigned slot)
+{
+    if (!occupied)
+        return 0;
+    unsigned start = (slot + 1) & SLOT_MASK;
+    uint64_t rotated = start ? (occupied >> start) | (occupied << (64 - start)) : occupied;
+    return (unsigned)__builtin_ctzll(rotated) + 1;
+}
+
+int timerWheelTimeoutMs(const struct TimerWheel *wheel)
+{
+    if (0 == wheel->stats.pending)
+        return -1;
+    /* The first tick with work: the next occupied slot of level 0, or the cascade of a higher level slot */
+    uint64_t nextTick = UINT64_MAX;
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; ++level)
+    {
+        unsigned shift = TIMER_WHEEL_SLOT_BITS * level;
+        uint64_t base = wheel->currentTick >> shift;
+        unsigned offset = nextSlotOffset(wheel->occupied[level], (unsigned)(base & SLOT_MASK));
+        if (offset && ((base + offset) << shift) < nextTick)
+            nextTick = (base + offset) << shift;
+    }
+    uint64_t dueMs = wheel->startMs + nextTick * wheel->tickMs, now = nowMs();
+    if (dueMs <= now)
+        return 0;
+    return (dueMs - now > 0x7fffffff) ? 0x7fffffff : (int)(dueMs - now);
+}
+
+int timerWheelFormat(const struct TimerWheel *wheel, char *buffer, size_t size)
+{
+    const struct TimerWheelStats *stats = &wheel->stats;
+    return snprintf(buffer, size, "%zu pending (peak %zu), %llu armed, %llu expired, %llu cancelled, %llu cascaded, tick %u ms",
+                    stats->pending, stats->peakPending, stats->armed, stats->expired, stats->cancelled, stats->cascaded,
+                    wheel->tickMs);
+}
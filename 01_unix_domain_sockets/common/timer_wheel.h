@@ -0,0 +1,86 @@
+/**------------------------------------------------------------------------------------------------
+ * ?                                           ABOUT
+ * @author         :  Nguyen Dinh Hoan
+ * @email          :  hoann.wk@gmail.com
+ * @repo           :  https://github.com/hoan9x/IPC-in-Linux
+ * @createdOn      :  16-Oct-2026
+ * @description    :  Hierarchical timer wheel: O(1) arm/cancel of idle timeouts, deadlines and periodic
+ *                    tasks, the event loop sleeps until the next one is due
+ *------------------------------------------------------------------------------------------------**/
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Each level has 64 slots, one bit of the occupancy mask per slot */
+#define TIMER_WHEEL_SLOT_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_SLOT_BITS)
+/* 5 levels of 64 slots cover 2^30 ticks, about 12 days with 1 ms ticks; later timers are kept at the last level */
+#define TIMER_WHEEL_LEVELS 5
+#define TIMER_WHEEL_DEFAULT_TICK_MS 1
+
+struct Timer;
+/* Called once the timer expired, it is no longer pending: the callback may arm it again or free it */
+typedef void (*TimerCallback)(struct Timer *timer);
+
+/* A timer is embedded in the state it belongs to (e.g. a client), the wheel never allocates */
+struct Timer
+{
+    struct Timer *next;
+    struct Timer **pprev;   /* the pointer to this timer in its slot list, NULL when not pending */
+    uint64_t expiresTick;
+    uint8_t level;
+    uint8_t slot;
+    TimerCallback callback;
+    void *data;             /* owner of the timer, for the callback */
+};
+
+struct TimerWheelStats
+{
+    unsigned long long armed;       /* timerWheelAdd() calls, re-arming included */
+    unsigned long long cancelled;   /* pending timers cancelled or re-armed */
+    unsigned long long expired;     /* callbacks run */
+    unsigned long long cascaded;    /* timers moved down one level, each timer moves at most once per level */
+    size_t pending;
+    size_t peakPending;
+};
+
+/**
+ * Timers are kept in lists by expiry tick: level 0 has one slot per tick of the next 64 ticks, level 1 one slot
+ * per 64 ticks of the next 4096, and so on. Arming or cancelling a timer is a list insert or unlink, whatever the
+ * number of timers. When level 0 wraps, the next slot of level 1 is spread over level 0 (cascade), so a timer is
+ * touched at most once per level before it expires. Ticks with no timer are skipped, the loop never wakes up to
+ * find nothing to do. Not thread-safe, a wheel belongs to one event loop.
+ **/
+struct TimerWheel
+{
+    struct Timer *slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+    uint64_t occupied[TIMER_WHEEL_LEVELS];  /* bit n set when slot n of the level holds timers */
+    uint64_t currentTick;                   /* every timer up to this tick has run */
+    uint64_t startMs;                       /* CLOCK_MONOTONIC time of tick 0 */
+    unsigned tickMs;
+    struct TimerWheelStats stats;
+};
+
+void timerWheelInit(struct TimerWheel *wheel, unsigned tickMs);
+void timerInit(struct Timer *timer, TimerCallback callback, void *data);
+
+static inline bool timerIsPending(const struct Timer *timer)
+{
+    return NULL != timer->pprev;
+}
+
+/* Arm timer to expire in delayMs (rounded up to the next tick), a pending timer is moved */
+void timerWheelAdd(struct TimerWheel *wheel, struct Timer *timer, unsigned delayMs);
+/* Stop a pending timer, nothing happens if it is not pending */
+void timerWheelCancel(struct TimerWheel *wheel, struct Timer *timer);
+/* Run the callbacks of every timer due by now, return how many expired */
+int timerWheelAdvance(struct TimerWheel *wheel);
+/* Milliseconds until the wheel needs timerWheelAdvance() again, for the wait of the event loop, -1 if no timer is pending */
+int timerWheelTimeoutMs(const struct TimerWheel *wheel);
+/* Format the counters into buffer, return snprintf() result */
+int timerWheelFormat(const struct TimerWheel *wheel, char *buffer, size_t size);
+
+#endif /* TIMER_WHEEL_H */
@@ -0,0 +1,296 @@
+/**------------------------------------------------------------------------------------------------
+ * ?                                           ABOUT
+ * @author         :  Nguyen Dinh Hoan
+ * @email          :  hoann.wk@gmail.com
+ * @repo           :  https://github.com/hoan9x/IPC-in-Linux
+ * @createdOn      :  16-Oct-2026
+ * @description    :  Work-stealing thread pool for message handlers: the event loop submits work items,
+ *                    finished items come back on a lock-free queue and wake the loop through an eventfd
+ *------------------------------------------------------------------------------------------------**/
+#define _GNU_SOURCE
+#include "work_pool.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+/**------------------------------------------------------------------------
+ *                   Deques of the workers
+ *------------------------------------------------------------------------**/
+static void dequePush(struct WorkDeque *deque, struct WorkItem *item)
+{
+    pthread_mutex_lock(&deque->lock);
+    item->next = NULL;
+    item->prev = deque->tail;
+    if (deque->tail)
+        deque->tail->next = item;
+    else
+        deque->head = item;
+    deque->tail = item;
+    pthread_mutex_unlock(&deque->lock);
+}
+
+/* Take the oldest item (owner) or the newest one (thief), NULL if the deque is empty */
+static struct WorkItem *dequeTake(struct WorkDeque *deque, bool isOldest)
+{
+    struct WorkItem *item;
+    pthread_mutex_lock(&deque->lock);
+    item = isOldest ? deque->head : deque->tail;
+    if (item)
+    {
+        if (item->prev)
+            item->prev->next = item->next;
+        else
+            deque->head = item->next;
+        if (item->next)
+            item->next->prev = item->prev;
+        else
+            deque->tail = item->prev;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return item;
+}
+
+/**------------------------------------------------------------------------
+ *                   Completion queue (intrusive MPSC)
+ *------------------------------------------------------------------------**/
+/* Any thread: the exchange orders the producers, the item is reachable once the previous tail links to it */
+static void donePush(struct WorkPool *pool, struct WorkItem *item)
+{
+    atomic_store_explicit(&item->doneNext, NULL, memory_order_relaxed);
+    struct WorkItem *prev = atomic_exchange_explicit(&pool->doneTail, item, memory_order_acq_rel);
+    atomic_store_explicit(&prev->doneNext, item, memory_order_release);
+}
+
+struct WorkItem *workPoolTakeDone(struct WorkPool *pool)
+{
+    struct WorkItem *head = pool->doneHead;
+    struct WorkItem *next = atomic_load_explicit(&head->doneNext, memory_order_acquire);
+    if (&pool->doneStub == head)
+    {
+        if (!next)
+            return NULL;
+        pool->doneHead = next;
+        head = next;
+        next = atomic_load_explicit(&next->doneNext, memory_order_acquire);
+    }
+    if (next)
+    {
+        pool->doneHead = next;
+        pool->stats.completed++;
+        return head;
+    }
+    /**
+     * head is the last item linked. If it is not the tail, a worker is between its exchange and its link: the
+     * item shows up once linked, and that worker notifies the loop after linking.
+     **/
+    if (head != atomic_load_explicit(&pool->doneTail, memory_order_acquire))
+        return NULL;
+    /* The stub goes behind head so head can be taken without leaving the queue empty */
+    donePush(pool, &pool->doneStub);
+    next = atomic_load_explicit(&head->doneNext, memory_order_acquire);
+    if (!next)
+        return NULL;
+    pool->doneHead = next;
+    pool->stats.completed++;
+    return head;
+}
+
+/* Wake the loop unless a wakeup is already pending, the flag is cleared by workPoolAcknowledge() */
+static void notifyLoop(struct WorkPool *pool)
+{
+    uint64_t one = 1;
+    if (atomic_exchange(&pool->isNotified, true))
+        return;
+    if (write(pool->eventFd, &one, sizeof(one)) < 0)
+    {
+        /* Only EAGAIN at the counter limit, the loop has a wakeup pending anyway */
+    }
+}
+
+void workPoolAcknowledge(struct WorkPool *pool)
+{
+    uint64_t count;
+    if (read(pool->eventFd, &count, sizeof(count)) == sizeof(count))
+        pool->stats.wakeups++;
+    /* Cleared before the queue is read: an item pushed after this point writes the eventfd again */
+    atomic_store(&pool->isNotified, false);
+}
+
+/**------------------------------------------------------------------------
+ *                   Workers
+ *------------------------------------------------------------------------**/
+/* Own deque first, then the other deques starting with the next worker */
+static struct WorkItem *findWork(struct WorkWorker *worker)
+{
+    struct WorkPool *pool = worker->pool;
+    struct WorkItem *item = dequeTake(&worker->deque, true);
+    for (int i = 1; !item && i < pool->numWorkers; ++i)
+    {
+        item = dequeTake(&pool->workers[(worker->index + i) % pool->numWorkers].deque, false);
+        if (item)
+            atomic_fetch_add_explicit(&worker->stolen, 1, memory_order_relaxed);
+    }
+    if (item)
+        atomic_fetch_sub(&pool->queued, 1);
+    return item;
+}
+
+/**
+ * Sleep until an item is queued. The worker counts itself as sleeping before it checks the queued items, and the
+ * loop counts the item before it checks the sleepers: one of them always sees the other, no wakeup is lost.
+ * Return false when the pool is stopping and nothing is left to run.
+ **/
+static bool waitForWork(struct WorkPool *pool)
+{
+    bool hasWork = true;
+    pthread_mutex_lock(&pool->sleepLock);
+    atomic_fetch_add(&pool->numSleeping, 1);
+    while (0 == atomic_load(&pool->queued))
+    {
+        if (atomic_load(&pool->isStopping))
+        {
+            hasWork = false;
+            break;
+        }
+        pthread_cond_wait(&pool->sleepCond, &pool->sleepLock);
+    }
+    atomic_fetch_sub(&pool->numSleeping, 1);
+    pthread_mutex_unlock(&pool->sleepLock);
+    return hasWork;
+}
+
+static void *workerMain(void *arg)
+{
+    struct WorkWorker *worker = arg;
+    struct WorkPool *pool = worker->pool;
+    for (;;)
+    {
+        struct WorkItem *item = findWork(worker);
+        if (!item)
+        {
+            if (!waitForWork(pool))
+                break;
+            continue;
+        }
+        item->run(item);
+        atomic_fetch_add_explicit(&worker->executed, 1, memory_order_relaxed);
+        donePush(pool, item);
+        notifyLoop(pool);
+    }
+    return NULL;
+}
+
+int workPoolInit(struct WorkPool *pool, int numWorkers)
+{
+    memset(pool, 0, sizeof(*pool));
+    pool->eventFd = -1;
+    if (numWorkers <= 0 || numWorkers > WORK_POOL_MAX_WORKERS)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    pthread_mutex_init(&pool->sleepLock, NULL);
+    pthread_cond_init(&pool->sleepCond, NULL);
+    pool->doneHead = &pool->doneStub;
+    atomic_store(&pool->doneTail, &pool->doneStub);
+    pool->eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    pool->workers = aligned_alloc(WORK_POOL_CACHE_LINE, sizeof(struct WorkWorker) * numWorkers);
+    if (pool->eventFd < 0 || !pool->workers)
+    {
+        int savedErrno = pool->workers ? errno : ENOMEM;
+        workPoolRelease(pool);
+        errno = savedErrno;
+        return -1;
+    }
+    memset(pool->workers, 0, sizeof(struct WorkWorker) * numWorkers);
+    for (int i = 0; i < numWorkers; ++i)
+    {
+        struct WorkWorker *worker = &pool->workers[i];
+        pthread_mutex_init(&worker->deque.lock, NULL);
+        worker->pool = pool;
+        worker->index = i;
+    }
+    /* numWorkers is only set once every deque exists, a thief walks all of them */
+    pool->numWorkers = numWorkers;
+    for (int i = 0; i < numWorkers; ++i)
+    {
+        int ret = pthread_create(&pool->workers[i].thread, NULL, workerMain, &pool->workers[i]);
+        if (0 != ret)
+        {
+            /* The workers already started have nothing to run, they exit at once */
+            pool->numWorkers = i;
+            workPoolStop(pool);
+            workPoolRelease(pool);
+            errno = ret;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void workPoolStop(struct WorkPool *pool)
+{
+    pthread_mutex_lock(&pool->sleepLock);
+    atomic_store(&pool->isStopping, true);
+    pthread_cond_broadcast(&pool->sleepCond);
+    pthread_mutex_unlock(&pool->sleepLock);
+    for (int i = 0; i < pool->numWorkers; ++i)
+        pthread_join(pool->workers[i].thread, NULL);
+}
+
+void workPoolRelease(struct WorkPool *pool)
+{
+    free(pool->workers);
+    pool->workers = NULL;
+    pool->numWorkers = 0;
+    if (pool->eventFd >= 0)
+        close(pool->eventFd);
+    pool->eventFd = -1;
+}
+
+void workPoolSubmit(struct WorkPool *pool, struct WorkItem *item)
+{
+    struct WorkWorker *worker = &pool->workers[pool->nextWorker++ % pool->numWorkers];
+    /* Counted before it is visible: a worker that takes it never brings the count below zero */
+    atomic_fetch_add(&pool->queued, 1);
+    dequePush(&worker->deque, item);
+    if (atomic_load(&pool->numSleeping) > 0)
+    {
+        pthread_mutex_lock(&pool->sleepLock);
+        pthread_cond_signal(&pool->sleepCond);
+        pthread_mutex_unlock(&pool->sleepLock);
+    }
+    pool->stats.submitted++;
+    if (pool->stats.submitted - pool->stats.completed > pool->stats.peakInFlight)
+        pool->stats.peakInFlight = pool->stats.submitted - pool->stats.completed;
+}
+
+int workPoolParseWorkers(const char *text, int *numWorkers)
+{
+    char *end;
+    long value = strtol(text, &end, 10);
+    if (end == text || '\0' != *end || value < 0 || value > WORK_POOL_MAX_WORKERS)
+        return -1;
+    *numWorkers = (int)value;
+    return 0;
+}
+
+int workPoolStatsFormat(const struct WorkPool *pool, char *buffer, size_t size)
+{
+    const struct WorkPoolStats *stats = &pool->stats;
+    int length = snprintf(buffer, size, "%d workers, %llu submitted, %llu completed (peak %llu in flight), %llu wakeups",
+                          pool->numWorkers, stats->submitted, stats->completed, stats->peakInFlight, stats->wakeups);
+    for (int i = 0; i < pool->numWorkers && length >= 0 && (size_t)length < size; ++i)
+    {
+        const struct WorkWorker *worker = &pool->workers[i];
+        length += snprintf(buffer + length, size - length, "%s worker %d: %llu run (%llu stolen)", i ? "," : ";", i,
+                           (unsigned long long)atomic_load_explicit(&worker->executed, memory_order_relaxed),
+                           (unsigned long long)atomic_load_explicit(&worker->stolen, memory_order_relaxed));
+    }
+    return length;
+}
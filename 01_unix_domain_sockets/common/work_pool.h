@@ -0,0 +1,107 @@
+/**------------------------------------------------------------------------------------------------
+ * ?                                           ABOUT
+ * @author         :  Nguyen Dinh Hoan
+ * @email          :  hoann.wk@gmail.com
+ * @repo           :  https://github.com/hoan9x/IPC-in-Linux
+ * @createdOn      :  16-Oct-2026
+ * @description    :  Work-stealing thread pool for message handlers: the event loop submits work items,
+ *                    finished items come back on a lock-free queue and wake the loop through an eventfd
+ *------------------------------------------------------------------------------------------------**/
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define WORK_POOL_CACHE_LINE 64
+#define WORK_POOL_MAX_WORKERS 64
+
+/**
+ * One unit of work, embedded in the state of its owner (first member, so the owner is found by a cast).
+ * The item belongs to the pool from workPoolSubmit() until workPoolTakeDone() returns it: the owner must not
+ * touch what run() uses meanwhile, nor free it.
+ **/
+struct WorkItem
+{
+    struct WorkItem *prev;      /* links in the deque of a worker */
+    struct WorkItem *next;
+    _Atomic(struct WorkItem *) doneNext;    /* link in the completion queue */
+    void (*run)(struct WorkItem *item);     /* called on a worker thread */
+};
+
+/* Items waiting for one worker: it takes the oldest, a thief takes the newest so both rarely meet */
+struct WorkDeque
+{
+    pthread_mutex_t lock;
+    struct WorkItem *head;
+    struct WorkItem *tail;
+};
+
+struct WorkWorker
+{
+    _Alignas(WORK_POOL_CACHE_LINE) struct WorkDeque deque;
+    pthread_t thread;
+    struct WorkPool *pool;
+    int index;
+    atomic_ullong executed;     /* items run by this worker */
+    atomic_ullong stolen;       /* of which taken from the deque of another worker */
+};
+
+/* Counted by the loop thread */
+struct WorkPoolStats
+{
+    unsigned long long submitted;
+    unsigned long long completed;   /* items taken back with workPoolTakeDone() */
+    unsigned long long wakeups;     /* eventfd reads that reported finished items */
+    unsigned long long peakInFlight;
+};
+
+/**
+ * The loop hands items round-robin to the deques of the workers, a worker whose deque is empty steals from the
+ * others before sleeping, so one slow item only delays the items queued behind it on that worker until another
+ * one is free. Finished items are pushed on an intrusive MPSC queue (one atomic exchange per push, no lock)
+ * read by the loop only; a worker writes the eventfd only when the loop was not already notified, so a burst of
+ * completions costs one wakeup. Items of one owner may run on any worker in any order: an owner that needs
+ * ordering keeps at most one item in the pool at a time.
+ **/
+struct WorkPool
+{
+    struct WorkWorker *workers;
+    int numWorkers;
+    int eventFd;                /* readable when finished items wait, watched by the loop */
+    unsigned nextWorker;        /* round-robin of workPoolSubmit(), loop thread only */
+    atomic_size_t queued;       /* items in the deques, not taken by a worker yet */
+    atomic_int numSleeping;
+    atomic_bool isStopping;
+    pthread_mutex_t sleepLock;
+    pthread_cond_t sleepCond;
+    /* Completion queue: workers push at the tail, the loop pops at the head, a stub item keeps it non-empty */
+    _Alignas(WORK_POOL_CACHE_LINE) _Atomic(struct WorkItem *) doneTail;
+    atomic_bool isNotified;     /* the eventfd was written and the loop did not acknowledge it yet */
+    _Alignas(WORK_POOL_CACHE_LINE) struct WorkItem *doneHead;
+    struct WorkItem doneStub;
+    struct WorkPoolStats stats;
+};
+
+/**
+ * Start numWorkers threads. They inherit the signal mask of the caller: call it after loopControlInit() so the
+ * workers never take the signals of the loop. Return 0 or -1 with errno set.
+ **/
+int workPoolInit(struct WorkPool *pool, int numWorkers);
+/* Run the items still queued, then join the workers. Finished items stay in the completion queue */
+void workPoolStop(struct WorkPool *pool);
+/* Free the workers and close the eventfd, after workPoolStop() */
+void workPoolRelease(struct WorkPool *pool);
+/* Queue an item, loop thread only */
+void workPoolSubmit(struct WorkPool *pool, struct WorkItem *item);
+/* Read the eventfd and re-arm the notification, call it before taking the finished items of a wakeup */
+void workPoolAcknowledge(struct WorkPool *pool);
+/* Next finished item in completion order, NULL if none. Loop thread only */
+struct WorkItem *workPoolTakeDone(struct WorkPool *pool);
+/* Parse a number of workers, 0 to WORK_POOL_MAX_WORKERS. Return 0 or -1 if invalid */
+int workPoolParseWorkers(const char *text, int *numWorkers);
+int workPoolStatsFormat(const struct WorkPool *pool, char *buffer, size_t size);
+
+#endif /* WORK_POOL_H */
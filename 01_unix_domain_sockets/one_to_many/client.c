@@ -12,25 +12,40 @@
 #include <stdbool.h>
 #include <string.h>
 #include <signal.h>
+#include <errno.h>
+#include <poll.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <unistd.h>
 
+#include "../common/frame.h"
+#include "../common/socket_mode.h"
+#include "../common/fd_passing.h"
+#include "../common/bulk_payload.h"
+#include "../common/log.h"
+
 /* LOG macro function */
-#define LOG_INFO(format, ...) do { printf("[CLIENT_INFO] " format "\n", ##__VA_ARGS__); } while (0)
-#define LOG_ERROR(format, ...) do { printf("[CLIENT_ERROR] " format "\n", ##__VA_ARGS__); } while (0)
+#define LOG_INFO(format, ...) LOG_AT(LOG_LEVEL_INFO, "[CLIENT_INFO] " format, ##__VA_ARGS__)
+#define LOG_ERROR(format, ...) LOG_AT(LOG_LEVEL_ERROR, "[CLIENT_ERROR] " format, ##__VA_ARGS__)
 
 #define DEFAULT_SOCKET_PATH "/tmp/ipc-demo.sock"
 #define BUFFER_SIZE 128
 #define MAX_NUMBER_PENDING_CONNECTIONS 1
+/* Topics a subscriber can follow, as many as the broker accepts */
+#define MAX_TOPICS 16
+/* Bytes of a received message shown in the log */
+#define MESSAGE_PREVIEW 64
 
 /* Global variable to control the loop */
-volatile bool isKeepRunning = true;
+volatile sig_atomic_t isKeepRunning = true;
+/* Signal that stopped the loop, 0 if none */
+volatile sig_atomic_t caughtSignal = 0;
 
 /* Signal handler function for SIGINT (Ctrl+C) */
 void handleSigint(int sig)
 {
-    LOG_INFO("Signal %d (Ctrl+C)", sig);
+    /* Only async-signal-safe stores: LOG_INFO() here could deadlock on the lock held by the interrupted code */
+    caughtSignal = sig;
     isKeepRunning = false;
 }
 
@@ -46,8 +61,151 @@ void cleanupAndExitError(int dataSocket)
     exit(EXIT_FAILURE);
 }
 
+/* Fill a payload of size bytes: the usual text first, then a pattern depending on index */
+static void fillPayload(char *data, size_t size, int index)
+{
+    int length = snprintf(data, size, ">>>>>Client data (%d)<<<<<", index);
+    for (size_t i = (length > 0) ? (size_t)length : 0; i < size; ++i)
+        data[i] = (char)(index + i);
+}
+
+/**
+ * Send size bytes through a sealed memfd: the payload is built straight in the shared pages and only a BULK
+ * frame, with the memfd attached, goes through the socket. Return 0 or -1.
+ **/
+static int sendBulk(int dataSocket, int index, size_t size)
+{
+    void *data;
+    int memFd = bulkCreate(size, &data);
+    if (memFd < 0)
+        return -1;
+    fillPayload(data, size, index);
+    uint32_t checksum = bulkChecksum(data, size);
+    struct BulkDescriptor descriptor = {.length = size};
+    int ret = bulkSeal(memFd, data, size);
+    if (0 == ret)
+        ret = frameWriteWithFds(dataSocket, FRAME_TYPE_BULK, (uint32_t)index, &descriptor, sizeof(descriptor), &memFd, 1);
+    /* The descriptor in flight keeps the memfd alive, this one is not needed anymore */
+    close(memFd);
+    if (0 == ret)
+        LOG_INFO("Send bulk payload to server: %zu bytes, checksum %08x", size, checksum);
+    return ret;
+}
+
+/* Send a SUBSCRIBE/UNSUBSCRIBE frame (payload: topic) or a PUBLISH frame (payload: topic, NUL, data) with one writev() */
+static int sendTopicFrame(int dataSocket, uint16_t type, uint32_t seq, const char *topic, const char *data, size_t length)
+{
+    size_t topicLength = strlen(topic);
+    struct FrameHeader header = {.length = (uint32_t)topicLength, .type = type, .flags = 0, .seq = seq};
+    struct iovec iov[4] = {
+        {.iov_base = &header, .iov_len = FRAME_HEADER_SIZE},
+        {.iov_base = (void *)topic, .iov_len = topicLength},
+        {.iov_base = "", .iov_len = 1},
+        {.iov_base = (void *)data, .iov_len = length},
+    };
+    if (FRAME_TYPE_PUBLISH != type)
+        return writevAll(dataSocket, iov, 2);
+    header.length += 1 + (uint32_t)length;
+    return writevAll(dataSocket, iov, 4);
+}
+
+/* Subscriber side: print the messages published on the followed topics until the server or Ctrl+C ends it */
+static void receiveMessages(int dataSocket)
+{
+    struct FrameParser parser;
+    struct Frame frame;
+    struct pollfd pollFd = {.fd = dataSocket, .events = POLLIN};
+    unsigned long long numReceived = 0;
+    ssize_t ret;
+    frameParserInit(&parser);
+    while (isKeepRunning)
+    {
+        /* poll() is interrupted by Ctrl+C even though the handler is installed with signal() */
+        if (poll(&pollFd, 1, -1) < 0)
+        {
+            if (EINTR == errno)
+                continue;
+            LOG_ERROR("poll() return error");
+            break;
+        }
+        ret = frameParserRead(&parser, dataSocket);
+        if (ret <= 0)
+        {
+            if (ret < 0 && EINTR == errno)
+                continue;
+            LOG_INFO("Server closed the connection");
+            break;
+        }
+        while ((ret = frameParserNext(&parser, &frame)) > 0)
+        {
+            if (FRAME_TYPE_MESSAGE != frame.header.type)
+                continue;
+            const char *end = memchr(frame.payload, '\0', frame.header.length);
+            size_t topicLength = end ? (size_t)(end - frame.payload) : frame.header.length;
+            size_t length = frame.header.length - topicLength - (end ? 1 : 0);
+            numReceived++;
+            LOG_INFO("Message on [%.*s] (seq %u, %zu bytes): [%.*s]", (int)topicLength, frame.payload, frame.header.seq, length,
+                     (int)(length < MESSAGE_PREVIEW ? length : MESSAGE_PREVIEW), frame.payload + topicLength + 1);
+        }
+        if (ret < 0)
+        {
+            LOG_ERROR("Malformed frame received from server");
+            break;
+        }
+        frameParserTrim(&parser);
+    }
+    frameParserRelease(&parser);
+    LOG_INFO("%llu messages received", numReceived);
+}
+
+static void printUsage(const char *appName)
+{
+    printf("Usage: %s [-t " SOCKET_MODE_NAMES "] [-s size] [-b threshold] [-S topic]... [-P topic] [socket_path]\n", appName);
+    printf("  -t  Socket type, it must match the server: stream (default), seqpacket or dgram\n");
+    printf("  -s  Payload size in bytes, 0 sends the short text only (default 0)\n");
+    printf("  -b  Payloads of at least this size are passed as a sealed memfd on a stream socket (default %d)\n", BULK_DEFAULT_THRESHOLD);
+    printf("  -S  Subscribe to a topic of the pub/sub server and print its messages, may be repeated\n");
+    printf("  -P  Publish the data to a topic of the pub/sub server instead of sending it\n");
+}
+
 int main(int argc, char *argv[])
 {
+    enum SocketMode mode = SOCKET_MODE_STREAM;
+    size_t payloadSize = 0, bulkThreshold = BULK_DEFAULT_THRESHOLD;
+    const char *topics[MAX_TOPICS], *publishTopic = NULL;
+    int numTopics = 0, opt;
+    while (-1 != (opt = getopt(argc, argv, "t:s:b:S:P:h")))
+    {
+        switch (opt)
+        {
+            case 't':
+                if (socketModeParse(optarg, &mode) < 0)
+                {
+                    printUsage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 's': payloadSize = strtoul(optarg, NULL, 0); break;
+            case 'b': bulkThreshold = strtoul(optarg, NULL, 0); break;
+            case 'S':
+                if (MAX_TOPICS == numTopics)
+                {
+                    printUsage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                topics[numTopics++] = optarg;
+                break;
+            case 'P': publishTopic = optarg; break;
+            default: printUsage(argv[0]); return (opt == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    /* The pub/sub server is stream only, and a client either follows topics or publishes */
+    if ((numTopics > 0 || publishTopic) && (SOCKET_MODE_STREAM != mode || (numTopics > 0 && publishTopic)))
+    {
+        printUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
     /* Register signal handler for SIGINT (Ctrl+C) */
     signal(SIGINT, handleSigint);
     LOG_INFO("Press Ctrl+C to set the shutdown flag...");
@@ -55,17 +213,27 @@ int main(int argc, char *argv[])
     struct sockaddr_un structSocketInfo;
     int dataSocket = -1, ret;
     char buffer[BUFFER_SIZE];
+    /* Only the stream servers collect descriptors, the memfd path is not used on the message sockets */
+    bool isBulk = (payloadSize > 0 && payloadSize >= bulkThreshold && SOCKET_MODE_STREAM == mode && !publishTopic);
+    char *payload = (payloadSize > 0 && !isBulk) ? malloc(payloadSize) : NULL;
     /* Initialize socket path from application input parameter or default value */
-    const char *socketPath = (argc>1)?argv[1]:DEFAULT_SOCKET_PATH;
+    const char *socketPath = (argc>optind)?argv[optind]:DEFAULT_SOCKET_PATH;
 
     /* Create data socket */
-    dataSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+    dataSocket = socket(AF_UNIX, socketModeType(mode), 0);
     if (-1 == dataSocket)
     {
         LOG_ERROR("Creating a data socket failed");
         cleanupAndExitError(dataSocket);
     }
-    LOG_INFO("Data socket created");
+    LOG_INFO("Data socket created, %s mode", socketModeName(mode));
+
+    /* A datagram client gets an address of its own, so the server can tell the clients apart and answer them */
+    if (SOCKET_MODE_DGRAM == mode && -1 == socketAutobind(dataSocket))
+    {
+        LOG_ERROR("Binding the data socket failed");
+        cleanupAndExitError(dataSocket);
+    }
 
     /* Initialize socket info structure */
     memset(&structSocketInfo, 0, sizeof(struct sockaddr_un));
@@ -83,14 +251,54 @@ int main(int argc, char *argv[])
     /**------------------------------------------------------------------------
      *                Now the server and client can exchange data
      *------------------------------------------------------------------------**/
+    if (numTopics > 0)
+    {
+        for (int i = 0; i < numTopics; ++i)
+        {
+            if (-1 == sendTopicFrame(dataSocket, FRAME_TYPE_SUBSCRIBE, (uint32_t)i, topics[i], NULL, 0))
+            {
+                LOG_ERROR("Subscribing to [%s] failed", topics[i]);
+                cleanupAndExitError(dataSocket);
+            }
+            LOG_INFO("Subscribed to [%s]", topics[i]);
+        }
+        receiveMessages(dataSocket);
+        isKeepRunning = false;
+    }
     for (int index = 0; isKeepRunning; ++index)
     {
-        /* Prepare data to send to server */
-        memset(buffer, 0, BUFFER_SIZE);
-        snprintf(buffer, BUFFER_SIZE, ">>>>>Client data (%d)<<<<<", index);
-
-        LOG_INFO("Send data to server: [%s]", buffer);
-        ret = write(dataSocket, buffer, strlen(buffer)+1);
+        /**
+         * Prepare data to send to server, the frame header carries its length so no terminating NUL is sent.
+         * On a seqpacket or datagram socket the single writev() of the frame is one message.
+         **/
+        if (isBulk)
+        {
+            ret = sendBulk(dataSocket, index, payloadSize);
+        }
+        else if (publishTopic)
+        {
+            /* The server copies the message once, every subscriber of the topic is written from that copy */
+            size_t length = payloadSize;
+            if (payload)
+                fillPayload(payload, payloadSize, index);
+            else
+                length = (size_t)snprintf(buffer, BUFFER_SIZE, ">>>>>Client data (%d)<<<<<", index);
+            LOG_INFO("Publish %zu bytes to [%s]", length, publishTopic);
+            ret = sendTopicFrame(dataSocket, FRAME_TYPE_PUBLISH, (uint32_t)index, publishTopic, payload ? payload : buffer, length);
+        }
+        else if (payload)
+        {
+            /* Below the threshold the payload is sent inline, copied through the socket */
+            fillPayload(payload, payloadSize, index);
+            LOG_INFO("Send %zu bytes of data to server", payloadSize);
+            ret = frameWrite(dataSocket, FRAME_TYPE_DATA, (uint32_t)index, payload, payloadSize);
+        }
+        else
+        {
+            ret = snprintf(buffer, BUFFER_SIZE, ">>>>>Client data (%d)<<<<<", index);
+            LOG_INFO("Send data to server: [%s]", buffer);
+            ret = frameWrite(dataSocket, FRAME_TYPE_DATA, (uint32_t)index, buffer, ret);
+        }
         if (-1 == ret)
         {
             LOG_ERROR("Send data to server failed");
@@ -100,7 +308,12 @@ int main(int argc, char *argv[])
         sleep(3);
     }
 
+    if (caughtSignal)
+    {
+        LOG_INFO("Signal %d (Ctrl+C)", caughtSignal);
+    }
     /* Close socket */
+    free(payload);
     close(dataSocket);
     LOG_INFO("Client is down");
 
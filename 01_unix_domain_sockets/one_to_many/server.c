@@ -7,44 +7,115 @@
  * @description    :  This example demonstrates a UNIX domain socket server handling multiple clients
  *                    using select()
  *------------------------------------------------------------------------------------------------**/
-#define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <errno.h>
+#include <signal.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <sys/select.h>
 #include <unistd.h>
 
+#include "../common/conn_table.h"
+#include "../common/frame.h"
+#include "../common/batch_io.h"
+#include "../common/buffer_pool.h"
+#include "../common/socket_mode.h"
+#include "../common/accept_batch.h"
+#include "../common/timer_wheel.h"
+#include "../common/fd_passing.h"
+#include "../common/bulk_payload.h"
+#include "../common/splice_relay.h"
+#include "../common/log.h"
+
 /* LOG macro function */
-#define LOG_INFO(format, ...) do { printf("[SERVER_INFO] " format "\n", ##__VA_ARGS__); } while (0)
-#define LOG_ERROR(format, ...) do { printf("[SERVER_ERROR] " format "\n", ##__VA_ARGS__); } while (0)
+#define LOG_INFO(format, ...) LOG_AT(LOG_LEVEL_INFO, "[SERVER_INFO] " format, ##__VA_ARGS__)
+#define LOG_ERROR(format, ...) LOG_AT(LOG_LEVEL_ERROR, "[SERVER_ERROR] " format, ##__VA_ARGS__)
 
 #define DEFAULT_SOCKET_PATH "/tmp/ipc-demo.sock"
 #define BUFFER_SIZE 128
-#define MAX_NUMBER_PENDING_CONNECTIONS 10
-#define MAX_CLIENT_SUPPORTED 32
+/* Reads of one client in one wakeup while every read fills the buffer, the rest waits for the next wakeup */
+#define DEFAULT_READ_BUDGET 4
 
 #define IF_FAIL_THEN_EXIT(EXP, RELEASE, MSG, ...) ({ if (EXP) { LOG_ERROR(MSG, ##__VA_ARGS__); cleanupAndExitError(RELEASE); } })
 
 /* Flag to enable/disable select() use case on timeout */ 
 #define USE_CASE_SELECT_TIMEOUT 1
 
-/* An array of fd (file descriptors also called as data sockets) */
-int arrayFdSet[MAX_CLIENT_SUPPORTED];
+/**
+ * State of a stream client: its frame parser, the replies its socket did not take yet, and the descriptors
+ * received ahead of the BULK frames they belong to
+ **/
+struct ClientState
+{
+    int fd;
+    struct FrameParser parser;
+    struct OutQueue output;
+    int pendingFds[FD_PASSING_MAX_FDS];
+    int numPendingFds;
+    struct Timer idleTimer;     /* reclaims the client when it sends nothing for idleTimeoutMs */
+    struct Timer frameTimer;    /* deadline of the frame being received, frameDeadlineMs from its first bytes */
+};
+
+/* Table of monitored fds (file descriptors also called as data sockets), it grows with the number of clients */
+struct ConnTable connTable;
+/* Reads of every client go through one shared buffer, syscalls and frames are counted in ioStats */
+struct BatchReader reader;
+struct IoStats ioStats;
+/* Parser buffers of the clients are borrowed from this pool while a partial frame is pending */
+struct BufferPool bufferPool;
+/* Stream clients are non-blocking, a client whose queued replies pass highWater is not read until lowWater */
+struct OutQueueStats outputStats;
+size_t highWater = OUT_QUEUE_DEFAULT_HIGH_WATER, lowWater = OUT_QUEUE_DEFAULT_LOW_WATER;
+/* In seqpacket and dgram modes a message is one frame, the messages are received and answered in batches */
+enum SocketMode socketMode = SOCKET_MODE_STREAM;
+struct MsgBatch inMessages, outMessages;
+/* Pending connections are accepted in batches, the connection socket is not monitored while accepting is paused */
+struct AcceptBatch acceptBatch;
+bool isAcceptPaused = false;
+/* In relay mode the data of every client is forwarded to one downstream instead of being parsed */
+struct SpliceRelay relay = {.downstreamFd = -1};
+/* Replies to the frames of one read, sent with one writev() */
+struct OutBatch replies;
+
+/* Events handled per select() wakeup: every ready fd is served, starting from a slot that moves on each wakeup */
+struct DispatchStats
+{
+    unsigned long long wakeups;
+    unsigned long long events;          /* ready fds handled: client reads and writes, connections, console */
+    unsigned long long maxEvents;       /* most events of one wakeup */
+    unsigned long long budgetReached;   /* times a client was left with data to read for the next wakeup */
+};
+struct DispatchStats dispatchStats;
+int readBudget = DEFAULT_READ_BUDGET;
+int nextStartSlot = 0;
+/**
+ * Idle timeouts, frame deadlines and the periodic statistics are timers of one wheel, the wait of the loop
+ * ends when the next one is due. 0 disables a timeout.
+ **/
+struct TimerWheel timerWheel;
+int idleTimeoutMs = 0, frameDeadlineMs = 0, statsPeriodMs = 0;
+struct Timer statsTimer;
+unsigned long long numIdleClosed = 0, numDeadlineClosed = 0;
 
 /* Function to clean up resources and exit */
 void cleanupAndExitError(const char *socketPath)
 {
-    int i = 0;
-    for (; i < MAX_CLIENT_SUPPORTED; i++)
+    int slot = 0;
+    for (; slot < connTable.numSlots; slot++)
     {
-        if (arrayFdSet[i] != -1)
+        if (connTable.pollFds[slot].fd != -1)
         {
-            close(arrayFdSet[i]);
+            close(connTable.pollFds[slot].fd);
         }
     }
+    if (relay.downstreamFd >= 0)
+    {
+        spliceRelayClose(&relay);
+    }
     if (socketPath)
     {
         /* Remove the socket file */
@@ -54,91 +125,556 @@ void cleanupAndExitError(const char *socketPath)
     exit(EXIT_FAILURE);
 }
 
-static void initArrayFdSet()
+static void onIdleTimeout(struct Timer *timer);
+static void onFrameDeadline(struct Timer *timer);
+
+/* Add a client to the table with its own state (only a stream needs one), return -1 on failure */
+static int addClient(int fdNum)
 {
-    int i = 0;
-    for (; i < MAX_CLIENT_SUPPORTED; i++)
+    struct ClientState *state = NULL;
+    if (SOCKET_MODE_STREAM == socketMode)
+    {
+        state = malloc(sizeof(struct ClientState));
+        if (!state)
+            return -1;
+        frameParserInitPooled(&state->parser, &bufferPool);
+        outQueueInit(&state->output, &bufferPool, &outputStats);
+        state->numPendingFds = 0;
+        state->fd = fdNum;
+        timerInit(&state->idleTimer, onIdleTimeout, state);
+        timerInit(&state->frameTimer, onFrameDeadline, state);
+    }
+    if (connTableAdd(&connTable, fdNum, POLLIN) < 0)
+    {
+        free(state);
+        return -1;
+    }
+    connTableSetData(&connTable, fdNum, state);
+    if (state && idleTimeoutMs > 0)
     {
-        arrayFdSet[i] = -1;
+        timerWheelAdd(&timerWheel, &state->idleTimer, idleTimeoutMs);
     }
+    return 0;
+}
+
+/* Release the state of a client, remove it from the table and close it */
+static void closeClient(int fdNum)
+{
+    struct ClientState *state = connTableGetData(&connTable, fdNum);
+    if (state)
+    {
+        timerWheelCancel(&timerWheel, &state->idleTimer);
+        timerWheelCancel(&timerWheel, &state->frameTimer);
+        frameParserRelease(&state->parser);
+        outQueueRelease(&state->output);
+        /* Descriptors whose BULK frame never arrived */
+        for (int i = 0; i < state->numPendingFds; ++i)
+            close(state->pendingFds[i]);
+        free(state);
+    }
+    connTableRemove(&connTable, fdNum);
+    close(fdNum);
+}
+
+/* Idle timeout: the client sent nothing for idleTimeoutMs, its connection is reclaimed */
+static void onIdleTimeout(struct Timer *timer)
+{
+    struct ClientState *state = timer->data;
+    LOG_INFO("fd[%d] idle for %d ms, closing the connection", state->fd, idleTimeoutMs);
+    numIdleClosed++;
+    closeClient(state->fd);
+}
+
+/* Frame deadline: a frame was started and not completed in frameDeadlineMs, the client is stalled or too slow */
+static void onFrameDeadline(struct Timer *timer)
+{
+    struct ClientState *state = timer->data;
+    LOG_ERROR("fd[%d] did not complete its frame within %d ms, closing the connection", state->fd, frameDeadlineMs);
+    numDeadlineClosed++;
+    closeClient(state->fd);
 }
 
-static void addToArrayFdSet(int skt_fd)
+/**
+ * Arm the timers of a client that sent data: the idle timeout starts again, and the frame deadline runs while a
+ * partial frame is pending, from the read that started it (a read that completed frames starts a new one).
+ **/
+static void updateClientTimers(struct ClientState *state, bool isFrameCompleted)
 {
-    int i = 0;
-    for (; i < MAX_CLIENT_SUPPORTED; i++)
+    if (idleTimeoutMs > 0)
     {
-        if (arrayFdSet[i] != -1)
+        timerWheelAdd(&timerWheel, &state->idleTimer, idleTimeoutMs);
+    }
+    if (frameDeadlineMs > 0)
+    {
+        if (state->parser.readPos == state->parser.writePos)
+            timerWheelCancel(&timerWheel, &state->frameTimer);
+        else if (isFrameCompleted || !timerIsPending(&state->frameTimer))
+            timerWheelAdd(&timerWheel, &state->frameTimer, frameDeadlineMs);
+    }
+}
+
+/* Monitor the client for reading unless its replies are backing up, and for writing while replies are queued */
+static void updateClientEvents(int fdNum, struct ClientState *state)
+{
+    connTableSetEvents(&connTable, fdNum, outQueueEvents(&state->output, highWater, lowWater));
+}
+
+/* Write the queued replies of a writable client, it is closed if the write fails */
+static void flushClient(int fdNum)
+{
+    struct ClientState *state = connTableGetData(&connTable, fdNum);
+    if (outQueueFlush(&state->output, fdNum) < 0)
+    {
+        LOG_ERROR("Sending queued replies to fd[%d] failed, closing the connection", fdNum);
+        closeClient(fdNum);
+        return;
+    }
+    updateClientEvents(fdNum, state);
+}
+
+/**
+ * Handle the messages waiting on a seqpacket client or on the datagram socket: one recvmmsg() takes up to
+ * MSG_BATCH_MAX_MESSAGES of them and the pongs go back with one sendmmsg().
+ * Return the number of messages received, or -1 when the seqpacket client is gone and must be closed.
+ **/
+static int serveMessages(int fdNum)
+{
+    struct Frame frame;
+    const struct sockaddr_un *address = NULL;
+    socklen_t addressLength = 0;
+    int numReceived, i;
+
+    numReceived = msgBatchRecv(&inMessages, fdNum, MSG_DONTWAIT);
+    if (numReceived < 0)
+    {
+        if (EAGAIN == errno || EWOULDBLOCK == errno)
+            return 0;
+        LOG_ERROR("recvmmsg() fd[%d] return error", fdNum);
+        return -1;
+    }
+    for (i = 0; i < numReceived; ++i)
+    {
+        /* A frame is never empty, a zero-length message is the EOF of a seqpacket client */
+        if (SOCKET_MODE_SEQPACKET == socketMode && 0 == inMessages.msgs[i].msg_len)
+        {
+            LOG_INFO("Received EOF message");
+            numReceived = -1;
+            break;
+        }
+        if (msgBatchFrame(&inMessages, i, &frame) < 0)
+        {
+            LOG_ERROR("Malformed message of %u bytes received on fd[%d]", inMessages.msgs[i].msg_len, fdNum);
+            if (SOCKET_MODE_SEQPACKET == socketMode)
+            {
+                numReceived = -1;
+                break;
+            }
+            continue;
+        }
+        if (FRAME_TYPE_PING == frame.header.type)
+        {
+            /* Benchmark probe, a datagram is answered at its sender address, a seqpacket message on its connection */
+            if (SOCKET_MODE_DGRAM == socketMode)
+                address = msgBatchAddress(&inMessages, i, &addressLength);
+            msgBatchQueue(&outMessages, fdNum, FRAME_TYPE_PONG, frame.header.seq, frame.payload, frame.header.length, address, addressLength);
             continue;
-        arrayFdSet[i] = skt_fd;
-        break;
+        }
+        LOG_INFO("Received data on fd[%d] (seq %u): [%.*s]", fdNum, frame.header.seq, (int)frame.header.length, frame.payload);
+    }
+    if (msgBatchSend(&outMessages, fdNum) < 0)
+    {
+        LOG_ERROR("Answering ping on fd[%d] failed", fdNum);
     }
+    return numReceived;
+}
+
+/**
+ * A BULK frame only carries the size of its payload, the data is in the sealed memfd received along the frame.
+ * The memfd is mapped read-only and processed in place, the payload is never copied through the socket.
+ * Return -1 when the frame or its memfd is not valid, the connection is then closed.
+ **/
+static int handleBulk(int fdNum, struct ClientState *state, const struct Frame *frame)
+{
+    struct BulkDescriptor descriptor;
+    if (sizeof(descriptor) != frame->header.length || 0 == state->numPendingFds)
+        return -1;
+    memcpy(&descriptor, frame->payload, sizeof(descriptor));
+
+    /* Descriptors are received in the order of their frames */
+    int memFd = state->pendingFds[0];
+    state->numPendingFds--;
+    memmove(state->pendingFds, state->pendingFds + 1, state->numPendingFds * sizeof(int));
+    const char *data = bulkMap(memFd, (size_t)descriptor.length);
+    close(memFd);
+    if (!data)
+        return -1;
+
+    LOG_INFO("Received bulk payload from fd[%d] (seq %u): %llu bytes, checksum %08x", fdNum, frame->header.seq,
+             (unsigned long long)descriptor.length, bulkChecksum(data, (size_t)descriptor.length));
+    bulkUnmap(data, (size_t)descriptor.length);
+    return 0;
 }
 
-static void removeFromArrayFdSet(int skt_fd)
+/**
+ * Accept one batch of pending connections, the connection socket is not monitored while accepting is paused.
+ * select() is level-triggered: connections left in the backlog report the socket again on the next wakeup,
+ * so a storm of connections is taken a batch at a time between the reads of the connected clients.
+ **/
+static void acceptClients(const char *socketPath, int connSocket)
 {
-    int i = 0;
-    for (; i < MAX_CLIENT_SUPPORTED; i++)
+    int numAccepted, i, dataSocket;
+    numAccepted = acceptBatchRun(&acceptBatch, connSocket);
+    IF_FAIL_THEN_EXIT(numAccepted < 0, socketPath, "accept() return error");
+    for (i = 0; i < numAccepted; ++i)
     {
-        if (arrayFdSet[i] != skt_fd)
+        dataSocket = acceptBatch.fds[i];
+        LOG_INFO("Connection established (%d)", dataSocket);
+        if (dataSocket >= FD_SETSIZE)
+        {
+            /* fd_set can only hold fds below FD_SETSIZE, use poll() or epoll() servers for more clients */
+            LOG_ERROR("fd[%d] exceeds FD_SETSIZE (%d) supported by select(), closing the connection", dataSocket, FD_SETSIZE);
+            close(dataSocket);
+        }
+        else if (addClient(dataSocket) < 0)
+        {
+            LOG_ERROR("Adding fd[%d] to the table failed, closing the connection", dataSocket);
+            close(dataSocket);
+        }
+    }
+    if (!acceptBatch.isDrained && acceptBatchDelayMs(&acceptBatch) >= 0)
+    {
+        isAcceptPaused = true;
+        connTableSetEvents(&connTable, connSocket, 0);
+    }
+}
+
+/**
+ * Read a stream client once and handle its frames. Data is read into the shared buffer, or into the client parser
+ * when it holds a partial frame; recvmsg() also collects the memfds of BULK frames, they wait in the client state
+ * for their frame. Return 1 when the read filled the buffer (more data may be waiting), 0 when the client was
+ * read, or -1 when it was closed.
+ **/
+static int readClient(int fdNum)
+{
+    struct ClientState *state = connTableGetData(&connTable, fdNum);
+    struct Frame frame;
+    bool isWriteFailed = false, isFull, isFrameCompleted = false;
+    int numFds, ret;
+
+    LOG_INFO("Waiting for data from the client's fd[%d] using recvmsg()", fdNum);
+    ret = batchReaderReadWithFds(&reader, &state->parser, fdNum, state->pendingFds + state->numPendingFds,
+                                 FD_PASSING_MAX_FDS - state->numPendingFds, &numFds);
+    if (-1 == ret && EMSGSIZE == errno)
+    {
+        /* The client passed more descriptors than fit, the kernel dropped some of them */
+        LOG_ERROR("Descriptors from fd[%d] were truncated, closing the connection", fdNum);
+        closeClient(fdNum);
+        return -1;
+    }
+    if (-1 == ret && (EAGAIN == errno || EINTR == errno))
+    {
+        /* Nothing to read after all, the client socket is non-blocking */
+        batchReaderFinish(&reader);
+        return 0;
+    }
+    if (-1 == ret)
+    {
+        /* ECONNRESET from a client that went away with replies unread, only this client is lost */
+        LOG_ERROR("recvmsg() fd[%d] return error (%s), closing the connection", fdNum, strerror(errno));
+        closeClient(fdNum);
+        return -1;
+    }
+    if (/*EOF*/0 == ret)
+    {
+        /* Once the client has closed the socket, the server will received the EOF message */
+        LOG_INFO("Received EOF message");
+        closeClient(fdNum);
+        return -1;
+    }
+
+    state->numPendingFds += numFds;
+    isFull = batchReaderIsFull(&reader);
+    replies.queue = &state->output;
+    /* One read() may carry several frames, or only a part of one which stays in the parser */
+    while ((ret = batchReaderNext(&reader, &frame)) > 0)
+    {
+        isFrameCompleted = true;
+        if (FRAME_TYPE_BULK == frame.header.type)
+        {
+            if (handleBulk(fdNum, state, &frame) < 0)
+            {
+                ret = -1;
+                break;
+            }
             continue;
-        arrayFdSet[i] = -1;
-        break;
+        }
+        if (FRAME_TYPE_PING == frame.header.type)
+        {
+            /* Benchmark probe, echoed back without logging, the payload stays in the read buffer until the flush */
+            if (outBatchQueue(&replies, fdNum, FRAME_TYPE_PONG, frame.header.seq, frame.payload, frame.header.length) < 0)
+            {
+                isWriteFailed = true;
+            }
+            continue;
+        }
+        LOG_INFO("Received data from fd[%d] (seq %u): [%.*s]", fdNum, frame.header.seq, (int)frame.header.length, frame.payload);
+    }
+    /* The replies to the frames of this read are sent with one writev(), what the socket does not take is queued */
+    if (outBatchFlush(&replies, fdNum) < 0)
+    {
+        isWriteFailed = true;
+    }
+    /* A partial frame left in the shared buffer moves to the client parser, before the client can be closed */
+    if (batchReaderFinish(&reader) < 0 && ret >= 0)
+    {
+        LOG_ERROR("Keeping a partial frame of fd[%d] failed, closing the connection", fdNum);
+        closeClient(fdNum);
+        return -1;
+    }
+    if (ret < 0)
+    {
+        LOG_ERROR("Malformed frame received from fd[%d], closing the connection", fdNum);
+        closeClient(fdNum);
+        return -1;
     }
+    if (isWriteFailed)
+    {
+        LOG_ERROR("Answering ping of fd[%d] failed, closing the connection", fdNum);
+        closeClient(fdNum);
+        return -1;
+    }
+    updateClientEvents(fdNum, state);
+    updateClientTimers(state, isFrameCompleted);
+    /* A client paused by its reply queue is not read again until the queue drains */
+    return (isFull && (connTable.pollFds[connTable.slotOfFd[fdNum]].events & POLLIN)) ? 1 : 0;
 }
 
-/* Clone the arrayFdSet to fd_set data structure */
-static void cloneFdSetStruct(fd_set *ptrFdSet)
+/**
+ * Serve a readable client: it is read again while every read fills the buffer, up to readBudget reads, so a
+ * client streaming data can not hold the loop while the other ready clients wait. What is left stays in the
+ * socket and select() reports the client again on the next wakeup.
+ **/
+static void serveClient(const char *socketPath, int fdNum)
 {
-    FD_ZERO(ptrFdSet);
-    int i = 0;
-    for (; i < MAX_CLIENT_SUPPORTED; i++)
+    int numReads = 0, ret;
+    do
     {
-        if (arrayFdSet[i] != -1)
+        if (SOCKET_MODE_SEQPACKET == socketMode)
         {
-            FD_SET(arrayFdSet[i], ptrFdSet);
+            /* Message boundaries are kept by the socket, no parser involved, a full batch may leave messages behind */
+            ret = serveMessages(fdNum);
+            if (ret < 0)
+            {
+                closeClient(fdNum);
+                return;
+            }
+            ret = (MSG_BATCH_MAX_MESSAGES == ret) ? 1 : 0;
         }
+        else if (relay.downstreamFd >= 0)
+        {
+            /* The data goes from the client socket to the downstream through a pipe, it is never read here */
+            ret = spliceRelayForward(&relay, fdNum, (uint32_t)fdNum);
+            IF_FAIL_THEN_EXIT(relay.isDownstreamBroken, socketPath, "Relaying to the downstream failed: %s", strerror(errno));
+            if (ret <= 0 && !(ret < 0 && EAGAIN == errno))
+            {
+                LOG_INFO("Client fd[%d] closed (%s)", fdNum, (0 == ret) ? "EOF" : strerror(errno));
+                closeClient(fdNum);
+            }
+            else if (ret > 0 && idleTimeoutMs > 0)
+            {
+                /* The relayed stream is not parsed, only the idle timeout applies */
+                timerWheelAdd(&timerWheel, &((struct ClientState *)connTableGetData(&connTable, fdNum))->idleTimer, idleTimeoutMs);
+            }
+            /* One splice per wakeup, the pipe bounds what it moves */
+            ret = 0;
+        }
+        else
+        {
+            ret = readClient(fdNum);
+        }
+    } while (ret > 0 && ++numReads < readBudget);
+    if (ret > 0)
+    {
+        dispatchStats.budgetReached++;
     }
 }
 
-static int getMaxFromArrayFdSet()
+static void printUsage(const char *appName)
 {
-    int i = 0;
-    int max = -1;
-    for (; i < MAX_CLIENT_SUPPORTED; i++)
+    printf("Usage: %s [-t " SOCKET_MODE_NAMES "] [-r downstream] [-q high[:low]] [-B backlog] [-A rate[:burst]] [-R reads] [-i idle_ms] [-D deadline_ms] [-P period_ms] [socket_path]\n", appName);
+    printf("  -t  Socket type, stream (default), seqpacket or dgram (connectionless, no fd per client)\n");
+    printf("  -r  Relay the data of every client to downstream (a UNIX stream socket, or else a file) with splice()\n");
+    printf("  -q  Watermarks of the reply queues in bytes: a stream client is not read while more than high bytes of\n");
+    printf("      replies wait for it, until they drop to low (default %d:%d)\n", OUT_QUEUE_DEFAULT_HIGH_WATER, OUT_QUEUE_DEFAULT_LOW_WATER);
+    printf("  -B  Connections waiting in the listen() backlog, 0 (default) for net.core.somaxconn\n");
+    printf("  -A  Accept at most rate connections per second, in bursts of up to burst (default no limit)\n");
+    printf("  -R  Reads of one client per wakeup while its data keeps filling the buffer (default %d)\n", DEFAULT_READ_BUDGET);
+    printf("  -i  Close a stream client that sends nothing for idle_ms milliseconds (default 0, never)\n");
+    printf("  -D  Close a stream client that does not complete a frame within deadline_ms of its first bytes (default 0, never)\n");
+    printf("  -P  Print the statistics every period_ms milliseconds, as on console input (default 0, never)\n");
+}
+
+/* Statistics printed on console input and by the periodic timer */
+static void printStats(void)
+{
+    char statsBuffer[512];
+    ioStatsFormat(&ioStats, statsBuffer, sizeof(statsBuffer));
+    LOG_INFO("I/O of all clients: %s", statsBuffer);
+    outQueueStatsFormat(&outputStats, statsBuffer, sizeof(statsBuffer));
+    LOG_INFO("Reply queues: %s", statsBuffer);
+    bufferPoolFormat(&bufferPool, statsBuffer, sizeof(statsBuffer));
+    LOG_INFO("Buffer pool: %s", statsBuffer);
+    acceptStatsFormat(&acceptBatch, statsBuffer, sizeof(statsBuffer));
+    LOG_INFO("Accept: %s", statsBuffer);
+    LOG_INFO("Dispatch: %llu wakeups, %llu events (%.2f per wakeup, max %llu), read budget of %d reached %llu times",
+             dispatchStats.wakeups, dispatchStats.events, dispatchStats.wakeups ? (double)dispatchStats.events / dispatchStats.wakeups : 0.0,
+             dispatchStats.maxEvents, readBudget, dispatchStats.budgetReached);
+    timerWheelFormat(&timerWheel, statsBuffer, sizeof(statsBuffer));
+    LOG_INFO("Timers: %s; %llu idle clients and %llu missed frame deadlines closed", statsBuffer, numIdleClosed, numDeadlineClosed);
+    if (relay.downstreamFd >= 0)
     {
-        if (arrayFdSet[i] > max)
-            max = arrayFdSet[i];
+        spliceRelayFormatStats(&relay, statsBuffer, sizeof(statsBuffer));
+        LOG_INFO("Relay: %s", statsBuffer);
     }
-    return max;
 }
 
+/* Periodic task, armed again for the next period */
+static void onStatsPeriod(struct Timer *timer)
+{
+    printStats();
+    timerWheelAdd(&timerWheel, timer, statsPeriodMs);
+}
+
+
 int main(int argc, char *argv[])
 {
+    int opt, backlog = ACCEPT_DEFAULT_BACKLOG;
+    double acceptRate = 0, acceptBurst = 0;
+    const char *downstreamPath = NULL;
+    while (-1 != (opt = getopt(argc, argv, "t:r:q:B:A:R:i:D:P:h")))
+    {
+        switch (opt)
+        {
+            case 't':
+                if (socketModeParse(optarg, &socketMode) < 0)
+                {
+                    printUsage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'r': downstreamPath = optarg; break;
+            case 'q':
+                if (outQueueParseWatermarks(optarg, &highWater, &lowWater) < 0)
+                {
+                    printUsage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'B':
+                if (acceptParseBacklog(optarg, &backlog) < 0)
+                {
+                    printUsage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'A':
+                if (acceptParseRate(optarg, &acceptRate, &acceptBurst) < 0)
+                {
+                    printUsage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'R':
+                readBudget = atoi(optarg);
+                if (readBudget < 1)
+                {
+                    printUsage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'i':
+                idleTimeoutMs = atoi(optarg);
+                if (idleTimeoutMs < 0)
+                {
+                    printUsage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'D':
+                frameDeadlineMs = atoi(optarg);
+                if (frameDeadlineMs < 0)
+                {
+                    printUsage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'P':
+                statsPeriodMs = atoi(optarg);
+                if (statsPeriodMs < 0)
+                {
+                    printUsage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            default: printUsage(argv[0]); return (opt == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if (downstreamPath && SOCKET_MODE_STREAM != socketMode)
+    {
+        /* splice() moves bytes of a stream, message boundaries would be lost */
+        LOG_ERROR("Relay mode needs stream sockets");
+        return EXIT_FAILURE;
+    }
     /* Initialize socket path from application input parameter or default value */
-    const char *socketPath = (argc>1)?argv[1]:DEFAULT_SOCKET_PATH;
+    const char *socketPath = (argc>optind)?argv[optind]:DEFAULT_SOCKET_PATH;
     struct sockaddr_un structSocketInfo;
     /* Initialize socket info structure */
     memset(&structSocketInfo, 0, sizeof(struct sockaddr_un));
     structSocketInfo.sun_family = AF_UNIX;
     strncpy(structSocketInfo.sun_path, socketPath, sizeof(structSocketInfo.sun_path)-1);
-    fd_set rfds; /* read fds */
+    fd_set rfds, wfds; /* read and write fds */
 #if (USE_CASE_SELECT_TIMEOUT)
     struct timeval tv2Set, tv2Print;
+#else
+    struct timeval waitTimeout;
 #endif
-    int connSocket = -1, dataSocket = -1, ret, commSocketFd, i;
+    int connSocket = -1, ret, commSocketFd, i, k, acceptDelayMs, waitMs, numSlots, startSlot, numReads;
+    unsigned long long numEvents;
     char buffer[BUFFER_SIZE];
 
-    initArrayFdSet();
+    /* A client that resets with replies unread only loses its connection, writing to it fails with EPIPE */
+    signal(SIGPIPE, SIG_IGN);
+    connTableInit(&connTable);
+    outBatchInit(&replies, &ioStats);
+    bufferPoolInit(&bufferPool);
+    timerWheelInit(&timerWheel, TIMER_WHEEL_DEFAULT_TICK_MS);
+    if (statsPeriodMs > 0)
+    {
+        timerInit(&statsTimer, onStatsPeriod, NULL);
+        timerWheelAdd(&timerWheel, &statsTimer, statsPeriodMs);
+    }
+    IF_FAIL_THEN_EXIT(batchReaderInit(&reader, &ioStats) < 0, socketPath, "Allocating the read buffer failed");
+    ret = msgBatchInit(&inMessages, (SOCKET_MODE_STREAM == socketMode) ? 0 : SOCKET_MESSAGE_MAX_SIZE, &ioStats);
+    IF_FAIL_THEN_EXIT(ret < 0 || msgBatchInit(&outMessages, 0, &ioStats) < 0, socketPath, "Allocating the message buffers failed");
+    /* A datagram server never blocks on a client that does not read its pongs, they are dropped */
+    outMessages.sendFlags = (SOCKET_MODE_DGRAM == socketMode) ? MSG_DONTWAIT : 0;
+    /* A stream client is non-blocking, its replies wait in its output queue when it does not read them */
+    acceptBatchInit(&acceptBatch, SOCK_CLOEXEC | ((SOCKET_MODE_STREAM == socketMode) ? SOCK_NONBLOCK : 0), acceptRate, acceptBurst);
+    if (downstreamPath)
+    {
+        IF_FAIL_THEN_EXIT(spliceRelayOpen(&relay, downstreamPath) < 0, NULL, "Opening downstream [%s] failed: %s",
+                          downstreamPath, strerror(errno));
+        LOG_INFO("Relaying client data to [%s] (%d)", downstreamPath, relay.downstreamFd);
+    }
     /* Add socket descriptor STDIN_FILENO=0 to monitor stdin */
-    addToArrayFdSet(STDIN_FILENO);
+    connTableAdd(&connTable, STDIN_FILENO, POLLIN);
     /* Remove the socket if it exists */
     unlink(socketPath);
 
-    /* Create connection socket (master socket file descriptor) */
-    connSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+    /* Create connection socket (master socket file descriptor), non-blocking so accept() can be drained */
+    connSocket = socket(AF_UNIX, socketModeType(socketMode) | ((SOCKET_MODE_DGRAM != socketMode) ? SOCK_NONBLOCK : 0), 0);
     IF_FAIL_THEN_EXIT(connSocket < 0, socketPath, "Creating a connection socket failed");
-    LOG_INFO("Connection socket created (%d)", connSocket);
+    LOG_INFO("Connection socket created (%d), %s mode", connSocket, socketModeName(socketMode));
 
     /* Bind connection socket to path */
     ret = bind(connSocket, (const struct sockaddr *)&structSocketInfo, sizeof(struct sockaddr_un));
@@ -146,21 +682,41 @@ int main(int argc, char *argv[])
     LOG_INFO("Bind connection socket to path [%s] succeeded", socketPath);
 
     /**
-     * Listen for incoming connections, the second parameter means that while a request is being processed,
-     * MAX_NUMBER_PENDING_CONNECTIONS requests can wait.
+     * Listen for incoming connections, up to backlog connections wait to be accepted: a deep backlog lets a
+     * storm of reconnecting clients queue instead of failing. A datagram socket has no connection, it receives
+     * the messages of every client itself.
      **/
-    ret = listen(connSocket, MAX_NUMBER_PENDING_CONNECTIONS);
-    IF_FAIL_THEN_EXIT(ret < 0, socketPath, "Listening on socket failed");
-    LOG_INFO("Listening for incoming connections...");
+    if (SOCKET_MODE_DGRAM != socketMode)
+    {
+        ret = acceptListen(connSocket, backlog);
+        IF_FAIL_THEN_EXIT(ret < 0, socketPath, "Listening on socket failed");
+        LOG_INFO("Listening for incoming connections (backlog %d)...", ret);
+    }
 
-    /* Add connection socket to array set of FDs */
-    addToArrayFdSet(connSocket);
+    /* Add connection socket to the table of FDs */
+    ret = connTableAdd(&connTable, connSocket, POLLIN);
+    IF_FAIL_THEN_EXIT(ret < 0, socketPath, "Adding connection socket to the table failed");
     /* Main server loop */
     for (;;)
     {
-        cloneFdSetStruct(&rfds);
+        /* A paused connection socket is monitored again once the rate limit or the descriptors allow it */
+        acceptDelayMs = isAcceptPaused ? acceptBatchDelayMs(&acceptBatch) : -1;
+        if (isAcceptPaused && acceptDelayMs < 0)
+        {
+            isAcceptPaused = false;
+            connTableSetEvents(&connTable, connSocket, POLLIN);
+        }
+        /* The table keeps its fd_set up to date, copying it replaces re-building the set on every loop */
+        rfds = connTable.readFds;
+        wfds = connTable.writeFds;
         LOG_INFO("##### Waiting on select()");
 
+        /* The wait ends when the next timer is due, or when a paused connection socket can be monitored again */
+        waitMs = timerWheelTimeoutMs(&timerWheel);
+        if (acceptDelayMs >= 0 && (waitMs < 0 || acceptDelayMs < waitMs))
+        {
+            waitMs = acceptDelayMs;
+        }
 #if (USE_CASE_SELECT_TIMEOUT)
         /**
          * select() may update the timeout argument to indicate how much time was left,
@@ -168,12 +724,19 @@ int main(int argc, char *argv[])
          **/
         tv2Set.tv_sec = 5;
         tv2Set.tv_usec = 0;
+        if (waitMs >= 0 && waitMs < 5000)
+        {
+            tv2Set.tv_sec = waitMs / 1000;
+            tv2Set.tv_usec = (waitMs % 1000) * 1000;
+        }
         tv2Print = tv2Set;
         /* Call select(), the server will block until there is a connection or data request or timeout */
-        ret = select(getMaxFromArrayFdSet()+1, &rfds, NULL, NULL, /*timeout*/&tv2Set);
+        ret = select(connTable.maxFd+1, &rfds, &wfds, NULL, /*timeout*/&tv2Set);
 #else
         /* Call select(), the server will block until there is a connection or data request on any FDs */
-        ret = select(getMaxFromArrayFdSet()+1, &rfds, NULL, NULL, NULL);
+        waitTimeout.tv_sec = waitMs / 1000;
+        waitTimeout.tv_usec = (waitMs % 1000) * 1000;
+        ret = select(connTable.maxFd+1, &rfds, &wfds, NULL, (waitMs >= 0) ? &waitTimeout : NULL);
 #endif
         if (ret < 0)
         {
@@ -183,65 +746,102 @@ int main(int argc, char *argv[])
 #if (USE_CASE_SELECT_TIMEOUT)
         else if (0 == ret)
         {
-            LOG_INFO("select() timeout and no data within %ld(s) and %ld(us)", tv2Print.tv_sec, tv2Print.tv_usec);
+            if (0 == timerWheelAdvance(&timerWheel))
+            {
+                LOG_INFO("select() timeout and no data within %ld(s) and %ld(us)", tv2Print.tv_sec, tv2Print.tv_usec);
+            }
             continue;
         }
 #endif
 
-        if (FD_ISSET(connSocket, &rfds))
-        {
-            LOG_INFO("New connection received, accepting the connection");
-            dataSocket = accept(connSocket, NULL, NULL);
-            IF_FAIL_THEN_EXIT(dataSocket < 0, socketPath, "accept() return error");
-            LOG_INFO("Connection established (%d)", dataSocket);
-            addToArrayFdSet(dataSocket);
-        }
-        else if (FD_ISSET(0, &rfds))
-        {
-            /* Input from console stdin */
-            memset(buffer, 0, BUFFER_SIZE);
-            ret = read(0, buffer, BUFFER_SIZE);
-            LOG_INFO("Input read from stdin's fd[0]: [%.*s]", /*number read*/ret, buffer);
-        }
-        else
+        /**
+         * Every ready fd is handled in this wakeup. The clients come first, from a start slot that moves on
+         * each wakeup so no client is always served first, then the console and one batch of new connections.
+         **/
+        numEvents = 0;
+        numSlots = connTable.numSlots;
+        startSlot = (nextStartSlot < numSlots) ? nextStartSlot : 0;
+        for (k = 0; k < numSlots; ++k)
         {
-            /* Data arrives on one of the client's FDs, so check and get that FD */
-            i = 0; commSocketFd = -1;
-            for (; i < MAX_CLIENT_SUPPORTED; ++i)
+            i = (startSlot + k < numSlots) ? startSlot + k : startSlot + k - numSlots;
+            commSocketFd = connTable.pollFds[i].fd;
+            if (commSocketFd < 0 || connSocket == commSocketFd || STDIN_FILENO == commSocketFd)
             {
-                if (FD_ISSET(arrayFdSet[i], &rfds))
-                {
-                    commSocketFd = arrayFdSet[i];
-                    break;
-                }
+                continue;
             }
-
-            /* Prepare the buffer to receive the data */
-            memset(buffer, 0, BUFFER_SIZE);
-            LOG_INFO("Waiting for data from the client's fd[%d] using read()", commSocketFd);
-            ret = read(commSocketFd, buffer, BUFFER_SIZE);
-            if (-1 == ret)
+            /* Clients that can take their queued replies again, only stream clients are ever in the write set */
+            if ((connTable.pollFds[i].events & POLLOUT) && FD_ISSET(commSocketFd, &wfds))
             {
-                LOG_ERROR("read() fd[%d] return error", commSocketFd);
-                cleanupAndExitError(socketPath);
+                flushClient(commSocketFd);
+                numEvents++;
             }
-            else if (/*EOF*/0 == ret)
+            /* A client closed by the flush left its slot with fd -1, slots are only reused by the accept below */
+            if (commSocketFd == connTable.pollFds[i].fd && FD_ISSET(commSocketFd, &rfds))
             {
-                /* Once the client has closed the socket, the server will received the EOF message */
-                LOG_INFO("Received EOF message");
-                removeFromArrayFdSet(commSocketFd);
-                close(commSocketFd);
+                serveClient(socketPath, commSocketFd);
+                numEvents++;
+            }
+        }
+        nextStartSlot = startSlot + 1;
+
+        if (FD_ISSET(0, &rfds))
+        {
+            /* Input from console stdin */
+            numEvents++;
+            ret = read(STDIN_FILENO, buffer, BUFFER_SIZE);
+            if (ret <= 0)
+            {
+                /* Stdin stays readable at EOF or on error, watching it further would spin the loop */
+                LOG_INFO("stdin closed, stop monitoring it");
+                connTableRemove(&connTable, STDIN_FILENO);
             }
             else
             {
-                LOG_INFO("Received data from fd[%d]: [%.*s]", commSocketFd, /*number read*/ret, buffer);
+                LOG_INFO("Input read from stdin's fd[0]: [%.*s]", /*number read*/ret, buffer);
+                printStats();
             }
         }
+
+        if (FD_ISSET(connSocket, &rfds) && SOCKET_MODE_DGRAM == socketMode)
+        {
+            /* Every client sends on the connection socket, it gets the read budget of one client */
+            numEvents++;
+            numReads = 0;
+            do
+            {
+                ret = serveMessages(connSocket);
+                IF_FAIL_THEN_EXIT(ret < 0, socketPath, "Receiving datagrams failed");
+            } while (MSG_BATCH_MAX_MESSAGES == ret && ++numReads < readBudget);
+        }
+        else if (FD_ISSET(connSocket, &rfds))
+        {
+            LOG_INFO("New connection received, accepting the pending connections");
+            numEvents++;
+            acceptClients(socketPath, connSocket);
+        }
+
+        /* Expired timers run after the events, a connection they close is never served in the same wakeup */
+        timerWheelAdvance(&timerWheel);
+
+        dispatchStats.wakeups++;
+        dispatchStats.events += numEvents;
+        if (numEvents > dispatchStats.maxEvents)
+        {
+            dispatchStats.maxEvents = numEvents;
+        }
     }
 
     /* Perform clean up */
     close(connSocket);
-    removeFromArrayFdSet(connSocket);
+    connTableRemove(&connTable, connSocket);
+    connTableRelease(&connTable);
+    batchReaderRelease(&reader);
+    bufferPoolRelease(&bufferPool);
+    msgBatchRelease(&inMessages);
+    if (relay.downstreamFd >= 0)
+    {
+        spliceRelayClose(&relay);
+    }
     unlink(socketPath);
     LOG_INFO("Server is down");
 
@@ -7,7 +7,7 @@
  * @description    :  This example demonstrates a UNIX domain socket server handling multiple clients
  *                    using pselect()
  *------------------------------------------------------------------------------------------------**/
-#define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
@@ -20,30 +20,84 @@
 #include <time.h>
 #include <unistd.h>
 
+#include "../common/conn_table.h"
+#include "../common/frame.h"
+#include "../common/batch_io.h"
+#include "../common/buffer_pool.h"
+#include "../common/socket_mode.h"
+#include "../common/accept_batch.h"
+#include "../common/timer_wheel.h"
+#include "../common/hot_restart.h"
+#include "../common/log.h"
+
 /* LOG macro function */
-#define LOG_INFO(format, ...) do { printf("[SERVER_INFO] " format "\n", ##__VA_ARGS__); } while (0)
-#define LOG_ERROR(format, ...) do { printf("[SERVER_ERROR] " format "\n", ##__VA_ARGS__); } while (0)
+#define LOG_INFO(format, ...) LOG_AT(LOG_LEVEL_INFO, "[SERVER_INFO] " format, ##__VA_ARGS__)
+#define LOG_ERROR(format, ...) LOG_AT(LOG_LEVEL_ERROR, "[SERVER_ERROR] " format, ##__VA_ARGS__)
 
 #define DEFAULT_SOCKET_PATH "/tmp/ipc-demo.sock"
 #define BUFFER_SIZE 128
-#define MAX_NUMBER_PENDING_CONNECTIONS 10
-#define MAX_CLIENT_SUPPORTED 32
+/* Reads of one client in one wakeup while every read fills the buffer, the rest waits for the next wakeup */
+#define DEFAULT_READ_BUDGET 4
 
 #define IF_FAIL_THEN_EXIT(EXP, RELEASE, MSG, ...) ({ if (EXP) { LOG_ERROR(MSG, ##__VA_ARGS__); cleanupAndExitError(RELEASE); } })
 
 /* Flag to enable/disable pselect() use case on timeout */ 
 #define USE_CASE_PSELECT_TIMEOUT 1
 
-/* An array of fd (file descriptors also called as data sockets) */
-int arrayFdSet[MAX_CLIENT_SUPPORTED];
+/* Table of monitored fds (file descriptors also called as data sockets), it grows with the number of clients */
+struct ConnTable connTable;
+/* Reads of every client go through one shared buffer, syscalls and frames are counted in ioStats */
+struct BatchReader reader;
+struct IoStats ioStats;
+/* Parser buffers of the clients are borrowed from this pool while a partial frame is pending */
+struct BufferPool bufferPool;
+/* Stream clients are non-blocking, a client whose queued replies pass highWater is not read until lowWater */
+struct OutQueueStats outputStats;
+size_t highWater = OUT_QUEUE_DEFAULT_HIGH_WATER, lowWater = OUT_QUEUE_DEFAULT_LOW_WATER;
+/* In seqpacket and dgram modes a message is one frame, the messages are received and answered in batches */
+enum SocketMode socketMode = SOCKET_MODE_STREAM;
+struct MsgBatch inMessages, outMessages;
+/* Pending connections are accepted in batches, the connection socket is not monitored while accepting is paused */
+struct AcceptBatch acceptBatch;
+bool isAcceptPaused = false;
+/* Replies to the frames of one read, sent with one writev() */
+struct OutBatch replies;
+
+/* Events handled per pselect() wakeup: every ready fd is served, starting from a slot that moves on each wakeup */
+struct DispatchStats
+{
+    unsigned long long wakeups;
+    unsigned long long events;          /* ready fds handled: client reads and writes, connections, console */
+    unsigned long long maxEvents;       /* most events of one wakeup */
+    unsigned long long budgetReached;   /* times a client was left with data to read for the next wakeup */
+};
+struct DispatchStats dispatchStats;
+int readBudget = DEFAULT_READ_BUDGET;
+int nextStartSlot = 0;
+/**
+ * Idle timeouts, frame deadlines and the periodic statistics are timers of one wheel, the wait of the loop
+ * ends when the next one is due. 0 disables a timeout.
+ **/
+struct TimerWheel timerWheel;
+int idleTimeoutMs = 0, frameDeadlineMs = 0, statsPeriodMs = 0;
+struct Timer statsTimer;
+unsigned long long numIdleClosed = 0, numDeadlineClosed = 0;
+/* Hot restart: a new server started with -H connects to the control socket (socket path + ".ctl") and takes every socket over */
+char controlPath[sizeof(((struct sockaddr_un *)0)->sun_path)];
+int controlSocket = -1;
 
-/* Signal handler function */
+/* Signal handler function, it only records the signal: pselect() returns EINTR and the loop logs it */
 volatile sig_atomic_t isSignalReceived = false;
 volatile sig_atomic_t signalNumber = 0;
 void handleSignal(const int sigNum)
 {
     isSignalReceived = true;
     signalNumber = sigNum;
+}
+
+/* Called from the loop, never from the handler: logging takes the lock of the log and may allocate */
+static void logSignal(int sigNum)
+{
     switch (sigNum)
     {
         case SIGINT:
@@ -61,15 +115,25 @@ void handleSignal(const int sigNum)
     }
 }
 
+/* State of a stream client: its frame parser and the replies its socket did not take yet */
+struct ClientState
+{
+    int fd;
+    struct FrameParser parser;
+    struct OutQueue output;
+    struct Timer idleTimer;     /* reclaims the client when it sends nothing for idleTimeoutMs */
+    struct Timer frameTimer;    /* deadline of the frame being received, frameDeadlineMs from its first bytes */
+};
+
 /* Function to clean up resources and exit */
 void cleanupAndExitError(const char *socketPath)
 {
-    int i = 0;
-    for (; i < MAX_CLIENT_SUPPORTED; i++)
+    int slot = 0;
+    for (; slot < connTable.numSlots; slot++)
     {
-        if (arrayFdSet[i] != -1)
+        if (connTable.pollFds[slot].fd != -1)
         {
-            close(arrayFdSet[i]);
+            close(connTable.pollFds[slot].fd);
         }
     }
     if (socketPath)
@@ -81,65 +145,543 @@ void cleanupAndExitError(const char *socketPath)
     exit(EXIT_FAILURE);
 }
 
-static void initArrayFdSet()
+static void onIdleTimeout(struct Timer *timer);
+static void onFrameDeadline(struct Timer *timer);
+
+/* Add a client to the table with its own state (only a stream needs one), return -1 on failure */
+static int addClient(int fdNum)
 {
-    int i = 0;
-    for (; i < MAX_CLIENT_SUPPORTED; i++)
+    struct ClientState *state = NULL;
+    if (SOCKET_MODE_STREAM == socketMode)
+    {
+        state = malloc(sizeof(struct ClientState));
+        if (!state)
+            return -1;
+        frameParserInitPooled(&state->parser, &bufferPool);
+        outQueueInit(&state->output, &bufferPool, &outputStats);
+        state->fd = fdNum;
+        timerInit(&state->idleTimer, onIdleTimeout, state);
+        timerInit(&state->frameTimer, onFrameDeadline, state);
+    }
+    if (connTableAdd(&connTable, fdNum, POLLIN) < 0)
+    {
+        free(state);
+        return -1;
+    }
+    connTableSetData(&connTable, fdNum, state);
+    if (state && idleTimeoutMs > 0)
     {
-        arrayFdSet[i] = -1;
+        timerWheelAdd(&timerWheel, &state->idleTimer, idleTimeoutMs);
     }
+    return 0;
 }
 
-static void addToArrayFdSet(int fdNum)
+/* Release the state of a client, remove it from the table and close it */
+static void closeClient(int fdNum)
 {
-    int i = 0;
-    for (; i < MAX_CLIENT_SUPPORTED; i++)
+    struct ClientState *state = connTableGetData(&connTable, fdNum);
+    if (state)
     {
-        if (arrayFdSet[i] != -1)
+        timerWheelCancel(&timerWheel, &state->idleTimer);
+        timerWheelCancel(&timerWheel, &state->frameTimer);
+        frameParserRelease(&state->parser);
+        outQueueRelease(&state->output);
+        free(state);
+    }
+    connTableRemove(&connTable, fdNum);
+    close(fdNum);
+}
+
+/* Idle timeout: the client sent nothing for idleTimeoutMs, its connection is reclaimed */
+static void onIdleTimeout(struct Timer *timer)
+{
+    struct ClientState *state = timer->data;
+    LOG_INFO("fd[%d] idle for %d ms, closing the connection", state->fd, idleTimeoutMs);
+    numIdleClosed++;
+    closeClient(state->fd);
+}
+
+/* Frame deadline: a frame was started and not completed in frameDeadlineMs, the client is stalled or too slow */
+static void onFrameDeadline(struct Timer *timer)
+{
+    struct ClientState *state = timer->data;
+    LOG_ERROR("fd[%d] did not complete its frame within %d ms, closing the connection", state->fd, frameDeadlineMs);
+    numDeadlineClosed++;
+    closeClient(state->fd);
+}
+
+/**
+ * Arm the timers of a client that sent data: the idle timeout starts again, and the frame deadline runs while a
+ * partial frame is pending, from the read that started it (a read that completed frames starts a new one).
+ **/
+static void updateClientTimers(struct ClientState *state, bool isFrameCompleted)
+{
+    if (idleTimeoutMs > 0)
+    {
+        timerWheelAdd(&timerWheel, &state->idleTimer, idleTimeoutMs);
+    }
+    if (frameDeadlineMs > 0)
+    {
+        if (state->parser.readPos == state->parser.writePos)
+            timerWheelCancel(&timerWheel, &state->frameTimer);
+        else if (isFrameCompleted || !timerIsPending(&state->frameTimer))
+            timerWheelAdd(&timerWheel, &state->frameTimer, frameDeadlineMs);
+    }
+}
+
+/* Monitor the client for reading unless its replies are backing up, and for writing while replies are queued */
+static void updateClientEvents(int fdNum, struct ClientState *state)
+{
+    connTableSetEvents(&connTable, fdNum, outQueueEvents(&state->output, highWater, lowWater));
+}
+
+/* Write the queued replies of a writable client, it is closed if the write fails */
+static void flushClient(int fdNum)
+{
+    struct ClientState *state = connTableGetData(&connTable, fdNum);
+    if (outQueueFlush(&state->output, fdNum) < 0)
+    {
+        LOG_ERROR("Sending queued replies to fd[%d] failed, closing the connection", fdNum);
+        closeClient(fdNum);
+        return;
+    }
+    updateClientEvents(fdNum, state);
+}
+
+/**
+ * Handle the messages waiting on a seqpacket client or on the datagram socket: one recvmmsg() takes up to
+ * MSG_BATCH_MAX_MESSAGES of them and the pongs go back with one sendmmsg().
+ * Return the number of messages received, or -1 when the seqpacket client is gone and must be closed.
+ **/
+static int serveMessages(int fdNum)
+{
+    struct Frame frame;
+    const struct sockaddr_un *address = NULL;
+    socklen_t addressLength = 0;
+    int numReceived, i;
+
+    numReceived = msgBatchRecv(&inMessages, fdNum, MSG_DONTWAIT);
+    if (numReceived < 0)
+    {
+        if (EAGAIN == errno || EWOULDBLOCK == errno)
+            return 0;
+        LOG_ERROR("recvmmsg() fd[%d] return error", fdNum);
+        return -1;
+    }
+    for (i = 0; i < numReceived; ++i)
+    {
+        /* A frame is never empty, a zero-length message is the EOF of a seqpacket client */
+        if (SOCKET_MODE_SEQPACKET == socketMode && 0 == inMessages.msgs[i].msg_len)
+        {
+            LOG_INFO("Received EOF message");
+            numReceived = -1;
+            break;
+        }
+        if (msgBatchFrame(&inMessages, i, &frame) < 0)
+        {
+            LOG_ERROR("Malformed message of %u bytes received on fd[%d]", inMessages.msgs[i].msg_len, fdNum);
+            if (SOCKET_MODE_SEQPACKET == socketMode)
+            {
+                numReceived = -1;
+                break;
+            }
+            continue;
+        }
+        if (FRAME_TYPE_PING == frame.header.type)
+        {
+            /* Benchmark probe, a datagram is answered at its sender address, a seqpacket message on its connection */
+            if (SOCKET_MODE_DGRAM == socketMode)
+                address = msgBatchAddress(&inMessages, i, &addressLength);
+            msgBatchQueue(&outMessages, fdNum, FRAME_TYPE_PONG, frame.header.seq, frame.payload, frame.header.length, address, addressLength);
             continue;
-        arrayFdSet[i] = fdNum;
-        break;
+        }
+        LOG_INFO("Received data on fd[%d] (seq %u): [%.*s]", fdNum, frame.header.seq, (int)frame.header.length, frame.payload);
+    }
+    if (msgBatchSend(&outMessages, fdNum) < 0)
+    {
+        LOG_ERROR("Answering ping on fd[%d] failed", fdNum);
+    }
+    return numReceived;
+}
+
+/**
+ * Accept one batch of pending connections, the connection socket is not monitored while accepting is paused.
+ * pselect() is level-triggered: connections left in the backlog report the socket again on the next wakeup,
+ * so a storm of connections is taken a batch at a time between the reads of the connected clients.
+ **/
+static void acceptClients(const char *socketPath, int connSocket)
+{
+    int numAccepted, i, dataSocket;
+    numAccepted = acceptBatchRun(&acceptBatch, connSocket);
+    IF_FAIL_THEN_EXIT(numAccepted < 0, socketPath, "accept() return error");
+    for (i = 0; i < numAccepted; ++i)
+    {
+        dataSocket = acceptBatch.fds[i];
+        LOG_INFO("Connection established (%d)", dataSocket);
+        if (dataSocket >= FD_SETSIZE)
+        {
+            /* fd_set can only hold fds below FD_SETSIZE, use poll() or epoll() servers for more clients */
+            LOG_ERROR("fd[%d] exceeds FD_SETSIZE (%d) supported by pselect(), closing the connection", dataSocket, FD_SETSIZE);
+            close(dataSocket);
+        }
+        else if (addClient(dataSocket) < 0)
+        {
+            LOG_ERROR("Adding fd[%d] to the table failed, closing the connection", dataSocket);
+            close(dataSocket);
+        }
+    }
+    if (!acceptBatch.isDrained && acceptBatchDelayMs(&acceptBatch) >= 0)
+    {
+        isAcceptPaused = true;
+        connTableSetEvents(&connTable, connSocket, 0);
     }
 }
 
-static void removeFromArrayFdSet(int fdNum)
+/**
+ * Read a stream client once and handle its frames. Data is read into the shared buffer, or into the client parser
+ * when it holds a partial frame. Return 1 when the read filled the buffer (more data may be waiting), 0 when the
+ * client was read, or -1 when it was closed.
+ **/
+static int readClient(int fdNum)
 {
-    int i = 0;
-    for (; i < MAX_CLIENT_SUPPORTED; i++)
+    struct ClientState *state = connTableGetData(&connTable, fdNum);
+    struct Frame frame;
+    bool isWriteFailed = false, isFull, isFrameCompleted = false;
+    int ret;
+
+    LOG_INFO("Waiting for data from the client's fd[%d] using read()", fdNum);
+    ret = batchReaderRead(&reader, &state->parser, fdNum);
+    if (-1 == ret && (EAGAIN == errno || EINTR == errno))
+    {
+        /* Nothing to read after all, the client socket is non-blocking */
+        batchReaderFinish(&reader);
+        return 0;
+    }
+    if (-1 == ret)
+    {
+        /* Typically ECONNRESET, the client reset with replies still unread: it is closed, the server goes on */
+        LOG_ERROR("read() fd[%d] return error (%s), closing the connection", fdNum, strerror(errno));
+        closeClient(fdNum);
+        return -1;
+    }
+    if (/*EOF*/0 == ret)
+    {
+        /* Once the client has closed the socket, the server will received the EOF message */
+        LOG_INFO("Received EOF message");
+        closeClient(fdNum);
+        return -1;
+    }
+
+    isFull = batchReaderIsFull(&reader);
+    replies.queue = &state->output;
+    /* One read() may carry several frames, or only a part of one which stays in the parser */
+    while ((ret = batchReaderNext(&reader, &frame)) > 0)
     {
-        if (arrayFdSet[i] != fdNum)
+        isFrameCompleted = true;
+        if (FRAME_TYPE_PING == frame.header.type)
+        {
+            /* Benchmark probe, echoed back without logging, the payload stays in the read buffer until the flush */
+            if (outBatchQueue(&replies, fdNum, FRAME_TYPE_PONG, frame.header.seq, frame.payload, frame.header.length) < 0)
+            {
+                isWriteFailed = true;
+            }
             continue;
-        arrayFdSet[i] = -1;
-        break;
+        }
+        LOG_INFO("Received data from fd[%d] (seq %u): [%.*s]", fdNum, frame.header.seq, (int)frame.header.length, frame.payload);
     }
+    /* The replies to the frames of this read are sent with one writev(), what the socket does not take is queued */
+    if (outBatchFlush(&replies, fdNum) < 0)
+    {
+        isWriteFailed = true;
+    }
+    /* A partial frame left in the shared buffer moves to the client parser, before the client can be closed */
+    if (batchReaderFinish(&reader) < 0 && ret >= 0)
+    {
+        LOG_ERROR("Keeping a partial frame of fd[%d] failed, closing the connection", fdNum);
+        closeClient(fdNum);
+        return -1;
+    }
+    if (ret < 0)
+    {
+        LOG_ERROR("Malformed frame received from fd[%d], closing the connection", fdNum);
+        closeClient(fdNum);
+        return -1;
+    }
+    if (isWriteFailed)
+    {
+        LOG_ERROR("Answering ping of fd[%d] failed, closing the connection", fdNum);
+        closeClient(fdNum);
+        return -1;
+    }
+    updateClientEvents(fdNum, state);
+    updateClientTimers(state, isFrameCompleted);
+    /* A client paused by its reply queue is not read again until the queue drains */
+    return (isFull && (connTable.pollFds[connTable.slotOfFd[fdNum]].events & POLLIN)) ? 1 : 0;
 }
 
-/* Clone the arrayFdSet to fd_set data structure */
-static void cloneFdSetStruct(fd_set *ptrFdSet)
+/**
+ * Serve a readable client: it is read again while every read fills the buffer, up to readBudget reads, so a
+ * client streaming data can not hold the loop while the other ready clients wait. What is left stays in the
+ * socket and pselect() reports the client again on the next wakeup.
+ **/
+static void serveClient(int fdNum)
 {
-    FD_ZERO(ptrFdSet);
-    int i = 0;
-    for (; i < MAX_CLIENT_SUPPORTED; i++)
+    int numReads = 0, ret;
+    do
     {
-        if (arrayFdSet[i] != -1)
+        if (SOCKET_MODE_SEQPACKET == socketMode)
         {
-            FD_SET(arrayFdSet[i], ptrFdSet);
+            /* Message boundaries are kept by the socket, no parser involved, a full batch may leave messages behind */
+            ret = serveMessages(fdNum);
+            if (ret < 0)
+            {
+                closeClient(fdNum);
+                return;
+            }
+            ret = (MSG_BATCH_MAX_MESSAGES == ret) ? 1 : 0;
         }
+        else
+        {
+            ret = readClient(fdNum);
+        }
+    } while (ret > 0 && ++numReads < readBudget);
+    if (ret > 0)
+    {
+        dispatchStats.budgetReached++;
     }
 }
 
-static int getMaxFromArrayFdSet()
+/* Close every client, once the new server holds its own descriptors of them */
+static void closeHandedOffClients(int connSocket)
 {
-    int i = 0;
-    int max = -1;
-    for (; i < MAX_CLIENT_SUPPORTED; i++)
+    int slot, fdNum;
+    for (slot = 0; slot < connTable.numSlots; ++slot)
     {
-        if (arrayFdSet[i] > max)
-            max = arrayFdSet[i];
+        fdNum = connTable.pollFds[slot].fd;
+        if (fdNum < 0 || connSocket == fdNum || controlSocket == fdNum || STDIN_FILENO == fdNum)
+        {
+            continue;
+        }
+        /* The new server holds its own descriptor of the socket, closing this one does not disconnect the client */
+        closeClient(fdNum);
+    }
+}
+
+/**
+ * Hand the listening socket and every client, with its partial frame and queued replies, to the new server
+ * connected to the control socket. Return true once DONE is sent: this one must exit, leaving the socket path in
+ * place. Until then nothing is closed here, so if a send fails this server keeps the listening socket and every
+ * client and goes on serving; the new server, which gets no DONE, drops its copies and exits.
+ **/
+static bool handOff(int connSocket)
+{
+    uint32_t requestedMode, numConnections = 0;
+    int controlFd = hotRestartAccept(controlSocket, &requestedMode), slot, fdNum;
+    struct ClientState *state;
+    if (controlFd < 0)
+    {
+        LOG_ERROR("Hot restart request failed (%s)", strerror(errno));
+        return false;
+    }
+    if (requestedMode != (uint32_t)socketMode)
+    {
+        LOG_ERROR("Hot restart refused: the new server runs in %s mode, this one in %s mode",
+                  socketModeName((enum SocketMode)requestedMode), socketModeName(socketMode));
+        close(controlFd);
+        return false;
+    }
+    LOG_INFO("Hot restart requested, handing the listening socket and the connections over");
+    if (hotRestartSendListener(controlFd, connSocket) < 0)
+    {
+        LOG_ERROR("Sending the listening socket failed (%s)", strerror(errno));
+        close(controlFd);
+        return false;
+    }
+    for (slot = 0; slot < connTable.numSlots; ++slot)
+    {
+        fdNum = connTable.pollFds[slot].fd;
+        if (fdNum < 0 || connSocket == fdNum || controlSocket == fdNum || STDIN_FILENO == fdNum)
+        {
+            continue;
+        }
+        state = connTableGetData(&connTable, fdNum);
+        if (hotRestartSendConnection(controlFd, fdNum, state ? &state->parser : NULL, state ? &state->output : NULL) < 0)
+        {
+            if (EMSGSIZE != errno)
+            {
+                LOG_ERROR("Hot restart aborted after %u connections (%s), keeping every socket", numConnections, strerror(errno));
+                close(controlFd);
+                return false;
+            }
+            /* Neither server could serve it whole, it is closed on both sides */
+            LOG_ERROR("fd[%d] has too many buffered bytes to be handed over, closing the connection", fdNum);
+            closeClient(fdNum);
+        }
+        else
+        {
+            numConnections++;
+        }
     }
-    return max;
+    /* The control path is free before DONE, the new server binds it next */
+    connTableRemove(&connTable, controlSocket);
+    close(controlSocket);
+    controlSocket = -1;
+    unlink(controlPath);
+    if (hotRestartSendDone(controlFd, numConnections) < 0)
+    {
+        LOG_ERROR("Sending the end of the handoff failed (%s), keeping every socket", strerror(errno));
+        close(controlFd);
+        /* The new server exits without DONE, the control path is free for the next attempt */
+        controlSocket = hotRestartListen(controlPath);
+        if (controlSocket >= 0 && connTableAdd(&connTable, controlSocket, POLLIN) < 0)
+        {
+            close(controlSocket);
+            unlink(controlPath);
+            controlSocket = -1;
+        }
+        if (controlSocket < 0)
+        {
+            LOG_ERROR("Control socket [%s] not available again, hot restart disabled", controlPath);
+        }
+        return false;
+    }
+    close(controlFd);
+    closeHandedOffClients(connSocket);
+    LOG_INFO("Handed the listening socket and %u connections over, exiting", numConnections);
+    return true;
 }
 
+/* Add a client received from the previous server, with its partial frame and queued replies. Return -1 if it was closed */
+static int restoreClient(const struct HandoffMessage *message)
+{
+    struct ClientState *state;
+    struct iovec iov;
+    size_t space;
+    char *ptr;
+    if (message->fd >= FD_SETSIZE || addClient(message->fd) < 0)
+    {
+        close(message->fd);
+        return -1;
+    }
+    state = connTableGetData(&connTable, message->fd);
+    if (!state)
+    {
+        return 0;
+    }
+    if (message->inputBytes)
+    {
+        ptr = frameParserWritePtr(&state->parser, message->inputBytes, &space);
+        if (!ptr)
+        {
+            closeClient(message->fd);
+            return -1;
+        }
+        memcpy(ptr, message->input, message->inputBytes);
+        frameParserCommit(&state->parser, message->inputBytes);
+    }
+    iov.iov_base = (void *)message->output;
+    iov.iov_len = message->outputBytes;
+    if (message->outputBytes && outQueueAppend(&state->output, &iov, 1) < 0)
+    {
+        closeClient(message->fd);
+        return -1;
+    }
+    updateClientEvents(message->fd, state);
+    updateClientTimers(state, false);
+    return 0;
+}
+
+/**
+ * Take the sockets over from the server running on the same path, instead of creating the connection socket:
+ * the clients stay connected, the connections waiting in the backlog and the bytes not read yet are kept.
+ * Return the listening socket.
+ **/
+static int takeOver(void)
+{
+    struct HandoffMessage message;
+    int connSocket = -1, numRestored = 0, ret;
+    int controlFd = hotRestartConnect(controlPath, (uint32_t)socketMode);
+    IF_FAIL_THEN_EXIT(controlFd < 0, NULL, "Connecting to the running server on [%s] failed (%s)", controlPath, strerror(errno));
+    LOG_INFO("Connected to the running server on [%s], taking its sockets over", controlPath);
+
+    while ((ret = hotRestartReceive(controlFd, &message)) > 0)
+    {
+        if (FRAME_TYPE_HANDOFF_LISTENER == message.type)
+        {
+            connSocket = message.fd;
+        }
+        else if (FRAME_TYPE_HANDOFF_CONNECTION == message.type)
+        {
+            if (restoreClient(&message) < 0)
+            {
+                LOG_ERROR("Restoring a connection received from the running server failed, it was closed");
+            }
+            else
+            {
+                numRestored++;
+            }
+        }
+        else
+        {
+            LOG_INFO("Took over %d of the %u connections of the running server", numRestored, message.numConnections);
+            hotRestartMessageRelease(&message);
+            break;
+        }
+        hotRestartMessageRelease(&message);
+    }
+    close(controlFd);
+    /**
+     * Without DONE the old server still serves the listening socket and every client: this one drops its copies
+     * by exiting, leaving the socket and control paths to the old server.
+     **/
+    IF_FAIL_THEN_EXIT(ret <= 0, NULL, "The running server ended the handoff early (%s), it keeps its sockets",
+                      (ret < 0) ? strerror(errno) : "EOF");
+    IF_FAIL_THEN_EXIT(connSocket < 0, NULL, "No listening socket received from the running server");
+    return connSocket;
+}
+
+static void printUsage(const char *appName)
+{
+    printf("Usage: %s [-t " SOCKET_MODE_NAMES "] [-q high[:low]] [-B backlog] [-A rate[:burst]] [-R reads] [-i idle_ms] [-D deadline_ms] [-P period_ms] [-H] [socket_path]\n", appName);
+    printf("  -t  Socket type, stream (default), seqpacket or dgram (connectionless, no fd per client)\n");
+    printf("  -q  Watermarks of the reply queues in bytes: a stream client is not read while more than high bytes of\n");
+    printf("      replies wait for it, until they drop to low (default %d:%d)\n", OUT_QUEUE_DEFAULT_HIGH_WATER, OUT_QUEUE_DEFAULT_LOW_WATER);
+    printf("  -B  Connections waiting in the listen() backlog, 0 (default) for net.core.somaxconn\n");
+    printf("  -A  Accept at most rate connections per second, in bursts of up to burst (default no limit)\n");
+    printf("  -R  Reads of one client per wakeup while its data keeps filling the buffer (default %d)\n", DEFAULT_READ_BUDGET);
+    printf("  -i  Close a stream client that sends nothing for idle_ms milliseconds (default 0, never)\n");
+    printf("  -D  Close a stream client that does not complete a frame within deadline_ms of its first bytes (default 0, never)\n");
+    printf("  -P  Print the statistics every period_ms milliseconds, as on console input (default 0, never)\n");
+    printf("  -H  Hot restart: take the listening socket and the connections over from the server running on socket_path\n");
+}
+
+/* Statistics printed on console input and by the periodic timer */
+static void printStats(void)
+{
+    char statsBuffer[512];
+    ioStatsFormat(&ioStats, statsBuffer, sizeof(statsBuffer));
+    LOG_INFO("I/O of all clients: %s", statsBuffer);
+    outQueueStatsFormat(&outputStats, statsBuffer, sizeof(statsBuffer));
+    LOG_INFO("Reply queues: %s", statsBuffer);
+    bufferPoolFormat(&bufferPool, statsBuffer, sizeof(statsBuffer));
+    LOG_INFO("Buffer pool: %s", statsBuffer);
+    acceptStatsFormat(&acceptBatch, statsBuffer, sizeof(statsBuffer));
+    LOG_INFO("Accept: %s", statsBuffer);
+    LOG_INFO("Dispatch: %llu wakeups, %llu events (%.2f per wakeup, max %llu), read budget of %d reached %llu times",
+             dispatchStats.wakeups, dispatchStats.events, dispatchStats.wakeups ? (double)dispatchStats.events / dispatchStats.wakeups : 0.0,
+             dispatchStats.maxEvents, readBudget, dispatchStats.budgetReached);
+    timerWheelFormat(&timerWheel, statsBuffer, sizeof(statsBuffer));
+    LOG_INFO("Timers: %s; %llu idle clients and %llu missed frame deadlines closed", statsBuffer, numIdleClosed, numDeadlineClosed);
+}
+
+/* Periodic task, armed again for the next period */
+static void onStatsPeriod(struct Timer *timer)
+{
+    printStats();
+    timerWheelAdd(&timerWheel, timer, statsPeriodMs);
+}
+
+
 int main(int argc, char *argv[])
 {
     sigset_t sigList;
@@ -153,6 +695,9 @@ int main(int argc, char *argv[])
     /* Apply list signal to block for this process */
     sigprocmask(SIG_BLOCK, &sigList, NULL);
 
+    /* Ignored rather than only blocked: a client that resets with replies unread leaves no SIGPIPE pending */
+    signal(SIGPIPE, SIG_IGN);
+
     struct sigaction sa;
     sa.sa_handler = handleSignal;
     /* Restart interrupted system calls */
@@ -169,14 +714,87 @@ int main(int argc, char *argv[])
     sigaction(SIGTERM, &sa, NULL);
     LOG_INFO("Press Ctrl+C to send SIGINT, Ctrl+Z to send SIGTSTP, Ctrl+\\ to send SIGQUIT, `kill -SIGTERM <pid>` to send SIGTERM");
 
+    int opt, backlog = ACCEPT_DEFAULT_BACKLOG;
+    bool isHotRestart = false, isHandedOff = false;
+    double acceptRate = 0, acceptBurst = 0;
+    while (-1 != (opt = getopt(argc, argv, "t:q:B:A:R:i:D:P:Hh")))
+    {
+        switch (opt)
+        {
+            case 't':
+                if (socketModeParse(optarg, &socketMode) < 0)
+                {
+                    printUsage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'q':
+                if (outQueueParseWatermarks(optarg, &highWater, &lowWater) < 0)
+                {
+                    printUsage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'B':
+                if (acceptParseBacklog(optarg, &backlog) < 0)
+                {
+                    printUsage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'A':
+                if (acceptParseRate(optarg, &acceptRate, &acceptBurst) < 0)
+                {
+                    printUsage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'R':
+                readBudget = atoi(optarg);
+                if (readBudget < 1)
+                {
+                    printUsage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'i':
+                idleTimeoutMs = atoi(optarg);
+                if (idleTimeoutMs < 0)
+                {
+                    printUsage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'D':
+                frameDeadlineMs = atoi(optarg);
+                if (frameDeadlineMs < 0)
+                {
+                    printUsage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'H':
+                isHotRestart = true;
+                break;
+            case 'P':
+                statsPeriodMs = atoi(optarg);
+                if (statsPeriodMs < 0)
+                {
+                    printUsage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            default: printUsage(argv[0]); return (opt == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
     /* Initialize socket path from application input parameter or default value */
-    const char *socketPath = (argc>1)?argv[1]:DEFAULT_SOCKET_PATH;
+    const char *socketPath = (argc>optind)?argv[optind]:DEFAULT_SOCKET_PATH;
     struct sockaddr_un structSocketInfo;
     /* Initialize socket info structure */
     memset(&structSocketInfo, 0, sizeof(struct sockaddr_un));
     structSocketInfo.sun_family = AF_UNIX;
     strncpy(structSocketInfo.sun_path, socketPath, sizeof(structSocketInfo.sun_path)-1);
-    fd_set rfds; /* read fds */
+    fd_set rfds, wfds; /* read and write fds */
     /* Initialize sigmask to pselect() */
     sigset_t sigmask2Set;
     /**----------------------------------------------
@@ -194,52 +812,120 @@ int main(int argc, char *argv[])
     sigdelset(&sigmask2Set, SIGTSTP);
     sigdelset(&sigmask2Set, SIGQUIT);
     sigdelset(&sigmask2Set, SIGTERM);
+    struct timespec waitTimeout;
 #if (USE_CASE_PSELECT_TIMEOUT)
     struct timespec ts2Set;
     ts2Set.tv_sec = 3;
     ts2Set.tv_nsec = 0;
 #endif
-    int connSocket = -1, dataSocket = -1, ret, commSocketFd, i;
+    int connSocket = -1, ret, commSocketFd, i, k, acceptDelayMs, waitMs, numSlots, startSlot, numReads;
+    unsigned long long numEvents;
     char buffer[BUFFER_SIZE];
 
-    initArrayFdSet();
+    connTableInit(&connTable);
+    outBatchInit(&replies, &ioStats);
+    bufferPoolInit(&bufferPool);
+    timerWheelInit(&timerWheel, TIMER_WHEEL_DEFAULT_TICK_MS);
+    if (statsPeriodMs > 0)
+    {
+        timerInit(&statsTimer, onStatsPeriod, NULL);
+        timerWheelAdd(&timerWheel, &statsTimer, statsPeriodMs);
+    }
+    IF_FAIL_THEN_EXIT(batchReaderInit(&reader, &ioStats) < 0, socketPath, "Allocating the read buffer failed");
+    ret = msgBatchInit(&inMessages, (SOCKET_MODE_STREAM == socketMode) ? 0 : SOCKET_MESSAGE_MAX_SIZE, &ioStats);
+    IF_FAIL_THEN_EXIT(ret < 0 || msgBatchInit(&outMessages, 0, &ioStats) < 0, socketPath, "Allocating the message buffers failed");
+    /* A datagram server never blocks on a client that does not read its pongs, they are dropped */
+    outMessages.sendFlags = (SOCKET_MODE_DGRAM == socketMode) ? MSG_DONTWAIT : 0;
+    /* A stream client is non-blocking, its replies wait in its output queue when it does not read them */
+    acceptBatchInit(&acceptBatch, SOCK_CLOEXEC | ((SOCKET_MODE_STREAM == socketMode) ? SOCK_NONBLOCK : 0), acceptRate, acceptBurst);
     /* Add socket descriptor STDIN_FILENO=0 to monitor stdin */
-    addToArrayFdSet(STDIN_FILENO);
-    /* Remove the socket if it exists */
-    unlink(socketPath);
+    connTableAdd(&connTable, STDIN_FILENO, POLLIN);
+    /* The control socket of this server is named after its socket path */
+    ret = hotRestartControlPath(socketPath, controlPath, sizeof(controlPath));
+    IF_FAIL_THEN_EXIT(ret < 0 && isHotRestart, NULL, "Socket path too long for a control socket");
+    if (isHotRestart)
+    {
+        /* The socket path stays bound: the socket is the one of the running server */
+        connSocket = takeOver();
+        LOG_INFO("Took over connection socket (%d), %s mode", connSocket, socketModeName(socketMode));
+    }
+    else
+    {
+        /* Remove the socket if it exists */
+        unlink(socketPath);
 
-    /* Create connection socket (master socket file descriptor) */
-    connSocket = socket(AF_UNIX, SOCK_STREAM, 0);
-    IF_FAIL_THEN_EXIT(connSocket < 0, socketPath, "Creating a connection socket failed");
-    LOG_INFO("Connection socket created (%d)", connSocket);
+        /* Create connection socket (master socket file descriptor), non-blocking so accept() can be drained */
+        connSocket = socket(AF_UNIX, socketModeType(socketMode) | ((SOCKET_MODE_DGRAM != socketMode) ? SOCK_NONBLOCK : 0), 0);
+        IF_FAIL_THEN_EXIT(connSocket < 0, socketPath, "Creating a connection socket failed");
+        LOG_INFO("Connection socket created (%d), %s mode", connSocket, socketModeName(socketMode));
 
-    /* Bind connection socket to path */
-    ret = bind(connSocket, (const struct sockaddr *)&structSocketInfo, sizeof(struct sockaddr_un));
-    IF_FAIL_THEN_EXIT(ret < 0, socketPath, "Bind connection socket to path failed");
-    LOG_INFO("Bind connection socket to path [%s] succeeded", socketPath);
+        /* Bind connection socket to path */
+        ret = bind(connSocket, (const struct sockaddr *)&structSocketInfo, sizeof(struct sockaddr_un));
+        IF_FAIL_THEN_EXIT(ret < 0, socketPath, "Bind connection socket to path failed");
+        LOG_INFO("Bind connection socket to path [%s] succeeded", socketPath);
 
-    /**
-     * Listen for incoming connections, the second parameter means that while a request is being processed,
-     * MAX_NUMBER_PENDING_CONNECTIONS requests can wait.
-     **/
-    ret = listen(connSocket, MAX_NUMBER_PENDING_CONNECTIONS);
-    IF_FAIL_THEN_EXIT(ret < 0, socketPath, "Listening on socket failed");
-    LOG_INFO("Listening for incoming connections...");
+        /**
+         * Listen for incoming connections, up to backlog connections wait to be accepted: a deep backlog lets a
+         * storm of reconnecting clients queue instead of failing. A datagram socket has no connection, it receives
+         * the messages of every client itself.
+         **/
+        if (SOCKET_MODE_DGRAM != socketMode)
+        {
+            ret = acceptListen(connSocket, backlog);
+            IF_FAIL_THEN_EXIT(ret < 0, socketPath, "Listening on socket failed");
+            LOG_INFO("Listening for incoming connections (backlog %d)...", ret);
+        }
+    }
 
-    /* Add connection socket to array set of FDs */
-    addToArrayFdSet(connSocket);
+    /* Add connection socket to the table of FDs */
+    ret = connTableAdd(&connTable, connSocket, POLLIN);
+    IF_FAIL_THEN_EXIT(ret < 0, socketPath, "Adding connection socket to the table failed");
+    /* A later server started with -H takes the sockets over through the control socket */
+    controlSocket = controlPath[0] ? hotRestartListen(controlPath) : -1;
+    if (controlSocket < 0 || connTableAdd(&connTable, controlSocket, POLLIN) < 0)
+    {
+        LOG_ERROR("Control socket [%s] not available (%s), hot restart disabled", controlPath, strerror(errno));
+        if (controlSocket >= 0)
+        {
+            close(controlSocket);
+            unlink(controlPath);
+            controlSocket = -1;
+        }
+    }
+    else
+    {
+        LOG_INFO("Control socket [%s] ready for a hot restart", controlPath);
+    }
     /* Main server loop */
     for (;;)
     {
-        cloneFdSetStruct(&rfds);
+        /* A paused connection socket is monitored again once the rate limit or the descriptors allow it */
+        acceptDelayMs = isAcceptPaused ? acceptBatchDelayMs(&acceptBatch) : -1;
+        if (isAcceptPaused && acceptDelayMs < 0)
+        {
+            isAcceptPaused = false;
+            connTableSetEvents(&connTable, connSocket, POLLIN);
+        }
+        /* The table keeps its fd_set up to date, copying it replaces re-building the set on every loop */
+        rfds = connTable.readFds;
+        wfds = connTable.writeFds;
         LOG_INFO("##### Waiting on pselect()");
 
+        /* The wait ends when the next timer is due, or when a paused connection socket can be monitored again */
+        waitMs = timerWheelTimeoutMs(&timerWheel);
+        if (acceptDelayMs >= 0 && (waitMs < 0 || acceptDelayMs < waitMs))
+        {
+            waitMs = acceptDelayMs;
+        }
+        waitTimeout.tv_sec = waitMs / 1000;
+        waitTimeout.tv_nsec = (waitMs % 1000) * 1000000L;
 #if (USE_CASE_PSELECT_TIMEOUT)
         /* Call pselect(), the server will block until there is a connection or data request or timeout or signal received */
-        ret = pselect(getMaxFromArrayFdSet()+1, &rfds, NULL, NULL, /*timeout*/&ts2Set, &sigmask2Set);
+        ret = pselect(connTable.maxFd+1, &rfds, &wfds, NULL, /*timeout*/(waitMs >= 0 && waitTimeout.tv_sec < ts2Set.tv_sec) ?
+                      &waitTimeout : &ts2Set, &sigmask2Set);
 #else
         /* Call pselect(), the server will block until there is a connection or data request on any FDs or signal received */
-        ret = pselect(getMaxFromArrayFdSet()+1, &rfds, NULL, NULL, NULL, &sigmask2Set);
+        ret = pselect(connTable.maxFd+1, &rfds, &wfds, NULL, (waitMs >= 0) ? &waitTimeout : NULL, &sigmask2Set);
 #endif
         if (ret < 0)
         {
@@ -249,6 +935,7 @@ int main(int argc, char *argv[])
                 if (isSignalReceived)
                 {
                     isSignalReceived = false;
+                    logSignal(signalNumber);
                     if (SIGINT==signalNumber)
                     {
                         LOG_INFO("Shutdown due to signal [%d]", signalNumber);
@@ -256,6 +943,8 @@ int main(int argc, char *argv[])
                     }
                     else continue;
                 }
+                /* The fd sets are not valid after an error */
+                continue;
             }
             else
             {
@@ -266,66 +955,119 @@ int main(int argc, char *argv[])
 #if (USE_CASE_PSELECT_TIMEOUT)
         else if (0 == ret)
         {
-            LOG_INFO("pselect() timeout and no data within %ld(s) and %ld(ns)", ts2Set.tv_sec, ts2Set.tv_nsec);
+            if (0 == timerWheelAdvance(&timerWheel))
+            {
+                LOG_INFO("pselect() timeout and no data within %ld(s) and %ld(ns)", ts2Set.tv_sec, ts2Set.tv_nsec);
+            }
             continue;
         }
 #endif
 
-        if (FD_ISSET(connSocket, &rfds))
+        /**
+         * Every ready fd is handled in this wakeup. The clients come first, from a start slot that moves on
+         * each wakeup so no client is always served first, then the console and one batch of new connections.
+         **/
+        numEvents = 0;
+        numSlots = connTable.numSlots;
+        startSlot = (nextStartSlot < numSlots) ? nextStartSlot : 0;
+        for (k = 0; k < numSlots; ++k)
         {
-            LOG_INFO("New connection received, accepting the connection");
-            dataSocket = accept(connSocket, NULL, NULL);
-            IF_FAIL_THEN_EXIT(dataSocket < 0, socketPath, "accept() return error");
-            LOG_INFO("Connection established (%d)", dataSocket);
-            addToArrayFdSet(dataSocket);
+            i = (startSlot + k < numSlots) ? startSlot + k : startSlot + k - numSlots;
+            commSocketFd = connTable.pollFds[i].fd;
+            if (commSocketFd < 0 || connSocket == commSocketFd || controlSocket == commSocketFd || STDIN_FILENO == commSocketFd)
+            {
+                continue;
+            }
+            /* Clients that can take their queued replies again, only stream clients are ever in the write set */
+            if ((connTable.pollFds[i].events & POLLOUT) && FD_ISSET(commSocketFd, &wfds))
+            {
+                flushClient(commSocketFd);
+                numEvents++;
+            }
+            /* A client closed by the flush left its slot with fd -1, slots are only reused by the accept below */
+            if (commSocketFd == connTable.pollFds[i].fd && FD_ISSET(commSocketFd, &rfds))
+            {
+                serveClient(commSocketFd);
+                numEvents++;
+            }
         }
-        else if (FD_ISSET(0, &rfds))
+        nextStartSlot = startSlot + 1;
+
+        if (FD_ISSET(0, &rfds))
         {
             /* Input from console stdin */
-            memset(buffer, 0, BUFFER_SIZE);
-            ret = read(0, buffer, BUFFER_SIZE);
-            LOG_INFO("Input read from stdin's fd[0]: [%.*s]", /*number read*/ret, buffer);
-        }
-        else
-        {
-            /* Data arrives on one of the client's FDs, so check and get that FD */
-            i = 0; commSocketFd = -1;
-            for (; i < MAX_CLIENT_SUPPORTED; ++i)
+            numEvents++;
+            ret = read(STDIN_FILENO, buffer, BUFFER_SIZE);
+            if (ret <= 0)
             {
-                if (FD_ISSET(arrayFdSet[i], &rfds))
-                {
-                    commSocketFd = arrayFdSet[i];
-                    break;
-                }
+                /* Stdin stays readable at EOF or on error, watching it further would spin the loop */
+                LOG_INFO("stdin closed, stop monitoring it");
+                connTableRemove(&connTable, STDIN_FILENO);
             }
-
-            /* Prepare the buffer to receive the data */
-            memset(buffer, 0, BUFFER_SIZE);
-            LOG_INFO("Waiting for data from the client's fd[%d] using read()", commSocketFd);
-            ret = read(commSocketFd, buffer, BUFFER_SIZE);
-            if (-1 == ret)
+            else
             {
-                LOG_ERROR("read() fd[%d] return error", commSocketFd);
-                cleanupAndExitError(socketPath);
+                LOG_INFO("Input read from stdin's fd[0]: [%.*s]", /*number read*/ret, buffer);
+                printStats();
             }
-            else if (/*EOF*/0 == ret)
+        }
+
+        if (controlSocket >= 0 && FD_ISSET(controlSocket, &rfds))
+        {
+            /* A new server asks for the sockets, once they are handed over this one exits */
+            numEvents++;
+            if (handOff(connSocket))
             {
-                /* Once the client has closed the socket, the server will received the EOF message */
-                LOG_INFO("Received EOF message");
-                removeFromArrayFdSet(commSocketFd);
-                close(commSocketFd);
+                isHandedOff = true;
+                break;
             }
-            else
+        }
+
+        if (FD_ISSET(connSocket, &rfds) && SOCKET_MODE_DGRAM == socketMode)
+        {
+            /* Every client sends on the connection socket, it gets the read budget of one client */
+            numEvents++;
+            numReads = 0;
+            do
             {
-                LOG_INFO("Received data from fd[%d]: [%.*s]", commSocketFd, /*number read*/ret, buffer);
-            }
+                ret = serveMessages(connSocket);
+                IF_FAIL_THEN_EXIT(ret < 0, socketPath, "Receiving datagrams failed");
+            } while (MSG_BATCH_MAX_MESSAGES == ret && ++numReads < readBudget);
+        }
+        else if (FD_ISSET(connSocket, &rfds))
+        {
+            LOG_INFO("New connection received, accepting the pending connections");
+            numEvents++;
+            acceptClients(socketPath, connSocket);
+        }
+
+        /* Expired timers run after the events, a connection they close is never served in the same wakeup */
+        timerWheelAdvance(&timerWheel);
+
+        dispatchStats.wakeups++;
+        dispatchStats.events += numEvents;
+        if (numEvents > dispatchStats.maxEvents)
+        {
+            dispatchStats.maxEvents = numEvents;
         }
     }
 
     /* Perform clean up */
     close(connSocket);
-    removeFromArrayFdSet(connSocket);
-    unlink(socketPath);
+    connTableRemove(&connTable, connSocket);
+    connTableRelease(&connTable);
+    batchReaderRelease(&reader);
+    bufferPoolRelease(&bufferPool);
+    msgBatchRelease(&inMessages);
+    if (controlSocket >= 0)
+    {
+        close(controlSocket);
+        unlink(controlPath);
+    }
+    /* After a hot restart the socket path belongs to the new server */
+    if (!isHandedOff)
+    {
+        unlink(socketPath);
+    }
     LOG_INFO("Server is down");
 
     return EXIT_SUCCESS;
@@ -7,39 +7,68 @@
  * @description    :  This example demonstrates a UNIX domain socket server handling multiple clients
  *                    using poll()
  *------------------------------------------------------------------------------------------------**/
-#define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <signal.h>
+#include <errno.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <poll.h>
 #include <unistd.h>
 
+#include "../common/conn_table.h"
+#include "../common/frame.h"
+#include "../common/batch_io.h"
+#include "../common/buffer_pool.h"
+#include "../common/socket_mode.h"
+#include "../common/accept_batch.h"
+#include "../common/log.h"
+
 /* LOG macro function */
-#define LOG_INFO(format, ...) do { printf("[SERVER_INFO] " format "\n", ##__VA_ARGS__); } while (0)
-#define LOG_ERROR(format, ...) do { printf("[SERVER_ERROR] " format "\n", ##__VA_ARGS__); } while (0)
+#define LOG_INFO(format, ...) LOG_AT(LOG_LEVEL_INFO, "[SERVER_INFO] " format, ##__VA_ARGS__)
+#define LOG_ERROR(format, ...) LOG_AT(LOG_LEVEL_ERROR, "[SERVER_ERROR] " format, ##__VA_ARGS__)
 
 #define DEFAULT_SOCKET_PATH "/tmp/ipc-demo.sock"
 #define BUFFER_SIZE 128
-#define MAX_NUMBER_PENDING_CONNECTIONS 10
-#define MAX_CLIENT_SUPPORTED 32
 
 #define IF_FAIL_THEN_EXIT(EXP, RELEASE, MSG, ...) ({ if (EXP) { LOG_ERROR(MSG, ##__VA_ARGS__); cleanupAndExitError(RELEASE); } })
 
-/* An array of fd (file descriptors also called as data sockets) */
-struct pollfd arrayFdSet[MAX_CLIENT_SUPPORTED];
+/* Table of monitored fds (file descriptors also called as data sockets), its slots are passed to poll() as is */
+struct ConnTable connTable;
+/* Reads of every client go through one shared buffer, syscalls and frames are counted in ioStats */
+struct BatchReader reader;
+struct IoStats ioStats;
+/* Parser buffers of the clients are borrowed from this pool while a partial frame is pending */
+struct BufferPool bufferPool;
+/* Stream clients are non-blocking, a client whose queued replies pass highWater is not read until lowWater */
+struct OutQueueStats outputStats;
+size_t highWater = OUT_QUEUE_DEFAULT_HIGH_WATER, lowWater = OUT_QUEUE_DEFAULT_LOW_WATER;
+/* In seqpacket and dgram modes a message is one frame, the messages are received and answered in batches */
+enum SocketMode socketMode = SOCKET_MODE_STREAM;
+struct MsgBatch inMessages, outMessages;
+/* Pending connections are accepted in batches, the connection socket is not polled while accepting is paused */
+struct AcceptBatch acceptBatch;
+bool isAcceptPaused = false;
+
+/* State of a stream client: its frame parser and the replies its socket did not take yet */
+struct ClientState
+{
+    struct FrameParser parser;
+    struct OutQueue output;
+};
 
 /* Function to clean up resources and exit */
 void cleanupAndExitError(const char *socketPath)
 {
-    int i = 0;
-    for (; i < MAX_CLIENT_SUPPORTED; i++)
+    int slot = 0;
+    for (; slot < connTable.numSlots; slot++)
     {
-        if (arrayFdSet[i].fd != -1)
+        if (connTable.pollFds[slot].fd != -1)
         {
-            close(arrayFdSet[i].fd);
+            close(connTable.pollFds[slot].fd);
         }
     }
     if (socketPath)
@@ -51,63 +80,226 @@ void cleanupAndExitError(const char *socketPath)
     exit(EXIT_FAILURE);
 }
 
-static void initArrayFdSet()
+/* Add a client to the table with its own state (only a stream needs one), return -1 on failure */
+static int addClient(int fdNum)
 {
-    int i = 0;
-    for (; i < MAX_CLIENT_SUPPORTED; i++)
+    struct ClientState *state = NULL;
+    if (SOCKET_MODE_STREAM == socketMode)
+    {
+        state = malloc(sizeof(struct ClientState));
+        if (!state)
+            return -1;
+        frameParserInitPooled(&state->parser, &bufferPool);
+        outQueueInit(&state->output, &bufferPool, &outputStats);
+    }
+    if (connTableAdd(&connTable, fdNum, POLLIN) < 0)
     {
-        arrayFdSet[i].fd = -1;
+        free(state);
+        return -1;
     }
+    connTableSetData(&connTable, fdNum, state);
+    return 0;
 }
 
-static void addToArrayFdSet(int fdNum, short events)
+/* Release the state of a client, remove it from the table and close it */
+static void closeClient(int fdNum)
 {
-    int i = 0;
-    for (; i < MAX_CLIENT_SUPPORTED; i++)
+    struct ClientState *state = connTableGetData(&connTable, fdNum);
+    if (state)
     {
-        if (arrayFdSet[i].fd != -1)
-            continue;
-        arrayFdSet[i].fd = fdNum;
-        arrayFdSet[i].events = events;
-        break;
+        frameParserRelease(&state->parser);
+        outQueueRelease(&state->output);
+        free(state);
     }
+    connTableRemove(&connTable, fdNum);
+    close(fdNum);
+}
+
+/* Monitor the client for reading unless its replies are backing up, and for writing while replies are queued */
+static void updateClientEvents(int fdNum, struct ClientState *state)
+{
+    connTableSetEvents(&connTable, fdNum, outQueueEvents(&state->output, highWater, lowWater));
 }
 
-static void removeFromArrayFdSet(int fdNum)
+/* Write the queued replies of a writable client, it is closed if the write fails */
+static void flushClient(int fdNum)
 {
-    int i = 0;
-    for (; i < MAX_CLIENT_SUPPORTED; i++)
+    struct ClientState *state = connTableGetData(&connTable, fdNum);
+    if (outQueueFlush(&state->output, fdNum) < 0)
+    {
+        LOG_ERROR("Sending queued replies to fd[%d] failed, closing the connection", fdNum);
+        closeClient(fdNum);
+        return;
+    }
+    updateClientEvents(fdNum, state);
+}
+
+/**
+ * Handle the messages waiting on a seqpacket client or on the datagram socket: one recvmmsg() takes up to
+ * MSG_BATCH_MAX_MESSAGES of them and the pongs go back with one sendmmsg().
+ * Return the number of messages received, or -1 when the seqpacket client is gone and must be closed.
+ **/
+static int serveMessages(int fdNum)
+{
+    struct Frame frame;
+    const struct sockaddr_un *address = NULL;
+    socklen_t addressLength = 0;
+    int numReceived, i;
+
+    numReceived = msgBatchRecv(&inMessages, fdNum, MSG_DONTWAIT);
+    if (numReceived < 0)
+    {
+        if (EAGAIN == errno || EWOULDBLOCK == errno)
+            return 0;
+        LOG_ERROR("recvmmsg() fd[%d] return error", fdNum);
+        return -1;
+    }
+    for (i = 0; i < numReceived; ++i)
     {
-        if (arrayFdSet[i].fd != fdNum)
+        /* A frame is never empty, a zero-length message is the EOF of a seqpacket client */
+        if (SOCKET_MODE_SEQPACKET == socketMode && 0 == inMessages.msgs[i].msg_len)
+        {
+            LOG_INFO("Received EOF message");
+            numReceived = -1;
+            break;
+        }
+        if (msgBatchFrame(&inMessages, i, &frame) < 0)
+        {
+            LOG_ERROR("Malformed message of %u bytes received on fd[%d]", inMessages.msgs[i].msg_len, fdNum);
+            if (SOCKET_MODE_SEQPACKET == socketMode)
+            {
+                numReceived = -1;
+                break;
+            }
+            continue;
+        }
+        if (FRAME_TYPE_PING == frame.header.type)
+        {
+            /* Benchmark probe, a datagram is answered at its sender address, a seqpacket message on its connection */
+            if (SOCKET_MODE_DGRAM == socketMode)
+                address = msgBatchAddress(&inMessages, i, &addressLength);
+            msgBatchQueue(&outMessages, fdNum, FRAME_TYPE_PONG, frame.header.seq, frame.payload, frame.header.length, address, addressLength);
             continue;
-        arrayFdSet[i].fd = -1;
-        break;
+        }
+        LOG_INFO("Received data on fd[%d] (seq %u): [%.*s]", fdNum, frame.header.seq, (int)frame.header.length, frame.payload);
+    }
+    if (msgBatchSend(&outMessages, fdNum) < 0)
+    {
+        LOG_ERROR("Answering ping on fd[%d] failed", fdNum);
+    }
+    return numReceived;
+}
+
+/* Accept every pending connection the rate limit allows, the connection socket is not polled while it is paused */
+static void acceptClients(const char *socketPath, int connSocket)
+{
+    int numAccepted, i;
+    do
+    {
+        numAccepted = acceptBatchRun(&acceptBatch, connSocket);
+        IF_FAIL_THEN_EXIT(numAccepted < 0, socketPath, "accept() return error");
+        for (i = 0; i < numAccepted; ++i)
+        {
+            LOG_INFO("Connection established (%d)", acceptBatch.fds[i]);
+            if (addClient(acceptBatch.fds[i]) < 0)
+            {
+                LOG_ERROR("Adding fd[%d] to the table failed, closing the connection", acceptBatch.fds[i]);
+                close(acceptBatch.fds[i]);
+            }
+        }
+    } while (!acceptBatch.isDrained && acceptBatchDelayMs(&acceptBatch) < 0);
+    if (!acceptBatch.isDrained)
+    {
+        isAcceptPaused = true;
+        connTableSetEvents(&connTable, connSocket, 0);
     }
 }
 
+static void printUsage(const char *appName)
+{
+    printf("Usage: %s [-t " SOCKET_MODE_NAMES "] [-q high[:low]] [-B backlog] [-A rate[:burst]] [socket_path]\n", appName);
+    printf("  -t  Socket type, stream (default), seqpacket or dgram (connectionless, no fd per client)\n");
+    printf("  -q  Watermarks of the reply queues in bytes: a stream client is not read while more than high bytes of\n");
+    printf("      replies wait for it, until they drop to low (default %d:%d)\n", OUT_QUEUE_DEFAULT_HIGH_WATER, OUT_QUEUE_DEFAULT_LOW_WATER);
+    printf("  -B  Connections waiting in the listen() backlog, 0 (default) for net.core.somaxconn\n");
+    printf("  -A  Accept at most rate connections per second, in bursts of up to burst (default no limit)\n");
+}
+
 int main(int argc, char *argv[])
 {
+    int opt, backlog = ACCEPT_DEFAULT_BACKLOG;
+    double acceptRate = 0, acceptBurst = 0;
+    while (-1 != (opt = getopt(argc, argv, "t:q:B:A:h")))
+    {
+        switch (opt)
+        {
+            case 't':
+                if (socketModeParse(optarg, &socketMode) < 0)
+                {
+                    printUsage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'q':
+                if (outQueueParseWatermarks(optarg, &highWater, &lowWater) < 0)
+                {
+                    printUsage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'B':
+                if (acceptParseBacklog(optarg, &backlog) < 0)
+                {
+                    printUsage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'A':
+                if (acceptParseRate(optarg, &acceptRate, &acceptBurst) < 0)
+                {
+                    printUsage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            default: printUsage(argv[0]); return (opt == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
     /* Initialize socket path from application input parameter or default value */
-    const char *socketPath = (argc>1)?argv[1]:DEFAULT_SOCKET_PATH;
+    const char *socketPath = (argc>optind)?argv[optind]:DEFAULT_SOCKET_PATH;
     struct sockaddr_un structSocketInfo;
     /* Initialize socket info structure */
     memset(&structSocketInfo, 0, sizeof(struct sockaddr_un));
     structSocketInfo.sun_family = AF_UNIX;
     strncpy(structSocketInfo.sun_path, socketPath, sizeof(structSocketInfo.sun_path)-1);
-    int connSocket = -1, dataSocket = -1, ret, commSocketFd, i;
+    int connSocket = -1, ret, commSocketFd, i, acceptDelayMs;
     char buffer[BUFFER_SIZE];
-    struct pollfd fd2PollTmp = {0};
+    struct ClientState *state;
+    struct Frame frame;
+    struct OutBatch replies;
+    bool isWriteFailed = false;
+    char statsBuffer[512];
 
-    initArrayFdSet();
+    /* A client that resets with replies unread makes writev() fail with EPIPE, only that client is closed */
+    signal(SIGPIPE, SIG_IGN);
+    connTableInit(&connTable);
+    outBatchInit(&replies, &ioStats);
+    bufferPoolInit(&bufferPool);
+    IF_FAIL_THEN_EXIT(batchReaderInit(&reader, &ioStats) < 0, socketPath, "Allocating the read buffer failed");
+    ret = msgBatchInit(&inMessages, (SOCKET_MODE_STREAM == socketMode) ? 0 : SOCKET_MESSAGE_MAX_SIZE, &ioStats);
+    IF_FAIL_THEN_EXIT(ret < 0 || msgBatchInit(&outMessages, 0, &ioStats) < 0, socketPath, "Allocating the message buffers failed");
+    /* A datagram server never blocks on a client that does not read its pongs, they are dropped */
+    outMessages.sendFlags = (SOCKET_MODE_DGRAM == socketMode) ? MSG_DONTWAIT : 0;
+    /* A stream client is non-blocking, its replies wait in its output queue when it does not read them */
+    acceptBatchInit(&acceptBatch, SOCK_CLOEXEC | ((SOCKET_MODE_STREAM == socketMode) ? SOCK_NONBLOCK : 0), acceptRate, acceptBurst);
     /* Add socket descriptor STDIN_FILENO=0 to monitor stdin */
-    addToArrayFdSet(STDIN_FILENO, POLLIN);
+    connTableAdd(&connTable, STDIN_FILENO, POLLIN);
     /* Remove the socket if it exists */
     unlink(socketPath);
 
-    /* Create connection socket (master socket file descriptor) */
-    connSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+    /* Create connection socket (master socket file descriptor), non-blocking so accept() can be drained */
+    connSocket = socket(AF_UNIX, socketModeType(socketMode) | ((SOCKET_MODE_DGRAM != socketMode) ? SOCK_NONBLOCK : 0), 0);
     IF_FAIL_THEN_EXIT(connSocket < 0, socketPath, "Creating a connection socket failed");
-    LOG_INFO("Connection socket created (%d)", connSocket);
+    LOG_INFO("Connection socket created (%d), %s mode", connSocket, socketModeName(socketMode));
 
     /* Bind connection socket to path */
     ret = bind(connSocket, (const struct sockaddr *)&structSocketInfo, sizeof(struct sockaddr_un));
@@ -115,113 +307,198 @@ int main(int argc, char *argv[])
     LOG_INFO("Bind connection socket to path [%s] succeeded", socketPath);
 
     /**
-     * Listen for incoming connections, the second parameter means that while a request is being processed,
-     * MAX_NUMBER_PENDING_CONNECTIONS requests can wait.
+     * Listen for incoming connections, up to backlog connections wait to be accepted: a deep backlog lets a
+     * storm of reconnecting clients queue instead of failing. A datagram socket has no connection, it receives
+     * the messages of every client itself.
      **/
-    ret = listen(connSocket, MAX_NUMBER_PENDING_CONNECTIONS);
-    IF_FAIL_THEN_EXIT(ret < 0, socketPath, "Listening on socket failed");
-    LOG_INFO("Listening for incoming connections...");
+    if (SOCKET_MODE_DGRAM != socketMode)
+    {
+        ret = acceptListen(connSocket, backlog);
+        IF_FAIL_THEN_EXIT(ret < 0, socketPath, "Listening on socket failed");
+        LOG_INFO("Listening for incoming connections (backlog %d)...", ret);
+    }
 
-    /* Add connection socket to array set of FDs */
-    addToArrayFdSet(connSocket, POLLIN);
+    /* Add connection socket to the table of FDs */
+    ret = connTableAdd(&connTable, connSocket, POLLIN);
+    IF_FAIL_THEN_EXIT(ret < 0, socketPath, "Adding connection socket to the table failed");
     /* Main server loop */
     for (;;)
     {
+        /* A paused connection socket is polled again once the rate limit or the descriptors allow it */
+        acceptDelayMs = isAcceptPaused ? acceptBatchDelayMs(&acceptBatch) : -1;
+        if (isAcceptPaused && acceptDelayMs < 0)
+        {
+            isAcceptPaused = false;
+            connTableSetEvents(&connTable, connSocket, POLLIN);
+        }
         LOG_INFO("##### Waiting on poll()");
 
-        ret = poll(arrayFdSet, MAX_CLIENT_SUPPORTED, -1);
+        ret = poll(connTable.pollFds, connTable.numSlots, acceptDelayMs);
         IF_FAIL_THEN_EXIT(ret < 0, socketPath, "poll() return error");
 
-        /* Check file descriptors with events */
+        /* Check file descriptors with events, free slots have fd -1 and never return events */
         i = 0;
-        for (; i < MAX_CLIENT_SUPPORTED; ++i)
+        for (; i < connTable.numSlots; ++i)
         {
-            if (arrayFdSet[i].revents & POLLIN)
+            if (connTable.pollFds[i].revents & POLLIN)
             {
-                if (connSocket==arrayFdSet[i].fd)
+                if (connSocket==connTable.pollFds[i].fd && SOCKET_MODE_DGRAM == socketMode)
+                {
+                    ret = serveMessages(connSocket);
+                    IF_FAIL_THEN_EXIT(ret < 0, socketPath, "Receiving datagrams failed");
+                }
+                else if (connSocket==connTable.pollFds[i].fd)
                 {
-                    LOG_INFO("New connection received, accepting the connection");
-                    dataSocket = accept(connSocket, NULL, NULL);
-                    IF_FAIL_THEN_EXIT(dataSocket < 0, socketPath, "accept() return error");
-                    LOG_INFO("Connection established (%d)", dataSocket);
-                    addToArrayFdSet(dataSocket, POLLIN);
+                    LOG_INFO("New connection received, accepting the pending connections");
+                    acceptClients(socketPath, connSocket);
                 }
-                else if (0==arrayFdSet[i].fd)
+                else if (0==connTable.pollFds[i].fd)
                 {
                     /* Input from console stdin */
-                    memset(buffer, 0, BUFFER_SIZE);
                     ret = read(0, buffer, BUFFER_SIZE);
                     LOG_INFO("Input read from stdin's fd[0]: [%.*s]", /*number read*/ret, buffer);
+                    ioStatsFormat(&ioStats, statsBuffer, sizeof(statsBuffer));
+                    LOG_INFO("I/O of all clients: %s", statsBuffer);
+                    outQueueStatsFormat(&outputStats, statsBuffer, sizeof(statsBuffer));
+                    LOG_INFO("Reply queues: %s", statsBuffer);
+                    bufferPoolFormat(&bufferPool, statsBuffer, sizeof(statsBuffer));
+                    LOG_INFO("Buffer pool: %s", statsBuffer);
+                    acceptStatsFormat(&acceptBatch, statsBuffer, sizeof(statsBuffer));
+                    LOG_INFO("Accept: %s", statsBuffer);
                 }
                 else
                 {
                     /* Data arrives on the client's FD */
-                    commSocketFd = arrayFdSet[i].fd;
+                    commSocketFd = connTable.pollFds[i].fd;
+
+                    if (SOCKET_MODE_SEQPACKET == socketMode)
+                    {
+                        /* Message boundaries are kept by the socket, no parser involved */
+                        if (serveMessages(commSocketFd) < 0)
+                        {
+                            closeClient(commSocketFd);
+                        }
+                        continue;
+                    }
 
-                    /* Prepare the buffer to receive the data */
-                    memset(buffer, 0, BUFFER_SIZE);
+                    /* Data is read into the shared buffer, or into the client parser when it holds a partial frame */
+                    state = connTableGetData(&connTable, commSocketFd);
                     LOG_INFO("Waiting for data from the client's fd[%d] using read()", commSocketFd);
-                    ret = read(commSocketFd, buffer, BUFFER_SIZE);
-                    if (-1 == ret)
+                    ret = batchReaderRead(&reader, &state->parser, commSocketFd);
+                    if (-1 == ret && (EAGAIN == errno || EINTR == errno))
                     {
-                        LOG_ERROR("read() fd[%d] return error", commSocketFd);
-                        cleanupAndExitError(socketPath);
+                        /* Nothing to read after all, the client socket is non-blocking */
+                        batchReaderFinish(&reader);
+                    }
+                    else if (-1 == ret)
+                    {
+                        /* A reset client (ECONNRESET) is closed on its own, the other clients are still served */
+                        LOG_ERROR("read() fd[%d] return error (%s), closing the connection", commSocketFd, strerror(errno));
+                        closeClient(commSocketFd);
                     }
                     else if (/*EOF*/0 == ret)
                     {
                         /* Once the client has closed the socket, the server will received the EOF message */
                         LOG_INFO("Received EOF message");
-                        removeFromArrayFdSet(commSocketFd);
-                        close(commSocketFd);
+                        closeClient(commSocketFd);
                     }
                     else
                     {
-                        LOG_INFO("Received data from fd[%d]: [%.*s]", commSocketFd, /*number read*/ret, buffer);
+                        replies.queue = &state->output;
+                        /* One read() may carry several frames, or only a part of one which stays in the parser */
+                        while ((ret = batchReaderNext(&reader, &frame)) > 0)
+                        {
+                            if (FRAME_TYPE_PING == frame.header.type)
+                            {
+                                /* Benchmark probe, echoed back without logging, the payload stays in the read buffer until the flush */
+                                if (outBatchQueue(&replies, commSocketFd, FRAME_TYPE_PONG, frame.header.seq, frame.payload, frame.header.length) < 0)
+                                {
+                                    isWriteFailed = true;
+                                }
+                                continue;
+                            }
+                            LOG_INFO("Received data from fd[%d] (seq %u): [%.*s]", commSocketFd, frame.header.seq, (int)frame.header.length, frame.payload);
+                        }
+                        /* The replies to the frames of this read are sent with one writev(), what the socket does not take is queued */
+                        if (outBatchFlush(&replies, commSocketFd) < 0)
+                        {
+                            isWriteFailed = true;
+                        }
+                        /* A partial frame left in the shared buffer moves to the client parser, before the client can be closed */
+                        if (batchReaderFinish(&reader) < 0 && ret >= 0)
+                        {
+                            LOG_ERROR("Keeping a partial frame of fd[%d] failed, closing the connection", commSocketFd);
+                            closeClient(commSocketFd);
+                        }
+                        else if (ret < 0)
+                        {
+                            LOG_ERROR("Malformed frame received from fd[%d], closing the connection", commSocketFd);
+                            closeClient(commSocketFd);
+                        }
+                        else if (isWriteFailed)
+                        {
+                            LOG_ERROR("Answering ping of fd[%d] failed, closing the connection", commSocketFd);
+                            closeClient(commSocketFd);
+                        }
+                        else
+                        {
+                            updateClientEvents(commSocketFd, state);
+                        }
+                        isWriteFailed = false;
                     }
                 }
             }
-            if (arrayFdSet[i].revents & POLLRDNORM)
+            if (connTable.pollFds[i].revents & POLLRDNORM)
+            {
+                LOG_INFO("fd[%d] return event: POLLRDNORM", connTable.pollFds[i].fd);
+            }
+            if (connTable.pollFds[i].revents & POLLRDBAND)
             {
-                LOG_INFO("fd[%d] return event: POLLRDNORM", arrayFdSet[i].fd);
+                LOG_INFO("fd[%d] return event: POLLRDBAND", connTable.pollFds[i].fd);
             }
-            if (arrayFdSet[i].revents & POLLRDBAND)
+            if (connTable.pollFds[i].revents & POLLPRI)
             {
-                LOG_INFO("fd[%d] return event: POLLRDBAND", arrayFdSet[i].fd);
+                LOG_INFO("fd[%d] return event: POLLPRI", connTable.pollFds[i].fd);
             }
-            if (arrayFdSet[i].revents & POLLPRI)
+            if (connTable.pollFds[i].revents & POLLOUT)
             {
-                LOG_INFO("fd[%d] return event: POLLPRI", arrayFdSet[i].fd);
+                LOG_INFO("fd[%d] return event: POLLOUT", connTable.pollFds[i].fd);
             }
-            if (arrayFdSet[i].revents & POLLOUT)
+            if ((connTable.pollFds[i].events & POLLOUT) && (connTable.pollFds[i].revents & (POLLOUT | POLLERR | POLLHUP)))
             {
-                LOG_INFO("fd[%d] return event: POLLOUT", arrayFdSet[i].fd);
+                /* The client can take its queued replies again (or is gone, then the write fails and it is closed) */
+                flushClient(connTable.pollFds[i].fd);
             }
-            if (arrayFdSet[i].revents & POLLWRNORM)
+            if (connTable.pollFds[i].revents & POLLWRNORM)
             {
-                LOG_INFO("fd[%d] return event: POLLWRNORM", arrayFdSet[i].fd);
+                LOG_INFO("fd[%d] return event: POLLWRNORM", connTable.pollFds[i].fd);
             }
-            if (arrayFdSet[i].revents & POLLWRBAND)
+            if (connTable.pollFds[i].revents & POLLWRBAND)
             {
-                LOG_INFO("fd[%d] return event: POLLWRBAND", arrayFdSet[i].fd);
+                LOG_INFO("fd[%d] return event: POLLWRBAND", connTable.pollFds[i].fd);
             }
-            if (arrayFdSet[i].revents & POLLERR)
+            if (connTable.pollFds[i].revents & POLLERR)
             {
-                LOG_INFO("fd[%d] return event: POLLERR", arrayFdSet[i].fd);
+                LOG_INFO("fd[%d] return event: POLLERR", connTable.pollFds[i].fd);
             }
-            if (arrayFdSet[i].revents & POLLHUP)
+            if (connTable.pollFds[i].revents & POLLHUP)
             {
-                LOG_INFO("fd[%d] return event: POLLHUP", arrayFdSet[i].fd);
+                LOG_INFO("fd[%d] return event: POLLHUP", connTable.pollFds[i].fd);
             }
-            if (arrayFdSet[i].revents & POLLNVAL)
+            if (connTable.pollFds[i].revents & POLLNVAL)
             {
-                LOG_INFO("fd[%d] return event: POLLNVAL", arrayFdSet[i].fd);
+                LOG_INFO("fd[%d] return event: POLLNVAL", connTable.pollFds[i].fd);
             }
         }
     }
 
     /* Perform clean up */
     close(connSocket);
-    removeFromArrayFdSet(connSocket);
+    connTableRemove(&connTable, connSocket);
+    connTableRelease(&connTable);
+    batchReaderRelease(&reader);
+    bufferPoolRelease(&bufferPool);
+    msgBatchRelease(&inMessages);
     unlink(socketPath);
     LOG_INFO("Server is down");
 
@@ -0,0 +1,1032 @@
+/**------------------------------------------------------------------------------------------------
+ * ?                                           ABOUT
+ * @author         :  Nguyen Dinh Hoan
+ * @email          :  hoann.wk@gmail.com
+ * @repo           :  https://github.com/hoan9x/IPC-in-Linux
+ * @createdOn      :  16-Oct-2026
+ * @description    :  This example demonstrates a UNIX domain socket server handling multiple clients
+ *                    using epoll(), in level-triggered or edge-triggered mode
+ *------------------------------------------------------------------------------------------------**/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../common/frame.h"
+#include "../common/batch_io.h"
+#include "../common/buffer_pool.h"
+#include "../common/socket_mode.h"
+#include "../common/accept_batch.h"
+#include "../common/metrics.h"
+#include "../common/loop_control.h"
+#include "../common/work_pool.h"
+#include "../common/log.h"
+
+/* LOG macro function */
+#define LOG_INFO(format, ...) LOG_AT(LOG_LEVEL_INFO, "[SERVER_INFO] " format, ##__VA_ARGS__)
+#define LOG_ERROR(format, ...) LOG_AT(LOG_LEVEL_ERROR, "[SERVER_ERROR] " format, ##__VA_ARGS__)
+
+#define DEFAULT_SOCKET_PATH "/tmp/ipc-demo.sock"
+#define BUFFER_SIZE 128
+/* Maximum number of ready events returned by one epoll_wait() call */
+#define MAX_EVENTS_PER_WAIT 256
+
+#define IF_FAIL_THEN_EXIT(EXP, RELEASE, MSG, ...) ({ if (EXP) { LOG_ERROR(MSG, ##__VA_ARGS__); cleanupAndExitError(RELEASE); } })
+
+struct ClientConn;
+
+/**
+ * Frames of one client handed to the handler pool: the requests are copied one after the other at the start of
+ * buffer, the handler writes the replies right behind them (a reply is never bigger than its request).
+ **/
+struct HandlerJob
+{
+    struct WorkItem item;       /* first member, the pool hands back the item */
+    struct ClientConn *conn;
+    int fd;                     /* for the logs of the handler, the connection may be closed meanwhile */
+    char *buffer;
+    size_t capacity;
+    size_t inputBytes;
+    size_t outputBytes;
+    uint32_t numReplies;
+};
+
+/* Per-client state, registered as the epoll data so a ready event leads straight to it */
+struct ClientConn
+{
+    int fd;
+    uint32_t events;            /* events registered to epoll */
+    struct FrameParser parser;
+    struct OutQueue output;     /* replies the socket did not take yet */
+    struct ConnMetrics metrics; /* listed on the admin socket while the connection is open */
+    struct ClientConn *prev;    /* list of the open clients, walked when the server drains */
+    struct ClientConn *next;
+    /**
+     * With a handler pool, at most one job of the client is in the pool so its frames are handled and answered
+     * in order. Frames read meanwhile gather in pending (room for their replies included) and are submitted
+     * together when the job comes back.
+     **/
+    struct HandlerJob job;
+    bool isJobInFlight;
+    bool isClosed;              /* closed while its job was in flight, freed when the job comes back */
+    char *pending;
+    size_t pendingCapacity;
+    size_t pendingBytes;
+};
+
+/* epoll instance and connection socket, global so they can be released by cleanupAndExitError() */
+int epollFd = -1;
+int connSocket = -1;
+/* In seqpacket and dgram modes a message is one frame, the messages are received and answered in batches */
+enum SocketMode socketMode = SOCKET_MODE_STREAM;
+struct MsgBatch inMessages, outMessages;
+/* Parser buffers of the clients are borrowed from this pool while they hold unparsed data */
+struct BufferPool bufferPool;
+/* Replies to the frames of one read, what the socket does not take goes to the output queue of the client */
+struct OutBatch replies;
+/* A client whose queued replies pass highWater is not read until they drop to lowWater */
+struct OutQueueStats outputStats;
+size_t highWater = OUT_QUEUE_DEFAULT_HIGH_WATER, lowWater = OUT_QUEUE_DEFAULT_LOW_WATER;
+/* Pending connections are accepted in batches, the connection socket is not monitored while accepting is paused */
+struct AcceptBatch acceptBatch;
+bool isAcceptPaused = false;
+/* Open clients, the list is only walked to drain them */
+struct ClientConn *clientList = NULL;
+long numClients = 0;
+/**
+ * Signals and requests of other threads arrive on the fds of loopControl, in the epoll set like the clients.
+ * SIGINT and SIGTERM drain the server: no more connections, the queued replies are sent, the clients closed;
+ * it exits once every client is gone or drainMs after, a second SIGINT or SIGQUIT exits at once.
+ **/
+struct LoopControl loopControl;
+const struct LoopSignal controlSignals[] = {
+    {SIGINT, LOOP_REQUEST_DRAIN},
+    {SIGTERM, LOOP_REQUEST_DRAIN},
+    {SIGQUIT, LOOP_REQUEST_STOP},
+    {SIGUSR1, LOOP_REQUEST_STATS},
+};
+bool isDraining = false;
+int drainMs = LOOP_CONTROL_DEFAULT_DRAIN_MS;
+long long drainDeadlineMs = 0;
+/**
+ * Stream frames are handled by the threads of handlerPool when it has workers, the loop only reads, copies the
+ * frames and sends the replies computed, so an expensive handler no longer stalls the other clients.
+ * handlerCostUs is CPU time spent on each frame, a stand-in for a real handler, inline or in the pool.
+ **/
+struct WorkPool handlerPool;
+unsigned handlerCostUs = 0;
+
+/* Function to clean up resources and exit */
+void cleanupAndExitError(const char *socketPath)
+{
+    /* Client sockets are not tracked individually here, they are released by the kernel on exit */
+    if (-1 != epollFd)
+    {
+        close(epollFd);
+    }
+    if (-1 != connSocket)
+    {
+        close(connSocket);
+    }
+    if (socketPath)
+    {
+        /* Remove the socket file */
+        unlink(socketPath);
+    }
+    metricsStopAdmin();
+
+    exit(EXIT_FAILURE);
+}
+
+/* Raise the soft limit of open files up to the hard limit, so tens of thousands of clients can connect */
+static void raiseFileLimit()
+{
+    struct rlimit limit;
+    if (0 == getrlimit(RLIMIT_NOFILE, &limit) && limit.rlim_cur < limit.rlim_max)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        if (0 == setrlimit(RLIMIT_NOFILE, &limit))
+        {
+            LOG_INFO("Open file limit raised to %llu", (unsigned long long)limit.rlim_cur);
+        }
+    }
+}
+
+static long long nowMs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/* Stand-in for an expensive handler: keep the CPU busy for costUs microseconds */
+static void spinFor(unsigned costUs)
+{
+    struct timespec start, now;
+    if (0 == costUs)
+        return;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    do
+    {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+    } while ((now.tv_sec - start.tv_sec) * 1000000LL + (now.tv_nsec - start.tv_nsec) / 1000 < (long long)costUs);
+}
+
+/* Register conn->fd to the epoll instance for read events */
+static int addToEpoll(struct ClientConn *conn, bool isEdgeTriggered)
+{
+    struct epoll_event event = {0};
+    event.events = EPOLLIN | EPOLLRDHUP | (isEdgeTriggered ? EPOLLET : 0);
+    event.data.ptr = conn;
+    conn->events = event.events;
+    metricsAdd(METRIC_SYSCALL_CTL, 1);
+    return epoll_ctl(epollFd, EPOLL_CTL_ADD, conn->fd, &event);
+}
+
+/* Close a client socket and release its state */
+static void closeClient(struct ClientConn *conn)
+{
+    metricsConnClose(&conn->metrics);
+    metricsAdd(METRIC_SYSCALL_CTL, 1);
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+    frameParserRelease(&conn->parser);
+    outQueueRelease(&conn->output);
+    if (conn->pending)
+        bufferPoolPut(&bufferPool, conn->pending, conn->pendingCapacity);
+    conn->pending = NULL;
+    if (conn->prev)
+        conn->prev->next = conn->next;
+    else
+        clientList = conn->next;
+    if (conn->next)
+        conn->next->prev = conn->prev;
+    numClients--;
+    if (conn->isJobInFlight)
+    {
+        /* A handler still writes into the job, the state is freed when it comes back */
+        conn->isClosed = true;
+        return;
+    }
+    free(conn);
+}
+
+/**
+ * Monitor the client for reading unless its replies are backing up, and for writing while replies are queued.
+ * epoll_ctl() is only called when the events change. Re-enabling EPOLLIN also reports data that arrived
+ * meanwhile in edge-triggered mode, since a modification re-checks the readiness of the fd.
+ **/
+static int updateClientEvents(struct ClientConn *conn, bool isEdgeTriggered)
+{
+    short wanted = outQueueEvents(&conn->output, highWater, lowWater);
+    struct epoll_event event = {0};
+    /* Frames waiting for the handler count like queued replies, the client is not read until its job is back */
+    if (conn->pendingBytes >= highWater)
+        wanted &= ~POLLIN;
+    event.events = ((wanted & POLLIN) ? EPOLLIN | EPOLLRDHUP : 0) | ((wanted & POLLOUT) ? EPOLLOUT : 0) |
+                   (isEdgeTriggered ? EPOLLET : 0);
+    if (event.events == conn->events)
+        return 0;
+    event.data.ptr = conn;
+    conn->events = event.events;
+    metricsAdd(METRIC_SYSCALL_CTL, 1);
+    return epoll_ctl(epollFd, EPOLL_CTL_MOD, conn->fd, &event);
+}
+
+/* Write the queued replies of a writable client, return -1 if it failed and the client was closed */
+static int flushClient(struct ClientConn *conn, bool isEdgeTriggered)
+{
+    metricsAdd(METRIC_SYSCALL_WRITE, 1);
+    if (outQueueFlush(&conn->output, conn->fd) < 0 || updateClientEvents(conn, isEdgeTriggered) < 0)
+    {
+        LOG_ERROR("Sending queued replies to fd[%d] failed, closing the connection", conn->fd);
+        closeClient(conn);
+        return -1;
+    }
+    return 0;
+}
+
+/* Run by a worker of the handler pool: handle the frames of the job in order, the pongs go behind the requests */
+static void runJob(struct WorkItem *item)
+{
+    struct HandlerJob *job = (struct HandlerJob *)item;
+    struct FrameHeader header;
+    size_t pos = 0;
+    char *reply = job->buffer + job->inputBytes;
+    while (pos < job->inputBytes)
+    {
+        memcpy(&header, job->buffer + pos, FRAME_HEADER_SIZE);
+        const char *payload = job->buffer + pos + FRAME_HEADER_SIZE;
+        pos += FRAME_HEADER_SIZE + header.length;
+        spinFor(handlerCostUs);
+        if (FRAME_TYPE_PING == header.type)
+        {
+            header.type = FRAME_TYPE_PONG;
+            header.flags = 0;
+            memcpy(reply, &header, FRAME_HEADER_SIZE);
+            memcpy(reply + FRAME_HEADER_SIZE, payload, header.length);
+            reply += FRAME_HEADER_SIZE + header.length;
+            job->numReplies++;
+            continue;
+        }
+        LOG_INFO("Received data from fd[%d] (seq %u): [%.*s]", job->fd, header.seq, (int)header.length, payload);
+    }
+    job->outputBytes = (size_t)(reply - (job->buffer + job->inputBytes));
+}
+
+/* Copy a frame to the pending requests of the client, return 0 or -1 if out of memory */
+static int queueRequest(struct ClientConn *conn, const struct Frame *frame)
+{
+    size_t frameBytes = FRAME_HEADER_SIZE + frame->header.length;
+    /* Room for the requests and as much again for their replies */
+    size_t needed = 2 * (conn->pendingBytes + frameBytes);
+    if (needed > conn->pendingCapacity)
+    {
+        size_t capacity;
+        char *buffer = bufferPoolGet(&bufferPool, (needed > 2 * conn->pendingCapacity) ? needed : 2 * conn->pendingCapacity, &capacity);
+        if (!buffer)
+            return -1;
+        if (conn->pending)
+        {
+            memcpy(buffer, conn->pending, conn->pendingBytes);
+            bufferPoolPut(&bufferPool, conn->pending, conn->pendingCapacity);
+        }
+        conn->pending = buffer;
+        conn->pendingCapacity = capacity;
+    }
+    memcpy(conn->pending + conn->pendingBytes, &frame->header, FRAME_HEADER_SIZE);
+    memcpy(conn->pending + conn->pendingBytes + FRAME_HEADER_SIZE, frame->payload, frame->header.length);
+    conn->pendingBytes += frameBytes;
+    return 0;
+}
+
+/* Hand the pending requests of the client to the pool, unless its previous job is still there */
+static void submitRequests(struct ClientConn *conn)
+{
+    struct HandlerJob *job = &conn->job;
+    if (conn->isJobInFlight || 0 == conn->pendingBytes)
+        return;
+    job->fd = conn->fd;
+    job->buffer = conn->pending;
+    job->capacity = conn->pendingCapacity;
+    job->inputBytes = conn->pendingBytes;
+    job->outputBytes = 0;
+    job->numReplies = 0;
+    conn->pending = NULL;
+    conn->pendingCapacity = conn->pendingBytes = 0;
+    conn->isJobInFlight = true;
+    workPoolSubmit(&handlerPool, &job->item);
+}
+
+/* Send the replies of a finished job, after the ones already queued; what the socket does not take is queued */
+static int sendJobReplies(struct ClientConn *conn, struct HandlerJob *job)
+{
+    struct iovec iov = {.iov_base = job->buffer + job->inputBytes, .iov_len = job->outputBytes}, *iovPtr = &iov;
+    int iovCount = 1;
+    if (0 == job->outputBytes)
+        return 0;
+    metricsConnOut(&conn->metrics, job->numReplies, job->outputBytes);
+    if (0 == conn->output.bytes)
+    {
+        metricsAdd(METRIC_SYSCALL_WRITE, 1);
+        ssize_t ret = write(conn->fd, iov.iov_base, iov.iov_len);
+        if (ret < 0 && EAGAIN != errno && EWOULDBLOCK != errno && EINTR != errno)
+            return -1;
+        if (ret > 0)
+            iovSkip(&iovPtr, &iovCount, (size_t)ret);
+    }
+    return (iovCount > 0) ? outQueueAppend(&conn->output, iovPtr, iovCount) : 0;
+}
+
+/**
+ * Handle the messages waiting on a seqpacket client or on the datagram socket: one recvmmsg() takes up to
+ * MSG_BATCH_MAX_MESSAGES of them and the pongs go back with one sendmmsg().
+ * Return the number of messages received, or -1 when the seqpacket client is gone and must be closed.
+ **/
+static int serveMessages(int fdNum)
+{
+    struct Frame frame;
+    const struct sockaddr_un *address = NULL;
+    socklen_t addressLength = 0;
+    int numReceived, i;
+
+    numReceived = msgBatchRecv(&inMessages, fdNum, MSG_DONTWAIT);
+    metricsAdd(METRIC_SYSCALL_READ, 1);
+    if (numReceived < 0)
+    {
+        if (EAGAIN == errno || EWOULDBLOCK == errno)
+            return 0;
+        LOG_ERROR("recvmmsg() fd[%d] return error", fdNum);
+        return -1;
+    }
+    for (i = 0; i < numReceived; ++i)
+    {
+        /* A frame is never empty, a zero-length message is the EOF of a seqpacket client */
+        if (SOCKET_MODE_SEQPACKET == socketMode && 0 == inMessages.msgs[i].msg_len)
+        {
+            LOG_INFO("Received EOF message");
+            numReceived = -1;
+            break;
+        }
+        if (msgBatchFrame(&inMessages, i, &frame) < 0)
+        {
+            LOG_ERROR("Malformed message of %u bytes received on fd[%d]", inMessages.msgs[i].msg_len, fdNum);
+            if (SOCKET_MODE_SEQPACKET == socketMode)
+            {
+                numReceived = -1;
+                break;
+            }
+            continue;
+        }
+        if (FRAME_TYPE_PING == frame.header.type)
+        {
+            /* Benchmark probe, a datagram is answered at its sender address, a seqpacket message on its connection */
+            spinFor(handlerCostUs);
+            if (SOCKET_MODE_DGRAM == socketMode)
+                address = msgBatchAddress(&inMessages, i, &addressLength);
+            msgBatchQueue(&outMessages, fdNum, FRAME_TYPE_PONG, frame.header.seq, frame.payload, frame.header.length, address, addressLength);
+            continue;
+        }
+        LOG_INFO("Received data on fd[%d] (seq %u): [%.*s]", fdNum, frame.header.seq, (int)frame.header.length, frame.payload);
+    }
+    /* Messages of seqpacket clients are only counted per thread, the connection is not known here */
+    metricsAdd(METRIC_MESSAGES_IN, (uint64_t)(numReceived > 0 ? numReceived : 0));
+    if (outMessages.count > 0)
+    {
+        metricsAdd(METRIC_MESSAGES_OUT, (uint64_t)outMessages.count);
+        metricsAdd(METRIC_SYSCALL_WRITE, 1);
+    }
+    if (msgBatchSend(&outMessages, fdNum) < 0)
+    {
+        LOG_ERROR("Answering ping on fd[%d] failed", fdNum);
+    }
+    return numReceived;
+}
+
+/* Serve the messages of fd, in edge-triggered mode until a batch comes back short, i.e. the queue is drained */
+static int drainMessages(int fdNum, bool isEdgeTriggered)
+{
+    int ret;
+    do
+    {
+        ret = serveMessages(fdNum);
+    } while (isEdgeTriggered && MSG_BATCH_MAX_MESSAGES == ret);
+    return ret;
+}
+
+/**
+ * Monitor the connection socket or stop monitoring it while accepting is paused. Monitoring it again also
+ * reports the connections that waited meanwhile in edge-triggered mode, a modification re-checks readiness.
+ **/
+static int setAcceptMonitored(struct ClientConn *listenConn, bool isMonitored, bool isEdgeTriggered)
+{
+    struct epoll_event event = {0};
+    event.events = isMonitored ? (EPOLLIN | EPOLLRDHUP | (isEdgeTriggered ? EPOLLET : 0)) : 0;
+    event.data.ptr = listenConn;
+    listenConn->events = event.events;
+    isAcceptPaused = !isMonitored;
+    metricsAdd(METRIC_SYSCALL_CTL, 1);
+    return epoll_ctl(epollFd, EPOLL_CTL_MOD, listenConn->fd, &event);
+}
+
+/**
+ * Accept pending connections in batches until none is left, which edge-triggered mode needs because no
+ * further event is reported for them. Connections beyond the rate limit, or without a descriptor left for
+ * them, stay in the backlog and the connection socket is not monitored until they can be accepted.
+ **/
+static void acceptClients(const char *socketPath, struct ClientConn *listenConn, bool isEdgeTriggered)
+{
+    int numAccepted, dataSocket;
+    unsigned long long acceptCalls;
+    do
+    {
+        acceptCalls = acceptBatch.stats.acceptCalls;
+        numAccepted = acceptBatchRun(&acceptBatch, connSocket);
+        metricsAdd(METRIC_SYSCALL_ACCEPT, acceptBatch.stats.acceptCalls - acceptCalls);
+        IF_FAIL_THEN_EXIT(numAccepted < 0, socketPath, "accept() return error");
+        for (int i = 0; i < numAccepted; ++i)
+        {
+            dataSocket = acceptBatch.fds[i];
+            LOG_INFO("Connection established (%d)", dataSocket);
+            struct ClientConn *conn = malloc(sizeof(struct ClientConn));
+            if (!conn)
+            {
+                LOG_ERROR("Allocating state of fd[%d] failed, closing the connection", dataSocket);
+                close(dataSocket);
+                continue;
+            }
+            conn->fd = dataSocket;
+            conn->job.item.run = runJob;
+            conn->job.conn = conn;
+            conn->isJobInFlight = false;
+            conn->isClosed = false;
+            conn->pending = NULL;
+            conn->pendingCapacity = conn->pendingBytes = 0;
+            frameParserInitPooled(&conn->parser, &bufferPool);
+            outQueueInit(&conn->output, &bufferPool, &outputStats);
+            if (addToEpoll(conn, isEdgeTriggered) < 0)
+            {
+                LOG_ERROR("epoll_ctl() fd[%d] add failed, closing the connection", dataSocket);
+                close(dataSocket);
+                free(conn);
+                continue;
+            }
+            metricsConnOpen(&conn->metrics, dataSocket);
+            conn->prev = NULL;
+            conn->next = clientList;
+            if (clientList)
+                clientList->prev = conn;
+            clientList = conn;
+            numClients++;
+        }
+    } while (!acceptBatch.isDrained && acceptBatchDelayMs(&acceptBatch) < 0);
+    if (!acceptBatch.isDrained)
+    {
+        LOG_INFO("Accepting paused, pending connections wait in the backlog");
+        metricsAdd(METRIC_ACCEPT_PAUSES, 1);
+        setAcceptMonitored(listenConn, false, isEdgeTriggered);
+    }
+}
+
+/**
+ * Read data from a client. In edge-triggered mode the socket is drained until EAGAIN (or until reading is
+ * paused by the replies backing up), in level-triggered mode one read() is done per event and epoll reports
+ * the fd again if data is left.
+ **/
+static void readClient(struct ClientConn *conn, bool isEdgeTriggered)
+{
+    struct Frame frame;
+    ssize_t ret;
+    if (SOCKET_MODE_SEQPACKET == socketMode)
+    {
+        /* Message boundaries are kept by the socket, the parser of the client is not used */
+        if (drainMessages(conn->fd, isEdgeTriggered) < 0)
+        {
+            closeClient(conn);
+        }
+        return;
+    }
+    do
+    {
+        /* Data is read straight into the frame parser of the client */
+        ret = frameParserRead(&conn->parser, conn->fd);
+        metricsAdd(METRIC_SYSCALL_READ, 1);
+        if (ret < 0)
+        {
+            if (EAGAIN == errno || EWOULDBLOCK == errno)
+                break;
+            if (EINTR == errno)
+                continue;
+            LOG_ERROR("read() fd[%d] return error, closing the connection", conn->fd);
+            closeClient(conn);
+            break;
+        }
+        else if (/*EOF*/0 == ret)
+        {
+            /* Once the client has closed the socket, the server will received the EOF message */
+            LOG_INFO("Received EOF message from fd[%d]", conn->fd);
+            closeClient(conn);
+            break;
+        }
+
+        /* One read() may carry several frames, or only a part of one which stays in the parser */
+        uint64_t bytesRead = (uint64_t)ret, numFrames = 0;
+        replies.queue = &conn->output;
+        while ((ret = frameParserNext(&conn->parser, &frame)) > 0)
+        {
+            numFrames++;
+            if (handlerPool.numWorkers > 0)
+            {
+                /* Copied for the handler pool, the parser buffer is reused by the next read() */
+                if (queueRequest(conn, &frame) < 0)
+                {
+                    break;
+                }
+                continue;
+            }
+            spinFor(handlerCostUs);
+            if (FRAME_TYPE_PING == frame.header.type)
+            {
+                /* Benchmark probe, echoed back without logging, the payload stays in the parser until the flush */
+                if (outBatchQueue(&replies, conn->fd, FRAME_TYPE_PONG, frame.header.seq, frame.payload, frame.header.length) < 0)
+                {
+                    break;
+                }
+                continue;
+            }
+            LOG_INFO("Received data from fd[%d] (seq %u): [%.*s]", conn->fd, frame.header.seq, (int)frame.header.length, frame.payload);
+        }
+        if (ret < 0)
+        {
+            LOG_ERROR("Malformed frame received from fd[%d], closing the connection", conn->fd);
+            closeClient(conn);
+            break;
+        }
+        metricsConnIn(&conn->metrics, numFrames, bytesRead);
+        submitRequests(conn);
+        if (replies.count > 0)
+        {
+            metricsConnOut(&conn->metrics, (uint64_t)replies.count, replies.bytes);
+            metricsAdd(METRIC_SYSCALL_WRITE, 1);
+        }
+        /* The replies are sent with one writev() before the next read() reuses the parser buffer */
+        if (ret > 0 || outBatchFlush(&replies, conn->fd) < 0 || updateClientEvents(conn, isEdgeTriggered) < 0)
+        {
+            LOG_ERROR("Answering ping of fd[%d] failed, closing the connection", conn->fd);
+            closeClient(conn);
+            break;
+        }
+        /* Nothing pending, the buffer goes back to the pool until the client sends again */
+        frameParserTrim(&conn->parser);
+    } while (isEdgeTriggered && !conn->output.isReadPaused && conn->pendingBytes < highWater);
+}
+
+/* Statistics printed on console input and on SIGUSR1 */
+static void printStats()
+{
+    char statsBuffer[512];
+    bufferPoolFormat(&bufferPool, statsBuffer, sizeof(statsBuffer));
+    LOG_INFO("Buffer pool: %s", statsBuffer);
+    outQueueStatsFormat(&outputStats, statsBuffer, sizeof(statsBuffer));
+    LOG_INFO("Reply queues: %s", statsBuffer);
+    acceptStatsFormat(&acceptBatch, statsBuffer, sizeof(statsBuffer));
+    LOG_INFO("Accept: %s", statsBuffer);
+    loopControlStatsFormat(&loopControl, statsBuffer, sizeof(statsBuffer));
+    LOG_INFO("Control: %s; %ld clients open%s", statsBuffer, numClients, isDraining ? ", draining" : "");
+    if (handlerPool.numWorkers > 0)
+    {
+        workPoolStatsFormat(&handlerPool, statsBuffer, sizeof(statsBuffer));
+        LOG_INFO("Handlers: %s", statsBuffer);
+    }
+}
+
+/**
+ * A draining client is only written to, and closed once its replies are sent and its job, if any, is back:
+ * the frames it sent before the drain are still answered.
+ **/
+static void drainClient(struct ClientConn *conn)
+{
+    struct epoll_event event = {0};
+    if (0 == conn->output.bytes && !conn->isJobInFlight)
+    {
+        closeClient(conn);
+        return;
+    }
+    /* Level-triggered, a client that is not read must not keep reporting EPOLLIN */
+    event.events = (conn->output.bytes > 0) ? EPOLLOUT : 0;
+    if (event.events == conn->events)
+        return;
+    event.data.ptr = conn;
+    conn->events = event.events;
+    metricsAdd(METRIC_SYSCALL_CTL, 1);
+    if (epoll_ctl(epollFd, EPOLL_CTL_MOD, conn->fd, &event) < 0)
+    {
+        closeClient(conn);
+    }
+}
+
+/**
+ * Start draining: the connection socket is closed and its path removed, so a new server can bind it at once,
+ * and each client is only written to from now on, closed as soon as its queued replies are sent.
+ **/
+static void startDrain(const char *socketPath, struct ClientConn *listenConn)
+{
+    struct ClientConn *conn, *next;
+    LOG_INFO("Draining: no more connections, %ld clients closed once their replies are sent, within %d ms", numClients, drainMs);
+    isDraining = true;
+    isAcceptPaused = false;
+    drainDeadlineMs = nowMs() + drainMs;
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, listenConn->fd, NULL);
+    close(connSocket);
+    connSocket = -1;
+    unlink(socketPath);
+    for (conn = clientList; conn; conn = next)
+    {
+        next = conn->next;
+        drainClient(conn);
+    }
+}
+
+/* Send the queued replies of a draining client, close it once they are all sent or the client is gone */
+static void flushDrainingClient(struct ClientConn *conn, uint32_t events)
+{
+    metricsAdd(METRIC_SYSCALL_WRITE, 1);
+    if ((events & (EPOLLHUP | EPOLLERR)) || outQueueFlush(&conn->output, conn->fd) < 0)
+    {
+        closeClient(conn);
+        return;
+    }
+    drainClient(conn);
+}
+
+/**
+ * Take the jobs finished by the handler pool: the replies are sent in the order of the frames, the frames that
+ * arrived meanwhile are submitted, and a client closed while its job was in flight is freed.
+ **/
+static void completeJobs(bool isEdgeTriggered)
+{
+    struct WorkItem *item;
+    workPoolAcknowledge(&handlerPool);
+    while ((item = workPoolTakeDone(&handlerPool)))
+    {
+        struct HandlerJob *job = (struct HandlerJob *)item;
+        struct ClientConn *conn = job->conn;
+        int ret = conn->isClosed ? 0 : sendJobReplies(conn, job);
+        conn->isJobInFlight = false;
+        bufferPoolPut(&bufferPool, job->buffer, job->capacity);
+        job->buffer = NULL;
+        if (conn->isClosed)
+        {
+            free(conn);
+            continue;
+        }
+        if (ret < 0)
+        {
+            LOG_ERROR("Sending the replies of fd[%d] failed, closing the connection", conn->fd);
+            closeClient(conn);
+            continue;
+        }
+        submitRequests(conn);
+        if (isDraining)
+        {
+            drainClient(conn);
+        }
+        else if (updateClientEvents(conn, isEdgeTriggered) < 0)
+        {
+            LOG_ERROR("epoll_ctl() fd[%d] modify failed, closing the connection", conn->fd);
+            closeClient(conn);
+        }
+    }
+}
+
+static void printUsage(const char *appName)
+{
+    printf("Usage: %s [-e] [-l] [-t " SOCKET_MODE_NAMES "] [-q high[:low]] [-B backlog] [-A rate[:burst]] [-g drain_ms] [-w workers] [-c cost_us] [socket_path]\n", appName);
+    printf("  -e  Edge-triggered mode, ready sockets are drained until EAGAIN\n");
+    printf("  -l  Level-triggered mode (default)\n");
+    printf("  -t  Socket type, stream (default), seqpacket or dgram (connectionless, no fd per client)\n");
+    printf("  -q  Watermarks of the reply queues in bytes: a stream client is not read while more than high bytes of\n");
+    printf("      replies wait for it, until they drop to low (default %d:%d)\n", OUT_QUEUE_DEFAULT_HIGH_WATER, OUT_QUEUE_DEFAULT_LOW_WATER);
+    printf("  -B  Connections waiting in the listen() backlog, 0 (default) for net.core.somaxconn\n");
+    printf("  -A  Accept at most rate connections per second, in bursts of up to burst (default no limit)\n");
+    printf("  -g  On SIGINT or SIGTERM, give the clients drain_ms milliseconds to take their replies (default %d)\n", LOOP_CONTROL_DEFAULT_DRAIN_MS);
+    printf("  -w  Handle the stream frames on a pool of worker threads, 0 (default) handles them in the event loop\n");
+    printf("  -c  CPU time spent handling each frame in microseconds, to emulate an expensive handler (default 0)\n");
+    printf("SIGINT/SIGTERM drain the server, a second SIGINT or SIGQUIT stops it at once, SIGUSR1 prints the statistics\n");
+}
+
+int main(int argc, char *argv[])
+{
+    bool isEdgeTriggered = false;
+    int opt, backlog = ACCEPT_DEFAULT_BACKLOG, numWorkers = 0;
+    double acceptRate = 0, acceptBurst = 0;
+    while (-1 != (opt = getopt(argc, argv, "elt:q:B:A:g:w:c:h")))
+    {
+        switch (opt)
+        {
+            case 'e': isEdgeTriggered = true; break;
+            case 'l': isEdgeTriggered = false; break;
+            case 't':
+                if (socketModeParse(optarg, &socketMode) < 0)
+                {
+                    printUsage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'q':
+                if (outQueueParseWatermarks(optarg, &highWater, &lowWater) < 0)
+                {
+                    printUsage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'B':
+                if (acceptParseBacklog(optarg, &backlog) < 0)
+                {
+                    printUsage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'A':
+                if (acceptParseRate(optarg, &acceptRate, &acceptBurst) < 0)
+                {
+                    printUsage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'g':
+                drainMs = atoi(optarg);
+                if (drainMs < 0)
+                {
+                    printUsage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'w':
+                if (workPoolParseWorkers(optarg, &numWorkers) < 0)
+                {
+                    printUsage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'c': handlerCostUs = (unsigned)strtoul(optarg, NULL, 10); break;
+            default: printUsage(argv[0]); return (opt == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    /* Initialize socket path from application input parameter or default value */
+    const char *socketPath = (argc>optind)?argv[optind]:DEFAULT_SOCKET_PATH;
+    struct sockaddr_un structSocketInfo;
+    /* Initialize socket info structure */
+    memset(&structSocketInfo, 0, sizeof(struct sockaddr_un));
+    structSocketInfo.sun_family = AF_UNIX;
+    strncpy(structSocketInfo.sun_path, socketPath, sizeof(structSocketInfo.sun_path)-1);
+    struct epoll_event readyEvents[MAX_EVENTS_PER_WAIT];
+    int ret, i, acceptDelayMs, waitMs;
+    unsigned requests;
+    long long remainingMs;
+    bool isStopping = false, isJobDone = false;
+    char buffer[BUFFER_SIZE];
+    char adminPath[sizeof(structSocketInfo.sun_path) + sizeof(METRICS_ADMIN_SUFFIX)];
+    uint64_t wakeupNs;
+
+    /* Before the first log, which starts the writer thread: no thread but this one may take the signals */
+    if (loopControlInit(&loopControl, controlSignals, sizeof(controlSignals) / sizeof(controlSignals[0])) < 0)
+    {
+        LOG_ERROR("Creating the signalfd and eventfd failed");
+        return EXIT_FAILURE;
+    }
+    /* Not in the signalfd: a client that resets with replies unread makes writev() fail with EPIPE instead */
+    signal(SIGPIPE, SIG_IGN);
+    raiseFileLimit();
+    /* After loopControlInit(), the workers inherit the blocked signals. Seqpacket and dgram messages stay inline */
+    if (numWorkers > 0 && SOCKET_MODE_STREAM == socketMode)
+    {
+        IF_FAIL_THEN_EXIT(workPoolInit(&handlerPool, numWorkers) < 0, NULL, "Starting %d handler threads failed", numWorkers);
+        LOG_INFO("%d handler threads started", numWorkers);
+    }
+    bufferPoolInit(&bufferPool);
+    outBatchInit(&replies, NULL);
+    ret = msgBatchInit(&inMessages, (SOCKET_MODE_STREAM == socketMode) ? 0 : SOCKET_MESSAGE_MAX_SIZE, NULL);
+    IF_FAIL_THEN_EXIT(ret < 0 || msgBatchInit(&outMessages, 0, NULL) < 0, socketPath, "Allocating the message buffers failed");
+    /* A datagram server never blocks on a client that does not read its pongs, they are dropped */
+    outMessages.sendFlags = (SOCKET_MODE_DGRAM == socketMode) ? MSG_DONTWAIT : 0;
+    acceptBatchInit(&acceptBatch, SOCK_NONBLOCK | SOCK_CLOEXEC, acceptRate, acceptBurst);
+    /* Remove the socket if it exists */
+    unlink(socketPath);
+
+    /* Create the epoll instance */
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    IF_FAIL_THEN_EXIT(epollFd < 0, socketPath, "Creating an epoll instance failed");
+    LOG_INFO("epoll instance created (%d) in %s mode", epollFd, isEdgeTriggered ? "edge-triggered" : "level-triggered");
+
+    /* Create connection socket (master socket file descriptor), non-blocking so accept() can be drained */
+    connSocket = socket(AF_UNIX, socketModeType(socketMode) | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    IF_FAIL_THEN_EXIT(connSocket < 0, socketPath, "Creating a connection socket failed");
+    LOG_INFO("Connection socket created (%d), %s mode", connSocket, socketModeName(socketMode));
+
+    /* Bind connection socket to path */
+    ret = bind(connSocket, (const struct sockaddr *)&structSocketInfo, sizeof(struct sockaddr_un));
+    IF_FAIL_THEN_EXIT(ret < 0, socketPath, "Bind connection socket to path failed");
+    LOG_INFO("Bind connection socket to path [%s] succeeded", socketPath);
+
+    /**
+     * Listen for incoming connections, up to backlog connections wait to be accepted: a deep backlog lets a
+     * storm of reconnecting clients queue instead of failing. A datagram socket has no connection, it receives
+     * the messages of every client itself.
+     **/
+    if (SOCKET_MODE_DGRAM != socketMode)
+    {
+        ret = acceptListen(connSocket, backlog);
+        IF_FAIL_THEN_EXIT(ret < 0, socketPath, "Listening on socket failed");
+        LOG_INFO("Listening for incoming connections (backlog %d)...", ret);
+    }
+
+    struct ClientConn listenConn = {.fd = connSocket}, stdinConn = {.fd = STDIN_FILENO};
+    ret = addToEpoll(&listenConn, isEdgeTriggered);
+    IF_FAIL_THEN_EXIT(ret < 0, socketPath, "Adding connection socket to epoll failed");
+    /**
+     * Monitor stdin, always level-triggered because stdin is shared with the terminal and stays blocking.
+     * epoll does not support regular files, so stdin redirected from a file is not monitored.
+     **/
+    if (addToEpoll(&stdinConn, false) < 0)
+    {
+        LOG_INFO("stdin can not be monitored by epoll (errno %d), ignoring it", errno);
+    }
+    /* Signals and posted requests are events of the same epoll_wait(), there is no EINTR to check */
+    struct ClientConn signalConn = {.fd = loopControl.signalFd}, wakeupConn = {.fd = loopControl.eventFd};
+    ret = addToEpoll(&signalConn, false);
+    IF_FAIL_THEN_EXIT(ret < 0 || addToEpoll(&wakeupConn, false) < 0, socketPath, "Adding the control fds to epoll failed");
+    /* Finished jobs of the handler pool are reported the same way */
+    struct ClientConn handlerConn = {.fd = handlerPool.eventFd};
+    if (handlerPool.numWorkers > 0)
+    {
+        IF_FAIL_THEN_EXIT(addToEpoll(&handlerConn, false) < 0, socketPath, "Adding the handler pool eventfd to epoll failed");
+    }
+
+    /* Counters are served next to the socket, they are read without stopping the loop */
+    metricsRegisterThread("main");
+    snprintf(adminPath, sizeof(adminPath), "%s" METRICS_ADMIN_SUFFIX, socketPath);
+    if (metricsStartAdmin(adminPath) < 0)
+    {
+        LOG_ERROR("Serving the metrics on [%s] failed, running without them", adminPath);
+    }
+    else
+    {
+        LOG_INFO("Metrics served on [%s]", adminPath);
+    }
+
+    /* Main server loop */
+    while (!isStopping)
+    {
+        /* A paused connection socket is monitored again once the rate limit or the descriptors allow it */
+        acceptDelayMs = isAcceptPaused ? acceptBatchDelayMs(&acceptBatch) : -1;
+        if (isAcceptPaused && acceptDelayMs < 0)
+        {
+            IF_FAIL_THEN_EXIT(setAcceptMonitored(&listenConn, true, isEdgeTriggered) < 0, socketPath,
+                              "Monitoring the connection socket again failed");
+        }
+        waitMs = acceptDelayMs;
+        if (isDraining)
+        {
+            /* Connections are no longer accepted, the wait ends at the drain deadline */
+            remainingMs = drainDeadlineMs - nowMs();
+            waitMs = (remainingMs > 0) ? (int)remainingMs : 0;
+        }
+        LOG_INFO("##### Waiting on epoll_wait()");
+        /* Only the ready descriptors are returned, there is no need to scan every client */
+        ret = epoll_wait(epollFd, readyEvents, MAX_EVENTS_PER_WAIT, waitMs);
+        metricsAdd(METRIC_SYSCALL_WAIT, 1);
+        if (ret < 0)
+        {
+            if (EINTR == errno)
+                continue;
+            LOG_ERROR("epoll_wait() return error");
+            cleanupAndExitError(socketPath);
+        }
+        wakeupNs = metricsNow();
+
+        requests = 0;
+        for (i = 0; i < ret; ++i)
+        {
+            struct ClientConn *readyConn = readyEvents[i].data.ptr;
+            if (&signalConn == readyConn || &wakeupConn == readyConn)
+            {
+                /* Acted on after the other events of this wakeup, a drain closes clients they may point to */
+                requests |= loopControlTake(&loopControl);
+            }
+            else if (&handlerConn == readyConn)
+            {
+                /* Acted on after the other events too, completing a job may close a client they point to */
+                isJobDone = true;
+            }
+            else if (&listenConn == readyConn && SOCKET_MODE_DGRAM == socketMode)
+            {
+                IF_FAIL_THEN_EXIT(drainMessages(connSocket, isEdgeTriggered) < 0, socketPath, "Receiving datagrams failed");
+            }
+            else if (&listenConn == readyConn)
+            {
+                LOG_INFO("New connection received, accepting the pending connections");
+                acceptClients(socketPath, &listenConn, isEdgeTriggered);
+            }
+            else if (&stdinConn == readyConn)
+            {
+                /* Input from console stdin */
+                int numRead = read(STDIN_FILENO, buffer, BUFFER_SIZE);
+                if (numRead <= 0)
+                {
+                    /* stdin is closed, stop monitoring it otherwise it is reported ready forever */
+                    LOG_INFO("stdin closed, stop monitoring it");
+                    epoll_ctl(epollFd, EPOLL_CTL_DEL, STDIN_FILENO, NULL);
+                    continue;
+                }
+                LOG_INFO("Input read from stdin's fd[0]: [%.*s]", numRead, buffer);
+                printStats();
+            }
+            else if (isDraining)
+            {
+                /* Only the clients with replies left are still registered, for EPOLLOUT */
+                flushDrainingClient(readyConn, readyEvents[i].events);
+            }
+            else
+            {
+                /* The client can take its queued replies again, the flush closes it if it is gone */
+                if ((readyEvents[i].events & EPOLLOUT) && flushClient(readyConn, isEdgeTriggered) < 0)
+                {
+                    continue;
+                }
+                if (readyEvents[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+                {
+                    /* Data or EOF arrives on the client's FD, pending data is read before EOF is seen */
+                    readClient(readyConn, isEdgeTriggered);
+                }
+            }
+        }
+        if (isJobDone)
+        {
+            completeJobs(isEdgeTriggered);
+            isJobDone = false;
+        }
+        metricsLoopDone(wakeupNs, ret);
+
+        if (requests & LOOP_REQUEST_STATS)
+        {
+            printStats();
+        }
+        if ((requests & LOOP_REQUEST_STOP) || ((requests & LOOP_REQUEST_DRAIN) && isDraining))
+        {
+            LOG_INFO("Stop requested, %ld clients closed without draining", numClients);
+            isStopping = true;
+        }
+        else if (requests & LOOP_REQUEST_DRAIN)
+        {
+            startDrain(socketPath, &listenConn);
+        }
+        if (isDraining && 0 == numClients)
+        {
+            LOG_INFO("Drain complete, every client is gone");
+            isStopping = true;
+        }
+        else if (isDraining && nowMs() >= drainDeadlineMs)
+        {
+            LOG_ERROR("Drain deadline passed, closing %ld clients with replies still queued", numClients);
+            isStopping = true;
+        }
+    }
+
+    /* Perform clean up */
+    while (clientList)
+    {
+        closeClient(clientList);
+    }
+    if (handlerPool.numWorkers > 0)
+    {
+        /* Every client is closed, the jobs still in the pool only come back to be freed */
+        workPoolStop(&handlerPool);
+        completeJobs(isEdgeTriggered);
+        workPoolRelease(&handlerPool);
+    }
+    /* A drained server already removed its path, it may belong to a new server by now */
+    if (!isDraining)
+    {
+        close(connSocket);
+        unlink(socketPath);
+    }
+    close(epollFd);
+    loopControlRelease(&loopControl);
+    msgBatchRelease(&inMessages);
+    bufferPoolRelease(&bufferPool);
+    metricsStopAdmin();
+    LOG_INFO("Server is down");
+
+    return EXIT_SUCCESS;
+}
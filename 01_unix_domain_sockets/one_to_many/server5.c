@@ -0,0 +1,745 @@
+/**------------------------------------------------------------------------------------------------
+ * ?                                           ABOUT
+ * @author         :  Nguyen Dinh Hoan
+ * @email          :  hoann.wk@gmail.com
+ * @repo           :  https://github.com/hoan9x/IPC-in-Linux
+ * @createdOn      :  16-Oct-2026
+ * @description    :  This example demonstrates a UNIX domain socket server handling multiple clients
+ *                    using io_uring (multishot accept, multishot recv with a provided buffer ring),
+ *                    it falls back to poll() when the kernel lacks io_uring
+ *------------------------------------------------------------------------------------------------**/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <unistd.h>
+
+#include "../common/conn_table.h"
+#include "../common/frame.h"
+#include "../common/log.h"
+
+/* LOG macro function */
+#define LOG_INFO(format, ...) LOG_AT(LOG_LEVEL_INFO, "[SERVER_INFO] " format, ##__VA_ARGS__)
+#define LOG_ERROR(format, ...) LOG_AT(LOG_LEVEL_ERROR, "[SERVER_ERROR] " format, ##__VA_ARGS__)
+
+#define DEFAULT_SOCKET_PATH "/tmp/ipc-demo.sock"
+#define BUFFER_SIZE 128
+#define MAX_NUMBER_PENDING_CONNECTIONS 128
+
+/* Number of submission queue entries, the completion queue is RING_CQ_ENTRIES to absorb multishot bursts */
+#define RING_SQ_ENTRIES 256
+#define RING_CQ_ENTRIES 4096
+/* Provided buffer ring used by multishot recv, the count must be a power of 2 */
+#define PROVIDED_BUFFER_GROUP_ID 0
+#define PROVIDED_BUFFER_COUNT 1024
+#define PROVIDED_BUFFER_SIZE 2048
+
+#define IF_FAIL_THEN_EXIT(EXP, RELEASE, MSG, ...) ({ if (EXP) { LOG_ERROR(MSG, ##__VA_ARGS__); cleanupAndExitError(RELEASE); } })
+
+/* Flag to enable/disable sending a reply for every message received */
+#define USE_CASE_SEND_REPLY 1
+
+/**
+ * The operation is stored in the high 8 bits of the user_data, the low 56 bits hold the fd,
+ * or for a send the address of its struct ReplyRequest (user space addresses fit in 56 bits).
+ * A recv also carries the generation of its client in bits 32-55: completions still arriving after the client
+ * was closed, or after its fd number was reused by a new client, are recognized and dropped.
+ **/
+enum RingOperation
+{
+    RING_OP_ACCEPT = 1,
+    RING_OP_RECV,
+    RING_OP_SEND,
+    RING_OP_READ_STDIN,
+    RING_OP_CANCEL,
+};
+#define USER_DATA_VALUE_MASK ((UINT64_C(1) << 56) - 1)
+#define MAKE_USER_DATA(OP, VALUE) (((uint64_t)(OP) << 56) | ((uint64_t)(VALUE) & USER_DATA_VALUE_MASK))
+#define USER_DATA_OP(DATA) ((int)((DATA) >> 56))
+#define USER_DATA_VALUE(DATA) ((DATA) & USER_DATA_VALUE_MASK)
+#define GENERATION_MASK ((UINT32_C(1) << 24) - 1)
+#define MAKE_RECV_USER_DATA(FD, GENERATION) \
+    MAKE_USER_DATA(RING_OP_RECV, ((uint64_t)((GENERATION) & GENERATION_MASK) << 32) | (uint32_t)(FD))
+#define USER_DATA_FD(DATA) ((int)(uint32_t)(DATA))
+#define USER_DATA_GENERATION(DATA) ((uint32_t)((DATA) >> 32) & GENERATION_MASK)
+
+/* Userspace view of the rings shared with the kernel */
+struct IoRing
+{
+    int ringFd;
+    unsigned sqMask, sqEntries, cqMask;
+    unsigned *sqHead, *sqTail, *sqArray;
+    unsigned *cqHead, *cqTail;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    /* Local tail of prepared entries and how many of them were not yet passed to the kernel */
+    unsigned sqeTail, sqeToSubmit;
+    void *sqRingPtr, *cqRingPtr;
+    size_t sqRingSize, cqRingSize, sqesSize;
+    /* Provided buffers used by multishot recv */
+    struct io_uring_buf_ring *bufRing;
+    size_t bufRingSize;
+    char *bufBase;
+};
+
+struct IoRing ring = {.ringFd = -1};
+int connSocket = -1;
+/* Per-client state, the data of its table entry */
+struct ClientState
+{
+    struct FrameParser parser;
+    uint32_t generation;    /* tags the recv completions of this client, see MAKE_RECV_USER_DATA() */
+};
+
+/* Clients and their state, indexed by fd */
+struct ConnTable connTable;
+uint32_t nextGeneration = 0;
+static const char replyMessage[] = ">>>>>Server return<<<<<";
+
+/* A reply frame in flight, it must stay allocated until the completion of its send is received */
+struct ReplyRequest
+{
+    int fd;
+    uint32_t length;
+    char data[];    /* frame header and payload */
+};
+
+/* Function to clean up resources and exit */
+void cleanupAndExitError(const char *socketPath)
+{
+    int slot = 0;
+    for (; slot < connTable.numSlots; slot++)
+    {
+        if (connTable.pollFds[slot].fd != -1)
+        {
+            close(connTable.pollFds[slot].fd);
+        }
+    }
+    if (-1 != ring.ringFd)
+    {
+        close(ring.ringFd);
+    }
+    if (-1 != connSocket)
+    {
+        close(connSocket);
+    }
+    if (socketPath)
+    {
+        /* Remove the socket file */
+        unlink(socketPath);
+    }
+
+    exit(EXIT_FAILURE);
+}
+
+/**------------------------------------------------------------------------
+ *                       Minimal io_uring wrappers
+ * There is no dependency on liburing, the rings are mapped from the syscalls
+ *------------------------------------------------------------------------**/
+static int ioUringSetup(unsigned entries, struct io_uring_params *params)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int ioUringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, NULL, 0);
+}
+
+static int ioUringRegister(int fd, unsigned opcode, void *arg, unsigned nrArgs)
+{
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nrArgs);
+}
+
+/* Create the ring and map its queues, return -errno on failure so the caller can fall back to poll() */
+static int ringInit(struct IoRing *ptrRing)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_COOP_TASKRUN;
+    params.cq_entries = RING_CQ_ENTRIES;
+    ptrRing->ringFd = ioUringSetup(RING_SQ_ENTRIES, &params);
+    if (ptrRing->ringFd < 0 && EINVAL == errno)
+    {
+        /* Older kernel without COOP_TASKRUN, retry with the basic setup */
+        memset(&params, 0, sizeof(params));
+        params.flags = IORING_SETUP_CQSIZE;
+        params.cq_entries = RING_CQ_ENTRIES;
+        ptrRing->ringFd = ioUringSetup(RING_SQ_ENTRIES, &params);
+    }
+    if (ptrRing->ringFd < 0)
+        return -errno;
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_NODROP))
+        return -EOPNOTSUPP;
+
+    /* With IORING_FEAT_SINGLE_MMAP, the submission and completion rings share one mapping */
+    ptrRing->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ptrRing->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (ptrRing->cqRingSize > ptrRing->sqRingSize)
+        ptrRing->sqRingSize = ptrRing->cqRingSize;
+    ptrRing->sqRingPtr = mmap(NULL, ptrRing->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                              ptrRing->ringFd, IORING_OFF_SQ_RING);
+    if (MAP_FAILED == ptrRing->sqRingPtr)
+    {
+        ptrRing->sqRingPtr = NULL;
+        return -errno;
+    }
+    ptrRing->cqRingPtr = ptrRing->sqRingPtr;
+
+    ptrRing->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    ptrRing->sqes = mmap(NULL, ptrRing->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         ptrRing->ringFd, IORING_OFF_SQES);
+    if (MAP_FAILED == ptrRing->sqes)
+    {
+        ptrRing->sqes = NULL;
+        return -errno;
+    }
+
+    char *sqBase = ptrRing->sqRingPtr, *cqBase = ptrRing->cqRingPtr;
+    ptrRing->sqHead = (unsigned *)(sqBase + params.sq_off.head);
+    ptrRing->sqTail = (unsigned *)(sqBase + params.sq_off.tail);
+    ptrRing->sqMask = *(unsigned *)(sqBase + params.sq_off.ring_mask);
+    ptrRing->sqEntries = *(unsigned *)(sqBase + params.sq_off.ring_entries);
+    ptrRing->sqArray = (unsigned *)(sqBase + params.sq_off.array);
+    ptrRing->cqHead = (unsigned *)(cqBase + params.cq_off.head);
+    ptrRing->cqTail = (unsigned *)(cqBase + params.cq_off.tail);
+    ptrRing->cqMask = *(unsigned *)(cqBase + params.cq_off.ring_mask);
+    ptrRing->cqes = (struct io_uring_cqe *)(cqBase + params.cq_off.cqes);
+    ptrRing->sqeTail = *ptrRing->sqTail;
+    ptrRing->sqeToSubmit = 0;
+    return 0;
+}
+
+/* Pass the prepared entries to the kernel, and optionally wait for minComplete completions in the same syscall */
+static int ringSubmit(struct IoRing *ptrRing, unsigned minComplete)
+{
+    int ret;
+    __atomic_store_n(ptrRing->sqTail, ptrRing->sqeTail, __ATOMIC_RELEASE);
+    do
+    {
+        ret = ioUringEnter(ptrRing->ringFd, ptrRing->sqeToSubmit, minComplete,
+                           minComplete ? IORING_ENTER_GETEVENTS : 0);
+    } while (ret < 0 && EINTR == errno);
+    if (ret >= 0)
+        ptrRing->sqeToSubmit -= (unsigned)ret;
+    return ret;
+}
+
+/* Get a free submission entry, the pending batch is flushed to the kernel when the queue is full */
+static struct io_uring_sqe *ringGetSqe(struct IoRing *ptrRing)
+{
+    unsigned head = __atomic_load_n(ptrRing->sqHead, __ATOMIC_ACQUIRE);
+    if (ptrRing->sqeTail - head >= ptrRing->sqEntries)
+    {
+        if (ringSubmit(ptrRing, 0) < 0)
+            return NULL;
+        head = __atomic_load_n(ptrRing->sqHead, __ATOMIC_ACQUIRE);
+        if (ptrRing->sqeTail - head >= ptrRing->sqEntries)
+            return NULL;
+    }
+    unsigned index = ptrRing->sqeTail & ptrRing->sqMask;
+    struct io_uring_sqe *sqe = &ptrRing->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    ptrRing->sqArray[index] = index;
+    ptrRing->sqeTail++;
+    ptrRing->sqeToSubmit++;
+    return sqe;
+}
+
+/* Hand a provided buffer back to the kernel so multishot recv can use it again */
+static void ringRecycleBuffer(struct IoRing *ptrRing, unsigned short bufferId)
+{
+    unsigned short tail = ptrRing->bufRing->tail;
+    struct io_uring_buf *buf = &ptrRing->bufRing->bufs[tail & (PROVIDED_BUFFER_COUNT - 1)];
+    buf->addr = (uint64_t)(uintptr_t)(ptrRing->bufBase + (size_t)bufferId * PROVIDED_BUFFER_SIZE);
+    buf->len = PROVIDED_BUFFER_SIZE;
+    buf->bid = bufferId;
+    __atomic_store_n(&ptrRing->bufRing->tail, (unsigned short)(tail + 1), __ATOMIC_RELEASE);
+}
+
+/* Register the provided buffer ring, return -errno when the kernel does not support it */
+static int ringSetupBuffers(struct IoRing *ptrRing)
+{
+    struct io_uring_buf_reg reg;
+    ptrRing->bufRingSize = PROVIDED_BUFFER_COUNT * sizeof(struct io_uring_buf);
+    ptrRing->bufRing = mmap(NULL, ptrRing->bufRingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED == ptrRing->bufRing)
+    {
+        ptrRing->bufRing = NULL;
+        return -errno;
+    }
+    ptrRing->bufBase = mmap(NULL, (size_t)PROVIDED_BUFFER_COUNT * PROVIDED_BUFFER_SIZE, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED == ptrRing->bufBase)
+    {
+        ptrRing->bufBase = NULL;
+        return -errno;
+    }
+
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)ptrRing->bufRing;
+    reg.ring_entries = PROVIDED_BUFFER_COUNT;
+    reg.bgid = PROVIDED_BUFFER_GROUP_ID;
+    if (ioUringRegister(ptrRing->ringFd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+        return -errno;
+
+    ptrRing->bufRing->tail = 0;
+    for (unsigned short bufferId = 0; bufferId < PROVIDED_BUFFER_COUNT; ++bufferId)
+    {
+        ringRecycleBuffer(ptrRing, bufferId);
+    }
+    return 0;
+}
+
+/* Close the ring and unmap whatever was mapped, also after a setup that failed half-way */
+static void ringRelease(struct IoRing *ptrRing)
+{
+    if (-1 != ptrRing->ringFd)
+    {
+        close(ptrRing->ringFd);
+        ptrRing->ringFd = -1;
+    }
+    if (ptrRing->bufBase)
+        munmap(ptrRing->bufBase, (size_t)PROVIDED_BUFFER_COUNT * PROVIDED_BUFFER_SIZE);
+    if (ptrRing->bufRing)
+        munmap(ptrRing->bufRing, ptrRing->bufRingSize);
+    if (ptrRing->sqes)
+        munmap(ptrRing->sqes, ptrRing->sqesSize);
+    if (ptrRing->sqRingPtr)
+        munmap(ptrRing->sqRingPtr, ptrRing->sqRingSize);
+    ptrRing->bufBase = NULL;
+    ptrRing->bufRing = NULL;
+    ptrRing->sqes = NULL;
+    ptrRing->sqRingPtr = ptrRing->cqRingPtr = NULL;
+}
+
+/**------------------------------------------------------------------------
+ *                       Request preparation
+ *------------------------------------------------------------------------**/
+static bool prepareMultishotAccept(int listenFd)
+{
+    struct io_uring_sqe *sqe = ringGetSqe(&ring);
+    if (!sqe)
+        return false;
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listenFd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->user_data = MAKE_USER_DATA(RING_OP_ACCEPT, listenFd);
+    return true;
+}
+
+/* One multishot recv keeps producing completions, each one carrying a buffer picked from the buffer ring */
+static bool prepareMultishotRecv(int fdNum, const struct ClientState *state)
+{
+    struct io_uring_sqe *sqe = ringGetSqe(&ring);
+    if (!sqe)
+        return false;
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fdNum;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = PROVIDED_BUFFER_GROUP_ID;
+    sqe->user_data = MAKE_RECV_USER_DATA(fdNum, state->generation);
+    return true;
+}
+
+/**
+ * Cancel the multishot recv of a client. The request holds its own reference to the socket, closing the fd does
+ * not end it: without the cancel it would keep reading, its completions tagged with the fd number.
+ **/
+static bool prepareCancelRecv(int fdNum, const struct ClientState *state)
+{
+    struct io_uring_sqe *sqe = ringGetSqe(&ring);
+    if (!sqe)
+        return false;
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = MAKE_RECV_USER_DATA(fdNum, state->generation);
+    sqe->user_data = MAKE_USER_DATA(RING_OP_CANCEL, fdNum);
+    return true;
+}
+
+/* Queue a frame to send, the request is released when its completion is received */
+static bool prepareSendFrame(int fdNum, uint16_t type, uint32_t seq, const void *payload, uint32_t length)
+{
+    struct ReplyRequest *request = malloc(sizeof(struct ReplyRequest) + FRAME_HEADER_SIZE + length);
+    if (!request)
+        return false;
+    struct io_uring_sqe *sqe = ringGetSqe(&ring);
+    if (!sqe)
+    {
+        free(request);
+        return false;
+    }
+    struct FrameHeader header = {.length = length, .type = type, .flags = 0, .seq = seq};
+    request->fd = fdNum;
+    request->length = FRAME_HEADER_SIZE + length;
+    memcpy(request->data, &header, FRAME_HEADER_SIZE);
+    memcpy(request->data + FRAME_HEADER_SIZE, payload, length);
+
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = fdNum;
+    sqe->addr = (uint64_t)(uintptr_t)request->data;
+    sqe->len = request->length;
+    /* A big frame must not be cut by a short send, MSG_WAITALL makes io_uring retry until all is sent */
+    sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+    sqe->user_data = MAKE_USER_DATA(RING_OP_SEND, (uintptr_t)request);
+    return true;
+}
+
+/* Add a client to the table with its own frame parser and a new generation, return its state or NULL on failure */
+static struct ClientState *addClient(int fdNum)
+{
+    struct ClientState *state = malloc(sizeof(struct ClientState));
+    if (!state)
+        return NULL;
+    frameParserInit(&state->parser);
+    state->generation = nextGeneration++ & GENERATION_MASK;
+    if (connTableAdd(&connTable, fdNum, POLLIN) < 0)
+    {
+        free(state);
+        return NULL;
+    }
+    connTableSetData(&connTable, fdNum, state);
+    return state;
+}
+
+/**
+ * Release the state of a client, remove it from the table and close it. With io_uring its recv is cancelled, and
+ * the socket is shut down then the prepared entries submitted before the close: the sends still queued for this
+ * fd number resolve to this socket and fail, they never reach a new client that gets the same number.
+ **/
+static void closeClient(int fdNum)
+{
+    struct ClientState *state = connTableGetData(&connTable, fdNum);
+    if (-1 != ring.ringFd)
+    {
+        if (state && !prepareCancelRecv(fdNum, state))
+            LOG_ERROR("Preparing the cancel of the recv of fd[%d] failed, its completions are dropped", fdNum);
+        shutdown(fdNum, SHUT_RDWR);
+        if (ringSubmit(&ring, 0) < 0)
+            LOG_ERROR("Submitting the requests of fd[%d] before closing it failed", fdNum);
+    }
+    if (state)
+    {
+        frameParserRelease(&state->parser);
+        free(state);
+    }
+    connTableRemove(&connTable, fdNum);
+    close(fdNum);
+}
+
+/* Log the complete frames of a client, and queue a reply for each of them. Return -1 on a malformed frame */
+static int handleFrames(int fdNum, struct FrameParser *ptrParser)
+{
+    struct Frame frame;
+    int ret;
+    while ((ret = frameParserNext(ptrParser, &frame)) > 0)
+    {
+        if (FRAME_TYPE_PING == frame.header.type)
+        {
+            /* Benchmark probe, echoed back without logging */
+            if (-1 != ring.ringFd ? !prepareSendFrame(fdNum, FRAME_TYPE_PONG, frame.header.seq, frame.payload, frame.header.length)
+                                  : frameWrite(fdNum, FRAME_TYPE_PONG, frame.header.seq, frame.payload, frame.header.length) < 0)
+                LOG_ERROR("Answering ping of fd[%d] failed", fdNum);
+            continue;
+        }
+        LOG_INFO("Received data from fd[%d] (seq %u): [%.*s]", fdNum, frame.header.seq, (int)frame.header.length, frame.payload);
+#if (USE_CASE_SEND_REPLY)
+        /* The reply is only queued here, it is submitted with the rest of the batch */
+        if (-1 != ring.ringFd)
+        {
+            if (!prepareSendFrame(fdNum, FRAME_TYPE_REPLY, frame.header.seq, replyMessage, sizeof(replyMessage) - 1))
+                LOG_ERROR("Preparing reply to fd[%d] failed", fdNum);
+        }
+        else
+        {
+            frameWrite(fdNum, FRAME_TYPE_REPLY, frame.header.seq, replyMessage, sizeof(replyMessage) - 1);
+        }
+#endif
+    }
+    return ret;
+}
+
+static bool prepareReadStdin(char *buffer)
+{
+    struct io_uring_sqe *sqe = ringGetSqe(&ring);
+    if (!sqe)
+        return false;
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = STDIN_FILENO;
+    sqe->addr = (uint64_t)(uintptr_t)buffer;
+    sqe->len = BUFFER_SIZE;
+    sqe->off = (uint64_t)-1;
+    sqe->user_data = MAKE_USER_DATA(RING_OP_READ_STDIN, STDIN_FILENO);
+    return true;
+}
+
+/**------------------------------------------------------------------------
+ *                 Fallback when io_uring is not available
+ *------------------------------------------------------------------------**/
+static void runPollLoop(const char *socketPath)
+{
+    int ret, i;
+    char buffer[BUFFER_SIZE];
+
+    LOG_INFO("Running the poll() fallback loop");
+    for (;;)
+    {
+        LOG_INFO("##### Waiting on poll()");
+        ret = poll(connTable.pollFds, connTable.numSlots, -1);
+        if (ret < 0 && EINTR == errno)
+            continue;
+        IF_FAIL_THEN_EXIT(ret < 0, socketPath, "poll() return error");
+
+        for (i = 0; i < connTable.numSlots; ++i)
+        {
+            int readyFd = connTable.pollFds[i].fd;
+            if (!(connTable.pollFds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+                continue;
+            if (connSocket == readyFd)
+            {
+                int dataSocket = accept4(connSocket, NULL, NULL, SOCK_CLOEXEC);
+                IF_FAIL_THEN_EXIT(dataSocket < 0, socketPath, "accept() return error");
+                LOG_INFO("Connection established (%d)", dataSocket);
+                if (!addClient(dataSocket))
+                {
+                    LOG_ERROR("Adding fd[%d] to the table failed, closing the connection", dataSocket);
+                    close(dataSocket);
+                }
+            }
+            else if (STDIN_FILENO == readyFd)
+            {
+                ret = read(STDIN_FILENO, buffer, BUFFER_SIZE);
+                if (ret <= 0)
+                    connTableRemove(&connTable, STDIN_FILENO); /* stdin closed, stop monitoring it */
+                else
+                    LOG_INFO("Input read from stdin's fd[0]: [%.*s]", ret, buffer);
+            }
+            else if (frameParserRead(&((struct ClientState *)connTableGetData(&connTable, readyFd))->parser, readyFd) <= 0)
+            {
+                LOG_INFO("Received EOF message from fd[%d]", readyFd);
+                closeClient(readyFd);
+            }
+            else if (handleFrames(readyFd, &((struct ClientState *)connTableGetData(&connTable, readyFd))->parser) < 0)
+            {
+                LOG_ERROR("Malformed frame received from fd[%d], closing the connection", readyFd);
+                closeClient(readyFd);
+            }
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    /* Initialize socket path from application input parameter or default value */
+    const char *socketPath = (argc>1)?argv[1]:DEFAULT_SOCKET_PATH;
+    struct sockaddr_un structSocketInfo;
+    /* Initialize socket info structure */
+    memset(&structSocketInfo, 0, sizeof(struct sockaddr_un));
+    structSocketInfo.sun_family = AF_UNIX;
+    strncpy(structSocketInfo.sun_path, socketPath, sizeof(structSocketInfo.sun_path)-1);
+    int ret;
+    bool isStdinMonitored = true;
+    char stdinBuffer[BUFFER_SIZE];
+
+    /* The poll() fallback answers with writev(), EPIPE from a client that reset must not kill the server */
+    signal(SIGPIPE, SIG_IGN);
+
+    /* Remove the socket if it exists */
+    unlink(socketPath);
+
+    /* Create connection socket (master socket file descriptor) */
+    connSocket = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    IF_FAIL_THEN_EXIT(connSocket < 0, socketPath, "Creating a connection socket failed");
+    LOG_INFO("Connection socket created (%d)", connSocket);
+
+    /* Bind connection socket to path */
+    ret = bind(connSocket, (const struct sockaddr *)&structSocketInfo, sizeof(struct sockaddr_un));
+    IF_FAIL_THEN_EXIT(ret < 0, socketPath, "Bind connection socket to path failed");
+    LOG_INFO("Bind connection socket to path [%s] succeeded", socketPath);
+
+    /**
+     * Listen for incoming connections, the second parameter means that while a request is being processed,
+     * MAX_NUMBER_PENDING_CONNECTIONS requests can wait.
+     **/
+    ret = listen(connSocket, MAX_NUMBER_PENDING_CONNECTIONS);
+    IF_FAIL_THEN_EXIT(ret < 0, socketPath, "Listening on socket failed");
+    LOG_INFO("Listening for incoming connections...");
+
+    connTableInit(&connTable);
+    connTableAdd(&connTable, STDIN_FILENO, POLLIN);
+    ret = connTableAdd(&connTable, connSocket, POLLIN);
+    IF_FAIL_THEN_EXIT(ret < 0, socketPath, "Adding connection socket to the table failed");
+
+    /* Set up io_uring, any missing feature (old kernel, io_uring disabled by sysctl or seccomp) falls back to poll() */
+    ret = ringInit(&ring);
+    if (0 == ret)
+        ret = ringSetupBuffers(&ring);
+    if (ret < 0)
+    {
+        LOG_ERROR("io_uring is not available (%s)", strerror(-ret));
+        ringRelease(&ring);
+        runPollLoop(socketPath);
+    }
+    LOG_INFO("io_uring instance created (%d)", ring.ringFd);
+
+    IF_FAIL_THEN_EXIT(!prepareMultishotAccept(connSocket), socketPath, "Preparing accept request failed");
+    IF_FAIL_THEN_EXIT(!prepareReadStdin(stdinBuffer), socketPath, "Preparing stdin read request failed");
+
+    /* Main server loop */
+    for (;;)
+    {
+        /* Submit everything prepared while handling the previous batch and wait for completions, in one syscall */
+        LOG_INFO("##### Waiting on io_uring_enter()");
+        ret = ringSubmit(&ring, 1);
+        IF_FAIL_THEN_EXIT(ret < 0, socketPath, "io_uring_enter() return error");
+
+        unsigned head = *ring.cqHead;
+        unsigned tail = __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head)
+        {
+            struct io_uring_cqe *cqe = &ring.cqes[head & ring.cqMask];
+            int fdNum = USER_DATA_FD(cqe->user_data);
+            bool hasMore = cqe->flags & IORING_CQE_F_MORE;
+            struct ClientState *state;
+
+            switch (USER_DATA_OP(cqe->user_data))
+            {
+            case RING_OP_ACCEPT:
+                if (cqe->res >= 0)
+                {
+                    LOG_INFO("Connection established (%d)", cqe->res);
+                    state = addClient(cqe->res);
+                    if (!state)
+                    {
+                        LOG_ERROR("Adding fd[%d] to the table failed, closing the connection", cqe->res);
+                        close(cqe->res);
+                    }
+                    else if (!prepareMultishotRecv(cqe->res, state))
+                    {
+                        LOG_ERROR("Preparing recv request for fd[%d] failed, closing the connection", cqe->res);
+                        closeClient(cqe->res);
+                    }
+                }
+                else if (-EINVAL == cqe->res)
+                {
+                    /* Multishot accept is rejected by kernels older than 5.19 */
+                    LOG_ERROR("Multishot accept is not supported");
+                    ringRelease(&ring);
+                    runPollLoop(socketPath);
+                }
+                else
+                {
+                    LOG_ERROR("accept() return error (%s)", strerror(-cqe->res));
+                }
+                /* The multishot request stops on error or overflow, arm it again */
+                if (!hasMore)
+                    IF_FAIL_THEN_EXIT(!prepareMultishotAccept(connSocket), socketPath, "Preparing accept request failed");
+                break;
+
+            case RING_OP_RECV:
+                state = connTableGetData(&connTable, fdNum);
+                if (!state || state->generation != USER_DATA_GENERATION(cqe->user_data))
+                {
+                    /* Left over from a closed client (the cancelled recv ends with -ECANCELED), its buffer is still recycled */
+                    if (cqe->flags & IORING_CQE_F_BUFFER)
+                        ringRecycleBuffer(&ring, cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+                    break;
+                }
+                if (cqe->res > 0)
+                {
+                    unsigned short bufferId = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+                    const char *data = ring.bufBase + (size_t)bufferId * PROVIDED_BUFFER_SIZE;
+                    struct FrameParser *ptrParser = &state->parser;
+                    size_t space;
+                    /* Frames may span several provided buffers, so the data is appended to the parser of the client */
+                    char *ptrWrite = frameParserWritePtr(ptrParser, cqe->res, &space);
+                    if (ptrWrite)
+                    {
+                        memcpy(ptrWrite, data, cqe->res);
+                        frameParserCommit(ptrParser, cqe->res);
+                    }
+                    /* Give the buffer back right away */
+                    ringRecycleBuffer(&ring, bufferId);
+                    if (!ptrWrite || handleFrames(fdNum, ptrParser) < 0)
+                    {
+                        /* The multishot recv is cancelled by closeClient() */
+                        LOG_ERROR("Malformed frame received from fd[%d], closing the connection", fdNum);
+                        closeClient(fdNum);
+                    }
+                    else if (!hasMore && !prepareMultishotRecv(fdNum, state))
+                    {
+                        /* Without a recv armed the client would never be read again, nor closed */
+                        LOG_ERROR("Re-arming recv request for fd[%d] failed, closing the connection", fdNum);
+                        closeClient(fdNum);
+                    }
+                }
+                else if (-ENOBUFS == cqe->res)
+                {
+                    /* All provided buffers are in use, buffers recycled in this batch make room for the new request */
+                    if (!prepareMultishotRecv(fdNum, state))
+                    {
+                        LOG_ERROR("Re-arming recv request for fd[%d] failed, closing the connection", fdNum);
+                        closeClient(fdNum);
+                    }
+                }
+                else
+                {
+                    /* Once the client has closed the socket, the server will received the EOF message */
+                    if (0 == cqe->res)
+                        LOG_INFO("Received EOF message from fd[%d]", fdNum);
+                    else
+                        LOG_ERROR("recv() fd[%d] return error (%s), closing the connection", fdNum, strerror(-cqe->res));
+                    closeClient(fdNum);
+                }
+                break;
+
+            case RING_OP_SEND:
+            {
+                struct ReplyRequest *request = (struct ReplyRequest *)(uintptr_t)USER_DATA_VALUE(cqe->user_data);
+                if (cqe->res < 0 && -EPIPE != cqe->res && -ECONNRESET != cqe->res && -EBADF != cqe->res)
+                    LOG_ERROR("Sending reply to fd[%d] failed (%s)", request->fd, strerror(-cqe->res));
+                free(request);
+                break;
+            }
+
+            case RING_OP_READ_STDIN:
+                if (cqe->res <= 0)
+                {
+                    /* stdin is closed, stop monitoring it */
+                    isStdinMonitored = false;
+                    LOG_INFO("stdin closed, stop monitoring it");
+                    break;
+                }
+                LOG_INFO("Input read from stdin's fd[0]: [%.*s]", cqe->res, stdinBuffer);
+                if (isStdinMonitored)
+                    prepareReadStdin(stdinBuffer);
+                break;
+
+            default:
+                break;
+            }
+        }
+        __atomic_store_n(ring.cqHead, head, __ATOMIC_RELEASE);
+    }
+
+    /* Perform clean up */
+    ringRelease(&ring);
+    close(connSocket);
+    unlink(socketPath);
+    LOG_INFO("Server is down");
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,799 @@
+/**------------------------------------------------------------------------------------------------
+ * ?                                           ABOUT
+ * @author         :  Nguyen Dinh Hoan
+ * @email          :  hoann.wk@gmail.com
+ * @repo           :  https://github.com/hoan9x/IPC-in-Linux
+ * @createdOn      :  16-Oct-2026
+ * @description    :  This example demonstrates a UNIX domain socket server handling multiple clients
+ *                    with N worker threads, each one running its own epoll() loop over its own clients
+ *------------------------------------------------------------------------------------------------**/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../common/frame.h"
+#include "../common/batch_io.h"
+#include "../common/buffer_pool.h"
+#include "../common/accept_batch.h"
+#include "../common/metrics.h"
+#include "../common/loop_control.h"
+#include "../common/log.h"
+
+/* LOG macro function */
+#define LOG_INFO(format, ...) LOG_AT(LOG_LEVEL_INFO, "[SERVER_INFO] " format, ##__VA_ARGS__)
+#define LOG_ERROR(format, ...) LOG_AT(LOG_LEVEL_ERROR, "[SERVER_ERROR] " format, ##__VA_ARGS__)
+
+#define DEFAULT_SOCKET_PATH "/tmp/ipc-demo.sock"
+#define BUFFER_SIZE 128
+/* Maximum number of ready events returned by one epoll_wait() call */
+#define MAX_EVENTS_PER_WAIT 256
+/* Value written to a handoff pipe to ask the worker to stop */
+#define HANDOFF_STOP -1
+
+#define IF_FAIL_THEN_EXIT(EXP, RELEASE, MSG, ...) ({ if (EXP) { LOG_ERROR(MSG, ##__VA_ARGS__); cleanupAndExitError(RELEASE); } })
+
+/* How the acceptor picks the worker of a new connection */
+enum BalancePolicy
+{
+    BALANCE_ROUND_ROBIN,
+    BALANCE_LEAST_LOADED,
+};
+
+/**
+ * Counters of one worker. Only the worker writes them (except activeConns, also incremented by the acceptor),
+ * they are read by the main thread to print the statistics, so relaxed atomics are enough.
+ **/
+struct WorkerStats
+{
+    atomic_long activeConns;
+    atomic_long acceptedConns;
+    atomic_long closedConns;
+    atomic_long frames;
+    atomic_long bytesRead;
+    atomic_long wakeups;
+};
+
+/* Aligned on a cache line so that workers never write to the same line */
+struct Worker
+{
+    int id;
+    int cpu;                /* CPU the worker is pinned to, -1 if not pinned */
+    pthread_t thread;
+    int epollFd;
+    int handoffPipe[2];     /* the acceptor writes accepted fds to [1], the worker reads them from [0] */
+    struct WorkerStats stats;
+    /* Owned by the worker thread, a buffer pool is not shared between loops */
+    struct BufferPool bufferPool;
+    struct OutBatch replies;
+    struct OutQueueStats outputStats;
+} __attribute__((aligned(64)));
+
+/* Per-client state, registered as the epoll data so a ready event leads straight to it */
+struct ClientConn
+{
+    int fd;
+    struct FrameParser parser;
+    struct OutQueue output;     /* pongs the socket did not take yet, chunks borrowed from the worker's pool */
+    uint32_t events;            /* epoll events currently registered */
+    struct ConnMetrics metrics; /* listed on the admin socket while the connection is open */
+};
+
+struct Worker *workers = NULL;
+int numWorkers = 0;
+int connSocket = -1;
+/* Pending connections are accepted in batches, the connection socket is not monitored while accepting is paused */
+struct AcceptBatch acceptBatch;
+bool isAcceptPaused = false;
+
+/**
+ * Signals are blocked in every thread and read by the acceptor from a signalfd, workers post their requests
+ * to its eventfd: both are in the epoll set of the acceptor, no flag is checked between two system calls.
+ * SIGINT and SIGTERM drain the server: no more connections, the workers keep serving their clients until they
+ * leave or drainMs after; a second SIGINT or SIGQUIT stops it at once.
+ **/
+struct LoopControl loopControl;
+const struct LoopSignal controlSignals[] = {
+    {SIGINT, LOOP_REQUEST_DRAIN},
+    {SIGTERM, LOOP_REQUEST_DRAIN},
+    {SIGQUIT, LOOP_REQUEST_STOP},
+    {SIGUSR1, LOOP_REQUEST_STATS},
+};
+atomic_bool isDraining = false;
+int drainMs = LOOP_CONTROL_DEFAULT_DRAIN_MS;
+/* A client whose queued pongs pass highWater is not read until they drop to lowWater */
+size_t highWater = OUT_QUEUE_DEFAULT_HIGH_WATER, lowWater = OUT_QUEUE_DEFAULT_LOW_WATER;
+
+static long long nowMs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/* Function to clean up resources and exit */
+void cleanupAndExitError(const char *socketPath)
+{
+    /* Client sockets are owned by the workers, they are released by the kernel on exit */
+    if (-1 != connSocket)
+    {
+        close(connSocket);
+    }
+    if (socketPath)
+    {
+        /* Remove the socket file */
+        unlink(socketPath);
+    }
+    metricsStopAdmin();
+
+    exit(EXIT_FAILURE);
+}
+
+/* Raise the soft limit of open files up to the hard limit, so tens of thousands of clients can connect */
+static void raiseFileLimit()
+{
+    struct rlimit limit;
+    if (0 == getrlimit(RLIMIT_NOFILE, &limit) && limit.rlim_cur < limit.rlim_max)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        if (0 == setrlimit(RLIMIT_NOFILE, &limit))
+        {
+            LOG_INFO("Open file limit raised to %llu", (unsigned long long)limit.rlim_cur);
+        }
+    }
+}
+
+static void printWorkerStats()
+{
+    long totalActive = 0, totalFrames = 0;
+    for (int i = 0; i < numWorkers; ++i)
+    {
+        struct WorkerStats *stats = &workers[i].stats;
+        long active = atomic_load_explicit(&stats->activeConns, memory_order_relaxed);
+        long frames = atomic_load_explicit(&stats->frames, memory_order_relaxed);
+        LOG_INFO("worker[%d] cpu[%d] active=%ld accepted=%ld closed=%ld frames=%ld bytes=%ld wakeups=%ld",
+                 workers[i].id, workers[i].cpu, active,
+                 atomic_load_explicit(&stats->acceptedConns, memory_order_relaxed),
+                 atomic_load_explicit(&stats->closedConns, memory_order_relaxed), frames,
+                 atomic_load_explicit(&stats->bytesRead, memory_order_relaxed),
+                 atomic_load_explicit(&stats->wakeups, memory_order_relaxed));
+        totalActive += active;
+        totalFrames += frames;
+    }
+    LOG_INFO("total: workers=%d active=%ld frames=%ld", numWorkers, totalActive, totalFrames);
+    char statsBuffer[256];
+    acceptStatsFormat(&acceptBatch, statsBuffer, sizeof(statsBuffer));
+    LOG_INFO("accept: %s", statsBuffer);
+    loopControlStatsFormat(&loopControl, statsBuffer, sizeof(statsBuffer));
+    LOG_INFO("control: %s%s", statsBuffer, atomic_load(&isDraining) ? ", draining" : "");
+}
+
+static long countActiveConns()
+{
+    long total = 0;
+    for (int i = 0; i < numWorkers; ++i)
+        total += atomic_load_explicit(&workers[i].stats.activeConns, memory_order_relaxed);
+    return total;
+}
+
+/**------------------------------------------------------------------------
+ *                               Worker side
+ *------------------------------------------------------------------------**/
+static void closeClient(struct Worker *worker, struct ClientConn *conn)
+{
+    metricsConnClose(&conn->metrics);
+    metricsAdd(METRIC_SYSCALL_CTL, 1);
+    epoll_ctl(worker->epollFd, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+    frameParserRelease(&conn->parser);
+    outQueueRelease(&conn->output);
+    free(conn);
+    atomic_fetch_sub_explicit(&worker->stats.activeConns, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&worker->stats.closedConns, 1, memory_order_relaxed);
+    /* The draining acceptor counts the clients left each time one leaves */
+    if (atomic_load_explicit(&isDraining, memory_order_relaxed))
+        loopControlPost(&loopControl, LOOP_REQUEST_WAKEUP);
+}
+
+/* Take ownership of a connection handed over by the acceptor */
+static void adoptClient(struct Worker *worker, int dataSocket)
+{
+    struct epoll_event event = {0};
+    struct ClientConn *conn = malloc(sizeof(struct ClientConn));
+    if (conn)
+    {
+        conn->fd = dataSocket;
+        frameParserInit(&conn->parser);
+        outQueueInit(&conn->output, &worker->bufferPool, &worker->outputStats);
+        event.events = EPOLLIN | EPOLLRDHUP;
+        conn->events = event.events;
+        event.data.ptr = conn;
+        metricsAdd(METRIC_SYSCALL_CTL, 1);
+        if (0 == epoll_ctl(worker->epollFd, EPOLL_CTL_ADD, dataSocket, &event))
+        {
+            metricsConnOpen(&conn->metrics, dataSocket);
+            atomic_fetch_add_explicit(&worker->stats.acceptedConns, 1, memory_order_relaxed);
+            LOG_INFO("worker[%d] Connection established (%d)", worker->id, dataSocket);
+            return;
+        }
+        free(conn);
+    }
+    LOG_ERROR("worker[%d] Adding fd[%d] failed, closing the connection", worker->id, dataSocket);
+    close(dataSocket);
+    atomic_fetch_sub_explicit(&worker->stats.activeConns, 1, memory_order_relaxed);
+}
+
+/* Read the fds written by the acceptor, return false when asked to stop */
+static bool readHandoffPipe(struct Worker *worker)
+{
+    int fds[64];
+    ssize_t ret;
+    while ((ret = read(worker->handoffPipe[0], fds, sizeof(fds))) > 0)
+    {
+        metricsAdd(METRIC_SYSCALL_READ, 1);
+        /* Each fd is written as one int, smaller than PIPE_BUF, so it is never split */
+        for (ssize_t i = 0; i < ret / (ssize_t)sizeof(int); ++i)
+        {
+            if (HANDOFF_STOP == fds[i])
+                return false;
+            adoptClient(worker, fds[i]);
+        }
+    }
+    return true;
+}
+
+/* Watch EPOLLOUT while pongs are queued, stop reading a client past the high watermark until it drains */
+static int updateClientEvents(struct Worker *worker, struct ClientConn *conn)
+{
+    short wanted = outQueueEvents(&conn->output, highWater, lowWater);
+    struct epoll_event event = {0};
+    event.events = ((wanted & POLLIN) ? EPOLLIN | EPOLLRDHUP : 0) | ((wanted & POLLOUT) ? EPOLLOUT : 0);
+    if (event.events == conn->events)
+        return 0;
+    event.data.ptr = conn;
+    conn->events = event.events;
+    metricsAdd(METRIC_SYSCALL_CTL, 1);
+    return epoll_ctl(worker->epollFd, EPOLL_CTL_MOD, conn->fd, &event);
+}
+
+/* Write the queued pongs of a writable client, return -1 if it failed and the client was closed */
+static int flushClient(struct Worker *worker, struct ClientConn *conn)
+{
+    metricsAdd(METRIC_SYSCALL_WRITE, 1);
+    if (outQueueFlush(&conn->output, conn->fd) < 0 || updateClientEvents(worker, conn) < 0)
+    {
+        LOG_ERROR("worker[%d] Sending queued pongs to fd[%d] failed, closing the connection", worker->id, conn->fd);
+        closeClient(worker, conn);
+        return -1;
+    }
+    return 0;
+}
+
+static void readClient(struct Worker *worker, struct ClientConn *conn)
+{
+    struct OutBatch *replies = &worker->replies;
+    struct Frame frame;
+    ssize_t ret = frameParserRead(&conn->parser, conn->fd);
+    metricsAdd(METRIC_SYSCALL_READ, 1);
+    if (ret < 0)
+    {
+        if (EAGAIN == errno || EINTR == errno)
+            return;
+        LOG_ERROR("worker[%d] read() fd[%d] return error, closing the connection", worker->id, conn->fd);
+        closeClient(worker, conn);
+        return;
+    }
+    else if (/*EOF*/0 == ret)
+    {
+        /* Once the client has closed the socket, the server will received the EOF message */
+        LOG_INFO("worker[%d] Received EOF message from fd[%d]", worker->id, conn->fd);
+        closeClient(worker, conn);
+        return;
+    }
+    atomic_fetch_add_explicit(&worker->stats.bytesRead, ret, memory_order_relaxed);
+    metricsConnIn(&conn->metrics, 0, (uint64_t)ret);
+
+    /* One read() may carry several frames, or only a part of one which stays in the parser */
+    replies->queue = &conn->output;
+    while ((ret = frameParserNext(&conn->parser, &frame)) > 0)
+    {
+        atomic_fetch_add_explicit(&worker->stats.frames, 1, memory_order_relaxed);
+        metricsConnIn(&conn->metrics, 1, 0);
+        if (FRAME_TYPE_PING == frame.header.type)
+        {
+            /* Benchmark probe, echoed back without logging, the payload stays in the parser until the flush */
+            if (outBatchQueue(replies, conn->fd, FRAME_TYPE_PONG, frame.header.seq, frame.payload, frame.header.length) < 0)
+                break;
+            continue;
+        }
+        LOG_INFO("worker[%d] Received data from fd[%d] (seq %u): [%.*s]", worker->id, conn->fd,
+                 frame.header.seq, (int)frame.header.length, frame.payload);
+    }
+    if (ret < 0)
+    {
+        LOG_ERROR("worker[%d] Malformed frame received from fd[%d], closing the connection", worker->id, conn->fd);
+        replies->count = 0;
+        replies->bytes = 0;
+        closeClient(worker, conn);
+        return;
+    }
+    if (replies->count > 0)
+    {
+        metricsConnOut(&conn->metrics, (uint64_t)replies->count, replies->bytes);
+        metricsAdd(METRIC_SYSCALL_WRITE, 1);
+    }
+    /* What the socket does not take waits in the output queue, the next read() may reuse the parser buffer */
+    if (ret > 0 || outBatchFlush(replies, conn->fd) < 0 || updateClientEvents(worker, conn) < 0)
+    {
+        LOG_ERROR("worker[%d] Answering ping of fd[%d] failed, closing the connection", worker->id, conn->fd);
+        replies->count = 0;
+        replies->bytes = 0;
+        closeClient(worker, conn);
+    }
+}
+
+static void *workerMain(void *arg)
+{
+    struct Worker *worker = arg;
+    struct epoll_event readyEvents[MAX_EVENTS_PER_WAIT];
+    bool isRunning = true;
+    char name[METRICS_THREAD_NAME_MAX];
+
+    snprintf(name, sizeof(name), "worker-%d", worker->id);
+    metricsRegisterThread(name);
+    if (worker->cpu >= 0)
+    {
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        CPU_SET(worker->cpu, &cpuSet);
+        if (0 != pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet))
+        {
+            LOG_ERROR("worker[%d] Pinning to cpu[%d] failed", worker->id, worker->cpu);
+            worker->cpu = -1;
+        }
+    }
+
+    while (isRunning)
+    {
+        int ret = epoll_wait(worker->epollFd, readyEvents, MAX_EVENTS_PER_WAIT, -1);
+        metricsAdd(METRIC_SYSCALL_WAIT, 1);
+        if (ret < 0)
+        {
+            if (EINTR == errno)
+                continue;
+            /* The server can not run without this worker, the acceptor is asked to stop */
+            LOG_ERROR("worker[%d] epoll_wait() return error", worker->id);
+            loopControlPost(&loopControl, LOOP_REQUEST_STOP);
+            break;
+        }
+        atomic_fetch_add_explicit(&worker->stats.wakeups, 1, memory_order_relaxed);
+        uint64_t wakeupNs = metricsNow();
+
+        for (int i = 0; i < ret; ++i)
+        {
+            struct ClientConn *conn = readyEvents[i].data.ptr;
+            if (NULL == conn)
+            {
+                isRunning = readHandoffPipe(worker) && isRunning;
+                continue;
+            }
+            /* The client can take its queued pongs again, the flush closes it if it is gone */
+            if ((readyEvents[i].events & EPOLLOUT) && flushClient(worker, conn) < 0)
+                continue;
+            if (readyEvents[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+                readClient(worker, conn);
+        }
+        metricsLoopDone(wakeupNs, ret);
+    }
+    return NULL;
+}
+
+/**------------------------------------------------------------------------
+ *                              Acceptor side
+ *------------------------------------------------------------------------**/
+static struct Worker *pickWorker(enum BalancePolicy policy)
+{
+    static int nextWorker = 0;
+    if (BALANCE_ROUND_ROBIN == policy)
+    {
+        struct Worker *worker = &workers[nextWorker];
+        nextWorker = (nextWorker + 1) % numWorkers;
+        return worker;
+    }
+
+    /* Least loaded, start the scan after the last pick so that ties are spread over the workers */
+    struct Worker *best = NULL;
+    long bestLoad = 0;
+    for (int n = 0; n < numWorkers; ++n)
+    {
+        struct Worker *worker = &workers[(nextWorker + n) % numWorkers];
+        long load = atomic_load_explicit(&worker->stats.activeConns, memory_order_relaxed);
+        if (!best || load < bestLoad)
+        {
+            best = worker;
+            bestLoad = load;
+        }
+    }
+    nextWorker = (best->id + 1) % numWorkers;
+    return best;
+}
+
+/**
+ * Accept every pending connection the rate limit allows and hand each one to a worker. When accepting is
+ * paused the connection socket is taken out of the epoll set of the acceptor, the connections wait in the
+ * backlog until the main loop monitors it again.
+ **/
+static void acceptClients(const char *socketPath, int epollFd, enum BalancePolicy policy)
+{
+    int numAccepted;
+    unsigned long long acceptCalls;
+    do
+    {
+        acceptCalls = acceptBatch.stats.acceptCalls;
+        numAccepted = acceptBatchRun(&acceptBatch, connSocket);
+        metricsAdd(METRIC_SYSCALL_ACCEPT, acceptBatch.stats.acceptCalls - acceptCalls);
+        IF_FAIL_THEN_EXIT(numAccepted < 0, socketPath, "accept() return error");
+        for (int i = 0; i < numAccepted; ++i)
+        {
+            int dataSocket = acceptBatch.fds[i];
+            struct Worker *worker = pickWorker(policy);
+            /* Counted before the handoff, so the least loaded policy sees the connections not yet adopted */
+            atomic_fetch_add_explicit(&worker->stats.activeConns, 1, memory_order_relaxed);
+            metricsAdd(METRIC_SYSCALL_WRITE, 1);
+            if (write(worker->handoffPipe[1], &dataSocket, sizeof(int)) != sizeof(int))
+            {
+                LOG_ERROR("Handing fd[%d] to worker[%d] failed, closing the connection", dataSocket, worker->id);
+                atomic_fetch_sub_explicit(&worker->stats.activeConns, 1, memory_order_relaxed);
+                close(dataSocket);
+            }
+        }
+    } while (!acceptBatch.isDrained && acceptBatchDelayMs(&acceptBatch) < 0);
+    if (!acceptBatch.isDrained)
+    {
+        LOG_INFO("Accepting paused, pending connections wait in the backlog");
+        metricsAdd(METRIC_ACCEPT_PAUSES, 1);
+        metricsAdd(METRIC_SYSCALL_CTL, 1);
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, connSocket, NULL);
+        isAcceptPaused = true;
+    }
+}
+
+/* Start the workers, pinned to the CPUs allowed for the process in turn if isPinned is set */
+static void startWorkers(const char *socketPath, bool isPinned)
+{
+    cpu_set_t allowedCpus;
+    int allowedCount = 0, cpuList[CPU_SETSIZE];
+    if (isPinned && 0 == sched_getaffinity(0, sizeof(allowedCpus), &allowedCpus))
+    {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        {
+            if (CPU_ISSET(cpu, &allowedCpus))
+                cpuList[allowedCount++] = cpu;
+        }
+    }
+
+    workers = aligned_alloc(64, numWorkers * sizeof(struct Worker));
+    IF_FAIL_THEN_EXIT(NULL == workers, socketPath, "Allocating workers failed");
+    memset(workers, 0, numWorkers * sizeof(struct Worker));
+    for (int i = 0; i < numWorkers; ++i)
+    {
+        struct Worker *worker = &workers[i];
+        struct epoll_event event = {0};
+        worker->id = i;
+        worker->cpu = allowedCount ? cpuList[i % allowedCount] : -1;
+        bufferPoolInit(&worker->bufferPool);
+        outBatchInit(&worker->replies, NULL);
+
+        worker->epollFd = epoll_create1(EPOLL_CLOEXEC);
+        IF_FAIL_THEN_EXIT(worker->epollFd < 0, socketPath, "Creating the epoll instance of worker[%d] failed", i);
+        IF_FAIL_THEN_EXIT(pipe2(worker->handoffPipe, O_NONBLOCK | O_CLOEXEC) < 0, socketPath,
+                          "Creating the handoff pipe of worker[%d] failed", i);
+        /* The handoff pipe is registered with NULL data, client connections always have a non-NULL pointer */
+        event.events = EPOLLIN;
+        event.data.ptr = NULL;
+        IF_FAIL_THEN_EXIT(epoll_ctl(worker->epollFd, EPOLL_CTL_ADD, worker->handoffPipe[0], &event) < 0, socketPath,
+                          "Adding the handoff pipe of worker[%d] failed", i);
+        IF_FAIL_THEN_EXIT(0 != pthread_create(&worker->thread, NULL, workerMain, worker), socketPath,
+                          "Creating worker[%d] thread failed", i);
+    }
+}
+
+static void stopWorkers()
+{
+    int stop = HANDOFF_STOP;
+    for (int i = 0; i < numWorkers; ++i)
+    {
+        if (write(workers[i].handoffPipe[1], &stop, sizeof(int)) != sizeof(int))
+            LOG_ERROR("Asking worker[%d] to stop failed", i);
+    }
+    for (int i = 0; i < numWorkers; ++i)
+    {
+        pthread_join(workers[i].thread, NULL);
+        close(workers[i].epollFd);
+        close(workers[i].handoffPipe[0]);
+        close(workers[i].handoffPipe[1]);
+        bufferPoolRelease(&workers[i].bufferPool);
+    }
+}
+
+/* Stop accepting: the connection socket is closed and its path removed, a new server can bind it at once */
+static void startDrain(const char *socketPath, int epollFd)
+{
+    LOG_INFO("Draining: no more connections, waiting up to %d ms for %ld clients to leave", drainMs, countActiveConns());
+    atomic_store(&isDraining, true);
+    if (!isAcceptPaused)
+    {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, connSocket, NULL);
+    }
+    isAcceptPaused = false;
+    close(connSocket);
+    connSocket = -1;
+    unlink(socketPath);
+}
+
+static void printUsage(const char *appName)
+{
+    printf("Usage: %s [-n workers] [-b rr|ll] [-p] [-q high[:low]] [-B backlog] [-A rate[:burst]] [-g drain_ms] [socket_path]\n", appName);
+    printf("  -n  Number of worker threads (default: number of online CPUs)\n");
+    printf("  -b  Balance new connections round-robin (rr, default) or to the least loaded worker (ll)\n");
+    printf("  -p  Pin each worker thread to its own CPU\n");
+    printf("  -q  Watermarks of the pong queues in bytes: a client is not read while more than high bytes of\n");
+    printf("      pongs wait for it, until they drop to low (default %d:%d)\n", OUT_QUEUE_DEFAULT_HIGH_WATER, OUT_QUEUE_DEFAULT_LOW_WATER);
+    printf("  -B  Connections waiting in the listen() backlog, 0 (default) for net.core.somaxconn\n");
+    printf("  -A  Accept at most rate connections per second, in bursts of up to burst (default no limit)\n");
+    printf("  -g  On SIGINT or SIGTERM, give the clients drain_ms milliseconds to leave (default %d)\n", LOOP_CONTROL_DEFAULT_DRAIN_MS);
+    printf("Type any line on stdin or send SIGUSR1 to print the per-worker statistics, a second SIGINT or SIGQUIT stops a drain\n");
+}
+
+int main(int argc, char *argv[])
+{
+    enum BalancePolicy policy = BALANCE_ROUND_ROBIN;
+    bool isPinned = false;
+    int opt, backlog = ACCEPT_DEFAULT_BACKLOG, acceptDelayMs;
+    double acceptRate = 0, acceptBurst = 0;
+    numWorkers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    while (-1 != (opt = getopt(argc, argv, "n:b:pq:B:A:g:h")))
+    {
+        switch (opt)
+        {
+            case 'n': numWorkers = atoi(optarg); break;
+            case 'b': policy = (0 == strcmp(optarg, "ll")) ? BALANCE_LEAST_LOADED : BALANCE_ROUND_ROBIN; break;
+            case 'p': isPinned = true; break;
+            case 'q':
+                if (outQueueParseWatermarks(optarg, &highWater, &lowWater) < 0)
+                {
+                    printUsage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'B':
+                if (acceptParseBacklog(optarg, &backlog) < 0)
+                {
+                    printUsage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'A':
+                if (acceptParseRate(optarg, &acceptRate, &acceptBurst) < 0)
+                {
+                    printUsage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'g':
+                drainMs = atoi(optarg);
+                if (drainMs < 0)
+                {
+                    printUsage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            default: printUsage(argv[0]); return (opt == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if (numWorkers < 1)
+        numWorkers = 1;
+
+    /* Initialize socket path from application input parameter or default value */
+    const char *socketPath = (argc>optind)?argv[optind]:DEFAULT_SOCKET_PATH;
+    struct sockaddr_un structSocketInfo;
+    /* Initialize socket info structure */
+    memset(&structSocketInfo, 0, sizeof(struct sockaddr_un));
+    structSocketInfo.sun_family = AF_UNIX;
+    strncpy(structSocketInfo.sun_path, socketPath, sizeof(structSocketInfo.sun_path)-1);
+    struct epoll_event event = {0}, readyEvents[4];
+    int epollFd, ret, i, waitMs;
+    unsigned requests;
+    long long drainDeadlineMs = 0, remainingMs;
+    bool isStopping = false;
+    char buffer[BUFFER_SIZE];
+    char adminPath[sizeof(structSocketInfo.sun_path) + sizeof(METRICS_ADMIN_SUFFIX)];
+
+    /**
+     * Workers and the log writer inherit the signal mask, the signals are blocked before any thread starts
+     * so that none of them takes a signal the acceptor would never see
+     **/
+    if (loopControlInit(&loopControl, controlSignals, sizeof(controlSignals) / sizeof(controlSignals[0])) < 0)
+    {
+        LOG_ERROR("Creating the signalfd and eventfd failed");
+        return EXIT_FAILURE;
+    }
+    /* The disposition is process-wide, a worker writing to a client that reset gets EPIPE */
+    signal(SIGPIPE, SIG_IGN);
+    raiseFileLimit();
+    acceptBatchInit(&acceptBatch, SOCK_NONBLOCK | SOCK_CLOEXEC, acceptRate, acceptBurst);
+    /* Remove the socket if it exists */
+    unlink(socketPath);
+
+    /* Create connection socket (master socket file descriptor), non-blocking so accept() can be drained */
+    connSocket = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    IF_FAIL_THEN_EXIT(connSocket < 0, socketPath, "Creating a connection socket failed");
+    LOG_INFO("Connection socket created (%d)", connSocket);
+
+    /* Bind connection socket to path */
+    ret = bind(connSocket, (const struct sockaddr *)&structSocketInfo, sizeof(struct sockaddr_un));
+    IF_FAIL_THEN_EXIT(ret < 0, socketPath, "Bind connection socket to path failed");
+    LOG_INFO("Bind connection socket to path [%s] succeeded", socketPath);
+
+    /**
+     * Listen for incoming connections, up to backlog connections wait to be accepted: a deep backlog lets a
+     * storm of reconnecting clients queue instead of failing.
+     **/
+    ret = acceptListen(connSocket, backlog);
+    IF_FAIL_THEN_EXIT(ret < 0, socketPath, "Listening on socket failed");
+    LOG_INFO("Listening for incoming connections (backlog %d)...", ret);
+
+    startWorkers(socketPath, isPinned);
+    LOG_INFO("%d workers started, balancing %s%s", numWorkers,
+             BALANCE_ROUND_ROBIN == policy ? "round-robin" : "to the least loaded worker",
+             isPinned ? ", pinned to CPUs" : "");
+
+    LOG_INFO("Press Ctrl+C to drain and stop the server, type a line to print the statistics");
+
+    /* The acceptor thread only watches the connection socket, stdin and the control fds */
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    IF_FAIL_THEN_EXIT(epollFd < 0, socketPath, "Creating an epoll instance failed");
+    event.events = EPOLLIN;
+    event.data.fd = connSocket;
+    ret = epoll_ctl(epollFd, EPOLL_CTL_ADD, connSocket, &event);
+    IF_FAIL_THEN_EXIT(ret < 0, socketPath, "Adding connection socket to epoll failed");
+    event.data.fd = STDIN_FILENO;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, STDIN_FILENO, &event) < 0)
+    {
+        LOG_INFO("stdin can not be monitored by epoll (errno %d), ignoring it", errno);
+    }
+    event.data.fd = loopControl.signalFd;
+    ret = epoll_ctl(epollFd, EPOLL_CTL_ADD, loopControl.signalFd, &event);
+    event.data.fd = loopControl.eventFd;
+    IF_FAIL_THEN_EXIT(ret < 0 || epoll_ctl(epollFd, EPOLL_CTL_ADD, loopControl.eventFd, &event) < 0, socketPath,
+                      "Adding the control fds to epoll failed");
+
+    /* Each worker counts into its own block, the admin thread adds them up when it is scraped */
+    metricsRegisterThread("acceptor");
+    snprintf(adminPath, sizeof(adminPath), "%s" METRICS_ADMIN_SUFFIX, socketPath);
+    if (metricsStartAdmin(adminPath) < 0)
+    {
+        LOG_ERROR("Serving the metrics on [%s] failed, running without them", adminPath);
+    }
+    else
+    {
+        LOG_INFO("Metrics served on [%s]", adminPath);
+    }
+
+    /* Main acceptor loop */
+    while (!isStopping)
+    {
+        /* A paused connection socket is monitored again once the rate limit or the descriptors allow it */
+        acceptDelayMs = isAcceptPaused ? acceptBatchDelayMs(&acceptBatch) : -1;
+        if (isAcceptPaused && acceptDelayMs < 0)
+        {
+            event.events = EPOLLIN;
+            event.data.fd = connSocket;
+            metricsAdd(METRIC_SYSCALL_CTL, 1);
+            IF_FAIL_THEN_EXIT(epoll_ctl(epollFd, EPOLL_CTL_ADD, connSocket, &event) < 0, socketPath,
+                              "Monitoring the connection socket again failed");
+            isAcceptPaused = false;
+        }
+        waitMs = acceptDelayMs;
+        if (isDraining)
+        {
+            /* Connections are no longer accepted, the wait ends at the drain deadline */
+            remainingMs = drainDeadlineMs - nowMs();
+            waitMs = (remainingMs > 0) ? (int)remainingMs : 0;
+        }
+        ret = epoll_wait(epollFd, readyEvents, 4, waitMs);
+        metricsAdd(METRIC_SYSCALL_WAIT, 1);
+        if (ret < 0)
+        {
+            if (EINTR == errno)
+                continue;
+            LOG_ERROR("epoll_wait() return error");
+            cleanupAndExitError(socketPath);
+        }
+        uint64_t wakeupNs = metricsNow();
+
+        requests = 0;
+        for (i = 0; i < ret; ++i)
+        {
+            if (loopControl.signalFd == readyEvents[i].data.fd || loopControl.eventFd == readyEvents[i].data.fd)
+            {
+                requests |= loopControlTake(&loopControl);
+            }
+            else if (connSocket == readyEvents[i].data.fd)
+            {
+                acceptClients(socketPath, epollFd, policy);
+            }
+            else
+            {
+                /* Input from console stdin */
+                int numRead = read(STDIN_FILENO, buffer, BUFFER_SIZE);
+                if (numRead <= 0)
+                {
+                    /* stdin is closed, stop monitoring it otherwise it is reported ready forever */
+                    epoll_ctl(epollFd, EPOLL_CTL_DEL, STDIN_FILENO, NULL);
+                    continue;
+                }
+                LOG_INFO("Input read from stdin's fd[0]: [%.*s]", numRead, buffer);
+                printWorkerStats();
+            }
+        }
+        metricsLoopDone(wakeupNs, ret);
+
+        if (requests & LOOP_REQUEST_STATS)
+        {
+            printWorkerStats();
+        }
+        if ((requests & LOOP_REQUEST_STOP) || ((requests & LOOP_REQUEST_DRAIN) && isDraining))
+        {
+            isStopping = true;
+        }
+        else if (requests & LOOP_REQUEST_DRAIN)
+        {
+            startDrain(socketPath, epollFd);
+            drainDeadlineMs = nowMs() + drainMs;
+        }
+        if (isDraining && 0 == countActiveConns())
+        {
+            LOG_INFO("Drain complete, every client is gone");
+            isStopping = true;
+        }
+        else if (isDraining && nowMs() >= drainDeadlineMs)
+        {
+            LOG_ERROR("Drain deadline passed, %ld clients still connected", countActiveConns());
+            isStopping = true;
+        }
+    }
+
+    /* Perform clean up */
+    LOG_INFO("Shutdown requested, stopping the workers");
+    stopWorkers();
+    printWorkerStats();
+    free(workers);
+    close(epollFd);
+    /* A drained server already removed its path, it may belong to a new server by now */
+    if (!isDraining)
+    {
+        close(connSocket);
+        unlink(socketPath);
+    }
+    loopControlRelease(&loopControl);
+    metricsStopAdmin();
+    LOG_INFO("Server is down");
+
+    return EXIT_SUCCESS;
+}
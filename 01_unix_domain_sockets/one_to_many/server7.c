@@ -0,0 +1,471 @@
+/**------------------------------------------------------------------------------------------------
+ * ?                                           ABOUT
+ * @author         :  Nguyen Dinh Hoan
+ * @email          :  hoann.wk@gmail.com
+ * @repo           :  https://github.com/hoan9x/IPC-in-Linux
+ * @createdOn      :  16-Oct-2026
+ * @description    :  This example demonstrates a publish/subscribe broker on a UNIX domain socket
+ *                    using epoll(): a message published by one client goes to every subscriber
+ *------------------------------------------------------------------------------------------------**/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "../common/frame.h"
+#include "../common/buffer_pool.h"
+#include "../common/pubsub.h"
+#include "../common/accept_batch.h"
+#include "../common/log.h"
+
+/* LOG macro function */
+#define LOG_INFO(format, ...) LOG_AT(LOG_LEVEL_INFO, "[SERVER_INFO] " format, ##__VA_ARGS__)
+#define LOG_ERROR(format, ...) LOG_AT(LOG_LEVEL_ERROR, "[SERVER_ERROR] " format, ##__VA_ARGS__)
+
+#define DEFAULT_SOCKET_PATH "/tmp/ipc-demo.sock"
+#define BUFFER_SIZE 128
+/* Maximum number of ready events returned by one epoll_wait() call */
+#define MAX_EVENTS_PER_WAIT 256
+
+#define IF_FAIL_THEN_EXIT(EXP, RELEASE, MSG, ...) ({ if (EXP) { LOG_ERROR(MSG, ##__VA_ARGS__); cleanupAndExitError(RELEASE); } })
+
+/* Per-client state, registered as the epoll data so a ready event leads straight to it */
+struct ClientConn
+{
+    int fd;
+    uint32_t events;            /* events registered to epoll */
+    struct FrameParser parser;
+    struct Subscriber subscriber;   /* topics followed and messages not written yet */
+};
+
+#define CONN_OF_SUBSCRIBER(SUBSCRIBER) ((struct ClientConn *)((char *)(SUBSCRIBER) - offsetof(struct ClientConn, subscriber)))
+
+/* epoll instance and connection socket, global so they can be released by cleanupAndExitError() */
+int epollFd = -1;
+int connSocket = -1;
+/* Parser buffers and published messages are borrowed from this pool */
+struct BufferPool bufferPool;
+struct PubSub pubSub;
+/* Pending connections are accepted in batches, the connection socket leaves the epoll set while accepting is paused */
+struct AcceptBatch acceptBatch;
+bool isAcceptPaused = false;
+
+/* Function to clean up resources and exit */
+void cleanupAndExitError(const char *socketPath)
+{
+    /* Client sockets are not tracked individually here, they are released by the kernel on exit */
+    if (-1 != epollFd)
+    {
+        close(epollFd);
+    }
+    if (-1 != connSocket)
+    {
+        close(connSocket);
+    }
+    if (socketPath)
+    {
+        /* Remove the socket file */
+        unlink(socketPath);
+    }
+
+    exit(EXIT_FAILURE);
+}
+
+/* Raise the soft limit of open files up to the hard limit, so tens of thousands of clients can connect */
+static void raiseFileLimit()
+{
+    struct rlimit limit;
+    if (0 == getrlimit(RLIMIT_NOFILE, &limit) && limit.rlim_cur < limit.rlim_max)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        if (0 == setrlimit(RLIMIT_NOFILE, &limit))
+        {
+            LOG_INFO("Open file limit raised to %llu", (unsigned long long)limit.rlim_cur);
+        }
+    }
+}
+
+/* Register conn->fd to the epoll instance for read events */
+static int addToEpoll(struct ClientConn *conn)
+{
+    struct epoll_event event = {0};
+    event.events = EPOLLIN | EPOLLRDHUP;
+    event.data.ptr = conn;
+    conn->events = event.events;
+    return epoll_ctl(epollFd, EPOLL_CTL_ADD, conn->fd, &event);
+}
+
+/* Close a client socket and release its state, its subscriptions and queued messages included */
+static void closeClient(struct ClientConn *conn)
+{
+    if (conn->subscriber.dropped > 0)
+    {
+        LOG_INFO("fd[%d] missed %llu messages while it was too slow", conn->fd, conn->subscriber.dropped);
+    }
+    pubSubRemove(&pubSub, &conn->subscriber);
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+    frameParserRelease(&conn->parser);
+    free(conn);
+}
+
+/* Monitor the client for writing while messages are queued for it, epoll_ctl() is only called when this changes */
+static int updateClientEvents(struct ClientConn *conn)
+{
+    struct epoll_event event = {0};
+    event.events = EPOLLIN | EPOLLRDHUP | ((conn->subscriber.count > 0) ? EPOLLOUT : 0);
+    if (event.events == conn->events)
+        return 0;
+    event.data.ptr = conn;
+    conn->events = event.events;
+    return epoll_ctl(epollFd, EPOLL_CTL_MOD, conn->fd, &event);
+}
+
+/* Write the queued messages of a subscriber, return -1 if it failed and the client was closed */
+static int flushClient(struct ClientConn *conn)
+{
+    if (subscriberFlush(&pubSub, &conn->subscriber) < 0 || updateClientEvents(conn) < 0)
+    {
+        LOG_ERROR("Sending messages to fd[%d] failed, closing the connection", conn->fd);
+        closeClient(conn);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Deliver what was published since the last call: one writev() per subscriber covers every message it got,
+ * what the socket does not take waits for EPOLLOUT. Evicted subscribers are closed here, never in the middle
+ * of a publication.
+ **/
+static void deliverPending(void)
+{
+    struct Subscriber *subscriber;
+    while ((subscriber = pubSubNextPending(&pubSub)))
+    {
+        struct ClientConn *conn = CONN_OF_SUBSCRIBER(subscriber);
+        if (subscriber->isEvicted)
+        {
+            LOG_ERROR("fd[%d] has %u messages waiting, too slow, closing the connection", conn->fd, subscriber->count);
+            closeClient(conn);
+            continue;
+        }
+        flushClient(conn);
+    }
+}
+
+/**
+ * Accept the pending connections the rate limit allows, in batches. A burst of subscribers reconnecting to the
+ * broker would otherwise be taken all at once; what is left waits in the backlog while accepting is paused,
+ * the main loop monitors listenConn again when acceptBatchDelayMs() allows it.
+ **/
+static void acceptClients(const char *socketPath, struct ClientConn *listenConn)
+{
+    int numAccepted;
+    do
+    {
+        numAccepted = acceptBatchRun(&acceptBatch, connSocket);
+        IF_FAIL_THEN_EXIT(numAccepted < 0, socketPath, "accept() return error");
+        for (int i = 0; i < numAccepted; ++i)
+        {
+            int dataSocket = acceptBatch.fds[i];
+            LOG_INFO("Connection established (%d)", dataSocket);
+            struct ClientConn *conn = malloc(sizeof(struct ClientConn));
+            if (!conn)
+            {
+                LOG_ERROR("Allocating state of fd[%d] failed, closing the connection", dataSocket);
+                close(dataSocket);
+                continue;
+            }
+            conn->fd = dataSocket;
+            frameParserInitPooled(&conn->parser, &bufferPool);
+            subscriberInit(&conn->subscriber, dataSocket);
+            if (addToEpoll(conn) < 0)
+            {
+                LOG_ERROR("epoll_ctl() fd[%d] add failed, closing the connection", dataSocket);
+                close(dataSocket);
+                free(conn);
+            }
+        }
+    } while (!acceptBatch.isDrained && acceptBatchDelayMs(&acceptBatch) < 0);
+    if (!acceptBatch.isDrained)
+    {
+        LOG_INFO("Accepting paused, pending connections wait in the backlog");
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, listenConn->fd, NULL);
+        isAcceptPaused = true;
+    }
+}
+
+/* Handle one frame of a client, return -1 if the client must be closed */
+static int handleFrame(struct ClientConn *conn, const struct Frame *frame)
+{
+    switch (frame->header.type)
+    {
+        case FRAME_TYPE_PUBLISH:
+            /* Not logged, publishing is the hot path */
+            if (pubSubPublish(&pubSub, frame->header.seq, frame->payload, frame->header.length) < 0)
+            {
+                LOG_ERROR("Publication of fd[%d] (seq %u) is malformed or out of memory, ignored", conn->fd, frame->header.seq);
+            }
+            return 0;
+        case FRAME_TYPE_SUBSCRIBE:
+            if (pubSubSubscribe(&pubSub, &conn->subscriber, frame->payload, frame->header.length) < 0)
+            {
+                LOG_ERROR("fd[%d] can not subscribe to [%.*s]", conn->fd, (int)frame->header.length, frame->payload);
+                return 0;
+            }
+            LOG_INFO("fd[%d] subscribed to [%.*s]", conn->fd, (int)frame->header.length, frame->payload);
+            return 0;
+        case FRAME_TYPE_UNSUBSCRIBE:
+            if (0 == pubSubUnsubscribe(&pubSub, &conn->subscriber, frame->payload, frame->header.length))
+            {
+                LOG_INFO("fd[%d] unsubscribed from [%.*s]", conn->fd, (int)frame->header.length, frame->payload);
+            }
+            return 0;
+        case FRAME_TYPE_PING:
+            /* Benchmark probe, echoed back without logging. Queued after the messages in flight, never written past them */
+            return subscriberQueueFrame(&pubSub, &conn->subscriber, FRAME_TYPE_PONG, frame->header.seq, frame->payload, frame->header.length);
+        default:
+            LOG_INFO("Received data from fd[%d] (seq %u): [%.*s]", conn->fd, frame->header.seq, (int)frame->header.length, frame->payload);
+            return 0;
+    }
+}
+
+/* Read data from a client, one read() per event: epoll is level-triggered and reports the fd again if data is left */
+static void readClient(struct ClientConn *conn)
+{
+    struct Frame frame;
+    ssize_t ret;
+    for (;;)
+    {
+        /* Data is read straight into the frame parser of the client */
+        ret = frameParserRead(&conn->parser, conn->fd);
+        if (ret < 0)
+        {
+            if (EAGAIN == errno || EWOULDBLOCK == errno)
+                return;
+            if (EINTR == errno)
+                continue;
+            LOG_ERROR("read() fd[%d] return error, closing the connection", conn->fd);
+            closeClient(conn);
+            return;
+        }
+        break;
+    }
+    if (/*EOF*/0 == ret)
+    {
+        /* Once the client has closed the socket, the server will received the EOF message */
+        LOG_INFO("Received EOF message from fd[%d]", conn->fd);
+        closeClient(conn);
+        return;
+    }
+
+    /* One read() may carry several frames, or only a part of one which stays in the parser */
+    while ((ret = frameParserNext(&conn->parser, &frame)) > 0)
+    {
+        if (handleFrame(conn, &frame) < 0)
+        {
+            LOG_ERROR("Answering fd[%d] failed, closing the connection", conn->fd);
+            closeClient(conn);
+            return;
+        }
+    }
+    if (ret < 0)
+    {
+        LOG_ERROR("Malformed frame received from fd[%d], closing the connection", conn->fd);
+        closeClient(conn);
+        return;
+    }
+    /* Nothing pending, the buffer goes back to the pool until the client sends again */
+    frameParserTrim(&conn->parser);
+}
+
+static void printUsage(const char *appName)
+{
+    printf("Usage: %s [-p drop|disconnect] [-m max_queued] [-B backlog] [-A rate[:burst]] [socket_path]\n", appName);
+    printf("  -p  What to do with a subscriber that has max_queued messages waiting when another one arrives:\n");
+    printf("      drop the new message for it (default), or disconnect it\n");
+    printf("  -m  Messages a subscriber may have waiting (default %d)\n", PUBSUB_DEFAULT_MAX_QUEUED);
+    printf("  -B  Connections waiting in the listen() backlog, 0 (default) for net.core.somaxconn\n");
+    printf("  -A  Accept at most rate connections per second, in bursts of up to burst (default no limit)\n");
+}
+
+int main(int argc, char *argv[])
+{
+    enum PubSubPolicy policy = PUBSUB_POLICY_DROP;
+    unsigned long maxQueued = PUBSUB_DEFAULT_MAX_QUEUED;
+    int opt, backlog = ACCEPT_DEFAULT_BACKLOG, acceptDelayMs;
+    double acceptRate = 0, acceptBurst = 0;
+    while (-1 != (opt = getopt(argc, argv, "p:m:B:A:h")))
+    {
+        switch (opt)
+        {
+            case 'p':
+                if (pubSubParsePolicy(optarg, &policy) < 0)
+                {
+                    printUsage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'm':
+                maxQueued = strtoul(optarg, NULL, 0);
+                if (0 == maxQueued || maxQueued > UINT32_MAX)
+                {
+                    printUsage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'B':
+                if (acceptParseBacklog(optarg, &backlog) < 0)
+                {
+                    printUsage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'A':
+                if (acceptParseRate(optarg, &acceptRate, &acceptBurst) < 0)
+                {
+                    printUsage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            default: printUsage(argv[0]); return (opt == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    /* Initialize socket path from application input parameter or default value */
+    const char *socketPath = (argc>optind)?argv[optind]:DEFAULT_SOCKET_PATH;
+    struct sockaddr_un structSocketInfo;
+    /* Initialize socket info structure */
+    memset(&structSocketInfo, 0, sizeof(struct sockaddr_un));
+    structSocketInfo.sun_family = AF_UNIX;
+    strncpy(structSocketInfo.sun_path, socketPath, sizeof(structSocketInfo.sun_path)-1);
+    struct epoll_event readyEvents[MAX_EVENTS_PER_WAIT];
+    int ret, i;
+    char buffer[BUFFER_SIZE];
+    char statsBuffer[512];
+
+    /* A subscriber that closes while messages are written to it must not kill the broker */
+    signal(SIGPIPE, SIG_IGN);
+    raiseFileLimit();
+    bufferPoolInit(&bufferPool);
+    pubSubInit(&pubSub, &bufferPool, policy, (uint32_t)maxQueued);
+    acceptBatchInit(&acceptBatch, SOCK_NONBLOCK | SOCK_CLOEXEC, acceptRate, acceptBurst);
+    /* Remove the socket if it exists */
+    unlink(socketPath);
+
+    /* Create the epoll instance */
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    IF_FAIL_THEN_EXIT(epollFd < 0, socketPath, "Creating an epoll instance failed");
+    LOG_INFO("epoll instance created (%d), slow subscribers are %s after %lu queued messages", epollFd,
+             (PUBSUB_POLICY_DROP == policy) ? "skipped" : "disconnected", maxQueued);
+
+    /* Create connection socket (master socket file descriptor), non-blocking so accept() can be drained */
+    connSocket = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    IF_FAIL_THEN_EXIT(connSocket < 0, socketPath, "Creating a connection socket failed");
+    LOG_INFO("Connection socket created (%d)", connSocket);
+
+    /* Bind connection socket to path */
+    ret = bind(connSocket, (const struct sockaddr *)&structSocketInfo, sizeof(struct sockaddr_un));
+    IF_FAIL_THEN_EXIT(ret < 0, socketPath, "Bind connection socket to path failed");
+    LOG_INFO("Bind connection socket to path [%s] succeeded", socketPath);
+
+    /* Listen for incoming connections, subscribers connecting together queue in the backlog instead of failing */
+    ret = acceptListen(connSocket, backlog);
+    IF_FAIL_THEN_EXIT(ret < 0, socketPath, "Listening on socket failed");
+    LOG_INFO("Listening for incoming connections (backlog %d)...", ret);
+
+    struct ClientConn listenConn = {.fd = connSocket}, stdinConn = {.fd = STDIN_FILENO};
+    ret = addToEpoll(&listenConn);
+    IF_FAIL_THEN_EXIT(ret < 0, socketPath, "Adding connection socket to epoll failed");
+    /* epoll does not support regular files, so stdin redirected from a file is not monitored */
+    if (addToEpoll(&stdinConn) < 0)
+    {
+        LOG_INFO("stdin can not be monitored by epoll (errno %d), ignoring it", errno);
+    }
+
+    /* Main server loop */
+    for (;;)
+    {
+        /* A paused connection socket is monitored again once the rate limit or the descriptors allow it */
+        acceptDelayMs = isAcceptPaused ? acceptBatchDelayMs(&acceptBatch) : -1;
+        if (isAcceptPaused && acceptDelayMs < 0)
+        {
+            IF_FAIL_THEN_EXIT(addToEpoll(&listenConn) < 0, socketPath, "Monitoring the connection socket again failed");
+            isAcceptPaused = false;
+        }
+        LOG_INFO("##### Waiting on epoll_wait()");
+        /* Only the ready descriptors are returned, there is no need to scan every client */
+        ret = epoll_wait(epollFd, readyEvents, MAX_EVENTS_PER_WAIT, acceptDelayMs);
+        if (ret < 0)
+        {
+            if (EINTR == errno)
+                continue;
+            LOG_ERROR("epoll_wait() return error");
+            cleanupAndExitError(socketPath);
+        }
+
+        for (i = 0; i < ret; ++i)
+        {
+            struct ClientConn *readyConn = readyEvents[i].data.ptr;
+            if (&listenConn == readyConn)
+            {
+                LOG_INFO("New connection received, accepting the connection");
+                acceptClients(socketPath, &listenConn);
+            }
+            else if (&stdinConn == readyConn)
+            {
+                /* Input from console stdin */
+                int numRead = read(STDIN_FILENO, buffer, BUFFER_SIZE);
+                if (numRead <= 0)
+                {
+                    /* stdin is closed, stop monitoring it otherwise it is reported ready forever */
+                    LOG_INFO("stdin closed, stop monitoring it");
+                    epoll_ctl(epollFd, EPOLL_CTL_DEL, STDIN_FILENO, NULL);
+                    continue;
+                }
+                LOG_INFO("Input read from stdin's fd[0]: [%.*s]", numRead, buffer);
+                pubSubFormatStats(&pubSub, statsBuffer, sizeof(statsBuffer));
+                LOG_INFO("Pub/sub: %s", statsBuffer);
+                bufferPoolFormat(&bufferPool, statsBuffer, sizeof(statsBuffer));
+                LOG_INFO("Buffer pool: %s", statsBuffer);
+                acceptStatsFormat(&acceptBatch, statsBuffer, sizeof(statsBuffer));
+                LOG_INFO("accept: %s", statsBuffer);
+            }
+            else
+            {
+                /* The subscriber can take its queued messages again, the flush closes it if it is gone */
+                if ((readyEvents[i].events & EPOLLOUT) && flushClient(readyConn) < 0)
+                {
+                    continue;
+                }
+                if (readyEvents[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+                {
+                    /* Data or EOF arrives on the client's FD, pending data is read before EOF is seen */
+                    readClient(readyConn);
+                }
+            }
+        }
+        /* The publications of every client read above go out together */
+        deliverPending();
+    }
+
+    /* Perform clean up */
+    close(connSocket);
+    close(epollFd);
+    pubSubRelease(&pubSub);
+    bufferPoolRelease(&bufferPool);
+    unlink(socketPath);
+    LOG_INFO("Server is down");
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,324 @@
+/**------------------------------------------------------------------------------------------------
+ * ?                                           ABOUT
+ * @author         :  Nguyen Dinh Hoan
+ * @email          :  hoann.wk@gmail.com
+ * @repo           :  https://github.com/hoan9x/IPC-in-Linux
+ * @createdOn      :  16-Oct-2026
+ * @description    :  This example demonstrates a UNIX domain socket server handling multiple clients
+ *                    with C++20 coroutines: one coroutine per client, written as straight-line code,
+ *                    all of them driven by one poll() loop on one thread
+ *------------------------------------------------------------------------------------------------**/
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "../common/coro_loop.hpp"
+#include "../common/frame.h"
+#include "../common/buffer_pool.h"
+#include "../common/accept_batch.h"
+#include "../common/log.h"
+
+/* LOG macro function */
+#define LOG_INFO(format, ...) LOG_AT(LOG_LEVEL_INFO, "[SERVER_INFO] " format, ##__VA_ARGS__)
+#define LOG_ERROR(format, ...) LOG_AT(LOG_LEVEL_ERROR, "[SERVER_ERROR] " format, ##__VA_ARGS__)
+
+#define DEFAULT_SOCKET_PATH "/tmp/ipc-demo.sock"
+#define BUFFER_SIZE 128
+/* Pongs answering the frames of one read() are sent with one writev() of up to this many frames */
+#define REPLY_BATCH_MAX 32
+
+#define IF_FAIL_THEN_EXIT(EXP, RELEASE, MSG, ...) ({ if (EXP) { LOG_ERROR(MSG, ##__VA_ARGS__); cleanupAndExitError(RELEASE); } })
+
+using coro::Loop;
+using coro::Task;
+
+/* Every coroutine runs on this loop, Ctrl+C stops it */
+Loop loop;
+/* Parser buffers of the clients are borrowed from this pool while a frame is being parsed */
+struct BufferPool bufferPool;
+/* A client that sends nothing for this long is closed, -1 for never */
+int idleTimeoutMs = -1;
+int connSocket = -1;
+unsigned long long numAccepted = 0, numClosed = 0, numIdleClosed = 0;
+
+/* Signal handler function for SIGINT (Ctrl+C) */
+void handleSigint(int sig)
+{
+    (void)sig;
+    loop.stop();
+}
+
+/* Function to clean up resources and exit */
+void cleanupAndExitError(const char *socketPath)
+{
+    if (-1 != connSocket)
+    {
+        close(connSocket);
+    }
+    if (socketPath)
+    {
+        /* Remove the socket file */
+        unlink(socketPath);
+    }
+
+    exit(EXIT_FAILURE);
+}
+
+/* Send the pongs queued in iov, return 0 or -1 with errno set (ETIMEDOUT if the client does not read them in time) */
+static coro::WriteAwaiter sendReplies(int fdNum, struct iovec *iov, int iovCount)
+{
+    return loop.writev(fdNum, iov, iovCount, idleTimeoutMs);
+}
+
+/**
+ * Serve one client until it closes the connection: wait for data, parse the frames, answer the pings.
+ * The coroutine only holds its frame while it waits, the parser buffer is borrowed from the pool once data
+ * arrived and given back when every frame was parsed, so thousands of idle clients cost little memory.
+ **/
+static Task serveClient(int fdNum)
+{
+    struct FrameParser parser;
+    struct FrameHeader headers[REPLY_BATCH_MAX];
+    struct iovec iov[REPLY_BATCH_MAX * 2];
+    struct Frame frame;
+    int numReplies, ret;
+    bool isWriteFailed;
+    ssize_t numRead;
+
+    frameParserInitPooled(&parser, &bufferPool);
+    for (;;)
+    {
+        if (co_await loop.readable(fdNum, idleTimeoutMs) < 0)
+        {
+            if (ETIMEDOUT == errno)
+            {
+                LOG_INFO("fd[%d] idle for %d ms, closing the connection", fdNum, idleTimeoutMs);
+                numIdleClosed++;
+            }
+            break;
+        }
+        numRead = frameParserRead(&parser, fdNum);
+        if (numRead < 0 && (EAGAIN == errno || EINTR == errno))
+        {
+            continue;
+        }
+        if (numRead < 0)
+        {
+            LOG_ERROR("read() fd[%d] return error", fdNum);
+            break;
+        }
+        if (/*EOF*/0 == numRead)
+        {
+            /* Once the client has closed the socket, the server will received the EOF message */
+            LOG_INFO("Received EOF message");
+            break;
+        }
+
+        /* One read() may carry several frames, or only a part of one which stays in the parser */
+        numReplies = 0;
+        isWriteFailed = false;
+        while (!isWriteFailed && (ret = frameParserNext(&parser, &frame)) > 0)
+        {
+            if (FRAME_TYPE_PING != frame.header.type)
+            {
+                LOG_INFO("Received data from fd[%d] (seq %u): [%.*s]", fdNum, frame.header.seq, (int)frame.header.length, frame.payload);
+                continue;
+            }
+            /* Benchmark probe, echoed back without logging, the payload stays in the parser buffer until it is sent */
+            headers[numReplies] = {frame.header.length, FRAME_TYPE_PONG, 0, frame.header.seq};
+            iov[2 * numReplies] = {&headers[numReplies], FRAME_HEADER_SIZE};
+            iov[2 * numReplies + 1] = {const_cast<char *>(frame.payload), frame.header.length};
+            if (REPLY_BATCH_MAX == ++numReplies)
+            {
+                isWriteFailed = co_await sendReplies(fdNum, iov, 2 * numReplies) < 0;
+                numReplies = 0;
+            }
+        }
+        if (!isWriteFailed && numReplies > 0)
+        {
+            isWriteFailed = co_await sendReplies(fdNum, iov, 2 * numReplies) < 0;
+        }
+        if (isWriteFailed)
+        {
+            LOG_ERROR("Answering ping of fd[%d] failed, closing the connection", fdNum);
+            break;
+        }
+        if (ret < 0)
+        {
+            LOG_ERROR("Malformed frame received from fd[%d], closing the connection", fdNum);
+            break;
+        }
+        frameParserTrim(&parser);
+    }
+    frameParserRelease(&parser);
+    loop.close(fdNum);
+    numClosed++;
+}
+
+/**
+ * Accept the clients and start one coroutine for each. Every pending connection is taken at once, up to
+ * ACCEPT_BATCH_MAX in a row: the loop then serves the other coroutines before the next batch.
+ **/
+static Task acceptClients(const char *socketPath)
+{
+    int dataSocket, numInBatch = 0;
+    for (;;)
+    {
+        if (ACCEPT_BATCH_MAX == numInBatch)
+        {
+            numInBatch = 0;
+            if (co_await loop.readable(connSocket) < 0)
+            {
+                break;
+            }
+        }
+        dataSocket = co_await loop.accept(connSocket, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (dataSocket < 0)
+        {
+            if (EINTR == errno || ECONNABORTED == errno)
+            {
+                continue;
+            }
+            if (EMFILE == errno || ENFILE == errno)
+            {
+                /* The pending connections wait in the backlog until descriptors are closed */
+                LOG_ERROR("Out of descriptors, accepting again in %d ms", ACCEPT_FD_RETRY_MS);
+                co_await loop.sleep(ACCEPT_FD_RETRY_MS);
+                continue;
+            }
+            LOG_ERROR("accept() return error");
+            break;
+        }
+        LOG_INFO("Connection established (%d)", dataSocket);
+        numAccepted++;
+        numInBatch++;
+        /* The client coroutine runs until its first wait before the next connection is accepted */
+        if (!serveClient(dataSocket).isStarted())
+        {
+            LOG_ERROR("Allocating the coroutine of fd[%d] failed, closing the connection", dataSocket);
+            close(dataSocket);
+        }
+    }
+    /* Without the connection socket the server is of no use */
+    cleanupAndExitError(socketPath);
+}
+
+/* Print the statistics for every line typed on the console */
+static Task readConsole()
+{
+    char buffer[BUFFER_SIZE];
+    char statsBuffer[512];
+    ssize_t ret;
+    for (;;)
+    {
+        /* stdin is blocking, it is only read once poll() reported data */
+        if (co_await loop.readable(STDIN_FILENO) < 0)
+        {
+            break;
+        }
+        ret = read(STDIN_FILENO, buffer, BUFFER_SIZE);
+        if (ret <= 0)
+        {
+            /* Console closed, the server keeps running without it */
+            loop.forget(STDIN_FILENO);
+            break;
+        }
+        /* Input from console stdin */
+        LOG_INFO("Input read from stdin's fd[0]: [%.*s]", (int)ret, buffer);
+        LOG_INFO("Clients: %llu accepted, %llu closed (%llu idle)", numAccepted, numClosed, numIdleClosed);
+        loop.formatStats(statsBuffer, sizeof(statsBuffer));
+        LOG_INFO("Loop: %s", statsBuffer);
+        bufferPoolFormat(&bufferPool, statsBuffer, sizeof(statsBuffer));
+        LOG_INFO("Buffer pool: %s", statsBuffer);
+    }
+}
+
+static void printUsage(const char *appName)
+{
+    printf("Usage: %s [-i idle_ms] [-B backlog] [socket_path]\n", appName);
+    printf("  -i  Close a client that sends nothing, or does not read its pongs, for idle_ms milliseconds (default never)\n");
+    printf("  -B  Connections waiting in the listen() backlog, 0 (default) for net.core.somaxconn\n");
+}
+
+int main(int argc, char *argv[])
+{
+    int opt, backlog = ACCEPT_DEFAULT_BACKLOG;
+    char *end;
+    while (-1 != (opt = getopt(argc, argv, "i:B:h")))
+    {
+        switch (opt)
+        {
+            case 'i':
+                idleTimeoutMs = (int)strtol(optarg, &end, 10);
+                if ('\0' != *end || idleTimeoutMs <= 0)
+                {
+                    printUsage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'B':
+                if (acceptParseBacklog(optarg, &backlog) < 0)
+                {
+                    printUsage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            default: printUsage(argv[0]); return (opt == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    /* Initialize socket path from application input parameter or default value */
+    const char *socketPath = (argc>optind)?argv[optind]:DEFAULT_SOCKET_PATH;
+    struct sockaddr_un structSocketInfo;
+    /* Initialize socket info structure */
+    memset(&structSocketInfo, 0, sizeof(struct sockaddr_un));
+    structSocketInfo.sun_family = AF_UNIX;
+    strncpy(structSocketInfo.sun_path, socketPath, sizeof(structSocketInfo.sun_path)-1);
+    int ret;
+    char statsBuffer[512];
+
+    bufferPoolInit(&bufferPool);
+    IF_FAIL_THEN_EXIT(loop.init() < 0, socketPath, "Initializing the event loop failed");
+    /* A client gone before reading its pongs makes writev() fail with EPIPE instead of killing the server */
+    signal(SIGPIPE, SIG_IGN);
+    /* Remove the socket if it exists */
+    unlink(socketPath);
+
+    /* Create connection socket (master socket file descriptor), non-blocking so accept() can be awaited */
+    connSocket = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    IF_FAIL_THEN_EXIT(connSocket < 0, socketPath, "Creating a connection socket failed");
+    LOG_INFO("Connection socket created (%d)", connSocket);
+
+    /* Bind connection socket to path */
+    ret = bind(connSocket, (const struct sockaddr *)&structSocketInfo, sizeof(struct sockaddr_un));
+    IF_FAIL_THEN_EXIT(ret < 0, socketPath, "Bind connection socket to path failed");
+    LOG_INFO("Bind connection socket to path [%s] succeeded", socketPath);
+
+    /* Listen for incoming connections, up to backlog connections wait to be accepted */
+    ret = acceptListen(connSocket, backlog);
+    IF_FAIL_THEN_EXIT(ret < 0, socketPath, "Listening on socket failed");
+    LOG_INFO("Listening for incoming connections (backlog %d)...", ret);
+
+    /* Register signal handler for SIGINT (Ctrl+C), poll() returns EINTR when it is received */
+    signal(SIGINT, handleSigint);
+    LOG_INFO("Press Ctrl+C to stop the server, type a line to print the statistics");
+
+    /* The coroutines start at once and run until their first wait, then the loop drives them */
+    IF_FAIL_THEN_EXIT(!acceptClients(socketPath).isStarted(), socketPath, "Starting the accept coroutine failed");
+    IF_FAIL_THEN_EXIT(!readConsole().isStarted(), socketPath, "Starting the console coroutine failed");
+    ret = loop.run();
+    IF_FAIL_THEN_EXIT(ret < 0, socketPath, "poll() return error");
+
+    /* Perform clean up */
+    loop.formatStats(statsBuffer, sizeof(statsBuffer));
+    LOG_INFO("Loop: %s", statsBuffer);
+    close(connSocket);
+    unlink(socketPath);
+    LOG_INFO("Server is down");
+
+    return EXIT_SUCCESS;
+}
@@ -6,31 +6,52 @@
  * @createdOn      :  08-Oct-2024
  * @description    :  This example demonstrates a client exchanging data over a UNIX domain socket
  *------------------------------------------------------------------------------------------------**/
-#define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <errno.h>
 #include <signal.h>
+#include <time.h>
+#include <fcntl.h>
+#include <poll.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <unistd.h>
 
+#include "../common/frame.h"
+#include "../common/batch_io.h"
+#include "../common/buffer_pool.h"
+#include "../common/socket_mode.h"
+#include "../common/log.h"
+
 /* LOG macro function */
-#define LOG_INFO(format, ...) do { printf("[CLIENT_INFO] " format "\n", ##__VA_ARGS__); } while (0)
-#define LOG_ERROR(format, ...) do { printf("[CLIENT_ERROR] " format "\n", ##__VA_ARGS__); } while (0)
+#define LOG_INFO(format, ...) LOG_AT(LOG_LEVEL_INFO, "[CLIENT_INFO] " format, ##__VA_ARGS__)
+#define LOG_ERROR(format, ...) LOG_AT(LOG_LEVEL_ERROR, "[CLIENT_ERROR] " format, ##__VA_ARGS__)
 
 #define DEFAULT_SOCKET_PATH "/tmp/ipc-demo.sock"
 #define BUFFER_SIZE 128
 #define MAX_NUMBER_PENDING_CONNECTIONS 1
+#define DEFAULT_INTERVAL_MS 3000
+
+/* A slot of the window, requests in flight have consecutive seqs so seq % window never collides */
+struct PendingRequest
+{
+    uint32_t seq;
+    bool isPending;
+};
 
 /* Global variable to control the loop */
-volatile bool isKeepRunning = true;
+volatile sig_atomic_t isKeepRunning = true;
+/* Signal that stopped the loop, 0 if none */
+volatile sig_atomic_t caughtSignal = 0;
 
 /* Signal handler function for SIGINT (Ctrl+C) */
 void handleSigint(int sig)
 {
-    LOG_INFO("Signal %d (Ctrl+C)", sig);
+    /* Logging takes the log lock and may allocate the ring of the thread: only the flags are set here */
+    caughtSignal = sig;
     isKeepRunning = false;
 }
 
@@ -46,26 +67,85 @@ void cleanupAndExitError(int dataSocket)
     exit(EXIT_FAILURE);
 }
 
+/* Next reply of the last receive, taken from the stream reader or from the received messages */
+static int nextReply(enum SocketMode mode, struct BatchReader *reader, struct MsgBatch *messages, int *index, struct Frame *frame)
+{
+    if (SOCKET_MODE_STREAM == mode)
+    {
+        return batchReaderNext(reader, frame);
+    }
+    if (*index >= messages->count)
+    {
+        return 0;
+    }
+    return msgBatchFrame(messages, (*index)++, frame);
+}
+
+static void printUsage(const char *appName)
+{
+    printf("Usage: %s [-t " SOCKET_MODE_NAMES "] [-w window] [-c count] [-i interval_ms] [-q] [socket_path]\n", appName);
+    printf("  -t  Socket type, it must match the server: stream (default), seqpacket or dgram\n");
+    printf("  -w  Number of requests kept in flight, 1 waits for each reply before the next request (default 1)\n");
+    printf("  -c  Number of requests to send, 0 sends until Ctrl+C (default 0)\n");
+    printf("  -i  Delay in milliseconds once the whole window is answered (default %d)\n", DEFAULT_INTERVAL_MS);
+    printf("  -q  Do not log every request and reply, only the summary\n");
+}
+
 int main(int argc, char *argv[])
 {
+    int window = 1, count = 0, intervalMs = DEFAULT_INTERVAL_MS, opt;
+    bool isQuiet = false;
+    enum SocketMode mode = SOCKET_MODE_STREAM;
+    while (-1 != (opt = getopt(argc, argv, "t:w:c:i:qh")))
+    {
+        switch (opt)
+        {
+            case 't':
+                if (socketModeParse(optarg, &mode) < 0)
+                {
+                    printUsage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'w': window = atoi(optarg); break;
+            case 'c': count = atoi(optarg); break;
+            case 'i': intervalMs = atoi(optarg); break;
+            case 'q': isQuiet = true; break;
+            default: printUsage(argv[0]); return (opt == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if (window < 1)
+    {
+        window = 1;
+    }
+
     /* Register signal handler for SIGINT (Ctrl+C) */
     signal(SIGINT, handleSigint);
     LOG_INFO("Press Ctrl+C to set the shutdown flag...");
 
     struct sockaddr_un structSocketInfo;
-    int dataSocket = -1, ret;
-    char buffer[BUFFER_SIZE];
+    int dataSocket = -1, ret, index;
+    struct FrameParser parser;
+    struct Frame frame;
+    struct timespec startTime, endTime;
     /* Initialize socket path from application input parameter or default value */
-    const char *socketPath = (argc>1)?argv[1]:DEFAULT_SOCKET_PATH;
+    const char *socketPath = (argc>optind)?argv[optind]:DEFAULT_SOCKET_PATH;
 
     /* Create data socket */
-    dataSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+    dataSocket = socket(AF_UNIX, socketModeType(mode), 0);
     if (-1 == dataSocket)
     {
         LOG_ERROR("Creating a data socket failed");
         cleanupAndExitError(dataSocket);
     }
-    LOG_INFO("Data socket created");
+    LOG_INFO("Data socket created, %s mode", socketModeName(mode));
+
+    /* A datagram client needs an address of its own for the replies */
+    if (SOCKET_MODE_DGRAM == mode && -1 == socketAutobind(dataSocket))
+    {
+        LOG_ERROR("Binding the data socket failed");
+        cleanupAndExitError(dataSocket);
+    }
 
     /* Initialize socket info structure */
     memset(&structSocketInfo, 0, sizeof(struct sockaddr_un));
@@ -79,38 +159,185 @@ int main(int argc, char *argv[])
         LOG_ERROR("Connection request failed, server is down");
         cleanupAndExitError(dataSocket);
     }
+    /**
+     * Non-blocking: a window larger than the socket buffers cannot be written in one go while the server waits
+     * for its replies to be read, the requests wait in the client and go out as the socket drains.
+     **/
+    if (-1 == fcntl(dataSocket, F_SETFL, O_NONBLOCK))
+    {
+        LOG_ERROR("Making the data socket non-blocking failed");
+        cleanupAndExitError(dataSocket);
+    }
 
     /**------------------------------------------------------------------------
      *                Now the server and client can exchange data
      *------------------------------------------------------------------------**/
-    for (int index = 0; isKeepRunning; ++index)
+    /* Payload of every slot of the window, they stay in place until the batch of requests is flushed */
+    char *payloads = malloc((size_t)window * BUFFER_SIZE);
+    struct PendingRequest *pending = calloc(window, sizeof(struct PendingRequest));
+    struct OutBatch requests;
+    struct BatchReader reader;
+    struct MsgBatch outMessages, inMessages;
+    struct IoStats ioStats = {0};
+    struct BufferPool bufferPool;
+    struct OutQueue outQueue;
+    char statsBuffer[256];
+    bufferPoolInit(&bufferPool);
+    outQueueInit(&outQueue, &bufferPool, NULL);
+    outBatchInit(&requests, &ioStats);
+    /* What a stream socket does not take waits in outQueue, written on POLLOUT */
+    requests.queue = &outQueue;
+    /* Replies hold the fixed reply message of the server, a receive buffer of BUFFER_SIZE is enough */
+    if (!payloads || !pending || batchReaderInit(&reader, &ioStats) < 0 || msgBatchInit(&outMessages, 0, &ioStats) < 0
+        || msgBatchInit(&inMessages, (SOCKET_MODE_STREAM == mode) ? 0 : FRAME_HEADER_SIZE + BUFFER_SIZE, &ioStats) < 0)
     {
-        /* Prepare data to send to server */
-        memset(buffer, 0, BUFFER_SIZE);
-        snprintf(buffer, BUFFER_SIZE, ">>>>>Client data (%d)<<<<<", index);
+        LOG_ERROR("Allocating a window of %d requests failed", window);
+        cleanupAndExitError(dataSocket);
+    }
+    uint32_t nextSeq = 0;
+    int outstanding = 0, maxDepth = 0;
+    unsigned long long numReplies = 0, depthSum = 0, numWaits = 0;
 
-        LOG_INFO("Send data to server: [%s]", buffer);
-        ret = write(dataSocket, buffer, strlen(buffer)+1);
+    frameParserInit(&parser);
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+    while (isKeepRunning && (0 == count || numReplies < (unsigned long long)count))
+    {
+        /**
+         * Fill the free slots of the window with new requests, they are sent together by one writev() or sendmmsg().
+         * A message batch is not filled past its size, a full one would be sent by a blocking sendmmsg().
+         **/
+        while (outstanding < window && (0 == count || nextSeq < (uint32_t)count)
+               && (SOCKET_MODE_STREAM == mode || outMessages.count < MSG_BATCH_MAX_MESSAGES))
+        {
+            /* The frame header carries the payload length so no terminating NUL is sent */
+            char *payload = payloads + (size_t)(nextSeq % window) * BUFFER_SIZE;
+            int length = snprintf(payload, BUFFER_SIZE, ">>>>>Client data (%u)<<<<<", nextSeq);
+            if (SOCKET_MODE_STREAM == mode)
+            {
+                ret = outBatchQueue(&requests, dataSocket, FRAME_TYPE_DATA, nextSeq, payload, length);
+            }
+            else
+            {
+                ret = msgBatchQueue(&outMessages, dataSocket, FRAME_TYPE_DATA, nextSeq, payload, length, NULL, 0);
+            }
+            if (-1 == ret)
+            {
+                LOG_ERROR("Send data to server failed");
+                cleanupAndExitError(dataSocket);
+            }
+            if (!isQuiet)
+            {
+                LOG_INFO("Send data to server: [%.*s]", length, payload);
+            }
+
+            pending[nextSeq % window] = (struct PendingRequest){.seq = nextSeq, .isPending = true};
+            nextSeq++;
+            outstanding++;
+        }
+        /* Whatever the socket does not take now stays queued, the replies are read meanwhile */
+        ret = (SOCKET_MODE_STREAM == mode) ? outBatchFlush(&requests, dataSocket) : msgBatchSendSome(&outMessages, dataSocket);
         if (-1 == ret)
         {
             LOG_ERROR("Send data to server failed");
             cleanupAndExitError(dataSocket);
         }
 
-        /* Receive data from server */
-        memset(buffer, 0, BUFFER_SIZE);
-        ret = read(dataSocket, buffer, BUFFER_SIZE);
+        /* Wait for replies, and for room in the socket while requests are still queued */
+        struct pollfd pollFd = {.fd = dataSocket, .events = POLLIN};
+        if ((SOCKET_MODE_STREAM == mode) ? outQueue.bytes > 0 : outMessages.count > 0)
+        {
+            pollFd.events |= POLLOUT;
+        }
+        ret = poll(&pollFd, 1, -1);
         if (-1 == ret)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            LOG_ERROR("Waiting for the server failed");
+            cleanupAndExitError(dataSocket);
+        }
+        if ((pollFd.revents & POLLOUT) && SOCKET_MODE_STREAM == mode && -1 == outQueueFlush(&outQueue, dataSocket))
+        {
+            LOG_ERROR("Send data to server failed");
+            cleanupAndExitError(dataSocket);
+        }
+        if (!(pollFd.revents & (POLLIN | POLLHUP | POLLERR)))
+        {
+            continue;
+        }
+
+        /* Receive data from server, one read() or recvmmsg() may complete several requests */
+        depthSum += outstanding;
+        numWaits++;
+        if (outstanding > maxDepth)
+        {
+            maxDepth = outstanding;
+        }
+        if (SOCKET_MODE_STREAM == mode)
+        {
+            ret = batchReaderRead(&reader, &parser, dataSocket);
+        }
+        else
+        {
+            ret = msgBatchRecv(&inMessages, dataSocket, MSG_DONTWAIT);
+        }
+        if (ret <= 0)
         {
             LOG_ERROR("Received data from server failed");
             cleanupAndExitError(dataSocket);
         }
-        LOG_INFO("Received data: [%.*s]", /*number read*/ret, buffer);
-        /* Sleep for 3s */
-        sleep(3);
+        index = 0;
+        while ((ret = nextReply(mode, &reader, &inMessages, &index, &frame)) > 0)
+        {
+            /* Replies are matched by seq, they do not have to come back in order */
+            struct PendingRequest *request = &pending[frame.header.seq % window];
+            if (FRAME_TYPE_REPLY != frame.header.type || !request->isPending || request->seq != frame.header.seq)
+            {
+                LOG_ERROR("Unexpected frame received from server (type %u, seq %u)", frame.header.type, frame.header.seq);
+                cleanupAndExitError(dataSocket);
+            }
+            request->isPending = false;
+            outstanding--;
+            numReplies++;
+            if (!isQuiet)
+            {
+                LOG_INFO("Received data (seq %u): [%.*s]", frame.header.seq, (int)frame.header.length, frame.payload);
+            }
+        }
+        /* A zero-length message, the EOF of a seqpacket server, is not a frame either */
+        if (ret < 0 || (SOCKET_MODE_STREAM == mode && batchReaderFinish(&reader) < 0))
+        {
+            LOG_ERROR("Malformed frame received from server");
+            cleanupAndExitError(dataSocket);
+        }
+
+        if (intervalMs > 0 && 0 == outstanding)
+        {
+            /* Sleep once the whole window is answered */
+            usleep(intervalMs * 1000);
+        }
     }
+    clock_gettime(CLOCK_MONOTONIC, &endTime);
+    double elapsed = (endTime.tv_sec - startTime.tv_sec) + (endTime.tv_nsec - startTime.tv_nsec) / 1e9;
+    LOG_INFO("%llu replies in %.3f s (%.0f msg/s), window %d, achieved depth %.1f on average, %d at most", numReplies,
+             elapsed, elapsed > 0 ? numReplies / elapsed : 0.0, window, numWaits ? (double)depthSum / numWaits : 0.0, maxDepth);
+    ioStatsFormat(&ioStats, statsBuffer, sizeof(statsBuffer));
+    LOG_INFO("I/O: %s", statsBuffer);
 
+    if (caughtSignal)
+    {
+        LOG_INFO("Signal %d (Ctrl+C)", caughtSignal);
+    }
     /* Close socket */
+    batchReaderRelease(&reader);
+    msgBatchRelease(&inMessages);
+    frameParserRelease(&parser);
+    outQueueRelease(&outQueue);
+    bufferPoolRelease(&bufferPool);
+    free(pending);
+    free(payloads);
     close(dataSocket);
     LOG_INFO("Client is down");
 
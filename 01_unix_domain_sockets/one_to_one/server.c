@@ -6,31 +6,43 @@
  * @createdOn      :  08-Oct-2024
  * @description    :  This example demonstrates a UNIX domain socket server
  *------------------------------------------------------------------------------------------------**/
-#define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <errno.h>
 #include <signal.h>
+#include <poll.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <unistd.h>
 
+#include "../common/frame.h"
+#include "../common/batch_io.h"
+#include "../common/buffer_pool.h"
+#include "../common/socket_mode.h"
+#include "../common/log.h"
+
 /* LOG macro function */
-#define LOG_INFO(format, ...) do { printf("[SERVER_INFO] " format "\n", ##__VA_ARGS__); } while (0)
-#define LOG_ERROR(format, ...) do { printf("[SERVER_ERROR] " format "\n", ##__VA_ARGS__); } while (0)
+#define LOG_INFO(format, ...) LOG_AT(LOG_LEVEL_INFO, "[SERVER_INFO] " format, ##__VA_ARGS__)
+#define LOG_ERROR(format, ...) LOG_AT(LOG_LEVEL_ERROR, "[SERVER_ERROR] " format, ##__VA_ARGS__)
 
 #define DEFAULT_SOCKET_PATH "/tmp/ipc-demo.sock"
-#define BUFFER_SIZE 128
 #define MAX_NUMBER_PENDING_CONNECTIONS 1
 
+static const char replyMessage[] = ">>>>>Server return<<<<<";
+
 /* Global variable to control the loop */
-volatile bool isKeepRunning = true;
+volatile sig_atomic_t isKeepRunning = true;
+/* Signal that stopped the loop, 0 if none */
+volatile sig_atomic_t caughtSignal = 0;
 
 /* Signal handler function for SIGINT (Ctrl+C) */
 void handleSigint(int sig)
 {
-    LOG_INFO("Signal %d (Ctrl+C)", sig);
+    /* A handler that interrupts a log call must not log itself, the shutdown is logged once the loops end */
+    caughtSignal = sig;
     isKeepRunning = false;
 }
 
@@ -56,29 +68,141 @@ void cleanupAndExitError(int connSocket, int dataSocket, const char *socketPath)
     exit(EXIT_FAILURE);
 }
 
+/**
+ * Serve a seqpacket connection, or the datagram socket shared by every client. A message is exactly one frame,
+ * so no parser is needed: one recvmmsg() takes the waiting requests and their replies go back with one sendmmsg().
+ * Return 0 when the seqpacket client is gone, -1 on a receive error.
+ **/
+static int serveMessages(int sock, enum SocketMode mode, struct MsgBatch *requests, struct MsgBatch *replies)
+{
+    struct Frame frame;
+    socklen_t addressLength;
+    const struct sockaddr_un *address;
+    int numReceived, i;
+    bool isClosed = false;
+
+    while (isKeepRunning && !isClosed)
+    {
+        /* MSG_WAITFORONE blocks until the first message, then only takes the ones already queued */
+        LOG_INFO("Waiting for messages on fd[%d] using recvmmsg()", sock);
+        numReceived = msgBatchRecv(requests, sock, MSG_WAITFORONE);
+        if (numReceived < 0)
+        {
+            return -1;
+        }
+        for (i = 0; i < numReceived; ++i)
+        {
+            /* A frame is never empty, a zero-length message is the EOF of a seqpacket connection */
+            if (SOCKET_MODE_SEQPACKET == mode && 0 == requests->msgs[i].msg_len)
+            {
+                LOG_INFO("Received EOF message");
+                isClosed = true;
+                break;
+            }
+            if (msgBatchFrame(requests, i, &frame) < 0)
+            {
+                LOG_ERROR("Malformed message of %u bytes received", requests->msgs[i].msg_len);
+                if (SOCKET_MODE_SEQPACKET == mode)
+                {
+                    isClosed = true;
+                    break;
+                }
+                continue;
+            }
+
+            /* A datagram is answered at its sender address, a seqpacket message on the connection */
+            address = (SOCKET_MODE_DGRAM == mode) ? msgBatchAddress(requests, i, &addressLength) : NULL;
+            if (FRAME_TYPE_PING == frame.header.type)
+            {
+                /* Benchmark probe, echoed back without logging, the payload stays in the receive buffer until the send */
+                msgBatchQueue(replies, sock, FRAME_TYPE_PONG, frame.header.seq, frame.payload, frame.header.length, address, addressLength);
+                continue;
+            }
+            LOG_INFO("Received data (seq %u): [%.*s]", frame.header.seq, (int)frame.header.length, frame.payload);
+            msgBatchQueue(replies, sock, FRAME_TYPE_REPLY, frame.header.seq, replyMessage, sizeof(replyMessage) - 1, address, addressLength);
+        }
+
+        /* A client that is gone or does not read its replies only loses its own messages */
+        if (-1 == msgBatchSend(replies, sock))
+        {
+            LOG_ERROR("Sending back to client data failed");
+            if (SOCKET_MODE_SEQPACKET == mode)
+            {
+                isClosed = true;
+            }
+        }
+    }
+    return 0;
+}
+
+static void printUsage(const char *appName)
+{
+    printf("Usage: %s [-t " SOCKET_MODE_NAMES "] [-q high[:low]] [socket_path]\n", appName);
+    printf("  -t  Socket type, stream (default), seqpacket or dgram (connectionless)\n");
+    printf("  -q  Watermarks of the reply queue in bytes: the client is not read while more than high bytes of\n");
+    printf("      replies wait for it, until they drop to low (default %d:%d)\n", OUT_QUEUE_DEFAULT_HIGH_WATER, OUT_QUEUE_DEFAULT_LOW_WATER);
+}
+
 int main(int argc, char *argv[])
 {
+    enum SocketMode mode = SOCKET_MODE_STREAM;
+    size_t highWater = OUT_QUEUE_DEFAULT_HIGH_WATER, lowWater = OUT_QUEUE_DEFAULT_LOW_WATER;
+    int opt;
+    while (-1 != (opt = getopt(argc, argv, "t:q:h")))
+    {
+        switch (opt)
+        {
+            case 'q':
+                if (outQueueParseWatermarks(optarg, &highWater, &lowWater) < 0)
+                {
+                    printUsage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 't':
+                if (socketModeParse(optarg, &mode) < 0)
+                {
+                    printUsage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            default: printUsage(argv[0]); return (opt == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
     /* Register signal handler for SIGINT (Ctrl+C) */
     signal(SIGINT, handleSigint);
+    /* A client that goes away with pongs unread makes write() fail with EPIPE instead of killing the server */
+    signal(SIGPIPE, SIG_IGN);
     LOG_INFO("Press Ctrl+C to set the shutdown flag...");
 
     struct sockaddr_un structSocketInfo;
-    int connSocket = -1, dataSocket = -1, ret;
-    char buffer[BUFFER_SIZE];
+    int connSocket = -1, dataSocket = -1, ret, numQueued;
+    struct OutBatch replies;
+    struct BatchReader reader;
+    struct MsgBatch inMessages, outMessages;
+    struct IoStats ioStats;
+    struct BufferPool pool;
+    struct OutQueue output;
+    struct OutQueueStats outputStats;
+    struct pollfd pollFd;
+    char statsBuffer[256];
+    struct FrameParser parser;
+    struct Frame frame;
     /* Initialize socket path from application input parameter or default value */
-    const char *socketPath = (argc>1)?argv[1]:DEFAULT_SOCKET_PATH;
+    const char *socketPath = (argc>optind)?argv[optind]:DEFAULT_SOCKET_PATH;
 
     /* Remove the socket if it exists */
     unlink(socketPath);
 
     /* Create connection socket (master socket file descriptor) */
-    connSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+    connSocket = socket(AF_UNIX, socketModeType(mode), 0);
     if (-1 == connSocket)
     {
         LOG_ERROR("Creating a connection socket failed");
         cleanupAndExitError(-1, -1, socketPath);
     }
-    LOG_INFO("Connection socket created (%d)", connSocket);
+    LOG_INFO("Connection socket created (%d), %s mode", connSocket, socketModeName(mode));
 
     /* Initialize socket info structure */
     memset(&structSocketInfo, 0, sizeof(struct sockaddr_un));
@@ -94,23 +218,54 @@ int main(int argc, char *argv[])
     }
     LOG_INFO("Bind connection socket to path [%s] succeeded", socketPath);
 
-    /**
-     * Listen for incoming connections, the second parameter means that while a request is being processed,
-     * MAX_NUMBER_PENDING_CONNECTIONS requests can wait.
-     */
-    ret = listen(connSocket, MAX_NUMBER_PENDING_CONNECTIONS);
-    if (-1 == ret)
+    memset(&ioStats, 0, sizeof(ioStats));
+    bufferPoolInit(&pool);
+    ret = msgBatchInit(&inMessages, SOCKET_MESSAGE_MAX_SIZE, &ioStats);
+    if (-1 == ret || -1 == msgBatchInit(&outMessages, 0, &ioStats) || -1 == batchReaderInit(&reader, &ioStats))
     {
-        LOG_ERROR("Listening on socket failed");
+        LOG_ERROR("Allocating the receive buffers failed");
         cleanupAndExitError(connSocket, -1, socketPath);
     }
-    LOG_INFO("Listening for incoming connections...");
 
-    /* Main server loop */
-    while (isKeepRunning)
+    if (SOCKET_MODE_DGRAM == mode)
+    {
+        /* Nothing to listen to or accept, every client sends its datagrams to this one socket */
+        outMessages.sendFlags = MSG_DONTWAIT;
+        LOG_INFO("Receiving datagrams...");
+        if (-1 == serveMessages(connSocket, mode, &inMessages, &outMessages))
+        {
+            LOG_ERROR("recvmmsg() return error");
+            cleanupAndExitError(connSocket, -1, socketPath);
+        }
+        ioStatsFormat(&ioStats, statsBuffer, sizeof(statsBuffer));
+        LOG_INFO("I/O of all clients: %s", statsBuffer);
+    }
+    else
+    {
+        /**
+         * Listen for incoming connections, the second parameter means that while a request is being processed,
+         * MAX_NUMBER_PENDING_CONNECTIONS requests can wait.
+         */
+        ret = listen(connSocket, MAX_NUMBER_PENDING_CONNECTIONS);
+        if (-1 == ret)
+        {
+            LOG_ERROR("Listening on socket failed");
+            cleanupAndExitError(connSocket, -1, socketPath);
+        }
+        LOG_INFO("Listening for incoming connections...");
+    }
+
+
+    /* Main server loop, a datagram server has no connection to accept */
+    while (SOCKET_MODE_DGRAM != mode && isKeepRunning)
     {
         LOG_INFO("##### Waiting on accept()");
-        dataSocket = accept(connSocket, NULL, NULL);
+        /* A stream client is non-blocking, its replies wait in its output queue when it does not read them */
+        dataSocket = accept4(connSocket, NULL, NULL, (SOCKET_MODE_STREAM == mode) ? SOCK_NONBLOCK : 0);
+        if (-1 == dataSocket && EINTR == errno)
+        {
+            continue;
+        }
         if (-1 == dataSocket)
         {
             LOG_ERROR("accept() return error");
@@ -121,49 +276,136 @@ int main(int argc, char *argv[])
         /**------------------------------------------------------------------------
         *                Now the server and client can exchange data
         *------------------------------------------------------------------------**/
-        while (true)
+        memset(&ioStats, 0, sizeof(ioStats));
+        if (SOCKET_MODE_SEQPACKET == mode)
         {
-            /* Initialize the buffer array to 0 */
-            memset(buffer, 0, BUFFER_SIZE);
+            /* Message boundaries are kept by the socket, no frame parser */
+            if (-1 == serveMessages(dataSocket, mode, &inMessages, &outMessages))
+            {
+                LOG_ERROR("recvmmsg() return error");
+                cleanupAndExitError(connSocket, dataSocket, socketPath);
+            }
+            ioStatsFormat(&ioStats, statsBuffer, sizeof(statsBuffer));
+            LOG_INFO("I/O of fd[%d]: %s", dataSocket, statsBuffer);
+            close(dataSocket);
+            continue;
+        }
 
-            /* Read data from the client */
-            LOG_INFO("Waiting for data from the client's fd[%d] using read()", dataSocket);
-            ret = read(dataSocket, buffer, BUFFER_SIZE);
+        frameParserInit(&parser);
+        outBatchInit(&replies, &ioStats);
+        memset(&outputStats, 0, sizeof(outputStats));
+        outQueueInit(&output, &pool, &outputStats);
+        replies.queue = &output;
+        pollFd.fd = dataSocket;
+        while (isKeepRunning)
+        {
+            /* Wait until the client sends (unless its replies are backing up) or can take its queued replies */
+            pollFd.events = outQueueEvents(&output, highWater, lowWater);
+            LOG_INFO("Waiting for data from the client's fd[%d] using poll()", dataSocket);
+            ret = poll(&pollFd, 1, -1);
+            if (-1 == ret && EINTR == errno)
+            {
+                continue;
+            }
             if (-1 == ret)
             {
-                LOG_ERROR("read() return error");
+                LOG_ERROR("poll() return error");
                 cleanupAndExitError(connSocket, dataSocket, socketPath);
             }
+            if ((pollFd.revents & (POLLOUT | POLLERR)) && -1 == outQueueFlush(&output, dataSocket))
+            {
+                /* Only this client is lost, the server goes on with the next one */
+                LOG_ERROR("Sending back to client data failed, closing the connection");
+                break;
+            }
+            if (!(pollFd.revents & (POLLIN | POLLHUP | POLLERR)) || output.isReadPaused)
+            {
+                continue;
+            }
+
+            /* Read data from the client, straight into the large read buffer, or the parser holding a partial frame */
+            ret = batchReaderRead(&reader, &parser, dataSocket);
+            if (-1 == ret && (EAGAIN == errno || EINTR == errno))
+            {
+                continue;
+            }
+            if (-1 == ret)
+            {
+                LOG_ERROR("read() return error, closing the connection");
+                break;
+            }
             else if (/*EOF*/0 == ret)
             {
                 /* Once the client has closed the socket, the server will received the EOF message */
                 LOG_INFO("Received EOF message");
                 break;
             }
-            else
-            {
-                LOG_INFO("Received data: [%.*s]", /*number read*/ret, buffer);
 
-                /* Prepare data to send back to client */
-                memset(buffer, 0, BUFFER_SIZE);
-                snprintf(buffer, BUFFER_SIZE, ">>>>>Server return<<<<<");
+            /**
+             * One read() may carry several frames, or only a part of one which stays in the parser.
+             * The replies of back-to-back requests are queued and sent together with one writev().
+             **/
+            while ((ret = batchReaderNext(&reader, &frame)) > 0)
+            {
+                if (FRAME_TYPE_PING == frame.header.type)
+                {
+                    /* Benchmark probe, echoed back without logging, the payload stays in the read buffer until the flush */
+                    if (-1 == outBatchQueue(&replies, dataSocket, FRAME_TYPE_PONG, frame.header.seq, frame.payload, frame.header.length))
+                    {
+                        break;
+                    }
+                    continue;
+                }
+                LOG_INFO("Received data (seq %u): [%.*s]", frame.header.seq, (int)frame.header.length, frame.payload);
 
-                LOG_INFO("Send data to client: [%s]", buffer);
-                ret = write(dataSocket, buffer, strlen(buffer)+1);
-                if (-1 == ret)
+                /* Queue the data to send back to client */
+                if (-1 == outBatchQueue(&replies, dataSocket, FRAME_TYPE_REPLY, frame.header.seq, replyMessage, sizeof(replyMessage) - 1))
                 {
-                    LOG_ERROR("Sending back to client data failed");
-                    cleanupAndExitError(connSocket, dataSocket, socketPath);
+                    break;
                 }
-                LOG_INFO("Sending back to client data succeeded");
+            }
+            numQueued = replies.count;
+            if (ret > 0 || -1 == outBatchFlush(&replies, dataSocket))
+            {
+                /* A write failed (not a full socket, its bytes are queued), only this client is lost */
+                LOG_ERROR("Sending back to client data failed, closing the connection");
+                break;
+            }
+            if (numQueued > 0)
+            {
+                LOG_INFO("Sending back to client %d replies succeeded: [%s]", numQueued, replyMessage);
+            }
+            if (ret < 0)
+            {
+                LOG_ERROR("Malformed frame received, closing the connection");
+                break;
+            }
+            if (-1 == batchReaderFinish(&reader))
+            {
+                LOG_ERROR("Keeping a partial frame failed, closing the connection");
+                break;
             }
         }
+        batchReaderFinish(&reader);
+        frameParserRelease(&parser);
+        outQueueRelease(&output);
+        ioStatsFormat(&ioStats, statsBuffer, sizeof(statsBuffer));
+        LOG_INFO("I/O of fd[%d]: %s", dataSocket, statsBuffer);
+        outQueueStatsFormat(&outputStats, statsBuffer, sizeof(statsBuffer));
+        LOG_INFO("Replies of fd[%d]: %s", dataSocket, statsBuffer);
 
         /* Close data socket after communication is done */
         close(dataSocket);
     }
 
+    if (caughtSignal)
+    {
+        LOG_INFO("Signal %d (Ctrl+C)", caughtSignal);
+    }
     /* Perform clean up */
+    batchReaderRelease(&reader);
+    msgBatchRelease(&inMessages);
+    bufferPoolRelease(&pool);
     close(connSocket);
     unlink(socketPath);
     LOG_INFO("Server is down");
@@ -0,0 +1,283 @@
+/**------------------------------------------------------------------------------------------------
+ * ?                                           ABOUT
+ * @author         :  Nguyen Dinh Hoan
+ * @email          :  hoann.wk@gmail.com
+ * @repo           :  https://github.com/hoan9x/IPC-in-Linux
+ * @createdOn      :  16-Oct-2026
+ * @description    :  This example demonstrates a client negotiating a shared memory channel over a UNIX domain
+ *                    socket, then exchanging data through lock-free rings, or through the socket as a fallback
+ *------------------------------------------------------------------------------------------------**/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "../common/frame.h"
+#include "../common/fd_passing.h"
+#include "../common/shm_ring.h"
+#include "../common/log.h"
+
+/* LOG macro function */
+#define LOG_INFO(format, ...) LOG_AT(LOG_LEVEL_INFO, "[CLIENT_INFO] " format, ##__VA_ARGS__)
+#define LOG_ERROR(format, ...) LOG_AT(LOG_LEVEL_ERROR, "[CLIENT_ERROR] " format, ##__VA_ARGS__)
+
+#define DEFAULT_SOCKET_PATH "/tmp/ipc-demo.sock"
+#define BUFFER_SIZE 128
+#define DEFAULT_INTERVAL_MS 3000
+/* A server that died can not wake a futex, waits are bounded so the socket is checked for EOF regularly */
+#define SHM_PEER_CHECK_INTERVAL_MS 100
+
+/* Global variable to control the loop */
+volatile sig_atomic_t isKeepRunning = true;
+/* Signal that stopped the loop, 0 if none */
+volatile sig_atomic_t caughtSignal = 0;
+
+/* Signal handler function for SIGINT (Ctrl+C) */
+void handleSigint(int sig)
+{
+    /* The handler runs between any two instructions of the loop, even inside LOG_INFO(): it only records the signal */
+    caughtSignal = sig;
+    isKeepRunning = false;
+}
+
+/* Function to clean up resources and exit */
+void cleanupAndExitError(int dataSocket)
+{
+    if (-1 != dataSocket)
+    {
+        /* Close data socket if it is open */
+        close(dataSocket);
+    }
+
+    exit(EXIT_FAILURE);
+}
+
+/* Return true once the server has closed its end of the socket */
+static bool isPeerClosed(int dataSocket)
+{
+    struct pollfd pfd = {.fd = dataSocket, .events = POLLIN | POLLRDHUP};
+    return poll(&pfd, 1, 0) > 0 && (pfd.revents & (POLLRDHUP | POLLHUP | POLLERR));
+}
+
+/**
+ * Ask the server for a shared memory channel with rings of `capacity` bytes.
+ * Return the mapped channel, or NULL when the server refuses it and the socket is used instead.
+ **/
+static void *requestSharedMemory(int dataSocket, struct FrameParser *parser, uint32_t capacity, size_t *channelSize)
+{
+    struct Frame frame;
+    int fds[FD_PASSING_MAX_FDS];
+    int numFds = 0, received, ret;
+    void *channel = NULL;
+
+    if (frameWrite(dataSocket, FRAME_TYPE_SHM_REQUEST, 0, &capacity, sizeof(capacity)) < 0)
+    {
+        LOG_ERROR("Send shared memory request to server failed");
+        cleanupAndExitError(dataSocket);
+    }
+
+    /* The memfd is attached to the reply, so the reply is received with recvmsg() instead of read() */
+    while (0 == (ret = frameParserNext(parser, &frame)))
+    {
+        size_t space;
+        char *ptr = frameParserWritePtr(parser, FRAME_HEADER_SIZE, &space);
+        ssize_t numRead = ptr ? recvWithFds(dataSocket, ptr, space, fds + numFds, FD_PASSING_MAX_FDS - numFds, &received) : -1;
+        if (numRead <= 0)
+        {
+            LOG_ERROR("Received shared memory reply from server failed");
+            cleanupAndExitError(dataSocket);
+        }
+        frameParserCommit(parser, numRead);
+        numFds += received;
+    }
+
+    if (ret > 0 && FRAME_TYPE_SHM_ACCEPT == frame.header.type && 1 == numFds)
+    {
+        if (shmChannelMap(fds[0], &channel, channelSize) < 0)
+        {
+            LOG_ERROR("Mapping the shared memory channel failed (errno %d)", errno);
+            channel = NULL;
+        }
+    }
+    for (int i = 0; i < numFds; ++i)
+    {
+        /* The mapping stays valid after the memfd is closed */
+        close(fds[i]);
+    }
+    if (channel)
+    {
+        LOG_INFO("Shared memory channel of %zu bytes mapped", *channelSize);
+        return channel;
+    }
+    if (ret < 0 || (ret > 0 && FRAME_TYPE_SHM_ACCEPT == frame.header.type))
+    {
+        /* The server switched to shared memory, the socket can not be used for data any more */
+        LOG_ERROR("Unusable shared memory reply from server");
+        cleanupAndExitError(dataSocket);
+    }
+    LOG_INFO("Server refused the shared memory channel, using the socket");
+    return NULL;
+}
+
+/* Send one request and wait for its reply through the shared memory channel, return 0 or -1 */
+static int exchangeSharedMemory(int dataSocket, void *channel, size_t channelSize, int index, const char *data, int length)
+{
+    struct ShmRingView ringOut, ringIn;
+    shmChannelRing(channel, channelSize, SHM_TO_SERVER, &ringOut);
+    shmChannelRing(channel, channelSize, SHM_TO_CLIENT, &ringIn);
+    struct Frame frame;
+    int ret;
+
+    while (shmRingSend(&ringOut, FRAME_TYPE_DATA, (uint32_t)index, data, length) < 0)
+    {
+        if (EMSGSIZE == errno || (0 == shmRingWaitWritable(&ringOut, length, SHM_PEER_CHECK_INTERVAL_MS) && isPeerClosed(dataSocket)))
+            return -1;
+    }
+
+    while (0 == (ret = shmRingPeek(&ringIn, &frame)))
+    {
+        if (0 == shmRingWaitReadable(&ringIn, SHM_PEER_CHECK_INTERVAL_MS) && isPeerClosed(dataSocket))
+            return -1;
+    }
+    if (ret < 0)
+        return -1;
+    LOG_INFO("Received data (seq %u): [%.*s]", frame.header.seq, (int)frame.header.length, frame.payload);
+    shmRingConsume(&ringIn, &frame);
+    return 0;
+}
+
+/* Send one request and wait for its reply through the socket, return 0 or -1 */
+static int exchangeSocket(int dataSocket, struct FrameParser *parser, int index, const char *data, int length)
+{
+    struct Frame frame;
+    int ret;
+
+    if (frameWrite(dataSocket, FRAME_TYPE_DATA, (uint32_t)index, data, length) < 0)
+        return -1;
+    /* Keep reading until a whole reply frame has arrived */
+    while (0 == (ret = frameParserNext(parser, &frame)))
+    {
+        if (frameParserRead(parser, dataSocket) <= 0)
+            return -1;
+    }
+    if (ret < 0)
+        return -1;
+    LOG_INFO("Received data (seq %u): [%.*s]", frame.header.seq, (int)frame.header.length, frame.payload);
+    return 0;
+}
+
+static void printUsage(const char *appName)
+{
+    printf("Usage: %s [-i interval_ms] [-c count] [-r ring_bytes] [-s] [socket_path]\n", appName);
+    printf("  -i  Delay between two messages in milliseconds (default %d)\n", DEFAULT_INTERVAL_MS);
+    printf("  -c  Number of messages to send, 0 sends until Ctrl+C (default 0)\n");
+    printf("  -r  Requested capacity of each shared memory ring in bytes (default %u)\n", SHM_RING_DEFAULT_CAPACITY);
+    printf("  -s  Do not request shared memory, exchange data through the socket only\n");
+}
+
+int main(int argc, char *argv[])
+{
+    int intervalMs = DEFAULT_INTERVAL_MS, count = 0, opt;
+    uint32_t ringCapacity = SHM_RING_DEFAULT_CAPACITY;
+    bool isSharedMemoryWanted = true;
+    while (-1 != (opt = getopt(argc, argv, "i:c:r:sh")))
+    {
+        switch (opt)
+        {
+            case 'i': intervalMs = atoi(optarg); break;
+            case 'c': count = atoi(optarg); break;
+            case 'r': ringCapacity = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 's': isSharedMemoryWanted = false; break;
+            default: printUsage(argv[0]); return (opt == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    /* Register signal handler for SIGINT (Ctrl+C) */
+    signal(SIGINT, handleSigint);
+    LOG_INFO("Press Ctrl+C to set the shutdown flag...");
+
+    struct sockaddr_un structSocketInfo;
+    int dataSocket = -1, ret, index;
+    char buffer[BUFFER_SIZE];
+    struct FrameParser parser;
+    struct timespec startTime, endTime;
+    void *channel = NULL;
+    size_t channelSize = 0;
+    /* Initialize socket path from application input parameter or default value */
+    const char *socketPath = (argc>optind)?argv[optind]:DEFAULT_SOCKET_PATH;
+
+    /* Create data socket */
+    dataSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (-1 == dataSocket)
+    {
+        LOG_ERROR("Creating a data socket failed");
+        cleanupAndExitError(dataSocket);
+    }
+    LOG_INFO("Data socket created");
+
+    /* Initialize socket info structure */
+    memset(&structSocketInfo, 0, sizeof(struct sockaddr_un));
+    structSocketInfo.sun_family = AF_UNIX;
+    strncpy(structSocketInfo.sun_path, socketPath, sizeof(structSocketInfo.sun_path)-1);
+
+    LOG_INFO("Request connection from socket path: [%s]", socketPath);
+    ret = connect(dataSocket, (const struct sockaddr *)&structSocketInfo, sizeof(struct sockaddr_un));
+    if (-1 == ret)
+    {
+        LOG_ERROR("Connection request failed, server is down");
+        cleanupAndExitError(dataSocket);
+    }
+
+    /**------------------------------------------------------------------------
+     *     Negotiate the transport, then the server and client exchange data
+     *------------------------------------------------------------------------**/
+    frameParserInit(&parser);
+    if (isSharedMemoryWanted)
+    {
+        channel = requestSharedMemory(dataSocket, &parser, ringCapacity, &channelSize);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+    for (index = 0; isKeepRunning && (0 == count || index < count); ++index)
+    {
+        /* Prepare data to send to server, the frame header carries its length so no terminating NUL is sent */
+        ret = snprintf(buffer, BUFFER_SIZE, ">>>>>Client data (%d)<<<<<", index);
+
+        LOG_INFO("Send data to server: [%s]", buffer);
+        ret = channel ? exchangeSharedMemory(dataSocket, channel, channelSize, index, buffer, ret)
+                      : exchangeSocket(dataSocket, &parser, index, buffer, ret);
+        if (-1 == ret)
+        {
+            LOG_ERROR("Exchanging data with server failed");
+            cleanupAndExitError(dataSocket);
+        }
+        if (intervalMs > 0)
+        {
+            usleep(intervalMs * 1000);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &endTime);
+    double elapsed = (endTime.tv_sec - startTime.tv_sec) + (endTime.tv_nsec - startTime.tv_nsec) / 1e9;
+    LOG_INFO("%d round trips through %s in %.3f s (%.0f msg/s)", index, channel ? "shared memory" : "the socket",
+             elapsed, elapsed > 0 ? index / elapsed : 0.0);
+
+    if (caughtSignal)
+    {
+        LOG_INFO("Signal %d (Ctrl+C)", caughtSignal);
+    }
+    /* Close socket, the server sees the EOF and releases its side of the channel */
+    shmChannelUnmap(channel, channelSize);
+    frameParserRelease(&parser);
+    close(dataSocket);
+    LOG_INFO("Client is down");
+
+    return  EXIT_SUCCESS;
+}
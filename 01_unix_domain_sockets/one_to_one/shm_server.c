@@ -0,0 +1,329 @@
+/**------------------------------------------------------------------------------------------------
+ * ?                                           ABOUT
+ * @author         :  Nguyen Dinh Hoan
+ * @email          :  hoann.wk@gmail.com
+ * @repo           :  https://github.com/hoan9x/IPC-in-Linux
+ * @createdOn      :  16-Oct-2026
+ * @description    :  This example demonstrates a UNIX domain socket server that moves the message exchange
+ *                    to lock-free rings in shared memory, the socket only carries the negotiation
+ *------------------------------------------------------------------------------------------------**/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "../common/frame.h"
+#include "../common/fd_passing.h"
+#include "../common/shm_ring.h"
+#include "../common/log.h"
+
+/* LOG macro function */
+#define LOG_INFO(format, ...) LOG_AT(LOG_LEVEL_INFO, "[SERVER_INFO] " format, ##__VA_ARGS__)
+#define LOG_ERROR(format, ...) LOG_AT(LOG_LEVEL_ERROR, "[SERVER_ERROR] " format, ##__VA_ARGS__)
+
+#define DEFAULT_SOCKET_PATH "/tmp/ipc-demo.sock"
+#define BUFFER_SIZE 128
+#define MAX_NUMBER_PENDING_CONNECTIONS 1
+/* A peer that died can not wake a futex, waits are bounded so the socket is checked for EOF regularly */
+#define SHM_PEER_CHECK_INTERVAL_MS 100
+
+/* Global variable to control the loop */
+volatile sig_atomic_t isKeepRunning = true;
+/* Signal that stopped the loop, 0 if none */
+volatile sig_atomic_t caughtSignal = 0;
+
+/* Signal handler function for SIGINT (Ctrl+C) */
+void handleSigint(int sig)
+{
+    /* Nothing that locks or allocates, the main thread reports the signal on its way out */
+    caughtSignal = sig;
+    isKeepRunning = false;
+}
+
+/* Function to clean up resources and exit */
+void cleanupAndExitError(int connSocket, int dataSocket, const char *socketPath)
+{
+    if (-1 != dataSocket)
+    {
+        /* Close data socket if it is open */
+        close(dataSocket);
+    }
+    if (-1 != connSocket)
+    {
+        /* Close connection socket (master socket file descriptor) if it is open */
+        close(connSocket);
+    }
+    if (socketPath)
+    {
+        /* Remove the socket file */
+        unlink(socketPath);
+    }
+
+    exit(EXIT_FAILURE);
+}
+
+/* Return true once the client has closed its end of the socket, the socket carries no data in shared memory mode */
+static bool isPeerClosed(int dataSocket)
+{
+    struct pollfd pfd = {.fd = dataSocket, .events = POLLIN | POLLRDHUP};
+    return poll(&pfd, 1, 0) > 0 && (pfd.revents & (POLLRDHUP | POLLHUP | POLLERR));
+}
+
+/**
+ * Serve the client through the shared memory channel until it closes the socket: requests are taken from
+ * the ring to the server and answered in the ring to the client, both without any syscall while the rings
+ * are neither empty nor full.
+ **/
+static void serveSharedMemory(int dataSocket, void *channel, size_t channelSize)
+{
+    struct ShmRingView ringIn, ringOut;
+    shmChannelRing(channel, channelSize, SHM_TO_SERVER, &ringIn);
+    shmChannelRing(channel, channelSize, SHM_TO_CLIENT, &ringOut);
+    char buffer[BUFFER_SIZE];
+    struct Frame frame;
+    int ret;
+
+    while (isKeepRunning)
+    {
+        if (0 == shmRingWaitReadable(&ringIn, SHM_PEER_CHECK_INTERVAL_MS))
+        {
+            if (isPeerClosed(dataSocket))
+            {
+                LOG_INFO("Received EOF message");
+                return;
+            }
+            continue;
+        }
+
+        while ((ret = shmRingPeek(&ringIn, &frame)) > 0)
+        {
+            if (FRAME_TYPE_PING == frame.header.type)
+            {
+                /* Benchmark probe, echoed back without logging */
+                while (shmRingSend(&ringOut, FRAME_TYPE_PONG, frame.header.seq, frame.payload, frame.header.length) < 0)
+                {
+                    if (EMSGSIZE == errno ||
+                        (0 == shmRingWaitWritable(&ringOut, frame.header.length, SHM_PEER_CHECK_INTERVAL_MS) && isPeerClosed(dataSocket)))
+                        return;
+                }
+                shmRingConsume(&ringIn, &frame);
+                continue;
+            }
+            LOG_INFO("Received data from shared memory (seq %u): [%.*s]", frame.header.seq, (int)frame.header.length, frame.payload);
+
+            /* Prepare data to send back to client */
+            ret = snprintf(buffer, BUFFER_SIZE, ">>>>>Server return<<<<<");
+            while (shmRingSend(&ringOut, FRAME_TYPE_REPLY, frame.header.seq, buffer, ret) < 0)
+            {
+                /* The client does not drain its ring, wait for room unless it is gone */
+                if (0 == shmRingWaitWritable(&ringOut, ret, SHM_PEER_CHECK_INTERVAL_MS) && isPeerClosed(dataSocket))
+                {
+                    LOG_INFO("Received EOF message");
+                    return;
+                }
+            }
+            LOG_INFO("Send data to client through shared memory: [%s]", buffer);
+            shmRingConsume(&ringIn, &frame);
+        }
+        if (ret < 0)
+        {
+            LOG_ERROR("Shared memory ring corrupted, closing the connection");
+            return;
+        }
+    }
+}
+
+/**
+ * Answer a FRAME_TYPE_SHM_REQUEST: create the channel and pass its memfd to the client.
+ * Return the mapped channel, or NULL after telling the client to keep using the socket.
+ **/
+static void *acceptSharedMemory(int dataSocket, const struct Frame *frame, size_t *channelSize)
+{
+    uint32_t capacity = SHM_RING_DEFAULT_CAPACITY;
+    void *channel = NULL;
+    if (frame->header.length >= sizeof(capacity))
+    {
+        memcpy(&capacity, frame->payload, sizeof(capacity));
+    }
+
+    int memFd = shmChannelCreate(capacity, &channel, channelSize);
+    if (memFd < 0)
+    {
+        LOG_ERROR("Creating the shared memory channel failed (errno %d), keep using the socket", errno);
+        frameWrite(dataSocket, FRAME_TYPE_SHM_REJECT, frame->header.seq, NULL, 0);
+        return NULL;
+    }
+    /* The client maps its own copy of the memfd, this one is not needed once it is sent */
+    int ret = frameWriteWithFds(dataSocket, FRAME_TYPE_SHM_ACCEPT, frame->header.seq, NULL, 0, &memFd, 1);
+    close(memFd);
+    if (ret < 0)
+    {
+        LOG_ERROR("Sending the shared memory channel failed");
+        shmChannelUnmap(channel, *channelSize);
+        return NULL;
+    }
+    LOG_INFO("Shared memory channel of %zu bytes sent to the client", *channelSize);
+    return channel;
+}
+
+int main(int argc, char *argv[])
+{
+    /* Register signal handler for SIGINT (Ctrl+C) */
+    signal(SIGINT, handleSigint);
+    /* Replies to a client that is gone fail with EPIPE, they must not kill the server */
+    signal(SIGPIPE, SIG_IGN);
+    LOG_INFO("Press Ctrl+C to set the shutdown flag...");
+
+    struct sockaddr_un structSocketInfo;
+    int connSocket = -1, dataSocket = -1, ret;
+    char buffer[BUFFER_SIZE];
+    struct FrameParser parser;
+    struct Frame frame;
+    void *channel = NULL;
+    size_t channelSize = 0;
+    /* Initialize socket path from application input parameter or default value */
+    const char *socketPath = (argc>1)?argv[1]:DEFAULT_SOCKET_PATH;
+
+    /* Remove the socket if it exists */
+    unlink(socketPath);
+
+    /* Create connection socket (master socket file descriptor) */
+    connSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (-1 == connSocket)
+    {
+        LOG_ERROR("Creating a connection socket failed");
+        cleanupAndExitError(-1, -1, socketPath);
+    }
+    LOG_INFO("Connection socket created (%d)", connSocket);
+
+    /* Initialize socket info structure */
+    memset(&structSocketInfo, 0, sizeof(struct sockaddr_un));
+    structSocketInfo.sun_family = AF_UNIX;
+    strncpy(structSocketInfo.sun_path, socketPath, sizeof(structSocketInfo.sun_path)-1);
+
+    /* Bind connection socket to path */
+    ret = bind(connSocket, (const struct sockaddr *)&structSocketInfo, sizeof(struct sockaddr_un));
+    if (-1 == ret)
+    {
+        LOG_ERROR("Bind connection socket to path failed");
+        cleanupAndExitError(connSocket, -1, socketPath);
+    }
+    LOG_INFO("Bind connection socket to path [%s] succeeded", socketPath);
+
+    /**
+     * Listen for incoming connections, the second parameter means that while a request is being processed,
+     * MAX_NUMBER_PENDING_CONNECTIONS requests can wait.
+     */
+    ret = listen(connSocket, MAX_NUMBER_PENDING_CONNECTIONS);
+    if (-1 == ret)
+    {
+        LOG_ERROR("Listening on socket failed");
+        cleanupAndExitError(connSocket, -1, socketPath);
+    }
+    LOG_INFO("Listening for incoming connections...");
+
+    /* Main server loop */
+    while (isKeepRunning)
+    {
+        LOG_INFO("##### Waiting on accept()");
+        dataSocket = accept(connSocket, NULL, NULL);
+        if (-1 == dataSocket)
+        {
+            LOG_ERROR("accept() return error");
+            cleanupAndExitError(connSocket, dataSocket, socketPath);
+        }
+        LOG_INFO("Connection established (%d)", dataSocket);
+
+        /**------------------------------------------------------------------------
+        *                Now the server and client can exchange data
+        *------------------------------------------------------------------------**/
+        frameParserInit(&parser);
+        while (true)
+        {
+            /* Read data from the client, straight into the frame parser buffer */
+            LOG_INFO("Waiting for data from the client's fd[%d] using read()", dataSocket);
+            ret = frameParserRead(&parser, dataSocket);
+            if (-1 == ret)
+            {
+                LOG_ERROR("read() return error");
+                cleanupAndExitError(connSocket, dataSocket, socketPath);
+            }
+            else if (/*EOF*/0 == ret)
+            {
+                /* Once the client has closed the socket, the server will received the EOF message */
+                LOG_INFO("Received EOF message");
+                break;
+            }
+
+            /* One read() may carry several frames, or only a part of one which stays in the parser */
+            while ((ret = frameParserNext(&parser, &frame)) > 0)
+            {
+                if (FRAME_TYPE_SHM_REQUEST == frame.header.type)
+                {
+                    /* From now on the messages go through shared memory, the socket only reports the EOF */
+                    channel = acceptSharedMemory(dataSocket, &frame, &channelSize);
+                    if (channel)
+                        break;
+                    continue;
+                }
+                if (FRAME_TYPE_PING == frame.header.type)
+                {
+                    /* Benchmark probe, echoed back without logging */
+                    if (-1 == frameWrite(dataSocket, FRAME_TYPE_PONG, frame.header.seq, frame.payload, frame.header.length))
+                    {
+                        LOG_ERROR("Answering ping failed");
+                        cleanupAndExitError(connSocket, dataSocket, socketPath);
+                    }
+                    continue;
+                }
+                LOG_INFO("Received data (seq %u): [%.*s]", frame.header.seq, (int)frame.header.length, frame.payload);
+
+                /* Prepare data to send back to client */
+                ret = snprintf(buffer, BUFFER_SIZE, ">>>>>Server return<<<<<");
+
+                LOG_INFO("Send data to client: [%s]", buffer);
+                ret = frameWrite(dataSocket, FRAME_TYPE_REPLY, frame.header.seq, buffer, ret);
+                if (-1 == ret)
+                {
+                    LOG_ERROR("Sending back to client data failed");
+                    cleanupAndExitError(connSocket, dataSocket, socketPath);
+                }
+                LOG_INFO("Sending back to client data succeeded");
+            }
+            if (ret < 0)
+            {
+                LOG_ERROR("Malformed frame received, closing the connection");
+                break;
+            }
+            if (channel)
+            {
+                serveSharedMemory(dataSocket, channel, channelSize);
+                shmChannelUnmap(channel, channelSize);
+                channel = NULL;
+                break;
+            }
+        }
+        frameParserRelease(&parser);
+
+        /* Close data socket after communication is done */
+        close(dataSocket);
+    }
+
+    if (caughtSignal)
+    {
+        LOG_INFO("Signal %d (Ctrl+C)", caughtSignal);
+    }
+    /* Perform clean up */
+    close(connSocket);
+    unlink(socketPath);
+    LOG_INFO("Server is down");
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,34 @@
+#!/bin/bash
+#
+# Run the benchmark suite and optionally gate it against a previous result.
+#   script/benchmark.sh [ipc_bench.app options]
+# Environment:
+#   BENCH_OUTPUT     CSV result file (default output_build/benchmark.csv)
+#   BENCH_BASELINE   CSV result of a previous run, the script fails if a run got slower than it
+#   BENCH_TOLERANCE  Allowed throughput drop in percent before failing (default 10)
+
+pwd_dir="$( cd "$( dirname "$0" )" && pwd )"
+build_out_dir=$pwd_dir/../output_build
+output=${BENCH_OUTPUT:-$build_out_dir/benchmark.csv}
+tolerance=${BENCH_TOLERANCE:-10}
+
+bash $pwd_dir/build.sh || exit 1
+$build_out_dir/ipc_bench.app -f csv "$@" > "$output" || exit 1
+echo "Results written to $output"
+
+if [ -n "$BENCH_BASELINE" ]; then
+    # Runs are matched on server, clients and size, msgs_per_sec is column 6
+    awk -F, -v tolerance="$tolerance" '
+        FNR == 1 { next }
+        NR == FNR { baseline[$1 FS $2 FS $3] = $6; next }
+        ($1 FS $2 FS $3) in baseline {
+            old = baseline[$1 FS $2 FS $3]
+            if (old > 0 && $6 < old * (1 - tolerance / 100)) {
+                printf "REGRESSION %s clients=%s size=%s: %s msgs/s, baseline %s\n", $1, $2, $3, $6, old
+                failed = 1
+            }
+        }
+        END { exit failed }
+    ' "$BENCH_BASELINE" "$output" || exit 1
+    echo "No regression above $tolerance% against $BENCH_BASELINE"
+fi
@@ -2,13 +2,27 @@
 
 pwd_dir="$( cd "$( dirname "$0" )" && pwd )"
 build_out_dir=$pwd_dir/../output_build
+common_dir=$pwd_dir/../common
 
 mkdir -p $build_out_dir
 
-gcc $pwd_dir/../one_to_one/server.c -o $build_out_dir/server.app
-gcc $pwd_dir/../one_to_one/client.c -o $build_out_dir/client.app
+gcc $pwd_dir/../one_to_one/server.c $common_dir/frame.c $common_dir/buffer_pool.c $common_dir/batch_io.c $common_dir/socket_mode.c $common_dir/fd_passing.c $common_dir/log.c -pthread -o $build_out_dir/server.app
+gcc $pwd_dir/../one_to_one/client.c $common_dir/frame.c $common_dir/buffer_pool.c $common_dir/batch_io.c $common_dir/socket_mode.c $common_dir/fd_passing.c $common_dir/log.c -pthread -o $build_out_dir/client.app
+gcc $pwd_dir/../one_to_one/shm_server.c $common_dir/frame.c $common_dir/buffer_pool.c $common_dir/fd_passing.c $common_dir/shm_ring.c $common_dir/log.c -pthread -o $build_out_dir/shm_server.app
+gcc $pwd_dir/../one_to_one/shm_client.c $common_dir/frame.c $common_dir/buffer_pool.c $common_dir/fd_passing.c $common_dir/shm_ring.c $common_dir/log.c -pthread -o $build_out_dir/shm_client.app
 
-gcc $pwd_dir/../one_to_many/server.c -o $build_out_dir/multiplexing_server.app
-gcc $pwd_dir/../one_to_many/server2.c -o $build_out_dir/multiplexing_server2.app
-gcc $pwd_dir/../one_to_many/server3.c -o $build_out_dir/multiplexing_server3.app
-gcc $pwd_dir/../one_to_many/client.c -o $build_out_dir/many_client.app
+gcc $pwd_dir/../one_to_many/server.c $common_dir/conn_table.c $common_dir/frame.c $common_dir/buffer_pool.c $common_dir/batch_io.c $common_dir/socket_mode.c $common_dir/fd_passing.c $common_dir/bulk_payload.c $common_dir/splice_relay.c $common_dir/accept_batch.c $common_dir/timer_wheel.c $common_dir/log.c -pthread -o $build_out_dir/multiplexing_server.app
+gcc $pwd_dir/../one_to_many/server2.c $common_dir/conn_table.c $common_dir/frame.c $common_dir/buffer_pool.c $common_dir/batch_io.c $common_dir/socket_mode.c $common_dir/fd_passing.c $common_dir/accept_batch.c $common_dir/timer_wheel.c $common_dir/hot_restart.c $common_dir/log.c -pthread -o $build_out_dir/multiplexing_server2.app
+gcc $pwd_dir/../one_to_many/server3.c $common_dir/conn_table.c $common_dir/frame.c $common_dir/buffer_pool.c $common_dir/batch_io.c $common_dir/socket_mode.c $common_dir/fd_passing.c $common_dir/accept_batch.c $common_dir/log.c -pthread -o $build_out_dir/multiplexing_server3.app
+gcc $pwd_dir/../one_to_many/server4.c $common_dir/frame.c $common_dir/buffer_pool.c $common_dir/batch_io.c $common_dir/socket_mode.c $common_dir/fd_passing.c $common_dir/metrics.c $common_dir/accept_batch.c $common_dir/loop_control.c $common_dir/work_pool.c $common_dir/log.c -pthread -o $build_out_dir/multiplexing_server4.app
+gcc $pwd_dir/../one_to_many/server5.c $common_dir/conn_table.c $common_dir/frame.c $common_dir/buffer_pool.c $common_dir/log.c -pthread -o $build_out_dir/multiplexing_server5.app
+gcc $pwd_dir/../one_to_many/server6.c $common_dir/frame.c $common_dir/buffer_pool.c $common_dir/batch_io.c $common_dir/fd_passing.c $common_dir/metrics.c $common_dir/accept_batch.c $common_dir/loop_control.c $common_dir/log.c -pthread -o $build_out_dir/multiplexing_server6.app
+gcc $pwd_dir/../one_to_many/server7.c $common_dir/frame.c $common_dir/buffer_pool.c $common_dir/pubsub.c $common_dir/accept_batch.c $common_dir/log.c -pthread -o $build_out_dir/multiplexing_server7.app
+# The coroutine server is C++20, the common C modules are compiled as C and linked in
+mkdir -p $build_out_dir/server8_obj
+(cd $build_out_dir/server8_obj && gcc -c $common_dir/conn_table.c $common_dir/frame.c $common_dir/buffer_pool.c $common_dir/accept_batch.c $common_dir/log.c)
+g++ -std=c++20 $pwd_dir/../one_to_many/server8.cpp $common_dir/coro_loop.cpp $build_out_dir/server8_obj/*.o -pthread -o $build_out_dir/multiplexing_server8.app
+gcc $pwd_dir/../one_to_many/client.c $common_dir/frame.c $common_dir/buffer_pool.c $common_dir/socket_mode.c $common_dir/fd_passing.c $common_dir/bulk_payload.c $common_dir/log.c -pthread -o $build_out_dir/many_client.app
+
+gcc $pwd_dir/../benchmark/bench.c $common_dir/frame.c $common_dir/buffer_pool.c $common_dir/histogram.c $common_dir/socket_mode.c -pthread -o $build_out_dir/ipc_bench.app
+gcc $pwd_dir/../benchmark/loadgen.c $common_dir/frame.c $common_dir/buffer_pool.c $common_dir/histogram.c -lm -o $build_out_dir/ipc_loadgen.app